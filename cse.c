@@ -0,0 +1,497 @@
+/*cse.c*/
+
+//
+// << Common-subexpression elimination: numbers the values computed in
+//    each basic block, and reuses a variable that already holds the
+//    value of an expression instead of computing it again. >>
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#define _POSIX_C_SOURCE 200809L  // strdup
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+
+#include "programgraph.h"
+#include "ram.h"
+#include "resolve.h"
+#include "cse.h"
+
+
+//
+// what a value number stands for: a binary expression (its operator,
+// see entry_kind), or one of
+//
+#define VN_LITERAL (-1)  // a literal, compared by text
+#define VN_ADDR    (-2)  // &x: lhs is x's slot
+#define VN_DEREF   (-3)  // *p: lhs is p's value number, rhs the memory epoch
+
+struct VN_ENTRY
+{
+  int kind;     // see above
+  int lhs;      // value numbers of the operands (or see above)
+  int rhs;
+  struct ELEMENT* literal;  // VN_LITERAL only
+  int vn;       // the value number
+};
+
+struct CSE
+{
+  struct SLOT_TABLE* slots;
+
+  bool* aliased;  // aliased[slot] => a pointer may reach the variable
+  int*  values;   // values[slot] = # of the value the variable holds, 0 => not known yet
+
+  struct VN_ENTRY* entries;  // the values numbered in the current basic block
+  int num_entries;
+  int capacity;
+
+  int next_vn;   // next value number to hand out
+  int epoch;     // bumped whenever a pointer may have written memory
+  int reused;    // # of expressions replaced
+};
+
+
+//
+// Private functions:
+//
+
+//
+// fresh_vn
+//
+// Returns a value number that stands for nothing else.
+//
+static int fresh_vn(struct CSE* cse)
+{
+	return cse->next_vn++;
+}
+
+//
+// number
+//
+// Returns (through vn) the value number of the given value, numbering
+// it if it hasn't been seen in the current basic block. Returns false
+// if memory could not be allocated.
+//
+static bool number(struct CSE* cse, int kind, int lhs, int rhs, struct ELEMENT* literal, int* vn)
+{
+	for (int i = 0; i < cse->num_entries; i++) {
+		struct VN_ENTRY* entry = &cse->entries[i];
+
+		if (entry->kind == kind && entry->lhs == lhs && entry->rhs == rhs &&
+			(literal == NULL || strcmp(entry->literal->element_value, literal->element_value) == 0)) {
+			*vn = entry->vn;
+			return true;
+		}
+	}
+
+	if (cse->num_entries == cse->capacity) {
+		int capacity = (cse->capacity == 0) ? 16 : cse->capacity * 2;
+		struct VN_ENTRY* entries = (struct VN_ENTRY*)realloc(cse->entries, capacity * sizeof(struct VN_ENTRY));
+		if (entries == NULL) {
+			return false;
+		}
+		cse->entries = entries;
+		cse->capacity = capacity;
+	}
+
+	struct VN_ENTRY* entry = &cse->entries[cse->num_entries++];
+	entry->kind = kind;
+	entry->lhs = lhs;
+	entry->rhs = rhs;
+	entry->literal = literal;
+	entry->vn = fresh_vn(cse);
+
+	*vn = entry->vn;
+	return true;
+}
+
+//
+// variable_vn
+//
+// Returns the value number of the value the variable in slot holds.
+//
+static int variable_vn(struct CSE* cse, int slot)
+{
+	if (cse->values[slot] == 0) {
+		cse->values[slot] = fresh_vn(cse);
+	}
+	return cse->values[slot];
+}
+
+//
+// operand_vn
+//
+// Returns (through vn) the value number of the given operand. The
+// executor ignores unary + and -, so we do too. Returns false if
+// memory could not be allocated.
+//
+static bool operand_vn(struct CSE* cse, struct UNARY_EXPR* expr, int* vn)
+{
+	struct ELEMENT* element = expr->element;
+
+	if (element->element_type != ELEMENT_IDENTIFIER) {
+		if (expr->expr_type == UNARY_PTR_DEREF || expr->expr_type == UNARY_ADDRESS_OF) {
+			*vn = fresh_vn(cse);  // an error
+			return true;
+		}
+		return number(cse, VN_LITERAL, element->element_type, 0, element, vn);
+	}
+
+	switch (expr->expr_type) {
+		case UNARY_ADDRESS_OF:
+			return number(cse, VN_ADDR, element->slot, 0, NULL, vn);
+
+		case UNARY_PTR_DEREF:
+			return number(cse, VN_DEREF, variable_vn(cse, element->slot), cse->epoch, NULL, vn);
+
+		default:
+			*vn = variable_vn(cse, element->slot);
+			return true;
+	}
+}
+
+//
+// entry_kind
+//
+// The kind of value number for the given binary expression: whether
+// an operand is dereferenced matters too, since *p + 1 isn't pointer
+// arithmetic even if *p is a pointer.
+//
+static int entry_kind(struct EXPR* expr)
+{
+	return expr->operator * 4 +
+		(expr->lhs->expr_type == UNARY_PTR_DEREF) * 2 +
+		(expr->rhs->expr_type == UNARY_PTR_DEREF);
+}
+
+//
+// holder
+//
+// Returns the slot of a variable that holds the value with the given
+// number, or -1 if there is none.
+//
+static int holder(struct CSE* cse, int vn)
+{
+	for (int slot = 0; slot < cse->slots->num_slots; slot++) {
+		if (cse->values[slot] == vn) {
+			return slot;
+		}
+	}
+	return -1;
+}
+
+//
+// reuse
+//
+// Replaces the given binary expression by the variable in slot, which
+// holds its value. Returns false if memory could not be allocated, in
+// which case the expression is left alone.
+//
+static bool reuse(struct CSE* cse, struct EXPR* expr, int slot)
+{
+	struct ELEMENT* element = (struct ELEMENT*)programgraph_alloc(expr, sizeof(struct ELEMENT));
+	if (element == NULL) {
+		return false;
+	}
+
+	element->element_type = ELEMENT_IDENTIFIER;
+	element->element_value = programgraph_strdup(expr, cse->slots->names[slot]);
+	element->slot = slot;
+	element->constant = NULL;
+	element->type = expr->type;
+
+	if (element->element_value == NULL) {
+		return false;
+	}
+
+	// the old operands stay in the graph's arena, which frees them with the graph
+
+	expr->lhs->expr_type = UNARY_ELEMENT;
+	expr->lhs->element = element;
+	expr->isBinaryExpr = false;
+	expr->operator = OPERATOR_NO_OP;
+	expr->rhs = NULL;
+	expr->cache_key = 0;
+	expr->proven_key = 0;
+
+	cse->reused++;
+	return true;
+}
+
+//
+// expr_vn
+//
+// Returns (through vn) the value number of the given expression,
+// replacing it by a variable that holds the value already if there is
+// one. Returns false if memory could not be allocated.
+//
+static bool expr_vn(struct CSE* cse, struct EXPR* expr, int* vn)
+{
+	int lhs, rhs;
+
+	if (!operand_vn(cse, expr->lhs, &lhs)) {
+		return false;
+	}
+
+	if (!expr->isBinaryExpr) {
+		*vn = lhs;
+		return true;
+	}
+
+	int seen = cse->num_entries;
+
+	if (!operand_vn(cse, expr->rhs, &rhs) || !number(cse, entry_kind(expr), lhs, rhs, NULL, vn)) {
+		return false;
+	}
+
+	// numbered before (and not just now)?
+	bool known = false;
+	for (int i = 0; i < seen && !known; i++) {
+		known = (cse->entries[i].vn == *vn);
+	}
+
+	int slot = known ? holder(cse, *vn) : -1;
+	return slot == -1 || reuse(cse, expr, slot);
+}
+
+//
+// forget
+//
+// Starts a new basic block: nothing is known about any value.
+//
+static void forget(struct CSE* cse)
+{
+	memset(cse->values, 0, cse->slots->num_slots * sizeof(int));
+	cse->num_entries = 0;
+}
+
+//
+// assign
+//
+// The variable in slot now holds the value with the given number.
+//
+static void assign(struct CSE* cse, int slot, int vn)
+{
+	cse->values[slot] = vn;
+
+	// *p may read it
+	if (cse->aliased[slot]) {
+		cse->epoch++;
+	}
+}
+
+//
+// pointer_write
+//
+// *p = ... may have written any variable a pointer may reach.
+//
+static void pointer_write(struct CSE* cse)
+{
+	for (int slot = 0; slot < cse->slots->num_slots; slot++) {
+		if (cse->aliased[slot]) {
+			cse->values[slot] = 0;
+		}
+	}
+	cse->epoch++;
+}
+
+//
+// cse_body
+//
+// Eliminates common subexpressions in the statements from stmt up to
+// (but not including) stop. Returns false if memory could not be
+// allocated.
+//
+static bool cse_body(struct CSE* cse, struct STMT* stmt, struct STMT* stop)
+{
+	forget(cse);
+
+	while (stmt != stop && stmt != NULL) {
+		switch (stmt->stmt_type) {
+			case STMT_ASSIGNMENT: {
+				struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+				int vn = fresh_vn(cse);  // e.g. input()
+
+				if (assignment->rhs->value_type == VALUE_EXPR &&
+					!expr_vn(cse, assignment->rhs->types.expr, &vn)) {
+					return false;
+				}
+
+				if (assignment->isPtrDeref) {
+					pointer_write(cse);
+				}
+				else {
+					assign(cse, assignment->slot, vn);
+				}
+
+				stmt = assignment->next_stmt;
+				break;
+			}
+
+			case STMT_FUNCTION_CALL:
+				stmt = stmt->types.function_call->next_stmt;
+				break;
+
+			case STMT_WHILE_LOOP: {
+				struct STMT_WHILE_LOOP* loop = stmt->types.while_loop;
+
+				if (!cse_body(cse, loop->loop_body, stmt)) {
+					return false;
+				}
+
+				forget(cse);
+				stmt = loop->next_stmt;
+				break;
+			}
+
+			case STMT_IF_THEN_ELSE: {
+				struct STMT_IF_THEN_ELSE* ifthen = stmt->types.if_then_else;
+
+				if (!cse_body(cse, ifthen->true_path, ifthen->next_stmt) ||
+					!cse_body(cse, ifthen->false_path, ifthen->next_stmt)) {
+					return false;
+				}
+
+				forget(cse);
+				stmt = ifthen->next_stmt;
+				break;
+			}
+
+			default:
+				stmt = stmt->types.pass->next_stmt;
+				break;
+		}
+	}
+
+	return true;
+}
+
+//
+// may_be_pointer
+//
+// Returns true if the given operand may be a pointer that takes part
+// in pointer arithmetic: &x, or a variable whose type isn't proven to
+// be something else (see typeinfer.h). *p never does.
+//
+static bool may_be_pointer(struct UNARY_EXPR* expr)
+{
+	if (expr->expr_type == UNARY_ADDRESS_OF) {
+		return true;
+	}
+
+	return expr->expr_type != UNARY_PTR_DEREF && expr->element->element_type == ELEMENT_IDENTIFIER &&
+		(expr->element->type == RAM_TYPE_PTR || expr->element->type == -1);
+}
+
+//
+// find_aliases_expr / find_aliases
+//
+// Finds the variables a pointer may reach: those whose address is
+// taken, or all of them if an expression may do pointer arithmetic
+// (a + or - of a pointer whose type isn't proven to be something
+// else).
+//
+static void find_aliases_expr(struct CSE* cse, struct EXPR* expr)
+{
+	struct UNARY_EXPR* operands[2] = { expr->lhs, expr->isBinaryExpr ? expr->rhs : NULL };
+
+	for (int i = 0; i < 2; i++) {
+		if (operands[i] != NULL && operands[i]->expr_type == UNARY_ADDRESS_OF &&
+			operands[i]->element->element_type == ELEMENT_IDENTIFIER) {
+			cse->aliased[operands[i]->element->slot] = true;
+		}
+	}
+
+	if (expr->isBinaryExpr && (expr->operator == OPERATOR_PLUS || expr->operator == OPERATOR_MINUS) &&
+		(expr->type == RAM_TYPE_PTR || expr->type == -1) &&
+		(may_be_pointer(expr->lhs) || may_be_pointer(expr->rhs))) {
+		for (int slot = 0; slot < cse->slots->num_slots; slot++) {
+			cse->aliased[slot] = true;
+		}
+	}
+}
+
+static void find_aliases(struct CSE* cse, struct STMT* stmt, struct STMT* stop)
+{
+	while (stmt != stop && stmt != NULL) {
+		switch (stmt->stmt_type) {
+			case STMT_ASSIGNMENT: {
+				struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+
+				if (assignment->rhs->value_type == VALUE_EXPR) {
+					find_aliases_expr(cse, assignment->rhs->types.expr);
+				}
+				stmt = assignment->next_stmt;
+				break;
+			}
+
+			case STMT_FUNCTION_CALL:
+				stmt = stmt->types.function_call->next_stmt;
+				break;
+
+			case STMT_WHILE_LOOP: {
+				struct STMT_WHILE_LOOP* loop = stmt->types.while_loop;
+
+				find_aliases_expr(cse, loop->condition);
+				find_aliases(cse, loop->loop_body, stmt);
+				stmt = loop->next_stmt;
+				break;
+			}
+
+			case STMT_IF_THEN_ELSE: {
+				struct STMT_IF_THEN_ELSE* ifthen = stmt->types.if_then_else;
+
+				find_aliases_expr(cse, ifthen->condition);
+				find_aliases(cse, ifthen->true_path, ifthen->next_stmt);
+				find_aliases(cse, ifthen->false_path, ifthen->next_stmt);
+				stmt = ifthen->next_stmt;
+				break;
+			}
+
+			default:
+				stmt = stmt->types.pass->next_stmt;
+				break;
+		}
+	}
+}
+
+
+//
+// Public functions:
+//
+
+//
+// cse_program
+//
+// Eliminates common subexpressions in the given (resolved, typed)
+// program graph, in place. Returns false if memory could not be
+// allocated.
+//
+bool cse_program(struct SLOT_TABLE* slots, struct STMT* program, int* num_reused)
+{
+	struct CSE cse = { .slots = slots, .next_vn = 1 };
+
+	*num_reused = 0;
+
+	cse.aliased = (bool*)calloc(slots->num_slots + 1, sizeof(bool));
+	cse.values = (int*)calloc(slots->num_slots + 1, sizeof(int));
+
+	bool optimized = cse.aliased != NULL && cse.values != NULL;
+	if (optimized) {
+		find_aliases(&cse, program, NULL);
+		optimized = cse_body(&cse, program, NULL);
+	}
+
+	*num_reused = cse.reused;
+
+	free(cse.aliased);
+	free(cse.values);
+	free(cse.entries);
+	return optimized;
+}
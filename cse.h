@@ -0,0 +1,50 @@
+/*cse.h*/
+
+//
+// Common-subexpression elimination for a nuPython program graph, run
+// after type inference (see typeinfer.h). Within a basic block (a run
+// of assignments and prints, which a while or if ends), a binary
+// expression computing the same value as an earlier one is replaced by
+// the variable that still holds that value:
+//
+//   a = *px + *py            a = *px + *py
+//   b = *px + *py     =>     b = a
+//
+// Values are numbered: each variable holds a value number, which an
+// assignment replaces (x = y copies y's), and an expression's number
+// is found from its operator and its operands' numbers. A pointer can
+// reach a variable whose address is taken (&x) --- or any variable if
+// the program may do pointer arithmetic --- so writing such a variable
+// or writing through a pointer (*p = ...) starts a new "memory epoch":
+// *p read afterwards is a new value, even if p isn't. *p = ... also
+// forgets the values of all the variables it may have written.
+//
+// A reused expression was computed successfully with the same operand
+// values, so it can't fail where it was removed: no error is lost.
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+#include "programgraph.h"
+#include "resolve.h"
+
+
+//
+// Public functions:
+//
+
+//
+// cse_program
+//
+// Replaces the redundant expressions of the given program graph,
+// resolved to the given slot table and with its types inferred, and
+// stores the # of expressions replaced in num_reused. Returns false if
+// memory could not be allocated, in which case the graph is still
+// valid but may be only partly optimized.
+//
+bool cse_program(struct SLOT_TABLE* slots, struct STMT* program, int* num_reused);
@@ -0,0 +1,241 @@
+/*escape.c*/
+
+//
+// << Escape analysis pass: finds the variables no pointer can reach,
+//    which don't need their RAM cells while the program runs. >>
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+
+#include "programgraph.h"
+#include "resolve.h"
+#include "escape.h"
+
+
+//
+// what the analysis knows so far: may_ptr[i] => slot i may hold a
+// pointer; deref_ptr => a dereference may yield one (a pointer was
+// written through a pointer); ptr_arith => some + or - may have a
+// pointer operand
+//
+struct ESCAPES
+{
+  bool* escaped;
+  bool* may_ptr;
+  bool  deref_ptr;
+  bool  ptr_arith;
+  bool  changed;  // did the last walk find a new pointer?
+};
+
+
+//
+// Private functions:
+//
+
+//
+// next_stmt
+//
+// Returns the statement following the given one.
+//
+static struct STMT* next_stmt(struct STMT* stmt)
+{
+	switch (stmt->stmt_type) {
+		case STMT_ASSIGNMENT:    return stmt->types.assignment->next_stmt;
+		case STMT_FUNCTION_CALL: return stmt->types.function_call->next_stmt;
+		case STMT_IF_THEN_ELSE:  return stmt->types.if_then_else->next_stmt;
+		case STMT_WHILE_LOOP:    return stmt->types.while_loop->next_stmt;
+		case STMT_PASS:          return stmt->types.pass->next_stmt;
+		default:                 return NULL;
+	}
+}
+
+
+//
+// visit_exprs
+//
+// Calls visit for the right-hand side of every assignment (stmt is the
+// assignment) and every condition (stmt is the while / if) from stmt
+// up to stop. Assignments of function call results are skipped: no
+// builtin returns a pointer, or takes an address.
+//
+static void visit_exprs(struct ESCAPES* a, struct STMT* stmt, struct STMT* stop,
+	void (*visit)(struct ESCAPES*, struct STMT*, struct EXPR*))
+{
+	while (stmt != stop && stmt != NULL) {
+		if (stmt->stmt_type == STMT_ASSIGNMENT) {
+			struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+			if (assignment->rhs->value_type == VALUE_EXPR) {
+				visit(a, stmt, assignment->rhs->types.expr);
+			}
+		}
+		else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+			struct STMT_WHILE_LOOP* loop = stmt->types.while_loop;
+			visit(a, stmt, loop->condition);
+			visit_exprs(a, loop->loop_body, stmt, visit);
+		}
+		else if (stmt->stmt_type == STMT_IF_THEN_ELSE) {
+			struct STMT_IF_THEN_ELSE* ifthen = stmt->types.if_then_else;
+			visit(a, stmt, ifthen->condition);
+			visit_exprs(a, ifthen->true_path, ifthen->next_stmt, visit);
+			visit_exprs(a, ifthen->false_path, ifthen->next_stmt, visit);
+		}
+		stmt = next_stmt(stmt);
+	}
+}
+
+
+//
+// operand_may_ptr / expr_may_ptr
+//
+// Returns true if the given operand / expression may be a pointer,
+// given what the analysis knows so far.
+//
+static bool operand_may_ptr(struct ESCAPES* a, struct UNARY_EXPR* expr)
+{
+	if (expr->expr_type == UNARY_ADDRESS_OF) {
+		return true;
+	}
+	if (expr->expr_type == UNARY_PTR_DEREF) {
+		return a->deref_ptr;
+	}
+	return expr->element->element_type == ELEMENT_IDENTIFIER && a->may_ptr[expr->element->slot];
+}
+
+static bool expr_may_ptr(struct ESCAPES* a, struct EXPR* expr)
+{
+	if (!expr->isBinaryExpr) {
+		return operand_may_ptr(a, expr->lhs);
+	}
+
+	// only ptr + int, int + ptr and ptr - int give a pointer
+	return (expr->operator == OPERATOR_PLUS || expr->operator == OPERATOR_MINUS) &&
+		(operand_may_ptr(a, expr->lhs) || operand_may_ptr(a, expr->rhs));
+}
+
+
+//
+// visit_address_of / visit_pointer_flow / visit_arithmetic
+//
+// The steps of the analysis: variables whose address is taken escape;
+// pointers flow through assignments (into the variable, or through
+// *p = ... into anything a pointer reaches) to a fixed point; then any
+// + or - of a possible pointer is pointer arithmetic.
+//
+static void visit_address_of(struct ESCAPES* a, struct STMT* stmt, struct EXPR* expr)
+{
+	(void)stmt;  // only visit_pointer_flow needs it
+
+	struct UNARY_EXPR* operands[] = { expr->lhs, expr->isBinaryExpr ? expr->rhs : NULL };
+
+	for (int i = 0; i < 2; i++) {
+		if (operands[i] != NULL && operands[i]->expr_type == UNARY_ADDRESS_OF &&
+			operands[i]->element->element_type == ELEMENT_IDENTIFIER) {
+			a->escaped[operands[i]->element->slot] = true;
+		}
+	}
+}
+
+static void visit_pointer_flow(struct ESCAPES* a, struct STMT* stmt, struct EXPR* expr)
+{
+	if (stmt->stmt_type != STMT_ASSIGNMENT || !expr_may_ptr(a, expr)) {
+		return;
+	}
+
+	struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+
+	if (assignment->isPtrDeref && !a->deref_ptr) {
+		a->deref_ptr = true;
+		a->changed = true;
+	}
+	else if (!assignment->isPtrDeref && !a->may_ptr[assignment->slot]) {
+		a->may_ptr[assignment->slot] = true;
+		a->changed = true;
+	}
+}
+
+static void visit_arithmetic(struct ESCAPES* a, struct STMT* stmt, struct EXPR* expr)
+{
+	(void)stmt;
+
+	if (expr->isBinaryExpr && expr_may_ptr(a, expr)) {
+		a->ptr_arith = true;
+	}
+}
+
+
+//
+// Public functions:
+//
+
+//
+// escape_find
+//
+bool escape_find(struct SLOT_TABLE* slots, struct STMT* program, bool* escaped)
+{
+	struct ESCAPES a;
+	int num_slots = slots->num_slots;
+
+	memset(&a, 0, sizeof(a));
+	a.escaped = escaped;
+	a.may_ptr = (bool*)calloc(num_slots + 1, sizeof(bool));
+
+	for (int slot = 0; slot < num_slots; slot++) {
+		escaped[slot] = (a.may_ptr == NULL);
+	}
+
+	if (a.may_ptr == NULL) {
+		return false;
+	}
+
+	visit_exprs(&a, program, NULL, visit_address_of);
+
+	do {
+		a.changed = false;
+		visit_exprs(&a, program, NULL, visit_pointer_flow);
+	} while (a.changed);
+
+	visit_exprs(&a, program, NULL, visit_arithmetic);
+
+	// a pointer can then walk to any cell
+	if (a.ptr_arith) {
+		for (int slot = 0; slot < num_slots; slot++) {
+			escaped[slot] = true;
+		}
+	}
+
+	free(a.may_ptr);
+	return true;
+}
+
+//
+// escape_program
+//
+bool escape_program(struct SLOT_TABLE* slots, struct STMT* program, struct ESCAPE_STATS* stats)
+{
+	bool* escaped = (bool*)calloc(slots->num_slots + 1, sizeof(bool));
+
+	stats->variables = slots->num_slots;
+	stats->locals = 0;
+
+	if (escaped == NULL || !escape_find(slots, program, escaped)) {
+		free(escaped);
+		return false;
+	}
+
+	for (int slot = 0; slot < slots->num_slots; slot++) {
+		if (!escaped[slot]) {
+			stats->locals++;
+		}
+	}
+
+	free(slots->escaped);
+	slots->escaped = escaped;
+	return true;
+}
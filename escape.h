@@ -0,0 +1,63 @@
+/*escape.h*/
+
+//
+// Escape analysis for a nuPython program graph. A variable needs its
+// RAM cell while the program runs only if a pointer can reach it:
+// pointers are made by &x (deref_pointer and the pointer arithmetic in
+// execute.c then read and write cells by address), so the pass finds
+// the variables whose address may be taken, following pointers through
+// assignments (p = &x, q = p, *r = p, ...) to a fixed point. If the
+// program may do pointer arithmetic, a pointer can walk to any cell, so
+// every variable escapes (see test23.py).
+//
+// The variables that don't escape can be kept anywhere, so long as
+// their cells hold their values wherever RAM is read: the VM keeps them
+// in a register file (see vm.h), and the C translation in typed locals
+// (see transpile.h).
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+#include "programgraph.h"
+#include "resolve.h"
+
+
+//
+// what the pass found, for --stats (see main.c):
+//
+struct ESCAPE_STATS
+{
+  int variables;  // # of variables in the program
+  int locals;     // ... no pointer can reach
+};
+
+
+//
+// Public functions:
+//
+
+//
+// escape_find
+//
+// Runs escape analysis on the given program graph, resolved to the
+// given slot table: escaped[i] is set to true if a pointer may reach
+// the variable bound to slot i, and false if not. escaped must have
+// room for every slot. Returns false if memory could not be allocated,
+// in which case every variable is taken to escape.
+//
+bool escape_find(struct SLOT_TABLE* slots, struct STMT* program, bool* escaped);
+
+//
+// escape_program
+//
+// The escape analysis pass: runs escape_find on the given program graph
+// and keeps the result in the slot table (see SLOT_TABLE::escaped); the
+// counts are stored in stats. Returns false if memory could not be
+// allocated.
+//
+bool escape_program(struct SLOT_TABLE* slots, struct STMT* program, struct ESCAPE_STATS* stats);
@@ -27,7 +27,15 @@
 
 #include "programgraph.h"
 #include "ram.h"
+#include "resolve.h"
 #include "execute.h"
+#include "output.h"
+
+
+//
+// inline cache counters, for all expressions (see execute.h)
+//
+struct OP_CACHE_STATS op_cache_stats = { 0, 0, 0, 0, 0 };
 
 
 //
@@ -51,6 +59,20 @@ char* strdup(const char* word) {
 	return copy;
 }
 
+//
+// literal_value()
+//
+// Given a literal element decoded by the resolution pass, copies its value from the constant pool into value
+// (sharing its string, if any) and returns true. Returns false if the element has no decoded value.
+//
+bool literal_value(struct ELEMENT* element, struct RAM_VALUE* value) {
+	if (element->constant == NULL) return false;
+
+	*value = *element->constant;
+	ram_value_retain(value);
+	return true;
+}
+
 //
 // handle_conversion()
 //
@@ -58,27 +80,26 @@ char* strdup(const char* word) {
 // Modifies the values via pointers and returns T/F depending on if successful. 
 //
 bool handle_conversion(struct FUNCTION_CALL* func_call, struct RAM_VALUE* stored_value, struct RAM* memory, int line_num) {
-	char* var_name = func_call->parameter->element_value;
-	struct RAM_VALUE* var_val = ram_read_cell_by_name(memory, var_name);
+	const struct RAM_VALUE* var_val = ram_borrow_cell_by_slot(memory, func_call->parameter->slot);
 	if (!var_val || var_val->value_type != RAM_TYPE_STR) {
-		printf("**SEMANTIC ERROR: %s() requires a string variable (line %d)\n", func_call->function_name, line_num);
+		output_error("**SEMANTIC ERROR: %s() requires a string variable (line %d)\n", func_call->function_name, line_num);
 		return false;
 	}
 
 	char* endOfStr;
-	if (strcmp(func_call->function_name, "int") == 0) {
-		int convert_val = strtol(var_val->types.s, &endOfStr, 10);
+	if (func_call->builtin == BUILTIN_INT) {
+		int convert_val = strtol(var_val->types.s->chars, &endOfStr, 10);
 		if (*endOfStr != '\0') {
-			printf("**SEMANTIC ERROR: invalid string for int() (line %d)\n", line_num);
+			output_error("**SEMANTIC ERROR: invalid string for int() (line %d)\n", line_num);
 			return false;
 		}
 		stored_value->value_type = RAM_TYPE_INT;
 		stored_value->types.i = convert_val;
 	} 
-	else if (strcmp(func_call->function_name, "float") == 0) {
-		double convert_val = strtod(var_val->types.s, &endOfStr);
+	else if (func_call->builtin == BUILTIN_FLOAT) {
+		double convert_val = strtod(var_val->types.s->chars, &endOfStr);
 		if (*endOfStr != '\0') {
-			printf("**SEMANTIC ERROR: invalid string for float() (line %d)\n", line_num);
+			output_error("**SEMANTIC ERROR: invalid string for float() (line %d)\n", line_num);
 			return false;
 		}
 		stored_value->value_type = RAM_TYPE_REAL;
@@ -95,35 +116,38 @@ bool handle_conversion(struct FUNCTION_CALL* func_call, struct RAM_VALUE* stored
 // value via a pointer and returns T/F depending on if successful.
 //
 bool handle_function(struct FUNCTION_CALL* func_call, struct RAM_VALUE* stored_value, struct RAM* memory, int line_num) {
-	if (strcmp(func_call->function_name, "input") == 0) {
+	if (func_call->builtin == BUILTIN_INPUT) {
 		if (func_call->parameter->element_type != ELEMENT_STR_LITERAL) {
-			printf("**SEMANTIC ERROR: input() must be passed a string\n");
+			output_error("**SEMANTIC ERROR: input() must be passed a string\n");
 			return false;
 		}
 
-		printf("%s", func_call->parameter->element_value);
+		// the prompt, and whatever was printed before it, before waiting for input
+		output_text(func_call->parameter->element_value, (int)strlen(func_call->parameter->element_value));
+		output_flush();
+
 		char line[256];
 		if (fgets(line, sizeof(line), stdin) == NULL) {
-			printf("**ERROR: Could not read input");
+			output_error("**ERROR: Could not read input");
 			return false;
 		}
 
 		line[strcspn(line, "\n")] = '\0';
 
 		stored_value->value_type = RAM_TYPE_STR;
-		stored_value->types.s = strdup(line);
+		stored_value->types.s = ram_str_new(line);
 		if (stored_value->types.s == NULL) {
-			printf("**ERROR: Memory alloc failed");
+			output_error("**ERROR: Memory alloc failed");
 			return false;
 		}
 		return true;
 	}
 
-	if (strcmp(func_call->function_name, "int") == 0 || strcmp(func_call->function_name, "float") == 0) {
+	if (func_call->builtin == BUILTIN_INT || func_call->builtin == BUILTIN_FLOAT) {
 		return handle_conversion(func_call, stored_value, memory, line_num);
 	}
 
-	printf("**ERROR: Unsupported function call '%s' (line %d)\n", func_call->function_name, line_num);
+	output_error("**ERROR: Unsupported function call '%s' (line %d)\n", func_call->function_name, line_num);
 	return false;
 }
 
@@ -134,6 +158,11 @@ bool handle_function(struct FUNCTION_CALL* func_call, struct RAM_VALUE* stored_v
 // and returns T/F depending on if the function returned successfully.
 //
 bool handle_normal_expression(struct ELEMENT* rhs_elt, struct RAM_VALUE* stored_value, struct RAM* memory, int line_num) {
+	// literal already decoded, no parsing needed
+	if (literal_value(rhs_elt, stored_value)) {
+		return true;
+	}
+
 	switch (rhs_elt->element_type) {
 		// we are assigning a normal int literal
 		case ELEMENT_INT_LITERAL: {
@@ -153,9 +182,9 @@ bool handle_normal_expression(struct ELEMENT* rhs_elt, struct RAM_VALUE* stored_
 
 		// assigning to string literal
 		case ELEMENT_STR_LITERAL: {
-			char* value = strdup(rhs_elt->element_value);
+			struct RAM_STR* value = ram_str_new(rhs_elt->element_value);
 			if (value == NULL) {
-				printf("**ERROR: Memory allocation failed\n");
+				output_error("**ERROR: Memory allocation failed\n");
 				return false;
 			}
 			stored_value->value_type = RAM_TYPE_STR;
@@ -179,20 +208,21 @@ bool handle_normal_expression(struct ELEMENT* rhs_elt, struct RAM_VALUE* stored_
 
 		case ELEMENT_IDENTIFIER: {
 			char* rhs_name = rhs_elt->element_value;
-			struct RAM_VALUE* rhs_value = ram_read_cell_by_name(memory, rhs_name);
+			const struct RAM_VALUE* rhs_value = ram_borrow_cell_by_slot(memory, rhs_elt->slot);
 			// sementic error, var not found (reuse error message)
 			if (rhs_value == NULL) {
-				printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", rhs_name, line_num);
+				output_error("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", rhs_name, line_num);
 				return false;
 			}
 			
-			// store copy of rhs 
+			// store copy of rhs (sharing its string, if any)
 			*stored_value = *rhs_value;
+			ram_value_retain(stored_value);
 			break;
 		}
 
 		default:
-			printf("**ERROR: Unsupported RHS");
+			output_error("**ERROR: Unsupported RHS");
 			return false;
 	}
 	return true;
@@ -205,17 +235,22 @@ bool handle_normal_expression(struct ELEMENT* rhs_elt, struct RAM_VALUE* stored_
 // and stores the result in a pointer to result. Returns T/F depending on if successful.
 //
 bool string_concat(struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE* result, int line_num) {
-	// we are doing string concat
-	size_t len = strlen(lhs.types.s) + strlen(rhs.types.s) + 1;		// account for 0 at end
-	result->types.s = malloc(len * sizeof(char));
-	if (result->types.s == NULL) {
-		printf("**ERROR: Memory allocation failed\n");
+	// we are doing string concat, lengths are known so no strlen() needed
+	struct RAM_STR* lhs_str = lhs.types.s;
+	struct RAM_STR* rhs_str = rhs.types.s;
+
+	struct RAM_STR* concat = ram_str_alloc(lhs_str->length + rhs_str->length);
+	if (concat == NULL) {
+		output_error("**ERROR: Memory allocation failed\n");
 		return false;
 	}
 
 	// concat
+	memcpy(concat->chars, lhs_str->chars, lhs_str->length);
+	memcpy(concat->chars + lhs_str->length, rhs_str->chars, rhs_str->length);
+
 	result->value_type = RAM_TYPE_STR;
-	snprintf(result->types.s, len, "%s%s", lhs.types.s, rhs.types.s);
+	result->types.s = concat;
 	return true;
 }
 
@@ -226,7 +261,18 @@ bool string_concat(struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE*
 // it in a pointer to 'result'. Returns T/F depending on if successful.
 //
 bool string_comparison(int operator, struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE* result, int line_num) {
-	int comparison = strcmp(lhs.types.s, rhs.types.s);
+	struct RAM_STR* lhs_str = lhs.types.s;
+	struct RAM_STR* rhs_str = rhs.types.s;
+
+	// compare the common prefix, then the shorter string comes first
+	int comparison = 0;
+	if (lhs_str != rhs_str) {
+		int min_len = (lhs_str->length < rhs_str->length) ? lhs_str->length : rhs_str->length;
+		comparison = memcmp(lhs_str->chars, rhs_str->chars, min_len);
+		if (comparison == 0) {
+			comparison = (lhs_str->length > rhs_str->length) - (lhs_str->length < rhs_str->length);
+		}
+	}
 	// see which operator
 	switch (operator) {
 		case OPERATOR_EQUAL:
@@ -248,7 +294,7 @@ bool string_comparison(int operator, struct RAM_VALUE lhs, struct RAM_VALUE rhs,
 			result->types.i = (comparison >= 0);
 			break;
 		default:
-			printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", line_num);
+			output_error("**SEMANTIC ERROR: invalid operand types (line %d)\n", line_num);
 			return false;
 	}
 	result->value_type = RAM_TYPE_BOOLEAN;
@@ -292,7 +338,7 @@ bool number_comparison(int operator, struct RAM_VALUE lhs, struct RAM_VALUE rhs,
 
 	// nothing else
 	else {
-		printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", line_num);
+		output_error("**SEMANTIC ERROR: invalid operand types (line %d)\n", line_num);
 		return false;
 	}
 
@@ -334,7 +380,7 @@ bool handle_integer_ops(int operator, struct RAM_VALUE lhs, struct RAM_VALUE rhs
 		// we are doing division
 		case OPERATOR_DIV:
 			if (rhs.types.i == 0) {
-				printf("**ZeroDivisionError: division by zero (line %d)\n", line_num);
+				output_error("**ZeroDivisionError: division by zero (line %d)\n", line_num);
 				return false;
 			}
 			result->types.i = lhs.types.i / rhs.types.i;
@@ -352,7 +398,7 @@ bool handle_integer_ops(int operator, struct RAM_VALUE lhs, struct RAM_VALUE rhs
 
 		// unknown operator
 		default:
-			printf("**ERROR: Unsupported operator (line %d)\n", line_num);
+			output_error("**ERROR: Unsupported operator (line %d)\n", line_num);
 			return false;
 	}
 	return true;
@@ -375,7 +421,7 @@ bool handle_real_ops(int operator, struct RAM_VALUE lhs, struct RAM_VALUE rhs, s
 		// we are doing division
 		case OPERATOR_DIV: {
 			if (rhs.types.d == 0.0) {
-				printf("**ZeroDivisionError: division by zero (line %d)\n", line_num);
+				output_error("**ZeroDivisionError: division by zero (line %d)\n", line_num);
 				return false;
 			}
 			result->types.d = lhs.types.d / rhs.types.d;
@@ -395,7 +441,7 @@ bool handle_real_ops(int operator, struct RAM_VALUE lhs, struct RAM_VALUE rhs, s
 
 		// unknown operator
 		default: {
-			printf("**ERROR: Unsupported operator (line %d)\n", line_num);
+			output_error("**ERROR: Unsupported operator (line %d)\n", line_num);
 			return false;
 		}
 	}
@@ -425,17 +471,18 @@ bool deref_pointer(struct RAM_VALUE* value, struct RAM* memory, int line_num) {
 	if (value->value_type != RAM_TYPE_PTR) return true;
 	int addr = value->types.i;
 	if (addr < 0 || addr >= memory->capacity) {
-		printf("**SEMANTIC ERROR: lhs pointer contains invalid address (line %d)\n", line_num);
+		output_error("**SEMANTIC ERROR: lhs pointer contains invalid address (line %d)\n", line_num);
 		return false;
 	}
 	
-	struct RAM_VALUE* deref_val = ram_read_cell_by_addr(memory, addr);
+	const struct RAM_VALUE* deref_val = ram_borrow_cell_by_addr(memory, addr);
 	if (!deref_val) {
-		printf("**SEMANTIC ERROR: lhs pointer contains invalid address (line %d)\n", line_num);
+		output_error("**SEMANTIC ERROR: lhs pointer contains invalid address (line %d)\n", line_num);
 		return false;
 	}
 
 	*value = *deref_val;
+	ram_value_retain(value);
 	return true;
 }
 
@@ -459,7 +506,7 @@ bool handle_pointer_arithmetic(int operator, struct RAM_VALUE lhs, struct RAM_VA
 	}
 	// unsupported operator
 	else {
-		printf("**SEMANTIC ERROR: invalid operand types for pointer arithmetic (line %d)\n", line_num);
+		output_error("**SEMANTIC ERROR: invalid operand types for pointer arithmetic (line %d)\n", line_num);
 		return false;
 	}
 
@@ -495,7 +542,7 @@ bool determine_op_result(int operator, struct RAM_VALUE lhs, struct RAM_VALUE rh
 				return string_comparison(operator, lhs, rhs, result, line_num);
 			}
 		}
-		printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", line_num);
+		output_error("**SEMANTIC ERROR: invalid operand types (line %d)\n", line_num);
 		return false;
 	}
 
@@ -521,10 +568,143 @@ bool determine_op_result(int operator, struct RAM_VALUE lhs, struct RAM_VALUE rh
 	}
 
 	// otherwise unsupported 
-	printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", line_num);
+	output_error("**SEMANTIC ERROR: invalid operand types (line %d)\n", line_num);
 	return false;
 }
 
+//
+// int_kernel()
+//
+// determine_op_result() for two integers: the common operators inline, the rest (division, errors) through
+// handle_integer_ops()
+//
+static bool int_kernel(int operator, struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE* result, int line_num) {
+	int a = lhs.types.i;
+	int b = rhs.types.i;
+
+	switch (operator) {
+		case OPERATOR_PLUS:      result->value_type = RAM_TYPE_INT; result->types.i = a + b; return true;
+		case OPERATOR_MINUS:     result->value_type = RAM_TYPE_INT; result->types.i = a - b; return true;
+		case OPERATOR_ASTERISK:  result->value_type = RAM_TYPE_INT; result->types.i = a * b; return true;
+		case OPERATOR_EQUAL:     result->value_type = RAM_TYPE_BOOLEAN; result->types.i = (a == b); return true;
+		case OPERATOR_NOT_EQUAL: result->value_type = RAM_TYPE_BOOLEAN; result->types.i = (a != b); return true;
+		case OPERATOR_LT:        result->value_type = RAM_TYPE_BOOLEAN; result->types.i = (a < b); return true;
+		case OPERATOR_LTE:       result->value_type = RAM_TYPE_BOOLEAN; result->types.i = (a <= b); return true;
+		case OPERATOR_GT:        result->value_type = RAM_TYPE_BOOLEAN; result->types.i = (a > b); return true;
+		case OPERATOR_GTE:       result->value_type = RAM_TYPE_BOOLEAN; result->types.i = (a >= b); return true;
+		default:
+			return handle_integer_ops(operator, lhs, rhs, result, line_num);
+	}
+}
+
+//
+// real_kernel()
+//
+// determine_op_result() for two reals (ints already converted), same as int_kernel()
+//
+static bool real_kernel(int operator, struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE* result, int line_num) {
+	double a = lhs.types.d;
+	double b = rhs.types.d;
+
+	switch (operator) {
+		case OPERATOR_PLUS:      result->value_type = RAM_TYPE_REAL; result->types.d = a + b; return true;
+		case OPERATOR_MINUS:     result->value_type = RAM_TYPE_REAL; result->types.d = a - b; return true;
+		case OPERATOR_ASTERISK:  result->value_type = RAM_TYPE_REAL; result->types.d = a * b; return true;
+		case OPERATOR_EQUAL:     result->value_type = RAM_TYPE_BOOLEAN; result->types.i = (a == b); return true;
+		case OPERATOR_NOT_EQUAL: result->value_type = RAM_TYPE_BOOLEAN; result->types.i = (a != b); return true;
+		case OPERATOR_LT:        result->value_type = RAM_TYPE_BOOLEAN; result->types.i = (a < b); return true;
+		case OPERATOR_LTE:       result->value_type = RAM_TYPE_BOOLEAN; result->types.i = (a <= b); return true;
+		case OPERATOR_GT:        result->value_type = RAM_TYPE_BOOLEAN; result->types.i = (a > b); return true;
+		case OPERATOR_GTE:       result->value_type = RAM_TYPE_BOOLEAN; result->types.i = (a >= b); return true;
+		default:
+			return handle_real_ops(operator, lhs, rhs, result, line_num);
+	}
+}
+
+//
+// proven_op_result()
+//
+// determine_op_result() for operand types proven by the type inference pass (see typeinfer.h): the kernel for
+// them, without checking the types of lhs and rhs at all.
+//
+static bool proven_op_result(struct EXPR* expr, struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE* result, int line_num) {
+	op_cache_stats.proven++;
+
+	switch (expr->proven_key) {
+		case OP_CACHE_KEY(RAM_TYPE_INT, RAM_TYPE_INT):
+			return int_kernel(expr->operator, lhs, rhs, result, line_num);
+
+		case OP_CACHE_KEY(RAM_TYPE_INT, RAM_TYPE_REAL):
+			lhs.types.d = (double)lhs.types.i;
+			return real_kernel(expr->operator, lhs, rhs, result, line_num);
+
+		case OP_CACHE_KEY(RAM_TYPE_REAL, RAM_TYPE_INT):
+			rhs.types.d = (double)rhs.types.i;
+			return real_kernel(expr->operator, lhs, rhs, result, line_num);
+
+		case OP_CACHE_KEY(RAM_TYPE_STR, RAM_TYPE_STR):
+			if (expr->operator == OPERATOR_PLUS) {
+				return string_concat(lhs, rhs, result, line_num);
+			}
+			return string_comparison(expr->operator, lhs, rhs, result, line_num);
+
+		case OP_CACHE_KEY(RAM_TYPE_PTR, RAM_TYPE_INT):
+		case OP_CACHE_KEY(RAM_TYPE_INT, RAM_TYPE_PTR):
+			return handle_pointer_arithmetic(expr->operator, lhs, rhs, result, line_num);
+
+		// two reals
+		default:
+			return real_kernel(expr->operator, lhs, rhs, result, line_num);
+	}
+}
+
+//
+// cached_op_result()
+//
+// Given a binary expression and the values of its operands, computes the result via the kernel for the proven or
+// cached operand types if they match, otherwise via determine_op_result(), (re)filling the cache for next time.
+//
+bool cached_op_result(struct EXPR* expr, struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE* result, int line_num, struct RAM* memory, bool lhs_deref, bool rhs_deref) {
+	if (expr->proven_key != 0) {
+		return proven_op_result(expr, lhs, rhs, result, line_num);
+	}
+
+	int key = OP_CACHE_KEY(lhs.value_type, rhs.value_type);
+
+	if (key == expr->cache_key) {
+		op_cache_stats.hits++;
+
+		switch (key) {
+			case OP_CACHE_KEY(RAM_TYPE_INT, RAM_TYPE_INT):
+				return int_kernel(expr->operator, lhs, rhs, result, line_num);
+
+			case OP_CACHE_KEY(RAM_TYPE_REAL, RAM_TYPE_REAL):
+				return real_kernel(expr->operator, lhs, rhs, result, line_num);
+
+			// mixed: both as reals
+			default:
+				change_numeric_types(&lhs, &rhs);
+				return real_kernel(expr->operator, lhs, rhs, result, line_num);
+		}
+	}
+
+	bool lhs_number = (lhs.value_type == RAM_TYPE_INT || lhs.value_type == RAM_TYPE_REAL);
+	bool rhs_number = (rhs.value_type == RAM_TYPE_INT || rhs.value_type == RAM_TYPE_REAL);
+
+	if (lhs_number && rhs_number) {
+		op_cache_stats.misses++;
+		if (expr->cache_key != 0) {
+			op_cache_stats.polymorphic++;
+		}
+		expr->cache_key = key;
+	}
+	else {
+		op_cache_stats.generic++;
+	}
+
+	return determine_op_result(expr->operator, lhs, rhs, result, line_num, memory, lhs_deref, rhs_deref);
+}
+
 
 //
 // retrieve_value
@@ -539,15 +719,15 @@ bool retrieve_value(struct UNARY_EXPR* op, struct RAM* memory, struct RAM_VALUE*
 	// check if operator is '&'
 	if (op->expr_type == UNARY_ADDRESS_OF) {
 		if (element->element_type != ELEMENT_IDENTIFIER) {
-			printf("**SEMANTIC ERROR: '&' can only be used with an identifier (line %d)\n", line_num);
+			output_error("**SEMANTIC ERROR: '&' can only be used with an identifier (line %d)\n", line_num);
 			return false;
 		}
 
 		char* name = element->element_value;
-		int addr = ram_get_addr(memory, name);
+		int addr = ram_get_addr_by_slot(memory, element->slot);
 		// make sure memory address is valid
 		if (addr == -1) {
-			printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", name, line_num);
+			output_error("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", name, line_num);
 			return false;
 		}
 
@@ -560,35 +740,42 @@ bool retrieve_value(struct UNARY_EXPR* op, struct RAM* memory, struct RAM_VALUE*
 	// check if operatort is '*'
 	if (op->expr_type == UNARY_PTR_DEREF) {
 		char* name = element->element_value;
-		struct RAM_VALUE* ptr_val = ram_read_cell_by_name(memory, name);
+		const struct RAM_VALUE* ptr_val = ram_borrow_cell_by_slot(memory, element->slot);
 		// make sure the ptr is valid
 		if (!ptr_val) {
-			printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", name, line_num);
+			output_error("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", name, line_num);
 			return false;
 		}
 		// make sure var is actually a ptr
 		if (ptr_val->value_type != RAM_TYPE_PTR) {
-			printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", line_num);
+			output_error("**SEMANTIC ERROR: invalid operand types (line %d)\n", line_num);
 			return false;
 		}
 		// make sure addr of ptr is within memory range
 		int addr = ptr_val->types.i;
 		if (addr < 0 || addr >= memory->capacity) {
-			printf("**SEMANTIC ERROR: '%s' contains invalid address (line %d)\n", name, line_num);
+			output_error("**SEMANTIC ERROR: '%s' contains invalid address (line %d)\n", name, line_num);
 			return false;
 		}
 		// make sure deref val is valid
-		struct RAM_VALUE* deref_val = ram_read_cell_by_addr(memory, addr);
+		const struct RAM_VALUE* deref_val = ram_borrow_cell_by_addr(memory, addr);
 		if (!deref_val) {
-			printf("**SEMANTIC ERROR: '%s' contains invalid address (line %d)\n", name, line_num);
+			output_error("**SEMANTIC ERROR: '%s' contains invalid address (line %d)\n", name, line_num);
 			return false;
 		}
 
 		*value = *deref_val;
+		ram_value_retain(value);
 		*success = true;
 		return true;
 	}
 	
+	// literal already decoded, no parsing needed
+	if (literal_value(element, value)) {
+		*success = true;
+		return true;
+	}
+
 	switch (element->element_type) {
 		// elt is an int literal
 		case ELEMENT_INT_LITERAL: {
@@ -609,9 +796,9 @@ bool retrieve_value(struct UNARY_EXPR* op, struct RAM* memory, struct RAM_VALUE*
 		// elt is a string literal
 		case ELEMENT_STR_LITERAL: {
 			value->value_type = RAM_TYPE_STR;
-			value->types.s = strdup(element->element_value);
+			value->types.s = ram_str_new(element->element_value);
 			if (value->types.s == NULL) {
-			printf("**ERROR: Memory allocation failed\n");
+			output_error("**ERROR: Memory allocation failed\n");
 			return false;
 			}
 			*success = true;
@@ -638,21 +825,22 @@ bool retrieve_value(struct UNARY_EXPR* op, struct RAM* memory, struct RAM_VALUE*
 		case ELEMENT_IDENTIFIER: {
 			// get var name
 			char* name = element->element_value;
-			struct RAM_VALUE* ram_value = ram_read_cell_by_name(memory, name);
+			const struct RAM_VALUE* ram_value = ram_borrow_cell_by_slot(memory, element->slot);
 			// identifier var not found
 			if (ram_value == NULL) {
-				printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", name, line_num);
+				output_error("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", name, line_num);
 				return 0;
 			}
 
 			*value = *ram_value;
+			ram_value_retain(value);
 			*success = true;
 			return true;
 		}
 
 		// unknown operand
 		default:
-			printf("**ERROR: Unsupported operand type (line %d)\n", line_num); 
+			output_error("**ERROR: Unsupported operand type (line %d)\n", line_num); 
 			return false;
 	}
 }
@@ -691,13 +879,57 @@ bool execute_binary_expression(struct EXPR* expr, struct RAM_VALUE* result, stru
 
 	// check if we got the value correctly, error printed out by retrieve_value()
 	if (!retrieve_value(rhs, memory, &rhs_val, &success, line_num) || !success) {
+		ram_value_release(&lhs_val);
 		return false;
 	}
 
-	return determine_op_result(expr->operator, lhs_val, rhs_val, result, line_num, memory, lhs->expr_type == UNARY_PTR_DEREF, rhs->expr_type == UNARY_PTR_DEREF);
+	bool ok = cached_op_result(expr, lhs_val, rhs_val, result, line_num, memory, lhs->expr_type == UNARY_PTR_DEREF, rhs->expr_type == UNARY_PTR_DEREF);
+
+	// done with the operands (the result holds its own string, if any)
+	ram_value_release(&lhs_val);
+	ram_value_release(&rhs_val);
+	return ok;
 }
 
 
+//
+// safe_value()
+//
+// Given an operand of a statement proven safe (see validate.h), returns its value without any checks: the variable
+// is surely defined, and a literal surely decoded. Strings are borrowed, not copied.
+//
+static struct RAM_VALUE safe_value(struct UNARY_EXPR* op, struct RAM* memory) {
+	struct ELEMENT* element = op->element;
+
+	if (element->element_type != ELEMENT_IDENTIFIER) {
+		return *element->constant;
+	}
+
+	int addr = memory->slots[element->slot];
+	if (op->expr_type == UNARY_ADDRESS_OF) {
+		struct RAM_VALUE value = { .value_type = RAM_TYPE_PTR, .types.i = addr };
+		return value;
+	}
+
+	return memory->cells[addr].value;
+}
+
+//
+// safe_expr_value()
+//
+// Given an expression of a statement proven safe, computes its value with the kernel for its proven operand types.
+// Nothing can go wrong, so nothing is checked.
+//
+static struct RAM_VALUE safe_expr_value(struct EXPR* expr, struct RAM* memory, int line_num) {
+	struct RAM_VALUE value = safe_value(expr->lhs, memory);
+
+	if (expr->isBinaryExpr) {
+		proven_op_result(expr, value, safe_value(expr->rhs, memory), &value, line_num);
+	}
+
+	return value;
+}
+
 // 
 // handle_pointer_assignment()
 //
@@ -708,22 +940,22 @@ bool handle_pointer_assignment(struct STMT_ASSIGNMENT* assignment, struct VALUE*
 	char* ptr_name = assignment->var_name;
 
 	// make sure ptr exists
-	struct RAM_VALUE* ptr_val = ram_read_cell_by_name(memory, ptr_name);
+	const struct RAM_VALUE* ptr_val = ram_borrow_cell_by_slot(memory, assignment->slot);
 	if (!ptr_val) {
-		printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", ptr_name, line_num);
+		output_error("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", ptr_name, line_num);
 		return false;
 	}
 
 	// make sure var == ptr
 	if (ptr_val->value_type != RAM_TYPE_PTR) {
-		printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", line_num);
+		output_error("**SEMANTIC ERROR: invalid operand types (line %d)\n", line_num);
 		return false;
 	}
 
 	// make sure addr in range
 	int addr = ptr_val->types.i;
 	if (addr < 0 || addr >= memory->capacity) {
-		printf("**SEMANTIC ERROR: '%s' contains invalid address (line %d)\n", ptr_name, line_num);
+		output_error("**SEMANTIC ERROR: '%s' contains invalid address (line %d)\n", ptr_name, line_num);
 		return false;
 	}
 
@@ -744,11 +976,11 @@ bool handle_pointer_assignment(struct STMT_ASSIGNMENT* assignment, struct VALUE*
 
 			// get address of var
 			char* target_name = unary_expr->element->element_value;
-			int target_addr = ram_get_addr(memory, target_name);
+			int target_addr = ram_get_addr_by_slot(memory, unary_expr->element->slot);
 
 			// validate  target address
 			if (target_addr == -1 || target_addr >= memory->capacity) {
-				printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", target_name, line_num);
+				output_error("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", target_name, line_num);
 				return false;
 			}
 
@@ -769,8 +1001,11 @@ bool handle_pointer_assignment(struct STMT_ASSIGNMENT* assignment, struct VALUE*
 	}
 
 	// make sure dereferencing works
-	if (!ram_write_cell_by_addr(memory, stored_value, addr)) {
-		printf("**ERROR: Could not write value to memory location\n");
+	bool written = ram_write_cell_by_addr(memory, stored_value, addr);
+	ram_value_release(&stored_value);
+
+	if (!written) {
+		output_error("**ERROR: Could not write value to memory location\n");
 		return false;
 	}
 
@@ -802,33 +1037,34 @@ bool handle_unary_address_of(struct UNARY_EXPR* expr, struct RAM_VALUE* stored_v
 //
 bool handle_unary_pointer_deref(struct UNARY_EXPR* expr, struct RAM_VALUE* stored_value, struct RAM* memory, int line_num) {
 	char* ptr_name = expr->element->element_value;
-	struct RAM_VALUE* ptr_val = ram_read_cell_by_name(memory, ptr_name);
+	const struct RAM_VALUE* ptr_val = ram_borrow_cell_by_slot(memory, expr->element->slot);
 
 	// make sure ptr is valid
 	if (!ptr_val) {
-		printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", ptr_name, line_num);
+		output_error("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", ptr_name, line_num);
 		return false;
 	}
 
 	// check if the variable is actually a pointer
 	if (ptr_val->value_type != RAM_TYPE_PTR) {
-		printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", line_num);
+		output_error("**SEMANTIC ERROR: invalid operand types (line %d)\n", line_num);
 		return false;
 	}
 
 	int addr = ptr_val->types.i;
 	if (addr < 0 || addr >= memory->capacity) {
-		printf("**SEMANTIC ERROR: '%s' contains invalid address (line %d)\n", ptr_name, line_num);
+		output_error("**SEMANTIC ERROR: '%s' contains invalid address (line %d)\n", ptr_name, line_num);
 		return false;
 	}
 
-	struct RAM_VALUE* deref_val = ram_read_cell_by_addr(memory, addr);
+	const struct RAM_VALUE* deref_val = ram_borrow_cell_by_addr(memory, addr);
 	if (!deref_val) {
-		printf("**SEMANTIC ERROR: '%s' contains invalid address (line %d)\n", ptr_name, line_num);
+		output_error("**SEMANTIC ERROR: '%s' contains invalid address (line %d)\n", ptr_name, line_num);
 		return false;
 	}
 
 	*stored_value = *deref_val;
+	ram_value_retain(stored_value);
 	return true;
 }
 
@@ -885,6 +1121,25 @@ bool process_rhs(struct VALUE* rhs, struct RAM_VALUE* stored_value, struct RAM*
 	return false;
 }	
 
+//
+// execute_safe_assignment
+//
+// Given an assignment proven safe (see validate.h), assigns the variable its value without any checks on the way.
+// Returns false only if memory could not be written.
+//
+bool execute_safe_assignment(struct STMT* stmt, struct RAM* memory) {
+	struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+	struct RAM_VALUE value = safe_expr_value(assignment->rhs->types.expr, memory, stmt->line);
+
+	// safe expressions never build a string, so there is nothing to release (memory references a borrowed one)
+	if (!ram_write_cell_by_slot(memory, value, assignment->slot, assignment->var_name)) {
+		output_error("**ERROR: Could not write variable to memory. Variable: %s\n", assignment->var_name);
+		return false;
+	}
+
+	return true;
+}
+
 //
 // execute_assignment
 //
@@ -912,15 +1167,16 @@ bool execute_assignment(struct STMT* stmt, struct RAM* memory) {
 
 	// if not assignment, then must be function call or expression
 	if (!process_rhs(rhs, &stored_value, memory, stmt->line)) {
+		ram_value_release(&stored_value);
 		return false;
 	}
 
-	// write our value to memory
-	if (!ram_write_cell_by_name(memory, stored_value, name)) {
-		printf("**ERROR: Could not write variable to memory. Variable: %s\n", name);
-		if (stored_value.value_type == RAM_TYPE_STR) {
-			free(stored_value.types.s);
-		}
+	// write our value to memory (memory takes its own reference to a string)
+	bool written = ram_write_cell_by_slot(memory, stored_value, assignment->slot, name);
+	ram_value_release(&stored_value);
+
+	if (!written) {
+		output_error("**ERROR: Could not write variable to memory. Variable: %s\n", name);
 		return false;
 	}
 
@@ -934,7 +1190,8 @@ bool execute_assignment(struct STMT* stmt, struct RAM* memory) {
 //
 // Given a pointer to a statement and memory, executes the function
 // call specified by the pointer. Specifically, it deals with printing
-// empty print statements (new line) and printing string literals via printf()
+// empty print statements (new line) and printing string literals, into
+// the output buffer (see output.h)
 //
 bool execute_function_call(struct STMT* stmt, struct RAM* memory) {
 	// make sure the stmt is actually a function call
@@ -943,71 +1200,73 @@ bool execute_function_call(struct STMT* stmt, struct RAM* memory) {
 	struct STMT_FUNCTION_CALL* call = stmt->types.function_call;
 
 	// check if it's just print() or print() with string literals
-	if (strcmp(call->function_name, "print") == 0) {
+	if (call->builtin == BUILTIN_PRINT) {
 		struct ELEMENT* parameter = call->parameter;
 
 		if (parameter == NULL) {
-			printf("\n");
+			output_line("", 0);
 		}
 		else {
 			switch (parameter->element_type) {
 				case ELEMENT_INT_LITERAL:
-					// convert string to integer and print
-					printf("%d\n", atoi(parameter->element_value));
+					// convert string to integer (unless already decoded) and print
+					output_int(parameter->constant ? parameter->constant->types.i : atoi(parameter->element_value));
 					break;
 
 				case ELEMENT_REAL_LITERAL:
-					// convert string to double and print
-					printf("%f\n", atof(parameter->element_value));
+					// convert string to double (unless already decoded) and print
+					output_real(parameter->constant ? parameter->constant->types.d : atof(parameter->element_value));
 					break;
 
 				case ELEMENT_STR_LITERAL:
 					// normal string
-					printf("%s\n", parameter->element_value);
+					output_line(parameter->element_value, (int)strlen(parameter->element_value));
 					break;
 
 				case ELEMENT_TRUE:
 					// true
-					printf("True\n");
+					output_line("True", 4);
 					break;
 
 				case ELEMENT_FALSE:
 					// false
-					printf("False\n");
+					output_line("False", 5);
 					break;
 
 				case ELEMENT_NONE:
 					// None type
-					printf("None\n");
+					output_line("None", 4);
 					break;
 
 				case ELEMENT_IDENTIFIER: {
-					// if identifier, get the value based on identiifer
-					struct RAM_VALUE* value = ram_read_cell_by_name(memory, parameter->element_value);
+					// if identifier, get the value based on identiifer (surely defined if the print is safe)
+					const struct RAM_VALUE* value = stmt->safe
+						? &memory->cells[memory->slots[parameter->slot]].value
+						: ram_borrow_cell_by_slot(memory, parameter->slot);
 					if (value == NULL) {
-						printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", parameter->element_value, stmt->line);
+						output_error("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", parameter->element_value, stmt->line);
 						return false;
 					}
 
 					// print the value
 					switch (value->value_type) {
 						case RAM_TYPE_INT:
-							printf("%d\n", value->types.i);
+							output_int(value->types.i);
 							break;
 						case RAM_TYPE_REAL:
-							printf("%f\n", value->types.d);
+							output_real(value->types.d);
 							break;
 						case RAM_TYPE_BOOLEAN:
-							printf("%s\n", value->types.i ? "True" : "False");
+							output_line(value->types.i ? "True" : "False", value->types.i ? 4 : 5);
 							break;
 						case RAM_TYPE_STR:
-							printf("%s\n", value->types.s);
+							output_line(value->types.s->chars, value->types.s->length);
 							break;
 						case RAM_TYPE_PTR:
-							printf("%d\n", value->types.i);
+							output_int(value->types.i);
 							break;
 						default:
-							printf("**ERROR: Unsupported variable type for '%s'\n", parameter->element_value);
+							output_error("**ERROR: Unsupported variable type for '%s'\n", parameter->element_value);
 						return false;
 					}
 					break;
@@ -1015,7 +1274,7 @@ bool execute_function_call(struct STMT* stmt, struct RAM* memory) {
 
 				default:
 					// unknown argument for print
-					printf("**ERROR: Unsupported argument type for print\n");
+					output_error("**ERROR: Unsupported argument type for print\n");
 					return false;
 			}
 		}
@@ -1028,6 +1287,133 @@ bool execute_function_call(struct STMT* stmt, struct RAM* memory) {
 }
 
 
+//
+// condition_operand()
+//
+// Given an operand of a loop condition, returns its value without copying it if it is a literal, a variable or a
+// dereferenced pointer variable that can be read without error, otherwise NULL (retrieve_value() then reports why).
+//
+static const struct RAM_VALUE* condition_operand(struct UNARY_EXPR* op, struct RAM* memory) {
+	struct ELEMENT* element = op->element;
+
+	if (op->expr_type == UNARY_ADDRESS_OF) {
+		return NULL;
+	}
+
+	if (element->element_type != ELEMENT_IDENTIFIER) {
+		return (op->expr_type == UNARY_PTR_DEREF) ? NULL : element->constant;
+	}
+
+	const struct RAM_VALUE* value = ram_borrow_cell_by_slot(memory, element->slot);
+	if (value == NULL || op->expr_type != UNARY_PTR_DEREF) {
+		return value;
+	}
+
+	return (value->value_type == RAM_TYPE_PTR) ? ram_borrow_cell_by_addr(memory, value->types.i) : NULL;
+}
+
+//
+// compare_numbers()
+//
+// Given a relational operator and two numbers, returns the truth of lhs operator rhs as number_comparison() computes it
+//
+static bool compare_numbers(int operator, const struct RAM_VALUE* lhs, const struct RAM_VALUE* rhs) {
+	if (lhs->value_type == RAM_TYPE_INT && rhs->value_type == RAM_TYPE_INT) {
+		int a = lhs->types.i;
+		int b = rhs->types.i;
+
+		switch (operator) {
+			case OPERATOR_EQUAL:     return a == b;
+			case OPERATOR_NOT_EQUAL: return a != b;
+			case OPERATOR_LT:        return a < b;
+			case OPERATOR_LTE:       return a <= b;
+			case OPERATOR_GT:        return a > b;
+			default:                 return a >= b;
+		}
+	}
+
+	double a = (lhs->value_type == RAM_TYPE_INT) ? (double)lhs->types.i : lhs->types.d;
+	double b = (rhs->value_type == RAM_TYPE_INT) ? (double)rhs->types.i : rhs->types.d;
+
+	switch (operator) {
+		case OPERATOR_EQUAL:     return a == b;
+		case OPERATOR_NOT_EQUAL: return a != b;
+		case OPERATOR_LT:        return a < b;
+		case OPERATOR_LTE:       return a <= b;
+		case OPERATOR_GT:        return a > b;
+		default:                 return a >= b;
+	}
+}
+
+//
+// execute_condition()
+//
+// Given the condition of a while loop (loop is true) or an if, returns whether it holds (CONDITION_TRUE) or not
+// (CONDITION_FALSE), or CONDITION_HALT if execution must stop. Conditions of the form x, x op y, x op 1 or 1 op *p, where op is relational
+// and the operands are numbers (or x is a boolean), are tested directly on the values in memory; everything else is
+// computed by execute_binary_expression() and then tested.
+//
+int execute_condition(struct EXPR* condition, bool loop, struct RAM* memory, int line_num) {
+	const struct RAM_VALUE* lhs = condition_operand(condition->lhs, memory);
+
+	if (lhs != NULL && !condition->isBinaryExpr) {
+		if (lhs->value_type == RAM_TYPE_INT || lhs->value_type == RAM_TYPE_BOOLEAN) {
+			return (lhs->types.i != 0) ? CONDITION_TRUE : CONDITION_FALSE;
+		}
+		if (lhs->value_type == RAM_TYPE_REAL) {
+			return (lhs->types.d != 0.0) ? CONDITION_TRUE : CONDITION_FALSE;
+		}
+	}
+	else if (lhs != NULL && is_relational_op(condition->operator) &&
+		(lhs->value_type == RAM_TYPE_INT || lhs->value_type == RAM_TYPE_REAL)) {
+		const struct RAM_VALUE* rhs = condition_operand(condition->rhs, memory);
+
+		if (rhs != NULL && (rhs->value_type == RAM_TYPE_INT || rhs->value_type == RAM_TYPE_REAL)) {
+			return compare_numbers(condition->operator, lhs, rhs) ? CONDITION_TRUE : CONDITION_FALSE;
+		}
+	}
+
+	struct RAM_VALUE condition_result = { .value_type = RAM_TYPE_NONE };
+	int truth;
+
+	// an error stops execution, unless a loop test left a value behind: that only ends the loop
+	if (!execute_binary_expression(condition, &condition_result, memory, line_num)) {
+		truth = (loop && condition_result.value_type != RAM_TYPE_NONE) ? CONDITION_FALSE : CONDITION_HALT;
+	}
+	else if (condition_result.value_type == RAM_TYPE_BOOLEAN || condition_result.value_type == RAM_TYPE_INT) {
+		truth = (condition_result.types.i != 0) ? CONDITION_TRUE : CONDITION_FALSE;
+	}
+	else if (condition_result.value_type == RAM_TYPE_REAL) {
+		truth = (condition_result.types.d != 0.0) ? CONDITION_TRUE : CONDITION_FALSE;
+	}
+	else if (loop) {
+		output_error("**SEMANTIC ERROR: invalid while loop condition type (line %d)\n", line_num);
+		truth = CONDITION_FALSE;
+	}
+	else {
+		output_error("**SEMANTIC ERROR: invalid if condition type (line %d)\n", line_num);
+		truth = CONDITION_HALT;
+	}
+
+	ram_value_release(&condition_result);
+	return truth;
+}
+
+//
+// execute_safe_condition()
+//
+// Given the condition of a while loop or an if proven safe (see validate.h), returns whether it holds, without any
+// checks: its value is surely an int, a real or a boolean.
+//
+int execute_safe_condition(struct EXPR* condition, struct RAM* memory, int line_num) {
+	struct RAM_VALUE value = safe_expr_value(condition, memory, line_num);
+
+	if (value.value_type == RAM_TYPE_REAL) {
+		return (value.types.d != 0.0) ? CONDITION_TRUE : CONDITION_FALSE;
+	}
+	return (value.types.i != 0) ? CONDITION_TRUE : CONDITION_FALSE;
+}
+
 //
 // execute
 //
@@ -1037,7 +1423,7 @@ bool execute_function_call(struct STMT* stmt, struct RAM* memory) {
 // and error message is output, execution stops,
 // and the function returns.
 //
-void execute(struct STMT* program, struct RAM* memory)
+bool execute(struct STMT* program, struct RAM* memory)
 {
 	struct STMT* stmt = program;
 	while (stmt != NULL) {
@@ -1045,9 +1431,10 @@ void execute(struct STMT* program, struct RAM* memory)
 		switch (stmt->stmt_type) {
 			case STMT_ASSIGNMENT: {
 				int line = stmt->line;
-				if (!execute_assignment(stmt, memory)) {
+				bool assigned = stmt->safe ? execute_safe_assignment(stmt, memory) : execute_assignment(stmt, memory);
+				if (!assigned) {
 					// assignment not done properly
-					return;
+					return false;
 				}
 				stmt = stmt->types.assignment->next_stmt;
 				break;
@@ -1057,7 +1444,7 @@ void execute(struct STMT* program, struct RAM* memory)
 				int line = stmt->line;
 				if (!execute_function_call(stmt, memory)) {
 					// function (print) call was not done properly
-					return;
+					return false;
 				}
 				stmt = stmt->types.function_call->next_stmt;
 				break;
@@ -1069,50 +1456,39 @@ void execute(struct STMT* program, struct RAM* memory)
 				break;
 			}
 
+			case STMT_IF_THEN_ELSE: {
+				struct STMT_IF_THEN_ELSE* if_then_else = stmt->types.if_then_else;
+
+				// evaluate the conditional, stopping if it can't be
+				int truth = stmt->safe
+					? execute_safe_condition(if_then_else->condition, memory, stmt->line)
+					: execute_condition(if_then_else->condition, false, memory, stmt->line);
+				if (truth == CONDITION_HALT) {
+					return false;
+				}
+
+				// take the true path or the false path (elif, else, or the statement after the if)
+				stmt = (truth == CONDITION_TRUE) ? if_then_else->true_path : if_then_else->false_path;
+				break;
+			}
+
 			case STMT_WHILE_LOOP: {
 				struct STMT_WHILE_LOOP* while_loop = stmt->types.while_loop;
-				bool continueLoop = true;
-
-				struct RAM_VALUE condition_result = { .value_type = RAM_TYPE_NONE };
-
-				// evaluate the loop conditional 
-				continueLoop = execute_binary_expression(while_loop->condition, &condition_result, memory, stmt->line);
-
-				// if the condition is satisfied, go to the first statement in the loop body
-				if (continueLoop) {
-					if (condition_result.value_type == RAM_TYPE_BOOLEAN) {
-						continueLoop = condition_result.types.i;
-					} 
-					else if (condition_result.value_type == RAM_TYPE_INT) {
-						continueLoop = (condition_result.types.i != 0);
-					} 
-					else if (condition_result.value_type == RAM_TYPE_REAL) {
-						continueLoop = (condition_result.types.d != 0.0);
-					} 
-					else {
-						printf("**SEMANTIC ERROR: invalid while loop condition type (line %d)\n", stmt->line);
-						stmt = while_loop->next_stmt;
-						break;
-					}
 
-					if (!continueLoop) {
-						stmt = while_loop->next_stmt;
-					}
-					else {
-						stmt = while_loop->loop_body;
-					}
+				// evaluate the loop conditional, stopping if it can't be
+				int truth = stmt->safe
+					? execute_safe_condition(while_loop->condition, memory, stmt->line)
+					: execute_condition(while_loop->condition, true, memory, stmt->line);
+				if (truth == CONDITION_HALT) {
+					return false;
 				}
 
-				// if not satisfied, go to statement after the loop
-				else {
-					if (condition_result.value_type == RAM_TYPE_NONE) {
-						return;
-					}
-					stmt = while_loop->next_stmt;
-				}
-				
+				// if the condition is satisfied, go to the first statement in the loop body, else the statement after the loop
+				stmt = (truth == CONDITION_TRUE) ? while_loop->loop_body : while_loop->next_stmt;
 				break;
 			}
 		}
 	}
+
+	return true;
 }
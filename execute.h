@@ -13,6 +13,46 @@
 #include "programgraph.h"
 #include "ram.h"
 
+
+//
+// Inline caches for binary operators: each EXPR remembers the operand
+// types it saw last (cache_key), and while they stay the same it goes
+// straight to the int/int, real/real or mixed kernel for them instead
+// of determine_op_result()'s chain of checks. Only number pairs are
+// cached; strings, pointers and booleans always take the generic path.
+//
+// Where the type inference pass proved the operand types (proven_key,
+// see typeinfer.h), the cache isn't consulted: the kernel for those
+// types is used directly, strings and pointers included.
+//
+#define OP_CACHE_KEY(lhs_type, rhs_type)  (((lhs_type) + 1) * 8 + (rhs_type) + 1)
+
+//
+// counters for all caches, to check they are monomorphic (see main.c,
+// --stats):
+//
+struct OP_CACHE_STATS
+{
+  long proven;       // operand types were proven, nothing checked
+  long hits;         // operand types were the cached ones
+  long misses;       // cache was (re)filled
+  long polymorphic;  // ... replacing different operand types
+  long generic;      // operand types that are never cached
+};
+
+extern struct OP_CACHE_STATS op_cache_stats;
+
+//
+// outcome of a while loop's condition (see execute_condition):
+//
+enum CONDITION_RESULTS
+{
+  CONDITION_FALSE = 0,
+  CONDITION_TRUE,
+  CONDITION_HALT
+};
+
+
 //
 // Public functions:
 //
@@ -33,6 +73,15 @@ bool handle_function(struct FUNCTION_CALL* func_call, struct RAM_VALUE* stored_v
 //
 bool handle_conversion(struct FUNCTION_CALL* func_call, struct RAM_VALUE* stored_value, struct RAM* memory, int line_num);
 
+//
+// literal_value()
+//
+// Given a literal element decoded by the resolution pass, copies its value from the constant pool into value
+// (sharing its string, if any) and returns true. Returns false if the element has no decoded value, e.g. it
+// is an identifier or None.
+//
+bool literal_value(struct ELEMENT* element, struct RAM_VALUE* value);
+
 //
 // handle_normal_expression()
 //
@@ -148,6 +197,15 @@ bool handle_unary_pointer_deref(struct UNARY_EXPR* expr, struct RAM_VALUE* store
 //
 bool determine_op_result(int operator, struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE* result, int line_num, struct RAM* memory, bool lhs_deref, bool rhs_deref);
 
+//
+// cached_op_result()
+//
+// Same as determine_op_result() for the given binary expression's operator, but consults and updates the
+// expression's proven operand types or its inline cache first. The result (and any error message) is the same
+// either way.
+//
+bool cached_op_result(struct EXPR* expr, struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE* result, int line_num, struct RAM* memory, bool lhs_deref, bool rhs_deref);
+
 //
 // retrieve_value
 //
@@ -185,6 +243,33 @@ bool retrieve_value(struct UNARY_EXPR* op, struct RAM* memory, struct RAM_VALUE*
 //
 bool execute_binary_expression(struct EXPR* expr, struct RAM_VALUE* result, struct RAM* memory, int line_num);
 
+//
+// execute_condition
+//
+// Given the condition of a while loop (loop is true) or an if statement, evaluates it straight to the next step:
+// CONDITION_TRUE runs the body / true path, CONDITION_FALSE ends the loop / takes the false path, and CONDITION_HALT
+// stops execution. An error always stops an if; a loop test that fails with a value left behind (e.g. a division
+// by zero) only ends the loop, as execute() always has. Common comparisons of numbers are done without building a
+// RAM_VALUE.
+//
+int execute_condition(struct EXPR* condition, bool loop, struct RAM* memory, int line_num);
+
+//
+// execute_safe_condition
+//
+// Same as execute_condition(), for a condition of a statement proven never to fail (see validate.h): no checks are
+// made, and the result is never CONDITION_HALT.
+//
+int execute_safe_condition(struct EXPR* condition, struct RAM* memory, int line_num);
+
+//
+// execute_safe_assignment
+//
+// Same as execute_assignment(), for an assignment proven never to fail (see validate.h): the variable is assigned
+// without checking the operands or their types.
+//
+bool execute_safe_assignment(struct STMT* stmt, struct RAM* memory);
+
 //
 // execute_assignment
 //
@@ -211,7 +296,8 @@ bool execute_function_call(struct STMT* stmt, struct RAM* memory);
 // executes the statements in the program graph.
 // If a semantic error occurs (e.g. type error),
 // and error message is output, execution stops,
-// and the function returns.
+// and the function returns false. Returns true if
+// the program ran to the end.
 //
-void execute(struct STMT* program, struct RAM* memory);
+bool execute(struct STMT* program, struct RAM* memory);
 
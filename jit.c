@@ -0,0 +1,1230 @@
+/*jit.c*/
+
+//
+// << Template JIT for hot nuPython while loops. Each bytecode instruction
+//    of the loop is translated into a fixed sequence of x86-64 machine
+//    code (a "template"), specialized to the types its operands hold when
+//    the loop is compiled. Guards bail out to the VM on anything else. >>
+//
+// Register use in the generated code, which is called as
+//
+//    int loop(struct RAM_CELL* cells, int num_values)
+//
+//   rdi = memory cells, esi = # of values in memory (for deref checks)
+//   eax/ecx = lhs/rhs int operands (pointers and booleans too)
+//   xmm0/xmm1 = lhs/rhs real operands
+//   edx = scratch for dereferencing
+//   r8d = the loop counter, if the loop has one
+//
+// Variables live in their RAM cells the whole time, so memory is always
+// up to date when the code bails out; the VM writes back the ones it
+// keeps in registers (VM_REG) before it runs the code, and loads them
+// again after (see vm.h). The one exception is the loop's
+// induction variable i (see optimize.h): it is loaded into r8d on entry
+// and stepped there with a single add, and written back to its cell only
+// when something could read it through RAM (a dereference, a call to
+// print) and in the bail-out stubs, which is how every loop exits.
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#define _DEFAULT_SOURCE  // MAP_ANONYMOUS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <stdint.h>   // uint64_t, uintptr_t
+#include <stddef.h>   // offsetof
+#include <string.h>
+#include <limits.h>   // INT_MIN
+
+#include "programgraph.h"
+#include "ram.h"
+#include "vm.h"
+#include "jit.h"
+#include "output.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <sys/mman.h>  // mmap, mprotect
+
+
+//
+// layout of memory cells, as seen by the generated code
+//
+#define CELL_SIZE   ((int)sizeof(struct RAM_CELL))
+#define VALUE_OFF   ((int)offsetof(struct RAM_CELL, value))
+#define TYPE_OFF    (VALUE_OFF + (int)offsetof(struct RAM_VALUE, value_type))
+#define PAYLOAD_OFF (VALUE_OFF + (int)offsetof(struct RAM_VALUE, types))
+
+//
+// registers, by their x86-64 encoding
+//
+#define EAX 0
+#define ECX 1
+#define EDX 2
+#define ESI 6
+#define EDI 7
+
+//
+// condition codes, as used by jcc (0x0F 0x80+cc) and setcc (0x0F 0x90+cc)
+//
+#define CC_O  0x0
+#define CC_B  0x2   // unsigned <
+#define CC_AE 0x3   // unsigned >=
+#define CC_E  0x4
+#define CC_NE 0x5
+#define CC_A  0x7   // unsigned >
+#define CC_P  0xA   // parity (unordered reals)
+#define CC_NP 0xB
+#define CC_L  0xC
+#define CC_GE 0xD
+#define CC_LE 0xE
+#define CC_G  0xF
+
+//
+// how a binary operator is compiled, given its operand types
+//
+enum JIT_BINARY_KINDS
+{
+  JIT_UNSUPPORTED = 0,
+  JIT_INT_ARITH,
+  JIT_INT_COMPARE,
+  JIT_REAL_ARITH,
+  JIT_REAL_COMPARE,
+  JIT_PTR_ARITH
+};
+
+//
+// a jump to a bail-out stub, patched once the stubs are emitted
+//
+struct FIXUP
+{
+  int at;  // offset of the jump's rel32
+  int pc;  // bytecode instruction to return to the VM
+};
+
+struct EMITTER
+{
+  unsigned char* buf;
+  int len;
+  int cap;
+  bool failed;  // out of memory or something not compilable
+
+  struct FIXUP* fixups;
+  int num_fixups;
+  int fixup_cap;
+
+  //
+  // what we are compiling: the VM program, memory (for addresses and
+  // observed types), and the static type of every slot at this point
+  // in the loop (-1 => not used by the loop)
+  //
+  struct VM_PROGRAM* vm;
+  struct RAM* memory;
+  int* types;
+
+  int counter;  // slot kept in r8d, or -1
+  int step;     // what the counter's step instruction adds to it
+};
+
+
+//
+// Private functions:
+//
+
+//
+// emit_byte
+//
+// Appends one byte of machine code.
+//
+static void emit_byte(struct EMITTER* e, int byte)
+{
+	if (e->len >= e->cap) {
+		int new_cap = e->cap * 2;
+		unsigned char* new_buf = (unsigned char*)realloc(e->buf, new_cap);
+		if (new_buf == NULL) {
+			e->failed = true;
+			return;
+		}
+		e->buf = new_buf;
+		e->cap = new_cap;
+	}
+
+	e->buf[e->len++] = (unsigned char)byte;
+}
+
+
+//
+// emit_bytes
+//
+// Appends the given bytes of machine code.
+//
+static void emit_bytes(struct EMITTER* e, int n, const unsigned char* bytes)
+{
+	for (int i = 0; i < n; i++) {
+		emit_byte(e, bytes[i]);
+	}
+}
+
+#define EMIT(e, ...) \
+	do { \
+		static const unsigned char bytes_[] = { __VA_ARGS__ }; \
+		emit_bytes(e, (int)sizeof(bytes_), bytes_); \
+	} while (0)
+
+
+//
+// emit_i32 / emit_i64
+//
+// Appends a little-endian immediate or displacement.
+//
+static void emit_i32(struct EMITTER* e, int32_t value)
+{
+	uint32_t v = (uint32_t)value;
+	for (int i = 0; i < 4; i++) {
+		emit_byte(e, (v >> (8 * i)) & 0xFF);
+	}
+}
+
+static void emit_i64(struct EMITTER* e, uint64_t value)
+{
+	for (int i = 0; i < 8; i++) {
+		emit_byte(e, (value >> (8 * i)) & 0xFF);
+	}
+}
+
+
+//
+// emit_rdi_modrm
+//
+// Appends the ModRM byte + disp32 that address [rdi + disp] with the
+// given register (or opcode extension) in the reg field.
+//
+static void emit_rdi_modrm(struct EMITTER* e, int reg, int disp)
+{
+	emit_byte(e, 0x80 | (reg << 3) | EDI);
+	emit_i32(e, disp);
+}
+
+
+//
+// cell_disp
+//
+// Returns the offset of the given field of the cell at the given
+// memory address, relative to rdi.
+//
+static int cell_disp(int addr, int field_off)
+{
+	return addr * CELL_SIZE + field_off;
+}
+
+
+//
+// slot_addr
+//
+// Returns the memory address bound to the given slot, or -1.
+//
+static int slot_addr(struct RAM* memory, int slot)
+{
+	return ram_get_addr_by_slot(memory, slot);
+}
+
+
+//
+// emit_bail
+//
+// Appends a jump (jcc if cc >= 0, else jmp) to the stub that returns
+// the given bytecode index to the VM.
+//
+static void emit_bail(struct EMITTER* e, int cc, int pc)
+{
+	if (cc >= 0) {
+		emit_byte(e, 0x0F);
+		emit_byte(e, 0x80 | cc);
+	}
+	else {
+		emit_byte(e, 0xE9);
+	}
+
+	if (e->num_fixups >= e->fixup_cap) {
+		int new_cap = e->fixup_cap * 2;
+		struct FIXUP* new_fixups = (struct FIXUP*)realloc(e->fixups, new_cap * sizeof(struct FIXUP));
+		if (new_fixups == NULL) {
+			e->failed = true;
+			return;
+		}
+		e->fixups = new_fixups;
+		e->fixup_cap = new_cap;
+	}
+
+	e->fixups[e->num_fixups].at = e->len;
+	e->fixups[e->num_fixups].pc = pc;
+	e->num_fixups++;
+
+	emit_i32(e, 0);  // patched later
+}
+
+
+//
+// emit_flush_counter
+//
+// Appends code that writes the counter in r8d back to its cell, if
+// the loop keeps one there.
+//
+static void emit_flush_counter(struct EMITTER* e)
+{
+	if (e->counter != -1) {
+		EMIT(e, 0x44, 0x89);  // mov [rdi + payload], r8d
+		emit_rdi_modrm(e, 0, cell_disp(slot_addr(e->memory, e->counter), PAYLOAD_OFF));
+	}
+}
+
+
+//
+// emit_deref
+//
+// Appends code that loads the pointer in the given slot into rdx and
+// turns it into the address of the cell it points to, bailing out if
+// the pointer is out of range or the cell does not hold the type we
+// compiled for. The pointer may point at the counter, so the counter
+// is written back first.
+//
+static void emit_deref(struct EMITTER* e, int ptr_slot, int expected_type, int pc)
+{
+	emit_flush_counter(e);
+
+	if (ptr_slot == e->counter) {
+		EMIT(e, 0x44, 0x89, 0xC2);  // mov edx, r8d
+	}
+	else {
+		emit_byte(e, 0x8B);  // mov edx, [rdi + ptr.payload]
+		emit_rdi_modrm(e, EDX, cell_disp(slot_addr(e->memory, ptr_slot), PAYLOAD_OFF));
+	}
+
+	// cmp edx, esi; jae bail  (also catches negative addresses)
+	EMIT(e, 0x39, 0xF2);
+	emit_bail(e, CC_AE, pc);
+
+	// imul rdx, rdx, CELL_SIZE; add rdx, rdi
+	EMIT(e, 0x48, 0x69, 0xD2);
+	emit_i32(e, CELL_SIZE);
+	EMIT(e, 0x48, 0x01, 0xFA);
+
+	// cmp dword [rdx + type], expected; jne bail
+	EMIT(e, 0x83, 0x7A, TYPE_OFF);
+	emit_byte(e, expected_type);
+	emit_bail(e, CC_NE, pc);
+}
+
+
+//
+// deref_type
+//
+// Returns the type of the value the given pointer slot points to
+// right now, which is what we specialize a dereference for, or -1.
+//
+static int deref_type(struct EMITTER* e, int slot)
+{
+	const struct RAM_VALUE* ptr = ram_borrow_cell_by_slot(e->memory, slot);
+	if (ptr == NULL || ptr->value_type != RAM_TYPE_PTR) {
+		return -1;
+	}
+
+	const struct RAM_VALUE* target = ram_borrow_cell_by_addr(e->memory, ptr->types.i);
+	if (target == NULL) {
+		return -1;
+	}
+
+	return target->value_type;
+}
+
+
+//
+// is_jit_type
+//
+// Returns true if the generated code can hold values of the given type.
+//
+static bool is_jit_type(int type)
+{
+	return type == RAM_TYPE_INT || type == RAM_TYPE_REAL ||
+		type == RAM_TYPE_PTR || type == RAM_TYPE_BOOLEAN;
+}
+
+
+//
+// operand_type
+//
+// Returns the static type of the given operand at this point in the
+// loop, or -1 if the JIT can't handle it.
+//
+static int operand_type(struct EMITTER* e, struct VM_OPERAND* operand)
+{
+	int type = -1;
+
+	switch (operand->kind) {
+		case VM_CONST:
+			type = e->vm->constants[operand->index].value_type;
+			break;
+
+		case VM_SLOT:
+		case VM_REG:
+			type = e->types[operand->index];
+			break;
+
+		case VM_ADDR:
+			type = RAM_TYPE_PTR;
+			break;
+
+		case VM_DEREF:
+			if (e->types[operand->index] == RAM_TYPE_PTR) {
+				type = deref_type(e, operand->index);
+			}
+			break;
+	}
+
+	return is_jit_type(type) ? type : -1;
+}
+
+
+//
+// emit_load_int
+//
+// Appends code that loads an int-like operand (int, pointer, boolean)
+// into the given register (eax or ecx).
+//
+static void emit_load_int(struct EMITTER* e, int reg, struct VM_OPERAND* operand, int type, int pc)
+{
+	switch (operand->kind) {
+		case VM_CONST:
+			emit_byte(e, 0xB8 + reg);  // mov reg, imm32
+			emit_i32(e, e->vm->constants[operand->index].types.i);
+			break;
+
+		case VM_SLOT:
+		case VM_REG:
+			if (operand->index == e->counter) {
+				EMIT(e, 0x44, 0x89);  // mov reg, r8d
+				emit_byte(e, 0xC0 | reg);
+				break;
+			}
+			emit_byte(e, 0x8B);  // mov reg, [rdi + payload]
+			emit_rdi_modrm(e, reg, cell_disp(slot_addr(e->memory, operand->index), PAYLOAD_OFF));
+			break;
+
+		case VM_ADDR:
+			emit_byte(e, 0xB8 + reg);  // mov reg, addr
+			emit_i32(e, slot_addr(e->memory, operand->index));
+			break;
+
+		case VM_DEREF:
+			emit_deref(e, operand->index, type, pc);
+			emit_byte(e, 0x8B);  // mov reg, [rdx + payload]
+			emit_byte(e, 0x42 | (reg << 3));
+			emit_byte(e, PAYLOAD_OFF);
+			break;
+	}
+}
+
+
+//
+// emit_load_real
+//
+// Appends code that loads a numeric operand into the given xmm register
+// (0 or 1) as a real, converting ints as the executor does.
+//
+static void emit_load_real(struct EMITTER* e, int xmm, struct VM_OPERAND* operand, int type, int pc)
+{
+	if (type == RAM_TYPE_INT) {
+		emit_load_int(e, xmm, operand, type, pc);  // into eax / ecx
+		EMIT(e, 0xF2, 0x0F, 0x2A);                 // cvtsi2sd xmm, reg
+		emit_byte(e, 0xC0 | (xmm << 3) | xmm);
+		return;
+	}
+
+	switch (operand->kind) {
+		case VM_CONST: {
+			uint64_t bits;
+			memcpy(&bits, &e->vm->constants[operand->index].types.d, sizeof(bits));
+			EMIT(e, 0x48, 0xB8);  // mov rax, imm64
+			emit_i64(e, bits);
+			EMIT(e, 0x66, 0x48, 0x0F, 0x6E);  // movq xmm, rax
+			emit_byte(e, 0xC0 | (xmm << 3));
+			break;
+		}
+
+		case VM_SLOT:
+		case VM_REG:
+			EMIT(e, 0xF2, 0x0F, 0x10);  // movsd xmm, [rdi + payload]
+			emit_rdi_modrm(e, xmm, cell_disp(slot_addr(e->memory, operand->index), PAYLOAD_OFF));
+			break;
+
+		case VM_DEREF:
+			emit_deref(e, operand->index, type, pc);
+			EMIT(e, 0xF2, 0x0F, 0x10);  // movsd xmm, [rdx + payload]
+			emit_byte(e, 0x42 | (xmm << 3));
+			emit_byte(e, PAYLOAD_OFF);
+			break;
+
+		default:
+			e->failed = true;
+			break;
+	}
+}
+
+
+//
+// binary_kind
+//
+// Decides how lhs operator rhs is computed for the given operand types,
+// following determine_op_result(). Anything that is an error there (or
+// that we don't compile, like ** and real %) is JIT_UNSUPPORTED.
+//
+static int binary_kind(int operator, int lhs_type, int rhs_type, bool lhs_deref, bool rhs_deref)
+{
+	bool relational = (operator >= OPERATOR_EQUAL && operator <= OPERATOR_GTE);
+
+	// pointer arithmetic, only + and - are legal
+	if ((lhs_type == RAM_TYPE_PTR && rhs_type == RAM_TYPE_INT && !lhs_deref) ||
+		(rhs_type == RAM_TYPE_PTR && lhs_type == RAM_TYPE_INT && !rhs_deref)) {
+		return (operator == OPERATOR_PLUS || operator == OPERATOR_MINUS) ? JIT_PTR_ARITH : JIT_UNSUPPORTED;
+	}
+
+	bool lhs_num = (lhs_type == RAM_TYPE_INT || lhs_type == RAM_TYPE_REAL);
+	bool rhs_num = (rhs_type == RAM_TYPE_INT || rhs_type == RAM_TYPE_REAL);
+	if (!lhs_num || !rhs_num) {
+		return JIT_UNSUPPORTED;
+	}
+
+	if (lhs_type == RAM_TYPE_INT && rhs_type == RAM_TYPE_INT) {
+		if (relational) {
+			return JIT_INT_COMPARE;
+		}
+		switch (operator) {
+			case OPERATOR_PLUS:
+			case OPERATOR_MINUS:
+			case OPERATOR_ASTERISK:
+			case OPERATOR_DIV:
+			case OPERATOR_MOD:
+				return JIT_INT_ARITH;
+			default:
+				return JIT_UNSUPPORTED;
+		}
+	}
+
+	if (relational) {
+		return JIT_REAL_COMPARE;
+	}
+	switch (operator) {
+		case OPERATOR_PLUS:
+		case OPERATOR_MINUS:
+		case OPERATOR_ASTERISK:
+		case OPERATOR_DIV:
+			return JIT_REAL_ARITH;
+		default:
+			return JIT_UNSUPPORTED;
+	}
+}
+
+
+//
+// emit_binary
+//
+// Appends code that computes instr's lhs operator rhs into eax (int,
+// pointer or boolean result) or xmm0 (real result). Returns the type
+// of the result, or -1 if the operation can't be compiled.
+//
+static int emit_binary(struct EMITTER* e, struct VM_INSTR* instr, int pc)
+{
+	int lhs_type = operand_type(e, &instr->lhs);
+	int rhs_type = operand_type(e, &instr->rhs);
+	if (lhs_type == -1 || rhs_type == -1) {
+		return -1;
+	}
+
+	int kind = binary_kind(instr->operator, lhs_type, rhs_type,
+		instr->lhs.kind == VM_DEREF, instr->rhs.kind == VM_DEREF);
+
+	switch (kind) {
+		case JIT_INT_ARITH:
+			emit_load_int(e, EAX, &instr->lhs, lhs_type, pc);
+			emit_load_int(e, ECX, &instr->rhs, rhs_type, pc);
+			switch (instr->operator) {
+				case OPERATOR_PLUS:     EMIT(e, 0x01, 0xC8); break;        // add eax, ecx
+				case OPERATOR_MINUS:    EMIT(e, 0x29, 0xC8); break;        // sub eax, ecx
+				case OPERATOR_ASTERISK: EMIT(e, 0x0F, 0xAF, 0xC1); break;  // imul eax, ecx
+				default:
+					// divide by zero is the interpreter's problem
+					EMIT(e, 0x85, 0xC9);  // test ecx, ecx
+					emit_bail(e, CC_E, pc);
+					EMIT(e, 0x99, 0xF7, 0xF9);  // cdq; idiv ecx
+					if (instr->operator == OPERATOR_MOD) {
+						EMIT(e, 0x89, 0xD0);  // mov eax, edx
+					}
+					break;
+			}
+			return RAM_TYPE_INT;
+
+		case JIT_INT_COMPARE: {
+			static const int setcc[] = { CC_E, CC_NE, CC_L, CC_LE, CC_G, CC_GE };
+			emit_load_int(e, EAX, &instr->lhs, lhs_type, pc);
+			emit_load_int(e, ECX, &instr->rhs, rhs_type, pc);
+			EMIT(e, 0x39, 0xC8);  // cmp eax, ecx
+			EMIT(e, 0x0F);
+			emit_byte(e, 0x90 | setcc[instr->operator - OPERATOR_EQUAL]);
+			EMIT(e, 0xC0, 0x0F, 0xB6, 0xC0);  // setcc al; movzx eax, al
+			return RAM_TYPE_BOOLEAN;
+		}
+
+		case JIT_REAL_ARITH:
+			emit_load_real(e, 0, &instr->lhs, lhs_type, pc);
+			emit_load_real(e, 1, &instr->rhs, rhs_type, pc);
+			switch (instr->operator) {
+				case OPERATOR_PLUS:     EMIT(e, 0xF2, 0x0F, 0x58, 0xC1); break;  // addsd xmm0, xmm1
+				case OPERATOR_MINUS:    EMIT(e, 0xF2, 0x0F, 0x5C, 0xC1); break;  // subsd xmm0, xmm1
+				case OPERATOR_ASTERISK: EMIT(e, 0xF2, 0x0F, 0x59, 0xC1); break;  // mulsd xmm0, xmm1
+				default:
+					// xorpd xmm2, xmm2; ucomisd xmm1, xmm2; jp +6; je bail
+					EMIT(e, 0x66, 0x0F, 0x57, 0xD2, 0x66, 0x0F, 0x2E, 0xCA, 0x7A, 0x06);
+					emit_bail(e, CC_E, pc);
+					EMIT(e, 0xF2, 0x0F, 0x5E, 0xC1);  // divsd xmm0, xmm1
+					break;
+			}
+			return RAM_TYPE_REAL;
+
+		case JIT_REAL_COMPARE:
+			emit_load_real(e, 0, &instr->lhs, lhs_type, pc);
+			emit_load_real(e, 1, &instr->rhs, rhs_type, pc);
+			switch (instr->operator) {
+				case OPERATOR_EQUAL:  // ucomisd xmm0, xmm1; sete al; setnp cl; and al, cl
+					EMIT(e, 0x66, 0x0F, 0x2E, 0xC1, 0x0F, 0x94, 0xC0, 0x0F, 0x9B, 0xC1, 0x20, 0xC8);
+					break;
+				case OPERATOR_NOT_EQUAL:  // ucomisd xmm0, xmm1; setne al; setp cl; or al, cl
+					EMIT(e, 0x66, 0x0F, 0x2E, 0xC1, 0x0F, 0x95, 0xC0, 0x0F, 0x9A, 0xC1, 0x08, 0xC8);
+					break;
+				case OPERATOR_LT:   // ucomisd xmm1, xmm0; seta al
+					EMIT(e, 0x66, 0x0F, 0x2E, 0xC8, 0x0F, 0x97, 0xC0);
+					break;
+				case OPERATOR_LTE:  // ucomisd xmm1, xmm0; setae al
+					EMIT(e, 0x66, 0x0F, 0x2E, 0xC8, 0x0F, 0x93, 0xC0);
+					break;
+				case OPERATOR_GT:   // ucomisd xmm0, xmm1; seta al
+					EMIT(e, 0x66, 0x0F, 0x2E, 0xC1, 0x0F, 0x97, 0xC0);
+					break;
+				default:            // ucomisd xmm0, xmm1; setae al
+					EMIT(e, 0x66, 0x0F, 0x2E, 0xC1, 0x0F, 0x93, 0xC0);
+					break;
+			}
+			EMIT(e, 0x0F, 0xB6, 0xC0);  // movzx eax, al
+			return RAM_TYPE_BOOLEAN;
+
+		case JIT_PTR_ARITH:
+			emit_load_int(e, EAX, &instr->lhs, lhs_type, pc);
+			emit_load_int(e, ECX, &instr->rhs, rhs_type, pc);
+			if (instr->operator == OPERATOR_PLUS) {
+				EMIT(e, 0x01, 0xC8);  // add eax, ecx
+			}
+			else if (lhs_type == RAM_TYPE_PTR) {
+				EMIT(e, 0x29, 0xC8);  // sub eax, ecx
+			}
+			else {
+				// int - ptr is computed as ptr - int by the executor
+				EMIT(e, 0x29, 0xC1, 0x89, 0xC8);  // sub ecx, eax; mov eax, ecx
+			}
+			return RAM_TYPE_PTR;
+
+		default:
+			return -1;
+	}
+}
+
+
+//
+// emit_store
+//
+// Appends code that writes the result (eax, or xmm0 for a real) and
+// its type into the cell of instr's destination, and records the
+// destination's new static type.
+//
+static void emit_store(struct EMITTER* e, struct VM_INSTR* instr, int type)
+{
+	int addr = slot_addr(e->memory, instr->dst);
+
+	emit_byte(e, 0xC7);  // mov dword [rdi + type], imm32
+	emit_rdi_modrm(e, 0, cell_disp(addr, TYPE_OFF));
+	emit_i32(e, type);
+
+	if (type == RAM_TYPE_REAL) {
+		EMIT(e, 0xF2, 0x0F, 0x11);  // movsd [rdi + payload], xmm0
+	}
+	else {
+		emit_byte(e, 0x89);  // mov [rdi + payload], eax
+	}
+	emit_rdi_modrm(e, 0, cell_disp(addr, PAYLOAD_OFF));
+
+	e->types[instr->dst] = type;
+}
+
+
+//
+// jit_print
+//
+// Called from generated code for print(x): x is a number, pointer or
+// boolean variable, or a string constant.
+//
+static void jit_print(const struct RAM_VALUE* value)
+{
+	switch (value->value_type) {
+		case RAM_TYPE_INT:
+		case RAM_TYPE_PTR:
+			output_int(value->types.i);
+			break;
+		case RAM_TYPE_REAL:
+			output_real(value->types.d);
+			break;
+		case RAM_TYPE_BOOLEAN:
+			output_line(value->types.i ? "True" : "False", value->types.i ? 4 : 5);
+			break;
+		case RAM_TYPE_STR:
+			output_line(value->types.s->chars, value->types.s->length);
+			break;
+	}
+}
+
+
+//
+// emit_print
+//
+// Appends a call to jit_print(), saving rdi / rsi around it and
+// keeping the stack 16-byte aligned. The counter is written back (it
+// may be what we print), and r8 saved in place of the alignment pad.
+//
+static bool emit_print(struct EMITTER* e, struct VM_INSTR* instr)
+{
+	if (instr->lhs.kind == VM_SLOT || instr->lhs.kind == VM_REG) {
+		if (!is_jit_type(e->types[instr->lhs.index])) {
+			return false;
+		}
+	}
+	else if (instr->lhs.kind != VM_CONST) {
+		return false;
+	}
+
+	emit_flush_counter(e);
+
+	if (e->counter != -1) {
+		EMIT(e, 0x57, 0x56, 0x41, 0x50);  // push rdi; push rsi; push r8
+	}
+	else {
+		EMIT(e, 0x57, 0x56, 0x48, 0x83, 0xEC, 0x08);  // push rdi; push rsi; sub rsp, 8
+	}
+
+	if (instr->lhs.kind == VM_SLOT || instr->lhs.kind == VM_REG) {
+		EMIT(e, 0x48, 0x8D);  // lea rdi, [rdi + value]
+		emit_rdi_modrm(e, EDI, cell_disp(slot_addr(e->memory, instr->lhs.index), VALUE_OFF));
+	}
+	else {
+		EMIT(e, 0x48, 0xBF);  // mov rdi, &constant
+		emit_i64(e, (uint64_t)(uintptr_t)&e->vm->constants[instr->lhs.index]);
+	}
+
+	EMIT(e, 0x48, 0xB8);  // mov rax, jit_print; call rax
+	emit_i64(e, (uint64_t)(uintptr_t)jit_print);
+	EMIT(e, 0xFF, 0xD0);
+
+	if (e->counter != -1) {
+		EMIT(e, 0x41, 0x58, 0x5E, 0x5F);  // pop r8; pop rsi; pop rdi
+	}
+	else {
+		EMIT(e, 0x48, 0x83, 0xC4, 0x08, 0x5E, 0x5F);  // add rsp, 8; pop rsi; pop rdi
+	}
+	return true;
+}
+
+
+//
+// emit_condition
+//
+// Appends the loop test: evaluates the WHILE condition and jumps to
+// the stub that leaves the loop if it is false.
+//
+static bool emit_condition(struct EMITTER* e, struct VM_INSTR* instr, int pc)
+{
+	int type;
+
+	if (instr->operator == OPERATOR_NO_OP) {
+		type = operand_type(e, &instr->lhs);
+		if (type == RAM_TYPE_REAL) {
+			emit_load_real(e, 0, &instr->lhs, type, pc);
+		}
+		else if (type != -1) {
+			emit_load_int(e, EAX, &instr->lhs, type, pc);
+		}
+	}
+	else {
+		type = emit_binary(e, instr, pc);
+	}
+
+	if (type == RAM_TYPE_INT || type == RAM_TYPE_BOOLEAN) {
+		EMIT(e, 0x85, 0xC0);  // test eax, eax; je exit
+		emit_bail(e, CC_E, instr->target);
+		return true;
+	}
+
+	if (type == RAM_TYPE_REAL) {
+		// xorpd xmm1, xmm1; ucomisd xmm0, xmm1; jp +6; je exit
+		EMIT(e, 0x66, 0x0F, 0x57, 0xC9, 0x66, 0x0F, 0x2E, 0xC1, 0x7A, 0x06);
+		emit_bail(e, CC_E, instr->target);
+		return true;
+	}
+
+	// pointers, strings, ... are reported by the interpreter
+	return false;
+}
+
+
+//
+// collect_slots
+//
+// Marks each slot used by the loop body with the type it holds in
+// memory right now. Returns false if any of them hasn't been written
+// yet or holds a type the JIT can't handle.
+//
+static bool use_slot(struct EMITTER* e, int slot)
+{
+	if (e->types[slot] != -1) {
+		return true;
+	}
+
+	const struct RAM_VALUE* value = ram_borrow_cell_by_slot(e->memory, slot);
+	if (value == NULL || !is_jit_type(value->value_type)) {
+		return false;
+	}
+
+	e->types[slot] = value->value_type;
+	return true;
+}
+
+static bool collect_slots(struct EMITTER* e, int head, int end)
+{
+	for (int pc = head; pc < end; pc++) {
+		struct VM_INSTR* instr = &e->vm->code[pc];
+		struct VM_OPERAND* operands[] = { &instr->lhs, &instr->rhs };
+
+		for (int i = 0; i < 2; i++) {
+			if (operands[i]->kind != VM_CONST && !use_slot(e, operands[i]->index)) {
+				return false;
+			}
+		}
+
+		if (instr->dst != -1 && !use_slot(e, instr->dst)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+//
+// find_counter
+//
+// Decides whether the loop's counter (see the WHILE instruction) can
+// live in r8d: it must hold an int or a pointer, and be written only
+// by one BINARY that adds (or subtracts) an int constant to it, which
+// keeps its type. Sets e->counter and e->step.
+//
+static void find_counter(struct EMITTER* e, int head, int end)
+{
+	int counter = e->vm->code[head].counter;
+
+	e->counter = -1;
+	e->step = 0;
+
+	if (counter == -1 || (e->types[counter] != RAM_TYPE_INT && e->types[counter] != RAM_TYPE_PTR)) {
+		return;
+	}
+
+	int writes = 0;
+	int step = 0;
+
+	for (int pc = head; pc < end; pc++) {
+		struct VM_INSTR* instr = &e->vm->code[pc];
+		if (instr->dst != counter) {
+			continue;
+		}
+
+		writes++;
+
+		struct VM_OPERAND* x = &instr->lhs;
+		struct VM_OPERAND* n = &instr->rhs;
+		if (instr->operator == OPERATOR_PLUS && (n->kind == VM_SLOT || n->kind == VM_REG)) {
+			x = &instr->rhs;
+			n = &instr->lhs;
+		}
+
+		if (instr->opcode != VM_BINARY || (x->kind != VM_SLOT && x->kind != VM_REG) || x->index != counter ||
+			n->kind != VM_CONST || e->vm->constants[n->index].value_type != RAM_TYPE_INT) {
+			return;
+		}
+
+		if (instr->operator == OPERATOR_PLUS) {
+			step = e->vm->constants[n->index].types.i;
+		}
+		else if (instr->operator == OPERATOR_MINUS && x == &instr->lhs && e->vm->constants[n->index].types.i != INT_MIN) {
+			step = -e->vm->constants[n->index].types.i;
+		}
+		else {
+			return;
+		}
+	}
+
+	if (writes == 1) {
+		e->counter = counter;
+		e->step = step;
+	}
+}
+
+
+//
+// emit_loop
+//
+// Appends the code for the loop head..end. Returns false if some
+// instruction can't be compiled.
+//
+static bool emit_loop(struct EMITTER* e, int head, int end, int* offsets, int* entry_types, int num_slots)
+{
+	struct RAM* memory = e->memory;
+
+	// load the counter first: the stubs write it back, even when an
+	// entry check fails (and then it is written back unchanged)
+	if (e->counter != -1) {
+		EMIT(e, 0x44, 0x8B);  // mov r8d, [rdi + payload]
+		emit_rdi_modrm(e, 0, cell_disp(slot_addr(memory, e->counter), PAYLOAD_OFF));
+	}
+
+	// entry checks: every variable must hold the type we compile for
+	for (int slot = 0; slot < num_slots; slot++) {
+		if (entry_types[slot] == -1) {
+			continue;
+		}
+		emit_byte(e, 0x83);  // cmp dword [rdi + type], imm8; jne bail
+		emit_rdi_modrm(e, 7, cell_disp(slot_addr(memory, slot), TYPE_OFF));
+		emit_byte(e, entry_types[slot]);
+		emit_bail(e, CC_NE, head);
+	}
+
+	for (int pc = head; pc < end; pc++) {
+		struct VM_INSTR* instr = &e->vm->code[pc];
+		offsets[pc - head] = e->len;
+
+		switch (instr->opcode) {
+			case VM_WHILE:
+				if (pc != head || instr->stmt != NULL || !emit_condition(e, instr, pc)) {
+					return false;  // nested loop, or condition left to the executor
+				}
+				break;
+
+			case VM_MOVE: {
+				int type = operand_type(e, &instr->lhs);
+				if (type == -1) {
+					return false;
+				}
+				if (type == RAM_TYPE_REAL) {
+					emit_load_real(e, 0, &instr->lhs, type, pc);
+				}
+				else {
+					emit_load_int(e, EAX, &instr->lhs, type, pc);
+				}
+				emit_store(e, instr, type);
+				break;
+			}
+
+			case VM_BINARY: {
+				if (instr->dst == e->counter) {
+					EMIT(e, 0x41, 0x81, 0xC0);  // add r8d, step
+					emit_i32(e, e->step);
+					break;
+				}
+
+				int type = emit_binary(e, instr, pc);
+				if (type == -1) {
+					return false;
+				}
+				emit_store(e, instr, type);
+				break;
+			}
+
+			case VM_PRINT:
+				if (!emit_print(e, instr)) {
+					return false;
+				}
+				break;
+
+			case VM_JUMP:
+				if (pc != end - 1 || instr->target != head) {
+					return false;
+				}
+				// back to the loop test, skipping the entry checks
+				emit_byte(e, 0xE9);
+				emit_i32(e, offsets[0] - (e->len + 4));
+				break;
+
+			default:
+				return false;
+		}
+
+		if (e->failed) {
+			return false;
+		}
+	}
+
+	// the loop has to leave every variable with the type it started with
+	for (int slot = 0; slot < num_slots; slot++) {
+		if (e->types[slot] != entry_types[slot]) {
+			return false;
+		}
+	}
+
+	// bail-out stubs: [mov [rdi + payload], r8d]; mov eax, pc; ret
+	offsets[end - head] = e->len;
+
+	for (int i = 0; i < e->num_fixups; i++) {
+		int stub = -1;
+		for (int j = 0; j < i; j++) {
+			if (e->fixups[j].pc == e->fixups[i].pc) {
+				int rel;
+				memcpy(&rel, &e->buf[e->fixups[j].at], sizeof(rel));
+				stub = e->fixups[j].at + 4 + rel;
+				break;
+			}
+		}
+
+		if (stub == -1) {
+			stub = e->len;
+			emit_flush_counter(e);
+			emit_byte(e, 0xB8);
+			emit_i32(e, e->fixups[i].pc);
+			emit_byte(e, 0xC3);
+			if (e->failed) {
+				return false;
+			}
+		}
+
+		int rel = stub - (e->fixups[i].at + 4);
+		memcpy(&e->buf[e->fixups[i].at], &rel, sizeof(rel));
+	}
+
+	return !e->failed;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// jit_available
+//
+// Returns true if native code can be generated on this platform.
+//
+bool jit_available(void)
+{
+	return true;
+}
+
+
+//
+// jit_compile_loop
+//
+// Compiles the while loop at head, specialized to the types in memory,
+// or returns NULL if it can't be compiled.
+//
+struct JIT_LOOP* jit_compile_loop(struct VM_PROGRAM* vm, int head, struct RAM* memory)
+{
+	struct VM_INSTR* instr = &vm->code[head];
+	if (instr->opcode != VM_WHILE || instr->stmt != NULL) {
+		return NULL;
+	}
+
+	int end = instr->target;  // just past the loop's JUMP
+	int num_slots = memory->num_slots;
+
+	struct EMITTER e;
+	memset(&e, 0, sizeof(e));
+	e.vm = vm;
+	e.memory = memory;
+	e.counter = -1;
+	e.cap = 256;
+	e.buf = (unsigned char*)malloc(e.cap);
+	e.fixup_cap = 16;
+	e.fixups = (struct FIXUP*)malloc(e.fixup_cap * sizeof(struct FIXUP));
+	e.types = (int*)malloc((num_slots + 1) * sizeof(int));
+
+	int* entry_types = (int*)malloc((num_slots + 1) * sizeof(int));
+	int* offsets = (int*)malloc((end - head + 1) * sizeof(int));
+
+	struct JIT_LOOP* loop = NULL;
+	bool compiled = false;
+
+	if (e.buf != NULL && e.fixups != NULL && e.types != NULL && entry_types != NULL && offsets != NULL) {
+		for (int slot = 0; slot < num_slots; slot++) {
+			e.types[slot] = -1;
+		}
+
+		if (collect_slots(&e, head, end)) {
+			memcpy(entry_types, e.types, num_slots * sizeof(int));
+			find_counter(&e, head, end);
+			compiled = emit_loop(&e, head, end, offsets, entry_types, num_slots);
+		}
+	}
+
+	if (compiled) {
+		loop = (struct JIT_LOOP*)malloc(sizeof(struct JIT_LOOP));
+	}
+
+	if (loop != NULL) {
+		long page = 4096;
+		loop->head = head;
+		loop->end = end;
+		loop->line = instr->line;
+		loop->deopts = 0;
+		loop->counter = e.counter;
+		loop->size = e.len;
+		loop->mapped = ((e.len + page - 1) / page) * page;
+		loop->offsets = offsets;
+
+		// write the code, then make it executable (but no longer writable)
+		void* mem = mmap(NULL, loop->mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mem == MAP_FAILED) {
+			free(loop);
+			loop = NULL;
+		}
+		else {
+			memcpy(mem, e.buf, e.len);
+			if (mprotect(mem, loop->mapped, PROT_READ | PROT_EXEC) != 0) {
+				munmap(mem, loop->mapped);
+				free(loop);
+				loop = NULL;
+			}
+			else {
+				loop->code = (unsigned char*)mem;
+				offsets = NULL;  // owned by the loop now
+			}
+		}
+	}
+
+	free(e.buf);
+	free(e.fixups);
+	free(e.types);
+	free(entry_types);
+	free(offsets);
+
+	return loop;
+}
+
+
+//
+// jit_run
+//
+// Runs the compiled loop, returning the bytecode index to continue at.
+//
+int jit_run(struct JIT_LOOP* loop, struct RAM* memory)
+{
+	int (*entry)(struct RAM_CELL*, int);
+
+	// ISO C has no cast from data to function pointers, so copy the bits
+	void* code = loop->code;
+	memcpy(&entry, &code, sizeof(entry));
+
+	return entry(memory->cells, memory->num_values);
+}
+
+
+//
+// jit_free
+//
+// Frees the memory (and code) associated with the compiled loop.
+//
+void jit_free(struct JIT_LOOP* loop)
+{
+	if (loop == NULL) {
+		return;
+	}
+
+	munmap(loop->code, loop->mapped);
+	free(loop->offsets);
+	free(loop);
+}
+
+#else  // no JIT for this platform
+
+bool jit_available(void)
+{
+	return false;
+}
+
+struct JIT_LOOP* jit_compile_loop(struct VM_PROGRAM* vm, int head, struct RAM* memory)
+{
+	return NULL;
+}
+
+int jit_run(struct JIT_LOOP* loop, struct RAM* memory)
+{
+	return loop->head;
+}
+
+void jit_free(struct JIT_LOOP* loop)
+{
+}
+
+#endif
+
+
+//
+// jit_dump
+//
+// Prints the native code for the compiled loop, grouped by the
+// bytecode instruction each piece was generated for.
+//
+void jit_dump(struct JIT_LOOP* loop, struct VM_PROGRAM* vm)
+{
+	static const char* opcodes[] = { "MOVE", "BINARY", "PRINT", "JUMP", "WHILE", "IF", "SWITCH", "EXEC_STMT", "HALT" };
+
+	output_flush();  // after what the program printed so far
+
+	printf("**JIT: loop at line %d (bytecode %d..%d), %d bytes",
+		loop->line, loop->head, loop->end - 1, (int)loop->size);
+	if (loop->counter != -1) {
+		printf(", counter (slot %d) in r8d", loop->counter);
+	}
+	printf("\n");
+
+	int num_pieces = loop->end - loop->head + 2;
+	for (int piece = 0; piece < num_pieces; piece++) {
+		int start = (piece == 0) ? 0 : loop->offsets[piece - 1];
+		int stop = (piece == num_pieces - 1) ? (int)loop->size : loop->offsets[piece];
+
+		if (piece == 0) {
+			printf(" entry checks:\n");
+		}
+		else if (piece == num_pieces - 1) {
+			printf(" bail-out stubs:\n");
+		}
+		else {
+			struct VM_INSTR* instr = &vm->code[loop->head + piece - 1];
+			printf(" %d: %s (line %d):\n", loop->head + piece - 1, opcodes[instr->opcode], instr->line);
+		}
+
+		for (int i = start; i < stop; i++) {
+			printf("%s%02x", ((i - start) % 16 == 0) ? "   " : " ", loop->code[i]);
+			if ((i - start) % 16 == 15 || i == stop - 1) {
+				printf("\n");
+			}
+		}
+	}
+
+	printf("**END JIT**\n");
+}
@@ -0,0 +1,110 @@
+/*jit.h*/
+
+//
+// Template JIT for hot while loops (x86-64 Linux only). When the VM sees
+// a while loop run JIT_HOT_LOOP times, the loop's bytecode is translated
+// instruction-by-instruction into native code in an mmap'd buffer. The
+// code is specialized to the types the loop's variables hold at that
+// point (int, real, pointer or boolean), which are checked on entry.
+//
+// Native code never reports errors itself: whenever a guard fails (a
+// type changed, a pointer went out of range, a divisor is zero, ...)
+// it returns to the VM at the bytecode instruction that failed, and the
+// VM re-runs that instruction --- which then produces the exact same
+// output and error messages as the interpreter.
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+#include <stddef.h>   // size_t
+#include "ram.h"
+#include "vm.h"
+
+
+//
+// # of times a loop condition is evaluated before the loop is compiled
+//
+#ifndef JIT_HOT_LOOP
+#define JIT_HOT_LOOP 1000
+#endif
+
+//
+// # of times native code may bail out before it is thrown away and the
+// loop is recompiled for the types seen since, and the # of times we
+// try compiling a loop before giving up on it
+//
+#define JIT_MAX_DEOPTS   16
+#define JIT_MAX_ATTEMPTS 3
+
+struct JIT_LOOP
+{
+  int head;       // bytecode index of the loop's WHILE
+  int end;        // bytecode index just past the loop's closing JUMP
+  int line;       // source line of the loop
+  int deopts;     // # of times the native code bailed out
+  int counter;    // slot of the loop counter kept in a register, or -1
+
+  unsigned char* code;  // executable buffer (mmap'd)
+  size_t size;          // # of bytes of code
+  size_t mapped;        // # of bytes mapped
+
+  //
+  // offsets[i] is where the code for bytecode instruction head+i
+  // starts; offsets[end-head] is where the bail-out stubs start.
+  // Everything before offsets[0] is the entry type checks.
+  //
+  int* offsets;
+};
+
+
+//
+// Public functions:
+//
+
+//
+// jit_available
+//
+// Returns true if native code can be generated on this platform.
+//
+bool jit_available(void);
+
+//
+// jit_compile_loop
+//
+// Compiles the while loop whose WHILE instruction is at index head
+// in the given bytecode, specialized to the types of the variables
+// currently in memory. Returns NULL if the loop can't be compiled,
+// e.g. because it contains an instruction or a type the JIT doesn't
+// handle, or a variable in it hasn't been written yet.
+//
+struct JIT_LOOP* jit_compile_loop(struct VM_PROGRAM* vm, int head, struct RAM* memory);
+
+//
+// jit_run
+//
+// Runs the compiled loop against the given memory, and returns the
+// index of the bytecode instruction the VM should continue with:
+// either the instruction after the loop, or one the native code
+// bailed out on (which the VM then runs itself).
+//
+int jit_run(struct JIT_LOOP* loop, struct RAM* memory);
+
+//
+// jit_free
+//
+// Frees the memory (and code) associated with the compiled loop.
+//
+void jit_free(struct JIT_LOOP* loop);
+
+//
+// jit_dump
+//
+// Prints the native code for the compiled loop, as hex bytes grouped
+// by the bytecode instruction they were generated for.
+//
+void jit_dump(struct JIT_LOOP* loop, struct VM_PROGRAM* vm);
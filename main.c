@@ -23,30 +23,255 @@
 #include "token.h"    // token defs
 #include "scanner.h" 
 #include "parser.h"
+#include "tokenbuffer.h"
+#include "parsebuffer.h"
 
 #include "programgraph.h"   // handle building + exeucting program graph
 #include "ram.h"
+#include "resolve.h"
 #include "execute.h"
+#include "vm.h"
+#include "transpile.h"
+#include "optimize.h"
+#include "typeinfer.h"
+#include "cse.h"
+#include "validate.h"
+#include "escape.h"
+#include "nupyc.h"
+#include "stream.h"
+#include "output.h"
 
 
+//
+// run_program
+//
+// Executes the given program graph, resolved to the given slots, against
+// the given memory, compiled to bytecode unless treewalk is given.
+// Returns false if it was stopped by an error (already output).
+//
+static bool run_program(struct STMT* program, struct SLOT_TABLE* slots, struct RAM* memory, bool treewalk, bool use_jit, bool dump_jit)
+{
+	if (treewalk) {
+		return execute(program, memory);
+	}
+
+	struct VM_PROGRAM* vm = vm_compile(program, slots);
+	//vm_print(vm);		// print out the bytecode
+	if (vm == NULL) {
+		output_error("**ERROR: unable to compile program\n");
+		return false;
+	}
+
+	vm->use_jit = vm->use_jit && use_jit;
+	vm->dump_jit = dump_jit;
+	bool finished = vm_execute(vm, memory);
+	vm_destroy(vm);
+
+	return finished;
+}
+
+//
+// run_streaming
+//
+// Executes the program in the given input a top-level statement at a
+// time, as each is read (see stream.h). Statements share one slot
+// table and memory, and run until the end of the program, an error,
+// or a syntax error in a statement not run yet.
+//
+static void run_streaming(FILE* input, bool treewalk, bool use_jit, bool dump_jit, bool stats)
+{
+	struct STREAM* stream = stream_open(input);
+	if (stream == NULL) {
+		printf("**ERROR: unable to read the program\n");
+		return;
+	}
+
+	printf("**executing...\n");
+
+	struct SLOT_TABLE* slots = resolve_init();
+	struct RAM* memory = ram_init();
+	bool running = true;
+
+	while (running) {
+		struct TOKEN_BUFFER* tokens = NULL;
+
+		// what the statements so far printed goes out before waiting for the next
+		output_flush();
+
+		int next = stream_next(stream, &tokens);
+
+		if (next == STREAM_END) {
+			break;
+		}
+		if (next == STREAM_ERROR) {
+			printf("**parsing failed...\n");
+			break;
+		}
+
+		struct STMT* program = programgraph_build(tokens);
+		tokenbuffer_destroy(tokens);
+
+		if (!resolve_program(slots, program)) {
+			printf("**ERROR: unable to resolve program identifiers\n");
+			running = false;
+		}
+		else if (!ram_reserve_slots(memory, slots->num_slots)) {
+			printf("**ERROR: unable to allocate memory for program variables\n");
+			running = false;
+		}
+		else if (program != NULL) {
+			running = run_program(program, slots, memory, treewalk, use_jit, dump_jit);
+		}
+
+		programgraph_destroy(program);
+	}
+
+	output_flush();
+
+	printf("**done\n");
+	ram_print(memory);			// print out memory by end of program
+
+	if (stats) {
+		printf("**op cache: %ld proven, %ld hits, %ld misses (%ld polymorphic), %ld generic\n",
+			op_cache_stats.proven, op_cache_stats.hits, op_cache_stats.misses, op_cache_stats.polymorphic, op_cache_stats.generic);
+		printf("**output: %ld bytes in %ld writes\n", output_stats.bytes, output_stats.writes);
+	}
+
+	ram_destroy(memory);
+	resolve_destroy(slots);
+	stream_close(stream);
+}
+
 //
 // main
 //
-// usage: program.exe [filename.py]
+// usage: program.exe [--treewalk] [--no-jit] [--jit-dump] [--no-optimize] [--stats] [--rebuild] [--stream] [--pipeline] [--parallel-scan] [--output full|line] [--output-buffer bytes] [--emit-c file.c] [filename.py]
 // 
 // If a filename is given, the file is opened and serves as
-// input to the program. If a filename is not given, then 
-// input is taken from the keyboard until $ is input.
+// input to the program; it is memory-mapped and parsed in memory
+// (see parsebuffer.h). If a filename is not given, then 
+// input is taken from the keyboard until $ is input. With --pipeline,
+// a program file is scanned on a thread of its own while the syntax
+// of what has been scanned so far is checked (see tokenring.h). With
+// --parallel-scan, a large program file is cut into chunks that are
+// scanned at the same time, a core each (see scanparallel.h).
+//
+// A program file's built (and optimized) program graph is cached
+// next to it, e.g. in test01.nupyc, and the next run of the file
+// loads that instead of parsing and building it again, so long as
+// the file is unchanged (see nupyc.h). --rebuild ignores the cache
+// and writes it anew.
+//
+// With --stream, the program isn't parsed as a whole before it runs:
+// each top-level statement is parsed, built and executed as soon as
+// it has been read (see stream.h), so output starts while the rest of
+// the input is still coming, and a syntax error only stops the program
+// where it is. Statements are run as built, without the optimization
+// passes (which prove things about the whole program), and input()
+// reads the lines after the statement calling it.
+//
+// The program is compiled to bytecode and run by the VM; with
+// --treewalk, the program graph is executed directly instead
+// (handy for checking the two against each other). Hot while loops
+// are compiled to native code by the VM unless --no-jit is given;
+// --jit-dump prints the code generated for each loop. Constant
+// expressions are folded, no-op statements dropped, the types of
+// operands proven, repeated expressions reused, statements that can't
+// fail marked to run without checks, and the variables no pointer can
+// reach found, which the VM keeps in registers, before the program
+// runs (see optimize.h, typeinfer.h, cse.h, validate.h and escape.h),
+// unless --no-optimize is given. --stats prints how many operations
+// have proven types or were reused, statements are safe and variables
+// are out of reach of pointers, and the binary operators' inline cache
+// counters (see execute.h), after the memory.
+//
+// What the program prints is buffered, and written out when the buffer
+// (of --output-buffer bytes) fills, at an input() prompt, when the
+// program stops and, with --stream, before waiting for each statement;
+// to a terminal, or with --output line, it is written a line at a time
+// (see output.h). --stats also prints how many bytes and write() calls
+// that took.
+//
+// With --emit-c, the program is not run but translated to C and
+// written to the given file, to be built into a native executable
+// (see transpile.h, and "make native").
 //
 int main(int argc, char* argv[])
 {
 	FILE* input = NULL;
 	bool  keyboardInput = false;
+	bool  treewalk = false;
+	bool  use_jit = true;
+	bool  dump_jit = false;
+	bool  optimize = true;
+	bool  stats = false;
+	bool  rebuild = false;
+	bool  streaming = false;
+	int   parse_mode = PARSE_SERIAL;
+	int   output_policy = OUTPUT_FULL;
+	int   output_size = OUTPUT_DEFAULT_SIZE;
+	char* emit_c = NULL;
+	
+	//
+	// options come first, then the (optional) filename:
+	//
+	int argi = 1;
+	while (argi < argc && strncmp(argv[argi], "--", 2) == 0) {
+		if (strcmp(argv[argi], "--treewalk") == 0) {
+			treewalk = true;
+		}
+		else if (strcmp(argv[argi], "--no-jit") == 0) {
+			use_jit = false;
+		}
+		else if (strcmp(argv[argi], "--jit-dump") == 0) {
+			dump_jit = true;
+		}
+		else if (strcmp(argv[argi], "--no-optimize") == 0) {
+			optimize = false;
+		}
+		else if (strcmp(argv[argi], "--stats") == 0) {
+			stats = true;
+		}
+		else if (strcmp(argv[argi], "--rebuild") == 0) {
+			rebuild = true;
+		}
+		else if (strcmp(argv[argi], "--stream") == 0) {
+			streaming = true;
+		}
+		else if (strcmp(argv[argi], "--pipeline") == 0) {
+			parse_mode = PARSE_PIPELINED;
+		}
+		else if (strcmp(argv[argi], "--parallel-scan") == 0) {
+			parse_mode = PARSE_PARALLEL;
+		}
+		else if (strcmp(argv[argi], "--output") == 0 && argi + 1 < argc && strcmp(argv[argi + 1], "full") == 0) {
+			output_policy = OUTPUT_FULL;
+			argi++;
+		}
+		else if (strcmp(argv[argi], "--output") == 0 && argi + 1 < argc && strcmp(argv[argi + 1], "line") == 0) {
+			output_policy = OUTPUT_LINE;
+			argi++;
+		}
+		else if (strcmp(argv[argi], "--output-buffer") == 0 && argi + 1 < argc && atoi(argv[argi + 1]) > 0) {
+			output_size = atoi(argv[++argi]);
+		}
+		else if (strcmp(argv[argi], "--emit-c") == 0 && argi + 1 < argc) {
+			emit_c = argv[++argi];
+		}
+		else {
+			printf("**ERROR: unknown option '%s'\n", argv[argi]);
+			return 0;
+		}
+		argi++;
+	}
+
+	// a program's output is written unbuffered if the buffer can't be allocated
+	output_init(output_policy, output_size);
 	
 	//
 	// where is the input coming from?
 	//
-	if (argc < 2) {
+	if (argi >= argc) {
 		//
 		// no args, just the program name:
 		//
@@ -57,7 +282,7 @@ int main(int argc, char* argv[])
 		//
 		// assume 2nd arg is a nuPython file:
 		//
-		char* filename = argv[1];
+		char* filename = argv[argi];
 		
 		input = fopen(filename, "r");
 		
@@ -75,12 +300,32 @@ int main(int argc, char* argv[])
 		printf("nuPython input (enter $ when you're done)>\n");
 	}
 	
+	if (streaming && emit_c == NULL) {
+		run_streaming(input, treewalk, use_jit, dump_jit, stats);
+
+		if (!keyboardInput) {
+			fclose(input);
+		}
+		return 0;
+	}
+
 	//
-	// call parser to check program syntax:
+	// a program file built before is loaded from its cache (see nupyc.h):
 	//
-	struct TokenQueue* tokens = parser_parse(input);
+	struct NUPYC_KEY key;
+	bool cacheable = !keyboardInput && nupyc_key(input, optimize, &key);
+	struct NUPYC_IMAGE* image = (cacheable && !rebuild) ? nupyc_load(argv[argi], &key) : NULL;
+
+	//
+	// otherwise call parser to check program syntax:
+	//
+	// (a program file is memory-mapped and parsed in memory, see parsebuffer.h)
+	struct TOKEN_BUFFER* tokens = NULL;
+	if (image == NULL) {
+		tokens = keyboardInput ? parser_parse_stream(input) : parser_parse_file(input, parse_mode);
+	}
 	
-	if (tokens == NULL)
+	if (image == NULL && tokens == NULL)
 	{
 		// 
 		// program has a syntax error, error msg already output:
@@ -96,21 +341,130 @@ int main(int argc, char* argv[])
 		printf("**parsing successful, valid syntax\n");
 		printf("**building program graph...\n");
 
-		// get graph structure via program_build
-		struct STMT* program = programgraph_build(tokens);
-		//programgraph_print(program);		// print out the initial program
-		printf("**executing...\n");
+		struct STMT* program = NULL;
+		struct STMT* graph = NULL;
+		struct SLOT_TABLE* slots = NULL;
+		struct TYPE_STATS type_stats = { 0, 0 };
+		struct VALIDATE_STATS validate_stats = { 0, 0 };
+		struct ESCAPE_STATS escape_stats = { 0, 0 };
+		int num_reused = 0;
 
-		// for storing variables in program
-		struct RAM* memory = ram_init();
+		if (image != NULL) {
+			// already built, resolved and optimized
+			program = image->program;
+			slots = image->slots;
+			type_stats = image->type_stats;
+			num_reused = image->num_reused;
+			validate_stats = image->validate_stats;
+			escape_stats = image->escape_stats;
+		}
+		else {
+			// get graph structure via program_build; it copies what it needs
+			program = programgraph_build(tokens);
+			cacheable = cacheable && tokens->quiet;  // a hit couldn't repeat the parser's warnings
+			tokenbuffer_destroy(tokens);
+			graph = program;		// optimize may drop the first statement
+			//programgraph_print(program);		// print out the initial program
 
-		// exeucte the program
-		execute(program, memory);
-		
-		printf("**done\n");
-		ram_print(memory);			// print out memory by end of program
+			// bind every identifier to a slot so execution never looks up names
+			slots = resolve_init();
+		}
+
+		// a pass that fails leaves the graph half done: nothing is run or translated
+		bool built = true;
+
+		if (image != NULL) {
+			// resolved and optimized before it was cached
+		}
+		else if (!resolve_program(slots, program)) {
+			printf("**ERROR: unable to resolve program identifiers\n");
+			built = false;
+		}
+		else if (optimize && !optimize_program(slots, &program)) {
+			printf("**ERROR: unable to optimize program\n");
+			built = false;
+		}
+		else if (optimize && !typeinfer_program(slots, program, &type_stats)) {
+			printf("**ERROR: unable to infer program types\n");
+			built = false;
+		}
+		else if (optimize && !cse_program(slots, program, &num_reused)) {
+			printf("**ERROR: unable to eliminate common subexpressions\n");
+			built = false;
+		}
+		else if (optimize && !validate_program(slots, program, &validate_stats)) {
+			printf("**ERROR: unable to validate program\n");
+			built = false;
+		}
+		else if (optimize && !escape_program(slots, program, &escape_stats)) {
+			printf("**ERROR: unable to analyze program pointers\n");
+			built = false;
+		}
+		else if (cacheable) {
+			// best effort: a cache that can't be written is just rebuilt next time
+			nupyc_save(argv[argi], &key, program, slots, &type_stats, num_reused, &validate_stats, &escape_stats);
+		}
+
+		// translating to C instead of running?
+		if (!built) {
+			// error already output
+		}
+		else if (emit_c != NULL) {
+			printf("**translating to C...\n");
+
+			FILE* output = fopen(emit_c, "w");
+			if (output == NULL) {
+				printf("**ERROR: unable to open output file '%s'\n", emit_c);
+			}
+			else {
+				bool translated = transpile_program(program, slots, output, (argi < argc) ? argv[argi] : "<stdin>");
+				if (fclose(output) != 0 || !translated) {
+					printf("**ERROR: unable to translate program to C\n");
+					remove(emit_c);
+				}
+				else {
+					printf("**wrote '%s'\n", emit_c);
+				}
+			}
+		}
+		else {
+			printf("**executing...\n");
+
+			// for storing variables in program, sized to fit every slot
+			struct RAM* memory = ram_init();
+
+			if (!ram_reserve_slots(memory, slots->num_slots)) {
+				printf("**ERROR: unable to allocate memory for program variables\n");
+			}
+			else {
+				// exeucte the program, compiled to bytecode unless asked not to
+				run_program(program, slots, memory, treewalk, use_jit, dump_jit);
+				output_flush();  // finished or stopped by an error, which is output after
+
+				printf("**done\n");
+				ram_print(memory);			// print out memory by end of program
+
+				if (stats) {
+					printf("**types: %d of %d operations proven monomorphic\n", type_stats.proven, type_stats.operations);
+					printf("**cse: %d operations reused\n", num_reused);
+					printf("**validation: %d of %d statements proven safe\n", validate_stats.safe, validate_stats.statements);
+					printf("**escape: %d of %d variables no pointer can reach\n", escape_stats.locals, escape_stats.variables);
+					printf("**op cache: %ld proven, %ld hits, %ld misses (%ld polymorphic), %ld generic\n",
+						op_cache_stats.proven, op_cache_stats.hits, op_cache_stats.misses, op_cache_stats.polymorphic, op_cache_stats.generic);
+					printf("**output: %ld bytes in %ld writes\n", output_stats.bytes, output_stats.writes);
+				}
+			}
+
+			ram_destroy(memory);
+		}
 		
-		tokenqueue_destroy(tokens);
+		if (image != NULL) {
+			nupyc_unload(image);
+		}
+		else {
+			programgraph_destroy(graph);
+			resolve_destroy(slots);
+		}
 	}
 	
 	//
@@ -0,0 +1,781 @@
+/*nupyc.c*/
+
+//
+// << Precompiled program cache: the program graph, slot table and
+//    constant pool saved as one relocatable image, and loaded with
+//    a single mmap. >>
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#define _POSIX_C_SOURCE 200809L  // fileno, mmap, open
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <stdint.h>
+#include <stddef.h>   // offsetof, max_align_t
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "programgraph.h"
+#include "ram.h"
+#include "resolve.h"
+#include "typeinfer.h"
+#include "validate.h"
+#include "nupyc.h"
+
+
+#define NUPYC_MAGIC  "NUPYC\r\n"  // 8 bytes with the '\0'; \r\n catches text-mode copies
+#define NUPYC_ALIGN  _Alignof(max_align_t)
+
+//
+// kinds of objects in an image:
+//
+enum NODE_KINDS
+{
+  NODE_STMT = 0,
+  NODE_ASSIGNMENT,
+  NODE_CALL_STMT,
+  NODE_IF,
+  NODE_WHILE,
+  NODE_PASS,
+  NODE_VALUE,
+  NODE_CALL,
+  NODE_EXPR,
+  NODE_UNARY,
+  NODE_ELEMENT,
+  NODE_STRING,
+  NODE_RAM_STR,
+  NODE_CONSTANT  // a RAM_VALUE in a constant block, which are written first
+};
+
+//
+// a pointer field waiting for the object it points to to be written:
+//
+struct PENDING
+{
+  size_t field;  // offset of the field in the image
+  const void* target;
+  int kind;
+};
+
+//
+// an object written to the image, by its address in memory:
+//
+struct PLACED
+{
+  const void* from;  // NULL => empty bucket
+  size_t offset;
+};
+
+//
+// builds an image in memory; offsets are used throughout, since the
+// image moves as it grows:
+//
+struct WRITER
+{
+  char* image;
+  size_t size;
+  size_t capacity;
+
+  size_t* relocs;  // offsets of the pointer fields
+  size_t num_relocs;
+  size_t reloc_capacity;
+
+  struct PLACED* placed;  // open addressing, capacity a power of 2
+  size_t num_placed;
+  size_t placed_capacity;
+
+  struct PENDING* pending;  // a stack, so long statement lists don't recurse
+  size_t num_pending;
+  size_t pending_capacity;
+
+  bool failed;  // out of memory
+};
+
+
+//
+// Private functions:
+//
+
+//
+// hash_bytes
+//
+// Content hash of a source file or an image, a 64-bit word at a time.
+//
+static uint64_t hash_bytes(const unsigned char* bytes, size_t length)
+{
+	uint64_t hash = 14695981039346656037ull ^ length;
+	size_t i = 0;
+
+	for (; i + 8 <= length; i += 8) {
+		uint64_t word;
+		memcpy(&word, bytes + i, sizeof(word));
+
+		hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+		hash ^= hash >> 29;
+	}
+
+	for (; i < length; i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+
+	return hash;
+}
+
+//
+// layout
+//
+// Signature of the sizes of everything in an image, so a cache written
+// by a build whose structs differ isn't used.
+//
+static unsigned int layout(void)
+{
+	const size_t sizes[] = {
+		sizeof(void*), sizeof(struct STMT), sizeof(struct STMT_ASSIGNMENT), sizeof(struct STMT_FUNCTION_CALL),
+		sizeof(struct STMT_IF_THEN_ELSE), sizeof(struct STMT_WHILE_LOOP), sizeof(struct STMT_PASS),
+		sizeof(struct VALUE), sizeof(struct FUNCTION_CALL), sizeof(struct EXPR), sizeof(struct UNARY_EXPR),
+		sizeof(struct ELEMENT), sizeof(struct SLOT_TABLE), sizeof(struct CONSTANT_BLOCK), sizeof(struct RAM_VALUE),
+		sizeof(struct RAM_STR), sizeof(struct NUPYC_IMAGE)
+	};
+
+	unsigned int signature = 2166136261u;
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		signature = (signature ^ (unsigned int)sizes[i]) * 16777619u;
+	}
+
+	return signature;
+}
+
+//
+// cache_path
+//
+// Returns the (malloc'd) path of the cache of the given source file,
+// plus the given suffix: x.py => x.nupyc. NULL if out of memory.
+//
+static char* cache_path(const char* source, const char* suffix)
+{
+	size_t len = strlen(source);
+
+	if (len >= 3 && strcmp(source + len - 3, ".py") == 0) {
+		len -= 3;
+	}
+
+	size_t size = len + strlen(".nupyc") + strlen(suffix) + 1;
+
+	char* path = (char*)malloc(size);
+	if (path != NULL) {
+		snprintf(path, size, "%.*s.nupyc%s", (int)len, source, suffix);
+	}
+
+	return path;
+}
+
+//
+// grow
+//
+// Makes room in the given array for one more element than count.
+//
+static bool grow(void** array, size_t* capacity, size_t count, size_t size)
+{
+	if (count < *capacity) {
+		return true;
+	}
+
+	size_t new_capacity = (*capacity == 0) ? 64 : 2 * *capacity;
+
+	void* grown = realloc(*array, new_capacity * size);
+	if (grown == NULL) {
+		return false;
+	}
+
+	*array = grown;
+	*capacity = new_capacity;
+	return true;
+}
+
+//
+// find_placed
+//
+// Returns the bucket of the given object, or the empty bucket where it
+// goes.
+//
+static struct PLACED* find_placed(struct WRITER* w, const void* from)
+{
+	size_t mask = w->placed_capacity - 1;
+	size_t bucket = (size_t)(((uintptr_t)from >> 3) * 0x9E3779B97F4A7C15ull) & mask;
+
+	while (w->placed[bucket].from != NULL && w->placed[bucket].from != from) {
+		bucket = (bucket + 1) & mask;
+	}
+
+	return &w->placed[bucket];
+}
+
+//
+// remember
+//
+// Records that the given object was written at offset.
+//
+static void remember(struct WRITER* w, const void* from, size_t offset)
+{
+	if (2 * (w->num_placed + 1) > w->placed_capacity) {
+		struct PLACED* old = w->placed;
+		size_t old_capacity = w->placed_capacity;
+
+		w->placed_capacity = (old_capacity == 0) ? 1024 : 2 * old_capacity;
+		w->placed = (struct PLACED*)calloc(w->placed_capacity, sizeof(struct PLACED));
+
+		if (w->placed == NULL) {
+			w->placed = old;
+			w->placed_capacity = old_capacity;
+			w->failed = true;
+			return;
+		}
+
+		for (size_t i = 0; i < old_capacity; i++) {
+			if (old[i].from != NULL) {
+				*find_placed(w, old[i].from) = old[i];
+			}
+		}
+
+		free(old);
+	}
+
+	struct PLACED* placed = find_placed(w, from);
+
+	if (placed->from == NULL) {
+		placed->from = from;
+		placed->offset = offset;
+		w->num_placed++;
+	}
+}
+
+//
+// reserve
+//
+// Returns the offset of size zeroed bytes at the end of the image.
+//
+static size_t reserve(struct WRITER* w, size_t size)
+{
+	size_t at = (w->size + NUPYC_ALIGN - 1) & ~(size_t)(NUPYC_ALIGN - 1);
+
+	if (w->failed) {
+		return 0;
+	}
+
+	if (at + size > w->capacity) {
+		size_t capacity = (w->capacity == 0) ? 4096 : w->capacity;
+
+		while (capacity < at + size) {
+			capacity *= 2;
+		}
+
+		char* image = (char*)realloc(w->image, capacity);
+		if (image == NULL) {
+			w->failed = true;
+			return 0;
+		}
+
+		w->image = image;
+		w->capacity = capacity;
+	}
+
+	memset(w->image + w->size, 0, at + size - w->size);
+	w->size = at + size;
+
+	return at;
+}
+
+//
+// copy
+//
+// Writes a copy of the given object, returning its offset. Its pointer
+// fields must then be linked (or left NULL).
+//
+static size_t copy(struct WRITER* w, const void* from, size_t size)
+{
+	size_t at = reserve(w, size);
+
+	if (!w->failed) {
+		memcpy(w->image + at, from, size);
+		remember(w, from, at);
+	}
+
+	return at;
+}
+
+//
+// set_pointer
+//
+// Points the field at the given offset to the object at target, and
+// lists the field for relocation.
+//
+static void set_pointer(struct WRITER* w, size_t field, size_t target)
+{
+	if (w->failed || !grow((void**)&w->relocs, &w->reloc_capacity, w->num_relocs, sizeof(size_t))) {
+		w->failed = true;
+		return;
+	}
+
+	uintptr_t value = target;
+	memcpy(w->image + field, &value, sizeof(value));
+
+	w->relocs[w->num_relocs++] = field;
+}
+
+//
+// link_field
+//
+// Points the field at the given offset to the image's copy of target,
+// which is written later if it hasn't been yet.
+//
+static void link_field(struct WRITER* w, size_t field, const void* target, int kind)
+{
+	if (target == NULL || w->failed) {
+		return;  // the copied field is already NULL
+	}
+
+	struct PLACED* placed = find_placed(w, target);
+
+	if (placed->from != NULL) {
+		set_pointer(w, field, placed->offset);
+	}
+	else if (kind == NODE_CONSTANT) {
+		w->failed = true;  // not in the slot table's pool?!
+	}
+	else if (!grow((void**)&w->pending, &w->pending_capacity, w->num_pending, sizeof(struct PENDING))) {
+		w->failed = true;
+	}
+	else {
+		w->pending[w->num_pending++] = (struct PENDING) { .field = field, .target = target, .kind = kind };
+	}
+}
+
+//
+// write_node
+//
+// Writes the given object of the given kind, returning its offset.
+//
+static size_t write_node(struct WRITER* w, const void* target, int kind)
+{
+	static const int stmt_kinds[] = { NODE_ASSIGNMENT, NODE_CALL_STMT, NODE_IF, NODE_WHILE, NODE_PASS };
+	size_t at = 0;
+
+	switch (kind) {
+		case NODE_STMT: {
+			const struct STMT* stmt = target;
+			at = copy(w, stmt, sizeof(struct STMT));
+			link_field(w, at + offsetof(struct STMT, types), stmt->types.pass, stmt_kinds[stmt->stmt_type]);
+			break;
+		}
+
+		case NODE_ASSIGNMENT: {
+			const struct STMT_ASSIGNMENT* assignment = target;
+			at = copy(w, assignment, sizeof(struct STMT_ASSIGNMENT));
+			link_field(w, at + offsetof(struct STMT_ASSIGNMENT, var_name), assignment->var_name, NODE_STRING);
+			link_field(w, at + offsetof(struct STMT_ASSIGNMENT, rhs), assignment->rhs, NODE_VALUE);
+			link_field(w, at + offsetof(struct STMT_ASSIGNMENT, next_stmt), assignment->next_stmt, NODE_STMT);
+			break;
+		}
+
+		case NODE_CALL_STMT: {
+			const struct STMT_FUNCTION_CALL* call = target;
+			at = copy(w, call, sizeof(struct STMT_FUNCTION_CALL));
+			link_field(w, at + offsetof(struct STMT_FUNCTION_CALL, function_name), call->function_name, NODE_STRING);
+			link_field(w, at + offsetof(struct STMT_FUNCTION_CALL, parameter), call->parameter, NODE_ELEMENT);
+			link_field(w, at + offsetof(struct STMT_FUNCTION_CALL, next_stmt), call->next_stmt, NODE_STMT);
+			break;
+		}
+
+		case NODE_IF: {
+			const struct STMT_IF_THEN_ELSE* ifthen = target;
+			at = copy(w, ifthen, sizeof(struct STMT_IF_THEN_ELSE));
+			link_field(w, at + offsetof(struct STMT_IF_THEN_ELSE, condition), ifthen->condition, NODE_EXPR);
+			link_field(w, at + offsetof(struct STMT_IF_THEN_ELSE, true_path), ifthen->true_path, NODE_STMT);
+			link_field(w, at + offsetof(struct STMT_IF_THEN_ELSE, false_path), ifthen->false_path, NODE_STMT);
+			link_field(w, at + offsetof(struct STMT_IF_THEN_ELSE, next_stmt), ifthen->next_stmt, NODE_STMT);
+			break;
+		}
+
+		case NODE_WHILE: {
+			const struct STMT_WHILE_LOOP* loop = target;
+			at = copy(w, loop, sizeof(struct STMT_WHILE_LOOP));
+			link_field(w, at + offsetof(struct STMT_WHILE_LOOP, condition), loop->condition, NODE_EXPR);
+			link_field(w, at + offsetof(struct STMT_WHILE_LOOP, loop_body), loop->loop_body, NODE_STMT);
+			link_field(w, at + offsetof(struct STMT_WHILE_LOOP, next_stmt), loop->next_stmt, NODE_STMT);
+			break;
+		}
+
+		case NODE_PASS: {
+			const struct STMT_PASS* pass = target;
+			at = copy(w, pass, sizeof(struct STMT_PASS));
+			link_field(w, at + offsetof(struct STMT_PASS, next_stmt), pass->next_stmt, NODE_STMT);
+			break;
+		}
+
+		case NODE_VALUE: {
+			const struct VALUE* value = target;
+			at = copy(w, value, sizeof(struct VALUE));
+			link_field(w, at + offsetof(struct VALUE, types), value->types.expr,
+				(value->value_type == VALUE_FUNCTION_CALL) ? NODE_CALL : NODE_EXPR);
+			break;
+		}
+
+		case NODE_CALL: {
+			const struct FUNCTION_CALL* call = target;
+			at = copy(w, call, sizeof(struct FUNCTION_CALL));
+			link_field(w, at + offsetof(struct FUNCTION_CALL, function_name), call->function_name, NODE_STRING);
+			link_field(w, at + offsetof(struct FUNCTION_CALL, parameter), call->parameter, NODE_ELEMENT);
+			break;
+		}
+
+		case NODE_EXPR: {
+			const struct EXPR* expr = target;
+			at = copy(w, expr, sizeof(struct EXPR));
+			link_field(w, at + offsetof(struct EXPR, lhs), expr->lhs, NODE_UNARY);
+			link_field(w, at + offsetof(struct EXPR, rhs), expr->rhs, NODE_UNARY);
+			break;
+		}
+
+		case NODE_UNARY: {
+			const struct UNARY_EXPR* unary = target;
+			at = copy(w, unary, sizeof(struct UNARY_EXPR));
+			link_field(w, at + offsetof(struct UNARY_EXPR, element), unary->element, NODE_ELEMENT);
+			break;
+		}
+
+		case NODE_ELEMENT: {
+			const struct ELEMENT* element = target;
+			at = copy(w, element, sizeof(struct ELEMENT));
+			link_field(w, at + offsetof(struct ELEMENT, element_value), element->element_value, NODE_STRING);
+			link_field(w, at + offsetof(struct ELEMENT, constant), element->constant, NODE_CONSTANT);
+			break;
+		}
+
+		case NODE_STRING:
+			at = copy(w, target, strlen((const char*)target) + 1);
+			break;
+
+		case NODE_RAM_STR:
+			at = copy(w, target, sizeof(struct RAM_STR) + ((const struct RAM_STR*)target)->length + 1);
+			break;
+
+		default:
+			w->failed = true;
+			break;
+	}
+
+	return at;
+}
+
+//
+// write_slots
+//
+// Writes the slot table, with its names, index, escapes and constant
+// pool, returning its offset. The copy is never added to, so the names
+// array holds exactly the slots in use.
+//
+static size_t write_slots(struct WRITER* w, const struct SLOT_TABLE* slots)
+{
+	size_t at = copy(w, slots, sizeof(struct SLOT_TABLE));
+
+	size_t names = reserve(w, slots->num_slots * sizeof(char*));
+	set_pointer(w, at + offsetof(struct SLOT_TABLE, names), names);
+	for (int i = 0; i < slots->num_slots; i++) {
+		link_field(w, names + i * sizeof(char*), slots->names[i], NODE_STRING);
+	}
+
+	if (slots->index != NULL) {
+		size_t index = reserve(w, slots->index_capacity * sizeof(int));
+		if (!w->failed) {
+			memcpy(w->image + index, slots->index, slots->index_capacity * sizeof(int));
+		}
+		set_pointer(w, at + offsetof(struct SLOT_TABLE, index), index);
+	}
+
+	if (slots->escaped != NULL) {
+		size_t escaped = reserve(w, slots->num_slots * sizeof(bool));
+		if (!w->failed) {
+			memcpy(w->image + escaped, slots->escaped, slots->num_slots * sizeof(bool));
+		}
+		set_pointer(w, at + offsetof(struct SLOT_TABLE, escaped), escaped);
+	}
+
+	//
+	// the blocks, and every constant in them, so elements can point in:
+	//
+	size_t field = at + offsetof(struct SLOT_TABLE, constants);
+
+	for (const struct CONSTANT_BLOCK* block = slots->constants; block != NULL; block = block->next) {
+		size_t block_at = copy(w, block, sizeof(struct CONSTANT_BLOCK));
+		set_pointer(w, field, block_at);
+
+		for (int i = 0; i < block->num_values; i++) {
+			size_t value_at = block_at + offsetof(struct CONSTANT_BLOCK, values) + i * sizeof(struct RAM_VALUE);
+
+			remember(w, &block->values[i], value_at);
+
+			if (block->values[i].value_type == RAM_TYPE_STR) {
+				link_field(w, value_at + offsetof(struct RAM_VALUE, types), block->values[i].types.s, NODE_RAM_STR);
+			}
+		}
+
+		field = block_at + offsetof(struct CONSTANT_BLOCK, next);
+	}
+
+	if (!w->failed) {
+		((struct SLOT_TABLE*)(w->image + at))->capacity = slots->num_slots;
+	}
+
+	return at;
+}
+
+//
+// build_fingerprint
+//
+// Fingerprint of the running interpreter's executable: its identity,
+// size and modification time, so every rebuild (of any pass) has a new
+// one. Returns false if the executable can't be found.
+//
+static bool build_fingerprint(uint64_t* fingerprint)
+{
+	struct stat info;
+
+	if (stat("/proc/self/exe", &info) != 0) {
+		return false;
+	}
+
+	const uint64_t identity[] = {
+		(uint64_t)info.st_dev, (uint64_t)info.st_ino, (uint64_t)info.st_size,
+		(uint64_t)info.st_mtim.tv_sec, (uint64_t)info.st_mtim.tv_nsec
+	};
+
+	*fingerprint = hash_bytes((const unsigned char*)identity, sizeof(identity));
+	return true;
+}
+
+//
+// valid_image
+//
+// Returns true if the mapped file is a cache for the given key, intact,
+// and its relocation table stays inside it.
+//
+static bool valid_image(const struct NUPYC_IMAGE* image, size_t size, const struct NUPYC_KEY* key)
+{
+	return memcmp(image->magic, NUPYC_MAGIC, sizeof(image->magic)) == 0 &&
+		image->version == NUPYC_VERSION &&
+		image->layout == layout() &&
+		image->key.hash == key->hash &&
+		image->key.length == key->length &&
+		image->key.optimized == key->optimized &&
+		image->key.build == key->build &&
+		image->size == size &&
+		image->checksum == hash_bytes((const unsigned char*)image + sizeof(struct NUPYC_IMAGE), size - sizeof(struct NUPYC_IMAGE)) &&
+		image->relocs % sizeof(uint64_t) == 0 &&
+		image->relocs <= size &&
+		image->num_relocs <= (size - image->relocs) / sizeof(uint64_t);
+}
+
+//
+// relocate
+//
+// Adds the address the image was mapped at to each of its pointers.
+// Returns false if one of them points outside the image.
+//
+static bool relocate(char* base, size_t size)
+{
+	const struct NUPYC_IMAGE* image = (const struct NUPYC_IMAGE*)base;
+	const uint64_t* relocs = (const uint64_t*)(base + image->relocs);
+	uint64_t num_relocs = image->num_relocs;
+
+	for (uint64_t i = 0; i < num_relocs; i++) {
+		uint64_t field = relocs[i];
+
+		if (field % sizeof(uintptr_t) != 0 || field > size - sizeof(uintptr_t)) {
+			return false;
+		}
+
+		uintptr_t* pointer = (uintptr_t*)(base + field);
+
+		if (*pointer == 0 || *pointer >= size) {
+			return false;
+		}
+
+		*pointer += (uintptr_t)base;
+	}
+
+	return true;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// nupyc_key
+//
+bool nupyc_key(FILE* input, bool optimized, struct NUPYC_KEY* key)
+{
+	struct stat info;
+
+	if (fstat(fileno(input), &info) != 0 || !S_ISREG(info.st_mode)) {
+		return false;
+	}
+
+	key->length = (uint64_t)info.st_size;
+	key->optimized = optimized;
+
+	if (!build_fingerprint(&key->build)) {
+		return false;
+	}
+
+	if (info.st_size == 0) {
+		key->hash = hash_bytes(NULL, 0);
+		return true;
+	}
+
+	void* text = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fileno(input), 0);
+	if (text == MAP_FAILED) {
+		return false;
+	}
+
+	key->hash = hash_bytes((const unsigned char*)text, (size_t)info.st_size);
+
+	munmap(text, (size_t)info.st_size);
+	return true;
+}
+
+//
+// nupyc_load
+//
+// The file is mapped copy-on-write: relocating it, and running the
+// program (which updates inline caches and string refcounts in it),
+// never writes the file.
+//
+struct NUPYC_IMAGE* nupyc_load(const char* source, const struct NUPYC_KEY* key)
+{
+	char* path = cache_path(source, "");
+	if (path == NULL) {
+		return NULL;
+	}
+
+	int fd = open(path, O_RDONLY);
+	free(path);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(struct NUPYC_IMAGE)) {
+		close(fd);
+		return NULL;
+	}
+
+	size_t size = (size_t)info.st_size;
+
+	char* base = (char*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		return NULL;
+	}
+
+	if (!valid_image((const struct NUPYC_IMAGE*)base, size, key) || !relocate(base, size)) {
+		munmap(base, size);
+		return NULL;
+	}
+
+	return (struct NUPYC_IMAGE*)base;
+}
+
+//
+// nupyc_unload
+//
+void nupyc_unload(struct NUPYC_IMAGE* image)
+{
+	if (image != NULL) {
+		munmap(image, (size_t)image->size);
+	}
+}
+
+//
+// nupyc_save
+//
+// Writes to a temporary file that is renamed over the cache, so a run
+// that loads it never sees half of one.
+//
+bool nupyc_save(const char* source, const struct NUPYC_KEY* key, struct STMT* program, struct SLOT_TABLE* slots,
+	const struct TYPE_STATS* type_stats, int num_reused, const struct VALIDATE_STATS* validate_stats,
+	const struct ESCAPE_STATS* escape_stats)
+{
+	struct WRITER w = { 0 };
+
+	reserve(&w, sizeof(struct NUPYC_IMAGE));  // the header, at offset 0
+
+	set_pointer(&w, offsetof(struct NUPYC_IMAGE, slots), write_slots(&w, slots));
+	link_field(&w, offsetof(struct NUPYC_IMAGE, program), program, NODE_STMT);
+
+	while (w.num_pending > 0 && !w.failed) {
+		struct PENDING pending = w.pending[--w.num_pending];
+		struct PLACED* placed = find_placed(&w, pending.target);
+
+		size_t at = (placed->from != NULL) ? placed->offset : write_node(&w, pending.target, pending.kind);
+		set_pointer(&w, pending.field, at);
+	}
+
+	size_t relocs = reserve(&w, w.num_relocs * sizeof(uint64_t));
+	bool saved = false;
+
+	if (!w.failed) {
+		for (size_t i = 0; i < w.num_relocs; i++) {
+			uint64_t field = w.relocs[i];
+			memcpy(w.image + relocs + i * sizeof(uint64_t), &field, sizeof(field));
+		}
+
+		struct NUPYC_IMAGE* header = (struct NUPYC_IMAGE*)w.image;
+
+		memcpy(header->magic, NUPYC_MAGIC, sizeof(header->magic));
+		header->version = NUPYC_VERSION;
+		header->layout = layout();
+		header->key = *key;
+		header->size = w.size;
+		header->type_stats = *type_stats;
+		header->num_reused = num_reused;
+		header->validate_stats = *validate_stats;
+		header->escape_stats = *escape_stats;
+		header->relocs = relocs;
+		header->num_relocs = w.num_relocs;
+		header->checksum = hash_bytes((const unsigned char*)w.image + sizeof(struct NUPYC_IMAGE), w.size - sizeof(struct NUPYC_IMAGE));
+
+		char* path = cache_path(source, "");
+		char* temp = cache_path(source, ".tmp");
+		FILE* output = (path == NULL || temp == NULL) ? NULL : fopen(temp, "wb");
+
+		if (output != NULL) {
+			bool written = fwrite(w.image, 1, w.size, output) == w.size;
+
+			saved = (fclose(output) == 0) && written && rename(temp, path) == 0;
+			if (!saved) {
+				remove(temp);
+			}
+		}
+
+		free(path);
+		free(temp);
+	}
+
+	free(w.image);
+	free(w.relocs);
+	free(w.placed);
+	free(w.pending);
+
+	return saved;
+}
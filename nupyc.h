@@ -0,0 +1,128 @@
+/*nupyc.h*/
+
+//
+// Precompiled program cache for nuPython. Once a program file has been
+// parsed, built into a program graph, resolved and optimized, the graph
+// is saved next to it --- test01.py is cached in test01.nupyc --- along
+// with its slot table (with what escape analysis found, see escape.h)
+// and constant pool. The next run of an unchanged file loads the cache
+// instead of scanning and parsing it again.
+//
+// A cache file is an image of the graph: the nodes, strings, slot table
+// and constants, laid out one after the other, with every pointer
+// stored as an offset into the file and listed in a relocation table.
+// Loading it is a single mmap of the file plus adding the address it
+// was mapped at to each pointer; nothing is allocated or copied.
+//
+// A cache is used only if its format version and struct layout match
+// this build's, it was written by this very build of the interpreter
+// (so a change to a pass, which may build a different graph from the
+// same source without changing any struct, never runs an old graph),
+// and it was built from a file with the same length and content hash,
+// with the same optimization setting. Anything else rebuilds it. A cache that can't be written (e.g. a read-only
+// directory) is simply not written.
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>  // true, false
+#include <stdint.h>   // uint64_t
+#include <stddef.h>   // size_t
+
+#include "programgraph.h"
+#include "resolve.h"
+#include "typeinfer.h"
+#include "validate.h"
+#include "escape.h"
+
+
+//
+// bump when the format changes:
+//
+#define NUPYC_VERSION 3
+
+//
+// what a cache must have been built from to be used:
+//
+struct NUPYC_KEY
+{
+  uint64_t hash;    // content hash of the source file
+  uint64_t length;  // # of bytes in the source file
+  bool optimized;   // built with the optimization passes?
+  uint64_t build;   // fingerprint of the interpreter that built it
+};
+
+//
+// a loaded cache: the header of the mapped file, with its pointers
+// fixed up (the rest of the header is private to nupyc.c):
+//
+struct NUPYC_IMAGE
+{
+  char magic[8];
+  int version;
+  unsigned int layout;  // sizes of the graph's structs, see nupyc.c
+  struct NUPYC_KEY key;
+  uint64_t size;        // # of bytes in the file
+  uint64_t checksum;    // hash of everything after the header
+
+  struct STMT* program;     // first statement, or NULL
+  struct SLOT_TABLE* slots;
+
+  //
+  // what the optimization passes found, for --stats:
+  //
+  struct TYPE_STATS type_stats;
+  int num_reused;
+  struct VALIDATE_STATS validate_stats;
+  struct ESCAPE_STATS escape_stats;
+
+  uint64_t relocs;      // offset of the relocation table
+  uint64_t num_relocs;
+};
+
+
+//
+// Public functions:
+//
+
+//
+// nupyc_key
+//
+// Computes the key of the given source file, opened but not read yet,
+// as built with or without the optimization passes by this build of
+// the interpreter. Returns false if it can't be read as a whole (e.g. a
+// pipe), or the build can't be told apart from others, in which case
+// it isn't cached.
+//
+bool nupyc_key(FILE* input, bool optimized, struct NUPYC_KEY* key);
+
+//
+// nupyc_load
+//
+// Loads the cache of the given source file if there is one that was
+// built from the given key. Returns NULL otherwise. The program and
+// the slot table it holds stay valid until nupyc_unload; they must
+// not be destroyed with programgraph_destroy / resolve_destroy.
+//
+struct NUPYC_IMAGE* nupyc_load(const char* source, const struct NUPYC_KEY* key);
+
+//
+// nupyc_unload
+//
+void nupyc_unload(struct NUPYC_IMAGE* image);
+
+//
+// nupyc_save
+//
+// Writes the cache of the given source file, built from the given key:
+// the program graph and slot table (which are left alone), and the
+// given pass stats. Returns false if it could not be written.
+//
+bool nupyc_save(const char* source, const struct NUPYC_KEY* key, struct STMT* program, struct SLOT_TABLE* slots,
+  const struct TYPE_STATS* type_stats, int num_reused, const struct VALIDATE_STATS* validate_stats,
+  const struct ESCAPE_STATS* escape_stats);
@@ -0,0 +1,531 @@
+/*optimize.c*/
+
+//
+// << Optimization pass: folds constant expressions, unlinks pass
+//    statements and removes self-assignments, so that work the
+//    program does the same way every time is done once, up front.
+//    While loops are also annotated with their induction variable. >>
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#define _POSIX_C_SOURCE 200809L  // strdup
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <limits.h>   // INT_MIN
+
+#include "programgraph.h"
+#include "ram.h"
+#include "resolve.h"
+#include "execute.h"
+#include "optimize.h"
+
+
+//
+// Private functions:
+//
+
+//
+// literal_operand
+//
+// Returns the decoded value of the given operand if it is a literal
+// (the executor ignores unary + and -), otherwise NULL.
+//
+static const struct RAM_VALUE* literal_operand(struct UNARY_EXPR* expr)
+{
+	if (expr->expr_type == UNARY_PTR_DEREF || expr->expr_type == UNARY_ADDRESS_OF) {
+		return NULL;
+	}
+
+	return expr->element->constant;
+}
+
+
+//
+// is_foldable
+//
+// Returns true if determine_op_result() computes lhs operator rhs
+// without error. Anything else is left for run-time, which reports
+// the error (or crashes, for integer % 0) exactly as before.
+//
+static bool is_foldable(int operator, const struct RAM_VALUE* lhs, const struct RAM_VALUE* rhs)
+{
+	bool relational = (operator >= OPERATOR_EQUAL && operator <= OPERATOR_GTE);
+
+	if (lhs->value_type == RAM_TYPE_STR && rhs->value_type == RAM_TYPE_STR) {
+		return operator == OPERATOR_PLUS || relational;
+	}
+
+	bool lhs_num = (lhs->value_type == RAM_TYPE_INT || lhs->value_type == RAM_TYPE_REAL);
+	bool rhs_num = (rhs->value_type == RAM_TYPE_INT || rhs->value_type == RAM_TYPE_REAL);
+	if (!lhs_num || !rhs_num) {
+		return false;
+	}
+
+	if (relational) {
+		return true;
+	}
+
+	bool ints = (lhs->value_type == RAM_TYPE_INT && rhs->value_type == RAM_TYPE_INT);
+
+	switch (operator) {
+		case OPERATOR_PLUS:
+		case OPERATOR_MINUS:
+		case OPERATOR_ASTERISK:
+		case OPERATOR_POWER:
+			return true;
+
+		case OPERATOR_DIV:
+			if (ints) {
+				return rhs->types.i != 0;
+			}
+			return ((rhs->value_type == RAM_TYPE_INT) ? (double)rhs->types.i : rhs->types.d) != 0.0;
+
+		case OPERATOR_MOD:
+			return !ints || rhs->types.i != 0;
+
+		default:
+			return false;
+	}
+}
+
+
+//
+// new_literal
+//
+// Returns a new literal element holding the given value, decoded into
+// the constant pool and allocated in the graph of the given node, or
+// NULL if memory could not be allocated.
+//
+static struct ELEMENT* new_literal(struct SLOT_TABLE* slots, const void* node, struct RAM_VALUE* value)
+{
+	char text[64];
+	const char* chars = text;
+
+	struct ELEMENT* element = (struct ELEMENT*)programgraph_alloc(node, sizeof(struct ELEMENT));
+	if (element == NULL) {
+		return NULL;
+	}
+
+	switch (value->value_type) {
+		case RAM_TYPE_INT:
+			element->element_type = ELEMENT_INT_LITERAL;
+			snprintf(text, sizeof(text), "%d", value->types.i);
+			break;
+
+		case RAM_TYPE_REAL:
+			// enough digits for atof() to give back the same double
+			element->element_type = ELEMENT_REAL_LITERAL;
+			snprintf(text, sizeof(text), "%.17g", value->types.d);
+			break;
+
+		case RAM_TYPE_STR:
+			element->element_type = ELEMENT_STR_LITERAL;
+			chars = value->types.s->chars;
+			break;
+
+		default:
+			element->element_type = value->types.i ? ELEMENT_TRUE : ELEMENT_FALSE;
+			chars = value->types.i ? "True" : "False";
+			break;
+	}
+
+	element->element_value = programgraph_strdup(node, chars);
+	element->slot = -1;
+	element->constant = NULL;
+	element->type = -1;
+
+	// on failure the element is simply left in the graph's arena
+	if (element->element_value == NULL || !resolve_literal(slots, element)) {
+		return NULL;
+	}
+
+	return element;
+}
+
+
+//
+// fold_expr
+//
+// Replaces the given expression by a literal if both of its operands
+// are literals. Returns false if memory could not be allocated.
+//
+static bool fold_expr(struct SLOT_TABLE* slots, struct EXPR* expr, int line)
+{
+	if (!expr->isBinaryExpr) {
+		return true;
+	}
+
+	const struct RAM_VALUE* lhs = literal_operand(expr->lhs);
+	const struct RAM_VALUE* rhs = literal_operand(expr->rhs);
+	if (lhs == NULL || rhs == NULL || !is_foldable(expr->operator, lhs, rhs)) {
+		return true;
+	}
+
+	struct RAM_VALUE result = { .value_type = RAM_TYPE_NONE };
+	if (!determine_op_result(expr->operator, *lhs, *rhs, &result, line, NULL, false, false)) {
+		return false;  // only fails if out of memory
+	}
+
+	struct ELEMENT* folded = new_literal(slots, expr, &result);
+	ram_value_release(&result);
+	if (folded == NULL) {
+		return false;
+	}
+
+	// the old operands stay in the graph's arena, which frees them with the graph
+	expr->lhs->element = folded;
+	expr->lhs->expr_type = UNARY_ELEMENT;
+
+	expr->rhs = NULL;
+	expr->isBinaryExpr = false;
+	expr->operator = OPERATOR_NO_OP;
+
+	return true;
+}
+
+
+//
+// is_self_assignment
+//
+// Returns true if the given statement is x = x.
+//
+static bool is_self_assignment(struct STMT_ASSIGNMENT* assignment)
+{
+	if (assignment->isPtrDeref || assignment->rhs->value_type != VALUE_EXPR) {
+		return false;
+	}
+
+	struct EXPR* expr = assignment->rhs->types.expr;
+
+	return !expr->isBinaryExpr &&
+		expr->lhs->expr_type == UNARY_ELEMENT &&
+		expr->lhs->element->element_type == ELEMENT_IDENTIFIER &&
+		expr->lhs->element->slot == assignment->slot;
+}
+
+
+//
+// unlink_stmt
+//
+// Returns the statement following a pass statement or a
+// self-assignment, which is dropped from the graph (its memory is
+// freed with the graph's arena).
+//
+static struct STMT* unlink_stmt(struct STMT* stmt)
+{
+	if (stmt->stmt_type == STMT_PASS) {
+		return stmt->types.pass->next_stmt;
+	}
+
+	return stmt->types.assignment->next_stmt;
+}
+
+
+//
+// variable_operand
+//
+// Returns the slot of the given operand if it is just a variable,
+// otherwise -1.
+//
+static int variable_operand(struct UNARY_EXPR* expr)
+{
+	if (expr == NULL || expr->expr_type != UNARY_ELEMENT || expr->element->element_type != ELEMENT_IDENTIFIER) {
+		return -1;
+	}
+
+	return expr->element->slot;
+}
+
+
+//
+// counter_step
+//
+// Returns true if the given statement is i = i + 5, i = 5 + i or
+// i = i - 5 for the given slot i, setting *step to 5 (or -5).
+//
+static bool counter_step(struct STMT* stmt, int slot, int* step)
+{
+	if (stmt->stmt_type != STMT_ASSIGNMENT) {
+		return false;
+	}
+
+	struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+	if (assignment->isPtrDeref || assignment->slot != slot || assignment->rhs->value_type != VALUE_EXPR) {
+		return false;
+	}
+
+	struct EXPR* expr = assignment->rhs->types.expr;
+	if (!expr->isBinaryExpr || (expr->operator != OPERATOR_PLUS && expr->operator != OPERATOR_MINUS)) {
+		return false;
+	}
+
+	struct UNARY_EXPR* literal = (variable_operand(expr->lhs) == slot) ? expr->rhs : expr->lhs;
+	const struct RAM_VALUE* value = literal_operand(literal);
+
+	if (literal->expr_type != UNARY_ELEMENT || value == NULL || value->value_type != RAM_TYPE_INT) {
+		return false;
+	}
+
+	if (expr->operator == OPERATOR_PLUS) {
+		*step = value->types.i;
+		return variable_operand(expr->lhs) == slot || variable_operand(expr->rhs) == slot;
+	}
+
+	*step = -value->types.i;
+	return variable_operand(expr->lhs) == slot && value->types.i != INT_MIN;
+}
+
+
+//
+// count_writes
+//
+// Returns the # of statements from stmt up to stop (including those
+// in nested loops and ifs) that may write the given slot: assignments
+// to it, and every assignment through a pointer.
+//
+static int count_writes(struct STMT* stmt, struct STMT* stop, int slot)
+{
+	int writes = 0;
+
+	while (stmt != stop) {
+		switch (stmt->stmt_type) {
+			case STMT_ASSIGNMENT: {
+				struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+				if (assignment->isPtrDeref || assignment->slot == slot) {
+					writes++;
+				}
+				stmt = assignment->next_stmt;
+				break;
+			}
+
+			case STMT_FUNCTION_CALL:
+				stmt = stmt->types.function_call->next_stmt;
+				break;
+
+			case STMT_WHILE_LOOP:
+				writes += count_writes(stmt->types.while_loop->loop_body, stmt, slot);
+				stmt = stmt->types.while_loop->next_stmt;
+				break;
+
+			case STMT_IF_THEN_ELSE: {
+				struct STMT_IF_THEN_ELSE* ifthen = stmt->types.if_then_else;
+				writes += count_writes(ifthen->true_path, ifthen->next_stmt, slot);
+				writes += count_writes(ifthen->false_path, ifthen->next_stmt, slot);
+				stmt = ifthen->next_stmt;
+				break;
+			}
+
+			default:
+				stmt = stmt->types.pass->next_stmt;
+				break;
+		}
+	}
+
+	return writes;
+}
+
+
+//
+// find_counter
+//
+// Looks for the induction variable of the given while loop: a variable
+// i compared by the condition (while i < N, while 0 != *p ...) and
+// written only by one i = i + step among the statements the body runs
+// every time around. Records it in the loop, if there is one.
+//
+static void find_counter(struct STMT* stmt)
+{
+	struct STMT_WHILE_LOOP* loop = stmt->types.while_loop;
+	struct EXPR* condition = loop->condition;
+
+	loop->counter_slot = -1;
+	loop->counter_step = 0;
+
+	if (!condition->isBinaryExpr || condition->operator < OPERATOR_EQUAL || condition->operator > OPERATOR_GTE) {
+		return;
+	}
+
+	struct UNARY_EXPR* operands[] = { condition->lhs, condition->rhs };
+	int candidates[2];
+
+	// i itself, or a pointer p walking memory
+	for (int i = 0; i < 2; i++) {
+		candidates[i] = variable_operand(operands[i]);
+		if (operands[i]->expr_type == UNARY_PTR_DEREF && operands[i]->element->element_type == ELEMENT_IDENTIFIER) {
+			candidates[i] = operands[i]->element->slot;
+		}
+	}
+
+	for (int i = 0; i < 2; i++) {
+		int slot = candidates[i];
+		if (slot == -1 || count_writes(loop->loop_body, stmt, slot) != 1) {
+			continue;
+		}
+
+		for (struct STMT* body = loop->loop_body; body != stmt; ) {
+			int step;
+			if (counter_step(body, slot, &step)) {
+				loop->counter_slot = slot;
+				loop->counter_step = step;
+				return;
+			}
+
+			switch (body->stmt_type) {
+				case STMT_ASSIGNMENT:    body = body->types.assignment->next_stmt; break;
+				case STMT_FUNCTION_CALL: body = body->types.function_call->next_stmt; break;
+				case STMT_WHILE_LOOP:    body = body->types.while_loop->next_stmt; break;
+				case STMT_IF_THEN_ELSE:  body = body->types.if_then_else->next_stmt; break;
+				default:                 body = body->types.pass->next_stmt; break;
+			}
+		}
+	}
+}
+
+
+static bool optimize_body(struct SLOT_TABLE* slots, struct STMT** link, struct STMT* stop, bool* assigned);
+
+//
+// optimize_path
+//
+// Optimizes a loop body or a path of an if, which may not run at all:
+// what it assigns doesn't count after it, so it works on a copy of
+// assigned.
+//
+static bool optimize_path(struct SLOT_TABLE* slots, struct STMT** link, struct STMT* stop, bool* assigned)
+{
+	bool* in_path = (bool*)malloc((slots->num_slots + 1) * sizeof(bool));
+	if (in_path == NULL) {
+		return false;
+	}
+	memcpy(in_path, assigned, slots->num_slots * sizeof(bool));
+
+	bool optimized = optimize_body(slots, link, stop, in_path);
+
+	free(in_path);
+	return optimized;
+}
+
+
+//
+// optimize_body
+//
+// Optimizes the statements from *link up to (but not including) stop,
+// where link is the pointer to the first statement (so it can be
+// unlinked). assigned[slot] is true if the variable in slot surely
+// has a value at this point; the body updates it as it goes.
+//
+static bool optimize_body(struct SLOT_TABLE* slots, struct STMT** link, struct STMT* stop, bool* assigned)
+{
+	// the statement after an if is also linked from the end of each of
+	// its paths, so it can't be unlinked
+	bool joined = false;
+
+	while (*link != stop) {
+		struct STMT* stmt = *link;
+		bool removable = !joined;
+
+		joined = false;
+
+		switch (stmt->stmt_type) {
+			case STMT_PASS:
+				if (removable) {
+					*link = unlink_stmt(stmt);
+					continue;
+				}
+				link = &stmt->types.pass->next_stmt;
+				break;
+
+			case STMT_ASSIGNMENT: {
+				struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+
+				if (removable && is_self_assignment(assignment) && assigned[assignment->slot]) {
+					*link = unlink_stmt(stmt);
+					continue;
+				}
+
+				if (assignment->rhs->value_type == VALUE_EXPR &&
+					!fold_expr(slots, assignment->rhs->types.expr, stmt->line)) {
+					return false;
+				}
+
+				// if the assignment fails, execution stops: after it, x has a value
+				if (!assignment->isPtrDeref) {
+					assigned[assignment->slot] = true;
+				}
+
+				link = &assignment->next_stmt;
+				break;
+			}
+
+			case STMT_FUNCTION_CALL:
+				link = &stmt->types.function_call->next_stmt;
+				break;
+
+			case STMT_WHILE_LOOP: {
+				struct STMT_WHILE_LOOP* loop = stmt->types.while_loop;
+
+				if (!fold_expr(slots, loop->condition, stmt->line)) {
+					return false;
+				}
+
+				if (!optimize_path(slots, &loop->loop_body, stmt, assigned)) {
+					return false;
+				}
+
+				find_counter(stmt);
+
+				link = &loop->next_stmt;
+				break;
+			}
+
+			case STMT_IF_THEN_ELSE: {
+				struct STMT_IF_THEN_ELSE* ifthen = stmt->types.if_then_else;
+
+				if (!fold_expr(slots, ifthen->condition, stmt->line) ||
+					!optimize_path(slots, &ifthen->true_path, ifthen->next_stmt, assigned) ||
+					!optimize_path(slots, &ifthen->false_path, ifthen->next_stmt, assigned)) {
+					return false;
+				}
+
+				link = &ifthen->next_stmt;
+				joined = true;
+				break;
+			}
+
+			default:
+				return true;
+		}
+	}
+
+	return true;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// optimize_program
+//
+// Optimizes the given (resolved) program graph in place. Returns
+// false if memory could not be allocated.
+//
+bool optimize_program(struct SLOT_TABLE* slots, struct STMT** program)
+{
+	bool* assigned = (bool*)calloc(slots->num_slots + 1, sizeof(bool));
+	if (assigned == NULL) {
+		return false;
+	}
+
+	bool optimized = optimize_body(slots, program, NULL, assigned);
+
+	free(assigned);
+	return optimized;
+}
@@ -0,0 +1,42 @@
+/*optimize.h*/
+
+//
+// Optimization pass over a resolved nuPython program graph, run
+// before the program is executed (or compiled). The graph is rewritten
+// in place:
+//
+//   - binary expressions whose operands are both literals are folded
+//     into a literal, using the executor's own rules; expressions that
+//     would fail at run-time (e.g. 1/0) are left alone, so the error is
+//     still reported when, and at the line where, they run
+//   - pass statements are unlinked from the statement chains
+//   - self-assignments (x = x) are removed where x is known to have a
+//     value already, since they then have no effect
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+#include "programgraph.h"
+#include "resolve.h"
+
+
+//
+// Public functions:
+//
+
+//
+// optimize_program
+//
+// Optimizes the given program graph, whose identifiers have been
+// resolved to the given slot table (folded literals are added to its
+// constant pool). The program's first statement may change, so the
+// program is passed by reference. Returns false if memory could not
+// be allocated, in which case the graph is still valid but may be
+// only partly optimized.
+//
+bool optimize_program(struct SLOT_TABLE* slots, struct STMT** program);
@@ -0,0 +1,218 @@
+/*output.c*/
+
+//
+// << Output buffer for print(): lines formatted into one buffer, and
+//    written to stdout a buffer at a time. >>
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#define _POSIX_C_SOURCE 200809L  // write, isatty
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "output.h"
+
+
+//
+// what was written (see output.h):
+//
+struct OUTPUT_STATS output_stats = { 0, 0 };
+
+static char* buffer = NULL;
+static int   capacity = 0;
+static int   used = 0;
+static bool  line_at_a_time = false;
+static bool  flush_at_exit = false;
+
+
+//
+// Private functions:
+//
+
+//
+// write_out
+//
+// Writes the given bytes to stdout, as many write() calls as it takes.
+// Output that can't be written (e.g. to a closed pipe) is dropped, as
+// printf would.
+//
+static void write_out(const char* text, size_t length)
+{
+	while (length > 0) {
+		ssize_t written = write(STDOUT_FILENO, text, length);
+		output_stats.writes++;
+
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return;
+		}
+
+		output_stats.bytes += written;
+		text += written;
+		length -= (size_t)written;
+	}
+}
+
+//
+// append
+//
+// Buffers the given bytes, writing the buffer first if they don't fit.
+// Bytes that wouldn't fit in it at all are written straight away.
+//
+static void append(const char* text, int length)
+{
+	if (buffer == NULL) {
+		output_init(OUTPUT_FULL, OUTPUT_DEFAULT_SIZE);  // no buffer if this fails
+	}
+
+	if (length > capacity - used) {
+		output_flush();
+	}
+
+	if (used == 0) {
+		fflush(stdout);  // anything printed before this goes first
+	}
+
+	if (length > capacity) {
+		write_out(text, (size_t)length);
+		return;
+	}
+
+	memcpy(buffer + used, text, (size_t)length);
+	used += length;
+}
+
+//
+// end_line
+//
+// Called after each line is buffered.
+//
+static void end_line(void)
+{
+	if (line_at_a_time) {
+		output_flush();
+	}
+}
+
+
+//
+// Public functions:
+//
+
+//
+// output_init
+//
+bool output_init(int policy, int size)
+{
+	output_flush();
+	free(buffer);
+
+	buffer = (size > 0) ? (char*)malloc((size_t)size) : NULL;
+	capacity = (buffer != NULL) ? size : 0;
+	used = 0;
+
+	line_at_a_time = (policy == OUTPUT_LINE) || isatty(STDOUT_FILENO);
+
+	if (!flush_at_exit) {
+		flush_at_exit = (atexit(output_flush) == 0);
+	}
+
+	return buffer != NULL;
+}
+
+//
+// output_text
+//
+void output_text(const char* text, int length)
+{
+	append(text, length);
+}
+
+//
+// output_line
+//
+void output_line(const char* text, int length)
+{
+	append(text, length);
+	append("\n", 1);
+	end_line();
+}
+
+//
+// output_int
+//
+// Formatted by hand, back to front; unsigned so INT_MIN negates.
+//
+void output_int(int value)
+{
+	char text[16];
+	int  start = sizeof(text);
+
+	unsigned int digits = (value < 0) ? 0u - (unsigned int)value : (unsigned int)value;
+
+	text[--start] = '\n';
+	do {
+		text[--start] = (char)('0' + digits % 10);
+		digits /= 10;
+	} while (digits != 0);
+
+	if (value < 0) {
+		text[--start] = '-';
+	}
+
+	append(text + start, (int)sizeof(text) - start);
+	end_line();
+}
+
+//
+// output_real
+//
+// The longest "%f" of a double is 1 + 309 digits + 7.
+//
+void output_real(double value)
+{
+	char text[400];
+	int  length = snprintf(text, sizeof(text), "%f\n", value);
+
+	if (length > 0 && length < (int)sizeof(text)) {
+		append(text, length);
+	}
+
+	end_line();
+}
+
+//
+// output_error
+//
+void output_error(const char* format, ...)
+{
+	va_list args;
+
+	output_flush();
+
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+}
+
+//
+// output_flush
+//
+void output_flush(void)
+{
+	if (used > 0) {
+		write_out(buffer, (size_t)used);
+		used = 0;
+	}
+}
@@ -0,0 +1,109 @@
+/*output.h*/
+
+//
+// The interpreter's own output buffer for print(). Printed lines are
+// formatted straight into one buffer and written to stdout with a
+// single write() when it fills, instead of a printf (and, to a pipe
+// or file, eventually a write) per line.
+//
+// The buffer is also flushed when input() prompts, when the program
+// stops (at its end, or on an error), and at exit. On a terminal, or
+// with OUTPUT_LINE, it is flushed after every line instead, as stdout
+// has always been.
+//
+// Everything else (error messages, the memory print) still goes
+// through stdio. An error while the program runs is printed with
+// output_error, which writes the buffer first; stdio is then flushed
+// before any line is buffered after it, so the two stay in order even
+// when the program goes on (e.g. past a while loop whose condition
+// failed).
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+
+#define OUTPUT_DEFAULT_SIZE (64 << 10)  // bytes buffered, unless given
+
+//
+// when the buffer is written:
+//
+enum OUTPUT_POLICIES
+{
+  OUTPUT_FULL = 0,  // when full (but a line at a time to a terminal)
+  OUTPUT_LINE       // a line at a time
+};
+
+//
+// what was written, to check it is batched (see main.c, --stats):
+//
+struct OUTPUT_STATS
+{
+  long bytes;   // # of bytes written
+  long writes;  // # of write() calls made
+};
+
+extern struct OUTPUT_STATS output_stats;
+
+
+//
+// Public functions:
+//
+
+//
+// output_init
+//
+// Sets up the buffer, of the given size in bytes, to be written with
+// the given policy. Output before this is buffered with OUTPUT_FULL
+// and OUTPUT_DEFAULT_SIZE. Returns false if the buffer could not be
+// allocated.
+//
+bool output_init(int policy, int size);
+
+//
+// output_text
+//
+// Buffers the given text as is (e.g. an input() prompt).
+//
+void output_text(const char* text, int length);
+
+//
+// output_line
+//
+// Buffers the given text and a newline, as print() does.
+//
+void output_line(const char* text, int length);
+
+//
+// output_int
+//
+// Buffers the given integer and a newline, as print() does.
+//
+void output_int(int value);
+
+//
+// output_real
+//
+// Buffers the given real and a newline, as print() does ("%f").
+//
+void output_real(double value);
+
+//
+// output_error
+//
+// printf for an error message while the program runs: what is buffered
+// is written first, so the message comes after it.
+//
+void output_error(const char* format, ...);
+
+//
+// output_flush
+//
+// Writes what is buffered to stdout.
+//
+void output_flush(void);
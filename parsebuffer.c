@@ -0,0 +1,658 @@
+/*parsebuffer.c*/
+
+//
+// << Buffer-based parsing: a memory-mapped program scanned in memory
+//    and checked against the nuPython grammar, falling back to the
+//    stdio parser for anything it doesn't accept. >>
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#define _POSIX_C_SOURCE 200809L  // fileno, fmemopen, mmap
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>   // memcpy, memset
+#include <limits.h>   // INT_MAX
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "token.h"
+#include "tokenqueue.h"
+#include "tokenbuffer.h"
+#include "scanbuffer.h"
+#include "tokenring.h"
+#include "scanparallel.h"
+#include "parser.h"
+#include "parsebuffer.h"
+
+
+//
+// Private functions:
+//
+// The check_ functions follow the grammar parser_parse checks, and
+// return true if the tokens at the cursor match, advancing past them.
+// They accept nothing parser_parse rejects; a false only means the
+// program goes to parser_parse for its error message.
+//
+
+//
+// expect
+//
+// Advances past the next token if it has the given id.
+//
+static bool expect(struct TOKEN_CURSOR* cur, int id)
+{
+	if (tokenbuffer_peekToken(cur).id != id) {
+		return false;
+	}
+
+	tokenbuffer_dequeue(cur);
+	return true;
+}
+
+//
+// is_element
+//
+// Returns true if the token id is that of an element: an identifier or
+// a literal.
+//
+static bool is_element(int id)
+{
+	switch (id) {
+		case nuPy_IDENTIFIER:
+		case nuPy_INT_LITERAL:
+		case nuPy_REAL_LITERAL:
+		case nuPy_STR_LITERAL:
+		case nuPy_KEYW_TRUE:
+		case nuPy_KEYW_FALSE:
+		case nuPy_KEYW_NONE:
+			return true;
+		default:
+			return false;
+	}
+}
+
+//
+// is_operator
+//
+// Returns true if the token id is that of a binary operator.
+//
+static bool is_operator(int id)
+{
+	switch (id) {
+		case nuPy_PLUS:
+		case nuPy_MINUS:
+		case nuPy_ASTERISK:
+		case nuPy_POWER:
+		case nuPy_PERCENT:
+		case nuPy_SLASH:
+		case nuPy_EQUALEQUAL:
+		case nuPy_NOTEQUAL:
+		case nuPy_LT:
+		case nuPy_LTE:
+		case nuPy_GT:
+		case nuPy_GTE:
+		case nuPy_KEYW_IS:
+		case nuPy_KEYW_IN:
+			return true;
+		default:
+			return false;
+	}
+}
+
+//
+// check_unary
+//
+// *x, &x, +x / -x (x an identifier or a number), or an element.
+//
+static bool check_unary(struct TOKEN_CURSOR* cur)
+{
+	int id = tokenbuffer_peekToken(cur).id;
+
+	if (id == nuPy_ASTERISK || id == nuPy_AMPERSAND) {
+		tokenbuffer_dequeue(cur);
+		return expect(cur, nuPy_IDENTIFIER);
+	}
+
+	if (id == nuPy_PLUS || id == nuPy_MINUS) {
+		tokenbuffer_dequeue(cur);
+		id = tokenbuffer_peekToken(cur).id;
+
+		if (id != nuPy_IDENTIFIER && id != nuPy_INT_LITERAL && id != nuPy_REAL_LITERAL) {
+			return false;
+		}
+	}
+	else if (!is_element(id)) {
+		return false;
+	}
+
+	tokenbuffer_dequeue(cur);
+	return true;
+}
+
+//
+// check_expr
+//
+// A unary expression, optionally followed by an operator and another.
+//
+static bool check_expr(struct TOKEN_CURSOR* cur)
+{
+	if (!check_unary(cur)) {
+		return false;
+	}
+
+	if (!is_operator(tokenbuffer_peekToken(cur).id)) {
+		return true;
+	}
+
+	tokenbuffer_dequeue(cur);
+	return check_unary(cur);
+}
+
+//
+// check_call
+//
+// f(), or f(e) for an element e.
+//
+static bool check_call(struct TOKEN_CURSOR* cur)
+{
+	if (!expect(cur, nuPy_IDENTIFIER) || !expect(cur, nuPy_LEFT_PAREN)) {
+		return false;
+	}
+
+	if (is_element(tokenbuffer_peekToken(cur).id)) {
+		tokenbuffer_dequeue(cur);
+	}
+
+	return expect(cur, nuPy_RIGHT_PAREN);
+}
+
+//
+// check_value
+//
+// The right-hand side of an assignment: a call or an expression.
+//
+static bool check_value(struct TOKEN_CURSOR* cur)
+{
+	if (tokenbuffer_peekToken(cur).id == nuPy_IDENTIFIER && tokenbuffer_peek2Token(cur).id == nuPy_LEFT_PAREN) {
+		return check_call(cur);
+	}
+
+	return check_expr(cur);
+}
+
+
+static bool check_stmts(struct TOKEN_CURSOR* cur);
+
+//
+// check_block
+//
+// : EOLN { EOLN stmts } EOLN
+//
+static bool check_block(struct TOKEN_CURSOR* cur)
+{
+	return expect(cur, nuPy_COLON) && expect(cur, nuPy_EOLN) &&
+		expect(cur, nuPy_LEFT_BRACE) && expect(cur, nuPy_EOLN) &&
+		check_stmts(cur) &&
+		expect(cur, nuPy_RIGHT_BRACE) && expect(cur, nuPy_EOLN);
+}
+
+//
+// check_if
+//
+// if (or elif) expr block, then an optional elif ... or else block,
+// right after it.
+//
+static bool check_if(struct TOKEN_CURSOR* cur)
+{
+	tokenbuffer_dequeue(cur);  // if / elif
+
+	if (!check_expr(cur) || !check_block(cur)) {
+		return false;
+	}
+
+	switch (tokenbuffer_peekToken(cur).id) {
+		case nuPy_KEYW_ELIF:
+			return check_if(cur);
+
+		case nuPy_KEYW_ELSE:
+			tokenbuffer_dequeue(cur);
+			return check_block(cur);
+
+		default:
+			return true;
+	}
+}
+
+//
+// check_stmt
+//
+static bool check_stmt(struct TOKEN_CURSOR* cur)
+{
+	switch (tokenbuffer_peekToken(cur).id) {
+		case nuPy_EOLN:
+			tokenbuffer_dequeue(cur);
+			return true;
+
+		case nuPy_KEYW_PASS:
+			tokenbuffer_dequeue(cur);
+			return expect(cur, nuPy_EOLN);
+
+		case nuPy_ASTERISK:
+			tokenbuffer_dequeue(cur);
+			return expect(cur, nuPy_IDENTIFIER) && expect(cur, nuPy_EQUAL) && check_value(cur) && expect(cur, nuPy_EOLN);
+
+		case nuPy_IDENTIFIER:
+			if (tokenbuffer_peek2Token(cur).id == nuPy_LEFT_PAREN) {
+				return check_call(cur) && expect(cur, nuPy_EOLN);
+			}
+			tokenbuffer_dequeue(cur);
+			return expect(cur, nuPy_EQUAL) && check_value(cur) && expect(cur, nuPy_EOLN);
+
+		case nuPy_KEYW_IF:
+			return check_if(cur);
+
+		case nuPy_KEYW_WHILE:
+			tokenbuffer_dequeue(cur);
+			return check_expr(cur) && check_block(cur);
+
+		default:
+			return false;
+	}
+}
+
+//
+// check_stmts
+//
+// One or more statements, up to a token that can't start one.
+//
+static bool check_stmts(struct TOKEN_CURSOR* cur)
+{
+	do {
+		if (!check_stmt(cur)) {
+			return false;
+		}
+
+		switch (tokenbuffer_peekToken(cur).id) {
+			case nuPy_EOLN:
+			case nuPy_KEYW_PASS:
+			case nuPy_ASTERISK:
+			case nuPy_IDENTIFIER:
+			case nuPy_KEYW_IF:
+			case nuPy_KEYW_WHILE:
+				continue;
+			default:
+				return true;
+		}
+	} while (true);
+}
+
+
+//
+// scan_and_check
+//
+// Scans the given text and checks its syntax, returning its tokens if
+// it is a program, otherwise NULL (with no error message).
+//
+static struct TOKEN_BUFFER* scan_and_check(const char* text, size_t length)
+{
+	struct TOKEN_BUFFER* tokens = NULL;
+
+	// a program has about a token per 4 chars, and values no longer than itself
+	if (length < INT_MAX / 2) {
+		tokens = tokenbuffer_alloc((int)(length / 4) + 16, (int)length + 64);
+	}
+
+	if (tokens != NULL && scanbuffer_scan(text, length, tokens)) {
+		struct TOKEN_CURSOR cursor = tokenbuffer_cursor(tokens);
+
+		if (check_stmts(&cursor) && tokenbuffer_peekToken(&cursor).id == nuPy_EOS) {
+			tokens->quiet = true;
+			return tokens;
+		}
+	}
+
+	tokenbuffer_destroy(tokens);
+	return NULL;
+}
+
+//
+// parse_text
+//
+// parser_parse_stream on the given text.
+//
+static struct TOKEN_BUFFER* parse_text(const char* text, size_t length)
+{
+	FILE* stream = fmemopen((void*)text, length, "r");
+	if (stream == NULL) {
+		printf("**ERROR: unable to read the program\n");
+		return NULL;
+	}
+
+	struct TOKEN_BUFFER* tokens = parser_parse_stream(stream);
+
+	fclose(stream);
+	return tokens;
+}
+
+
+//
+// the scanner's thread, when parsing is pipelined:
+//
+struct PRODUCER
+{
+  const char* text;
+  size_t length;
+  struct TOKEN_RING* ring;
+};
+
+//
+// push_token
+//
+// The emit function of the scanner's thread.
+//
+static bool push_token(void* ring, struct Token token, const char* value, int len)
+{
+	struct RING_TOKEN pushed = { .id = token.id, .line = token.line, .col = token.col, .len = len, .value = value };
+
+	return tokenring_push((struct TOKEN_RING*)ring, pushed);
+}
+
+//
+// produce
+//
+// The scanner's thread: scans the text into the ring, ending with the
+// nuPy_EOS token, or a TOKENRING_FAILED one if it can't be scanned.
+//
+static void* produce(void* arg)
+{
+	struct PRODUCER* producer = (struct PRODUCER*)arg;
+
+	if (!scanbuffer_emit(producer->text, producer->length, push_token, producer->ring)) {
+		struct RING_TOKEN failed = { .id = TOKENRING_FAILED, .value = "" };
+
+		tokenring_push(producer->ring, failed);
+	}
+
+	tokenring_flush(producer->ring);
+	return NULL;
+}
+
+//
+// starts_block
+//
+// Returns true if a token after a top-level EOLN belongs to the
+// statement before it: a block's {, or an elif / else.
+//
+static bool starts_block(int id)
+{
+	return id == nuPy_LEFT_BRACE || id == nuPy_KEYW_ELIF || id == nuPy_KEYW_ELSE;
+}
+
+//
+// consume
+//
+// The parser's side of a pipelined parse: moves the tokens from the
+// ring into the buffer and checks each top-level statement as soon as
+// all its tokens are in. A statement is known to be in once a token
+// after a top-level EOLN doesn't continue it, so the check never reads
+// a token that hasn't arrived. Returns true if the tokens are a
+// program.
+//
+static bool consume(struct TOKEN_RING* ring, struct TOKEN_BUFFER* tokens)
+{
+	struct RING_TOKEN batch[TOKENRING_BATCH];
+	struct TOKEN_CURSOR cursor = tokenbuffer_cursor(tokens);
+	int depth = 0;              // # of open {
+	bool after_eoln = false;    // the last token was a top-level EOLN
+	int complete = 0;           // the statements before this index are all in
+	int checked = 0;            // # of statements checked
+	bool eos = false;
+
+	while (!eos) {
+		int count = tokenring_pop(ring, batch, TOKENRING_BATCH);
+
+		for (int i = 0; i < count && !eos; i++) {
+			if (batch[i].id == TOKENRING_FAILED) {
+				return false;
+			}
+
+			struct Token token = { .id = batch[i].id, .line = batch[i].line, .col = batch[i].col };
+			if (!tokenbuffer_append(tokens, token, batch[i].value, batch[i].len)) {
+				return false;
+			}
+
+			if (after_eoln && !starts_block(token.id)) {
+				complete = tokens->num_tokens - 1;
+			}
+
+			depth += (token.id == nuPy_LEFT_BRACE) - (token.id == nuPy_RIGHT_BRACE);
+			after_eoln = (token.id == nuPy_EOLN && depth == 0);
+			eos = (token.id == nuPy_EOS);
+		}
+
+		while (cursor.index < complete) {
+			if (!check_stmt(&cursor)) {
+				return false;
+			}
+			checked++;
+		}
+
+		if (cursor.index != complete) {
+			return false;  // a statement ran past a top-level EOLN?!
+		}
+	}
+
+	//
+	// the statements after the last one known to be complete:
+	//
+	while (tokenbuffer_peekToken(&cursor).id != nuPy_EOS) {
+		if (!check_stmt(&cursor)) {
+			return false;
+		}
+		checked++;
+	}
+
+	return checked > 0;
+}
+
+//
+// parse_pipelined
+//
+// parser_parse_buffer with the scanner on a thread of its own.
+//
+static struct TOKEN_BUFFER* parse_pipelined(const char* text, size_t length)
+{
+	struct TOKEN_RING* ring = (struct TOKEN_RING*)malloc(sizeof(struct TOKEN_RING));
+	struct TOKEN_BUFFER* tokens = NULL;
+
+	if (length < INT_MAX / 2) {
+		tokens = tokenbuffer_alloc((int)(length / 4) + 16, (int)length + 64);
+	}
+
+	if (ring == NULL || tokens == NULL) {
+		free(ring);
+		tokenbuffer_destroy(tokens);
+		return parser_parse_buffer(text, length);
+	}
+
+	tokenring_init(ring);
+
+	struct PRODUCER producer = { .text = text, .length = length, .ring = ring };
+	pthread_t thread;
+
+	if (pthread_create(&thread, NULL, produce, &producer) != 0) {
+		free(ring);
+		tokenbuffer_destroy(tokens);
+		return parser_parse_buffer(text, length);
+	}
+
+	bool parsed = consume(ring, tokens);
+
+	tokenring_cancel(ring);  // if the parser stopped early, so does the scanner
+	pthread_join(thread, NULL);
+	free(ring);
+
+	if (parsed) {
+		tokens->quiet = true;
+		return tokens;
+	}
+
+	tokenbuffer_destroy(tokens);
+
+	//
+	// parser_parse scans the text again, and reports the error:
+	//
+	return parse_text(text, length);
+}
+
+
+//
+// parse_parallel
+//
+// parser_parse_buffer with the text scanned in chunks, a thread per
+// chunk (see scanparallel.h).
+//
+static struct TOKEN_BUFFER* parse_parallel(const char* text, size_t length)
+{
+	struct TOKEN_BUFFER* tokens = scanparallel_scan(text, length, scanparallel_threads());
+
+	if (tokens == NULL) {
+		return parser_parse_buffer(text, length);
+	}
+
+	struct TOKEN_CURSOR cursor = tokenbuffer_cursor(tokens);
+
+	if (check_stmts(&cursor) && tokenbuffer_peekToken(&cursor).id == nuPy_EOS) {
+		tokens->quiet = true;
+		return tokens;
+	}
+
+	tokenbuffer_destroy(tokens);
+
+	//
+	// parser_parse scans the text again, and reports the error:
+	//
+	return parse_text(text, length);
+}
+
+
+//
+// Public functions:
+//
+
+//
+// parser_parse_buffer
+//
+struct TOKEN_BUFFER* parser_parse_buffer(const char* text, size_t length)
+{
+	struct TOKEN_BUFFER* tokens = scan_and_check(text, length);
+
+	if (tokens != NULL) {
+		return tokens;
+	}
+
+	//
+	// parser_parse scans the text again, and reports the error:
+	//
+	return parse_text(text, length);
+}
+
+//
+// parser_parse_lines
+//
+// A failed text is parsed again after line - 1 empty lines, so the
+// errors parser_parse reports are at their lines in the whole input;
+// an empty line is just an EOLN, and builds no statement.
+//
+struct TOKEN_BUFFER* parser_parse_lines(const char* text, size_t length, int line)
+{
+	struct TOKEN_BUFFER* tokens = scan_and_check(text, length);
+
+	if (tokens != NULL) {
+		for (int i = 0; i < tokens->num_tokens; i++) {
+			tokens->tokens[i].line += line - 1;
+		}
+
+		return tokens;
+	}
+
+	size_t padding = (size_t)(line - 1);
+
+	char* padded = (char*)malloc(padding + length);
+	if (padded == NULL) {
+		printf("**ERROR: unable to read the program\n");
+		return NULL;
+	}
+
+	memset(padded, '\n', padding);
+	memcpy(padded + padding, text, length);
+
+	tokens = parse_text(padded, padding + length);
+
+	free(padded);
+	return tokens;
+}
+
+//
+// parser_parse_file
+//
+struct TOKEN_BUFFER* parser_parse_file(FILE* input, int mode)
+{
+	struct stat info;
+
+	if (fstat(fileno(input), &info) != 0 || !S_ISREG(info.st_mode) || info.st_size >= INT_MAX / 2) {
+		return parser_parse_stream(input);
+	}
+
+	if (info.st_size == 0) {
+		return parser_parse_buffer("", 0);
+	}
+
+	size_t length = (size_t)info.st_size;
+
+	void* text = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fileno(input), 0);
+	if (text == MAP_FAILED) {
+		return parser_parse_stream(input);
+	}
+
+	posix_madvise(text, length, POSIX_MADV_SEQUENTIAL);
+
+	struct TOKEN_BUFFER* tokens;
+
+	switch (mode) {
+		case PARSE_PIPELINED:
+			tokens = parse_pipelined((const char*)text, length);
+			break;
+		case PARSE_PARALLEL:
+			tokens = parse_parallel((const char*)text, length);
+			break;
+		default:
+			tokens = parser_parse_buffer((const char*)text, length);
+			break;
+	}
+
+	munmap(text, length);
+	return tokens;
+}
+
+//
+// parser_parse_stream
+//
+struct TOKEN_BUFFER* parser_parse_stream(FILE* input)
+{
+	struct TokenQueue* queue = parser_parse(input);
+	if (queue == NULL) {
+		return NULL;
+	}
+
+	struct TOKEN_BUFFER* tokens = tokenbuffer_create(queue);
+	tokenqueue_destroy(queue);
+
+	return tokens;
+}
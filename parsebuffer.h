@@ -0,0 +1,86 @@
+/*parsebuffer.h*/
+
+//
+// Buffer-based entry points to the nuPython parser. A program file is
+// memory-mapped and scanned in memory (see scanbuffer.h) straight into
+// a TOKEN_BUFFER, and its syntax is checked against the same grammar
+// as parser_parse, without a TokenQueue or a char at a time through
+// stdio.
+//
+// Only a program that scans and checks cleanly takes the fast path.
+// Anything else (a syntax error, or input the in-memory scanner leaves
+// alone) is handed to parser_parse, so every error and warning is the
+// one it has always been.
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stddef.h>   // size_t
+#include "tokenbuffer.h"
+
+
+//
+// how parser_parse_file scans and checks a program:
+//
+enum PARSE_MODES
+{
+  PARSE_SERIAL = 0,  // one after the other
+  PARSE_PIPELINED,   // the scanner on a thread of its own (see tokenring.h)
+  PARSE_PARALLEL     // the text scanned in chunks, a thread per core (see scanparallel.h)
+};
+
+//
+// Public functions:
+//
+
+//
+// parser_parse_buffer
+//
+// Given the text of a nuPython program, scans it and checks its syntax
+// like parser_parse. Returns NULL if a syntax error was found, in which
+// case an error message was output; otherwise returns the program's
+// tokens, which the caller frees with tokenbuffer_destroy.
+//
+struct TOKEN_BUFFER* parser_parse_buffer(const char* text, size_t length);
+
+//
+// parser_parse_lines
+//
+// parser_parse_buffer for part of a larger input, made of whole lines
+// starting at the given line # (1-based): the tokens, and any error
+// message, have their lines in the whole input. Used to parse a
+// program a statement at a time (see stream.h).
+//
+struct TOKEN_BUFFER* parser_parse_lines(const char* text, size_t length, int line);
+
+//
+// parser_parse_file
+//
+// parser_parse_buffer for the given input file, opened but not read
+// yet, which is memory-mapped. Input that can't be mapped (a pipe, the
+// keyboard) is read by parser_parse.
+//
+// With PARSE_PIPELINED, the scanner runs on a second thread, feeding
+// its tokens through a ring to this one, which checks each top-level
+// statement as soon as its tokens are in; the tokens, and any error
+// messages, are the same as PARSE_SERIAL's.
+//
+// With PARSE_PARALLEL, a large text is cut into chunks at line breaks
+// and each is scanned on a thread of its own, then the tokens are
+// checked on this one; again the same as PARSE_SERIAL's.
+//
+struct TOKEN_BUFFER* parser_parse_file(FILE* input, int mode);
+
+//
+// parser_parse_stream
+//
+// parser_parse, with the tokens it returns moved into a TOKEN_BUFFER.
+// Reads the given input only up to the $ that ends the program, so
+// the rest of it is left for input().
+//
+struct TOKEN_BUFFER* parser_parse_stream(FILE* input);
@@ -0,0 +1,1146 @@
+/*programgraph.c*/
+
+//
+// Project: program graph data structure for nuPython. Walks the
+// tokens produced by the parser and builds a graph of statements,
+// where each statement points to the next statement to execute
+// (the last statement in a loop body points back to the loop).
+//
+// Prof. Joe Hummel
+// Northwestern University
+// CS 211
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>   // max_align_t
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <assert.h>
+
+#include "programgraph.h"
+
+
+//
+// Private functions:
+//
+
+//
+// panic
+//
+// Outputs the given error message and exits the program.
+//
+static void panic(char* msg)
+{
+  printf("**PROGRAMGRAPH ERROR\n");
+  printf("**PROGRAMGRAPH ERROR: %s\n", msg);
+  printf("**PROGRAMGRAPH ERROR\n");
+  exit(-1);
+}
+
+
+//
+// Arena:
+//
+// Every node and string of a program graph is allocated from the
+// graph's arena, in the order the graph is built --- which is the
+// order of the program --- so a loop body and its expressions sit
+// together in memory, with no per-node malloc overhead, and the
+// whole graph is freed a block at a time.
+//
+
+#define PG_BLOCK_SIZE  (64 * 1024)
+#define PG_ALIGN       _Alignof(max_align_t)
+
+struct PG_BLOCK
+{
+  struct PG_BLOCK* next;
+  size_t size;  // # of bytes in data
+  size_t used;  // # of bytes handed out
+  max_align_t data[];
+};
+
+struct PG_ARENA
+{
+  struct PG_BLOCK* blocks;  // the block being filled comes first
+  struct PG_ARENA* next;    // next live arena
+};
+
+static struct PG_ARENA* arenas = NULL;    // arenas of the live graphs
+static struct PG_ARENA* building = NULL;  // arena of the graph being built
+
+
+//
+// pg_arena_alloc
+//
+// Returns size bytes from the given arena, or NULL if memory could
+// not be allocated.
+//
+static void* pg_arena_alloc(struct PG_ARENA* arena, size_t size)
+{
+  size = (size + PG_ALIGN - 1) & ~(PG_ALIGN - 1);
+
+  struct PG_BLOCK* block = arena->blocks;
+
+  if (block == NULL || block->size - block->used < size)
+  {
+    size_t block_size = (size > PG_BLOCK_SIZE) ? size : PG_BLOCK_SIZE;
+
+    struct PG_BLOCK* fresh = (struct PG_BLOCK*)malloc(sizeof(struct PG_BLOCK) + block_size);
+    if (fresh == NULL)
+      return NULL;
+
+    fresh->size = block_size;
+    fresh->used = 0;
+
+    //
+    // a big allocation gets a block of its own, behind the one
+    // being filled, so the space left there isn't wasted:
+    //
+    if (block != NULL && size > PG_BLOCK_SIZE / 4)
+    {
+      fresh->next = block->next;
+      block->next = fresh;
+    }
+    else
+    {
+      fresh->next = block;
+      arena->blocks = fresh;
+    }
+
+    block = fresh;
+  }
+
+  void* p = (char*)block->data + block->used;
+  block->used += size;
+
+  return p;
+}
+
+
+//
+// pg_find_arena
+//
+// Returns the live arena holding the given node, or NULL.
+//
+static struct PG_ARENA* pg_find_arena(const void* node)
+{
+  for (struct PG_ARENA* arena = arenas; arena != NULL; arena = arena->next)
+  {
+    for (struct PG_BLOCK* block = arena->blocks; block != NULL; block = block->next)
+    {
+      const char* data = (const char*)block->data;
+
+      if ((const char*)node >= data && (const char*)node < data + block->used)
+        return arena;
+    }
+  }
+
+  return NULL;
+}
+
+
+//
+// pg_free_arena
+//
+static void pg_free_arena(struct PG_ARENA* arena)
+{
+  struct PG_BLOCK* block = arena->blocks;
+
+  while (block != NULL)
+  {
+    struct PG_BLOCK* next = block->next;
+    free(block);
+    block = next;
+  }
+
+  free(arena);
+}
+
+
+//
+// pg_alloc
+//
+// Allocates size bytes for the graph being built; NULL if out of
+// memory.
+//
+static void* pg_alloc(size_t size)
+{
+  assert(building != NULL);
+
+  return pg_arena_alloc(building, size);
+}
+
+
+//
+// dupString
+//
+// Returns a copy of the given string, allocated in the graph's arena.
+//
+static char* dupString(const char* s)
+{
+  if (s == NULL)
+    panic("s is NULL (dupString)");
+
+  char* copy = (char*)pg_alloc(strlen(s) + 1);
+  if (copy == NULL)
+    panic("out of memory (dupString)");
+
+  strcpy(copy, s);
+
+  return copy;
+}
+
+
+//
+// isOperator
+//
+// Returns true if the given token is a binary operator, false if not.
+//
+static bool isOperator(struct Token token)
+{
+  switch (token.id)
+  {
+    case nuPy_PLUS:
+    case nuPy_MINUS:
+    case nuPy_ASTERISK:
+    case nuPy_POWER:
+    case nuPy_PERCENT:
+    case nuPy_SLASH:
+    case nuPy_EQUALEQUAL:
+    case nuPy_NOTEQUAL:
+    case nuPy_LT:
+    case nuPy_LTE:
+    case nuPy_GT:
+    case nuPy_GTE:
+    case nuPy_KEYW_IS:
+    case nuPy_KEYW_IN:
+      return true;
+    default:
+      return false;
+  }
+}
+
+
+//
+// pg_build_element
+//
+// Builds an element (identifier or literal) from the current token,
+// but does not advance past the token.
+//
+static struct ELEMENT* pg_build_element(struct TOKEN_CURSOR* cur)
+{
+  struct ELEMENT* element = (struct ELEMENT*)pg_alloc(sizeof(struct ELEMENT));
+  if (element == NULL)
+    panic("out of memory (pg_build_element)");
+
+  element->element_value = dupString(tokenbuffer_peekValue(cur));
+  element->slot = -1;  // bound later by the resolution pass
+  element->constant = NULL;  // decoded by the resolution pass too
+  element->type = -1;  // proven by the type inference pass
+
+  switch (tokenbuffer_peekToken(cur).id)
+  {
+    case nuPy_IDENTIFIER:
+      element->element_type = ELEMENT_IDENTIFIER;
+      break;
+    case nuPy_INT_LITERAL:
+      element->element_type = ELEMENT_INT_LITERAL;
+      break;
+    case nuPy_REAL_LITERAL:
+      element->element_type = ELEMENT_REAL_LITERAL;
+      break;
+    case nuPy_STR_LITERAL:
+      element->element_type = ELEMENT_STR_LITERAL;
+      break;
+    case nuPy_KEYW_TRUE:
+      element->element_type = ELEMENT_TRUE;
+      break;
+    case nuPy_KEYW_FALSE:
+      element->element_type = ELEMENT_FALSE;
+      break;
+    case nuPy_KEYW_NONE:
+      element->element_type = ELEMENT_NONE;
+      break;
+    default:
+      panic("unknown element type (pg_build_element)");
+  }
+
+  return element;
+}
+
+
+//
+// pg_build_unary_expr
+//
+// Builds a unary expression: an optional unary operator (*, &, +, -)
+// followed by an element. Advances past the expression.
+//
+static struct UNARY_EXPR* pg_build_unary_expr(struct TOKEN_CURSOR* cur)
+{
+  struct UNARY_EXPR* unary = (struct UNARY_EXPR*)pg_alloc(sizeof(struct UNARY_EXPR));
+  if (unary == NULL)
+    panic("out of memory (pg_build_unary_expr)");
+
+  switch (tokenbuffer_peekToken(cur).id)
+  {
+    case nuPy_ASTERISK:
+      unary->expr_type = UNARY_PTR_DEREF;
+      tokenbuffer_dequeue(cur);
+      break;
+    case nuPy_AMPERSAND:
+      unary->expr_type = UNARY_ADDRESS_OF;
+      tokenbuffer_dequeue(cur);
+      break;
+    case nuPy_PLUS:
+      unary->expr_type = UNARY_PLUS;
+      tokenbuffer_dequeue(cur);
+      break;
+    case nuPy_MINUS:
+      unary->expr_type = UNARY_MINUS;
+      tokenbuffer_dequeue(cur);
+      break;
+    default:
+      unary->expr_type = UNARY_ELEMENT;
+      break;
+  }
+
+  unary->element = pg_build_element(cur);
+  tokenbuffer_dequeue(cur);
+
+  return unary;
+}
+
+
+//
+// pg_build_expr
+//
+// Builds an expression: a unary expression, optionally followed by
+// a binary operator and a 2nd unary expression. Advances past the
+// expression.
+//
+static struct EXPR* pg_build_expr(struct TOKEN_CURSOR* cur)
+{
+  struct EXPR* expr = (struct EXPR*)pg_alloc(sizeof(struct EXPR));
+  if (expr == NULL)
+    panic("out of memory (pg_build_expr)");
+
+  expr->isBinaryExpr = false;
+  expr->operator = OPERATOR_NO_OP;
+  expr->rhs = NULL;
+  expr->cache_key = 0;
+  expr->type = -1;
+  expr->proven_key = 0;
+
+  expr->lhs = pg_build_unary_expr(cur);
+
+  if (!isOperator(tokenbuffer_peekToken(cur)))
+    return expr;
+
+  expr->isBinaryExpr = true;
+
+  switch (tokenbuffer_peekToken(cur).id)
+  {
+    case nuPy_PLUS:       expr->operator = OPERATOR_PLUS; break;
+    case nuPy_MINUS:      expr->operator = OPERATOR_MINUS; break;
+    case nuPy_ASTERISK:   expr->operator = OPERATOR_ASTERISK; break;
+    case nuPy_POWER:      expr->operator = OPERATOR_POWER; break;
+    case nuPy_PERCENT:    expr->operator = OPERATOR_MOD; break;
+    case nuPy_SLASH:      expr->operator = OPERATOR_DIV; break;
+    case nuPy_EQUALEQUAL: expr->operator = OPERATOR_EQUAL; break;
+    case nuPy_NOTEQUAL:   expr->operator = OPERATOR_NOT_EQUAL; break;
+    case nuPy_LT:         expr->operator = OPERATOR_LT; break;
+    case nuPy_LTE:        expr->operator = OPERATOR_LTE; break;
+    case nuPy_GT:         expr->operator = OPERATOR_GT; break;
+    case nuPy_GTE:        expr->operator = OPERATOR_GTE; break;
+    case nuPy_KEYW_IS:    expr->operator = OPERATOR_IS; break;
+    case nuPy_KEYW_IN:    expr->operator = OPERATOR_IN; break;
+    default:
+      panic("unknown operator (pg_build_expr)");
+  }
+
+  tokenbuffer_dequeue(cur);
+
+  expr->rhs = pg_build_unary_expr(cur);
+
+  return expr;
+}
+
+
+//
+// pg_build_value
+//
+// Builds the right-hand side of an assignment: either a function
+// call such as input('x? ') or an expression. Advances past the
+// value.
+//
+static struct VALUE* pg_build_value(struct TOKEN_CURSOR* cur)
+{
+  struct VALUE* value = (struct VALUE*)pg_alloc(sizeof(struct VALUE));
+  if (value == NULL)
+    panic("out of memory (pg_build_value)");
+
+  if (tokenbuffer_peekToken(cur).id == nuPy_IDENTIFIER &&
+    tokenbuffer_peek2Token(cur).id == nuPy_LEFT_PAREN)
+  {
+    //
+    // function call:
+    //
+    value->value_type = VALUE_FUNCTION_CALL;
+
+    struct FUNCTION_CALL* call = (struct FUNCTION_CALL*)pg_alloc(sizeof(struct FUNCTION_CALL));
+    if (call == NULL)
+      panic("out of memory (pg_build_value)");
+
+    call->function_name = dupString(tokenbuffer_peekValue(cur));
+    call->builtin = -1;  // bound later by the resolution pass
+    tokenbuffer_dequeue(cur);
+
+    assert(tokenbuffer_peekToken(cur).id == nuPy_LEFT_PAREN);
+    tokenbuffer_dequeue(cur);
+
+    if (tokenbuffer_peekToken(cur).id == nuPy_RIGHT_PAREN)
+    {
+      call->parameter = NULL;
+    }
+    else
+    {
+      call->parameter = pg_build_element(cur);
+      tokenbuffer_dequeue(cur);
+    }
+
+    assert(tokenbuffer_peekToken(cur).id == nuPy_RIGHT_PAREN);
+    tokenbuffer_dequeue(cur);
+
+    value->types.function_call = call;
+  }
+  else
+  {
+    //
+    // expression:
+    //
+    value->value_type = VALUE_EXPR;
+    value->types.expr = pg_build_expr(cur);
+  }
+
+  return value;
+}
+
+
+//
+// pg_alloc_stmt
+//
+// Allocates a statement of the given type along with the struct
+// for that type of statement. The caller fills in the details.
+//
+static struct STMT* pg_alloc_stmt(int stmt_type, int line)
+{
+  if (stmt_type != STMT_ASSIGNMENT &&
+    stmt_type != STMT_FUNCTION_CALL &&
+    stmt_type != STMT_IF_THEN_ELSE &&
+    stmt_type != STMT_WHILE_LOOP &&
+    stmt_type != STMT_PASS)
+    panic("unexpected stmt_type (pg_alloc_stmt)");
+
+  struct STMT* stmt = (struct STMT*)pg_alloc(sizeof(struct STMT));
+  if (stmt == NULL)
+    panic("out of memory (pg_alloc_stmt)");
+
+  stmt->stmt_type = stmt_type;
+  stmt->line = line;
+  stmt->safe = false;  // proven by the validation pass
+
+  if (stmt_type == STMT_ASSIGNMENT)
+  {
+    struct STMT_ASSIGNMENT* assignment = (struct STMT_ASSIGNMENT*)pg_alloc(sizeof(struct STMT_ASSIGNMENT));
+    if (assignment == NULL)
+      panic("out of memory (pg_alloc_stmt)");
+
+    assignment->var_name = NULL;
+    assignment->slot = -1;
+    assignment->isPtrDeref = false;
+    assignment->rhs = NULL;
+    assignment->next_stmt = NULL;
+
+    stmt->types.assignment = assignment;
+  }
+  else if (stmt_type == STMT_FUNCTION_CALL)
+  {
+    struct STMT_FUNCTION_CALL* call = (struct STMT_FUNCTION_CALL*)pg_alloc(sizeof(struct STMT_FUNCTION_CALL));
+    if (call == NULL)
+      panic("out of memory (pg_alloc_stmt)");
+
+    call->function_name = NULL;
+    call->builtin = -1;
+    call->parameter = NULL;
+    call->next_stmt = NULL;
+
+    stmt->types.function_call = call;
+  }
+  else if (stmt_type == STMT_IF_THEN_ELSE)
+  {
+    struct STMT_IF_THEN_ELSE* ifthen = (struct STMT_IF_THEN_ELSE*)pg_alloc(sizeof(struct STMT_IF_THEN_ELSE));
+    if (ifthen == NULL)
+      panic("out of memory (pg_alloc_stmt)");
+
+    ifthen->condition = NULL;
+    ifthen->true_path = NULL;
+    ifthen->false_path = NULL;
+    ifthen->next_stmt = NULL;
+
+    stmt->types.if_then_else = ifthen;
+  }
+  else if (stmt_type == STMT_WHILE_LOOP)
+  {
+    struct STMT_WHILE_LOOP* loop = (struct STMT_WHILE_LOOP*)pg_alloc(sizeof(struct STMT_WHILE_LOOP));
+    if (loop == NULL)
+      panic("out of memory (pg_alloc_stmt)");
+
+    loop->condition = NULL;
+    loop->loop_body = NULL;
+    loop->next_stmt = NULL;
+    loop->counter_slot = -1;
+    loop->counter_step = 0;
+
+    stmt->types.while_loop = loop;
+  }
+  else if (stmt_type == STMT_PASS)
+  {
+    struct STMT_PASS* pass = (struct STMT_PASS*)pg_alloc(sizeof(struct STMT_PASS));
+    if (pass == NULL)
+      panic("out of memory (pg_alloc_stmt)");
+
+    pass->next_stmt = NULL;
+
+    stmt->types.pass = pass;
+  }
+  else
+  {
+    panic("unexpected statement?! (pg_alloc_stmt)");
+  }
+
+  return stmt;
+}
+
+
+//
+// pg_get_next
+//
+// Returns the "next statement" link of the given statement; for a
+// while loop or an if this is the statement that follows it.
+//
+static struct STMT* pg_get_next(struct STMT* stmt)
+{
+  switch (stmt->stmt_type)
+  {
+    case STMT_ASSIGNMENT:
+      return stmt->types.assignment->next_stmt;
+    case STMT_FUNCTION_CALL:
+      return stmt->types.function_call->next_stmt;
+    case STMT_IF_THEN_ELSE:
+      return stmt->types.if_then_else->next_stmt;
+    case STMT_WHILE_LOOP:
+      return stmt->types.while_loop->next_stmt;
+    case STMT_PASS:
+      return stmt->types.pass->next_stmt;
+    default:
+      panic("unexpected statement?! (pg_get_next)");
+      return NULL;
+  }
+}
+
+
+static void pg_set_next(struct STMT* stmt, struct STMT* next);
+
+//
+// pg_set_last_next
+//
+// Links the last statement of the given (non-empty) list of
+// statements to next.
+//
+static void pg_set_last_next(struct STMT* first, struct STMT* next)
+{
+  struct STMT* last = first;
+
+  while (pg_get_next(last) != NULL)
+    last = pg_get_next(last);
+
+  pg_set_next(last, next);
+}
+
+
+//
+// pg_set_next
+//
+// Sets the "next statement" link of the given statement; for a while
+// loop this is the statement that follows the loop. For an if, the
+// last statement of each path is linked to next as well.
+//
+static void pg_set_next(struct STMT* stmt, struct STMT* next)
+{
+  switch (stmt->stmt_type)
+  {
+    case STMT_ASSIGNMENT:
+      stmt->types.assignment->next_stmt = next;
+      break;
+    case STMT_FUNCTION_CALL:
+      stmt->types.function_call->next_stmt = next;
+      break;
+    case STMT_IF_THEN_ELSE:
+    {
+      struct STMT_IF_THEN_ELSE* ifthen = stmt->types.if_then_else;
+
+      // an empty path (or a missing else) goes straight to next
+      if (ifthen->true_path == NULL)
+        ifthen->true_path = next;
+      else
+        pg_set_last_next(ifthen->true_path, next);
+
+      if (ifthen->false_path == NULL)
+        ifthen->false_path = next;
+      else
+        pg_set_last_next(ifthen->false_path, next);
+
+      ifthen->next_stmt = next;
+      break;
+    }
+    case STMT_WHILE_LOOP:
+      stmt->types.while_loop->next_stmt = next;
+      break;
+    case STMT_PASS:
+      stmt->types.pass->next_stmt = next;
+      break;
+    default:
+      panic("unexpected statement?! (pg_build_body)");
+  }
+}
+
+
+static struct STMT* pg_build_body(struct TOKEN_CURSOR* cur, int stop_token);
+
+//
+// pg_build_block
+//
+// Builds a { ... } block that follows the : at the end of an if,
+// elif, else or while line, returning its first statement.
+//
+static struct STMT* pg_build_block(struct TOKEN_CURSOR* cur)
+{
+  assert(tokenbuffer_peekToken(cur).id == nuPy_COLON);
+  tokenbuffer_dequeue(cur);  // :
+  tokenbuffer_dequeue(cur);  // EOLN
+
+  while (tokenbuffer_peekToken(cur).id == nuPy_EOLN)  // skip empty lines before {
+    tokenbuffer_dequeue(cur);
+
+  assert(tokenbuffer_peekToken(cur).id == nuPy_LEFT_BRACE);
+  tokenbuffer_dequeue(cur);  // {
+
+  struct STMT* first = pg_build_body(cur, nuPy_RIGHT_BRACE);
+
+  assert(tokenbuffer_peekToken(cur).id == nuPy_RIGHT_BRACE);
+  tokenbuffer_dequeue(cur);  // }
+  tokenbuffer_dequeue(cur);  // EOLN
+
+  return first;
+}
+
+
+//
+// pg_build_if
+//
+// Builds an if (or elif) statement, along with the elif / else
+// parts that follow it.
+//
+static struct STMT* pg_build_if(struct TOKEN_CURSOR* cur)
+{
+  struct STMT* stmt = pg_alloc_stmt(STMT_IF_THEN_ELSE, tokenbuffer_peekToken(cur).line);
+
+  struct STMT_IF_THEN_ELSE* ifthen = stmt->types.if_then_else;
+
+  tokenbuffer_dequeue(cur);  // if / elif
+
+  ifthen->condition = pg_build_expr(cur);
+  ifthen->true_path = pg_build_block(cur);
+
+  while (tokenbuffer_peekToken(cur).id == nuPy_EOLN)  // skip empty lines before elif / else
+    tokenbuffer_dequeue(cur);
+
+  if (tokenbuffer_peekToken(cur).id == nuPy_KEYW_ELIF)
+  {
+    ifthen->false_path = pg_build_if(cur);
+  }
+  else if (tokenbuffer_peekToken(cur).id == nuPy_KEYW_ELSE)
+  {
+    tokenbuffer_dequeue(cur);  // else
+
+    ifthen->false_path = pg_build_block(cur);
+  }
+
+  return stmt;
+}
+
+
+//
+// pg_build_body
+//
+// Builds the list of statements up to (but not including) the given
+// stop token, which is either $ for the program or } for a loop body.
+// Returns the first statement in the list; the last statement's next
+// link is left NULL for the caller to fill in.
+//
+static struct STMT* pg_build_body(struct TOKEN_CURSOR* cur, int stop_token)
+{
+  if (stop_token != nuPy_EOS && stop_token != nuPy_RIGHT_BRACE)
+    panic("invalid stop_token?! (pg_build_body)");
+
+  struct STMT* first = NULL;
+  struct STMT* prev = NULL;
+
+  while (tokenbuffer_peekToken(cur).id != stop_token)
+  {
+    struct STMT* stmt = NULL;
+    int line = tokenbuffer_peekToken(cur).line;
+
+    if (tokenbuffer_peekToken(cur).id == nuPy_EOLN)
+    {
+      //
+      // empty statement, skip:
+      //
+      tokenbuffer_dequeue(cur);
+      continue;
+    }
+    else if (tokenbuffer_peekToken(cur).id == nuPy_KEYW_PASS)
+    {
+      stmt = pg_alloc_stmt(STMT_PASS, line);
+
+      tokenbuffer_dequeue(cur);  // pass
+      tokenbuffer_dequeue(cur);  // EOLN
+    }
+    else if (tokenbuffer_peekToken(cur).id == nuPy_IDENTIFIER || tokenbuffer_peekToken(cur).id == nuPy_ASTERISK)
+    {
+      bool isPtrDeref = (tokenbuffer_peekToken(cur).id == nuPy_ASTERISK);
+
+      if (isPtrDeref)
+      {
+        tokenbuffer_dequeue(cur);
+        assert(tokenbuffer_peekToken(cur).id == nuPy_IDENTIFIER);
+      }
+
+      if (!isPtrDeref && tokenbuffer_peek2Token(cur).id == nuPy_LEFT_PAREN)
+      {
+        //
+        // function call, e.g. print(x):
+        //
+        stmt = pg_alloc_stmt(STMT_FUNCTION_CALL, line);
+
+        struct STMT_FUNCTION_CALL* call = stmt->types.function_call;
+
+        call->function_name = dupString(tokenbuffer_peekValue(cur));
+        tokenbuffer_dequeue(cur);  // identifier
+        tokenbuffer_dequeue(cur);  // (
+
+        if (tokenbuffer_peekToken(cur).id != nuPy_RIGHT_PAREN)
+        {
+          call->parameter = pg_build_element(cur);
+          tokenbuffer_dequeue(cur);
+        }
+
+        assert(tokenbuffer_peekToken(cur).id == nuPy_RIGHT_PAREN);
+        tokenbuffer_dequeue(cur);  // )
+      }
+      else
+      {
+        //
+        // assignment, e.g. x = 123 or *p = x + y:
+        //
+        stmt = pg_alloc_stmt(STMT_ASSIGNMENT, line);
+
+        struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+
+        assignment->isPtrDeref = isPtrDeref;
+        assignment->var_name = dupString(tokenbuffer_peekValue(cur));
+        tokenbuffer_dequeue(cur);  // identifier
+
+        assert(tokenbuffer_peekToken(cur).id == nuPy_EQUAL);
+        tokenbuffer_dequeue(cur);  // =
+
+        assignment->rhs = pg_build_value(cur);
+      }
+
+      tokenbuffer_dequeue(cur);  // EOLN
+    }
+    else if (tokenbuffer_peekToken(cur).id == nuPy_KEYW_IF)
+    {
+      stmt = pg_build_if(cur);
+    }
+    else if (tokenbuffer_peekToken(cur).id == nuPy_KEYW_WHILE)
+    {
+      stmt = pg_alloc_stmt(STMT_WHILE_LOOP, line);
+
+      struct STMT_WHILE_LOOP* loop = stmt->types.while_loop;
+
+      tokenbuffer_dequeue(cur);  // while
+
+      loop->condition = pg_build_expr(cur);
+      loop->loop_body = pg_build_block(cur);
+
+      //
+      // the last stmt in the body loops back to the while:
+      //
+      assert(loop->loop_body != NULL);
+
+      pg_set_last_next(loop->loop_body, stmt);
+    }
+    else
+    {
+      panic("unexpected statement?! (pg_build_body)");
+    }
+
+    //
+    // link into the list of statements:
+    //
+    if (first == NULL)
+      first = stmt;
+    else
+      pg_set_next(prev, stmt);
+
+    prev = stmt;
+  }
+
+  return first;
+}
+
+
+//
+// pg_print_element
+//
+static void pg_print_element(struct ELEMENT* element)
+{
+  if (element == NULL)
+    return;
+
+  if (element->element_type == ELEMENT_STR_LITERAL)
+    printf("'%s'", element->element_value);
+  else
+    printf("%s", element->element_value);
+}
+
+
+//
+// pg_print_unary_expr
+//
+static void pg_print_unary_expr(struct UNARY_EXPR* unary)
+{
+  switch (unary->expr_type)
+  {
+    case UNARY_PTR_DEREF:  putchar('*'); break;
+    case UNARY_ADDRESS_OF: putchar('&'); break;
+    case UNARY_PLUS:       putchar('+'); break;
+    case UNARY_MINUS:      putchar('-'); break;
+    default: break;
+  }
+
+  pg_print_element(unary->element);
+}
+
+
+//
+// pg_print_expr
+//
+static void pg_print_expr(struct EXPR* expr)
+{
+  pg_print_unary_expr(expr->lhs);
+
+  if (!expr->isBinaryExpr)
+    return;
+
+  switch (expr->operator)
+  {
+    case OPERATOR_PLUS:      printf(" + "); break;
+    case OPERATOR_MINUS:     printf(" - "); break;
+    case OPERATOR_ASTERISK:  printf(" * "); break;
+    case OPERATOR_POWER:     printf(" ** "); break;
+    case OPERATOR_MOD:       printf(" %% "); break;
+    case OPERATOR_DIV:       printf(" / "); break;
+    case OPERATOR_EQUAL:     printf(" == "); break;
+    case OPERATOR_NOT_EQUAL: printf(" != "); break;
+    case OPERATOR_LT:        printf(" < "); break;
+    case OPERATOR_LTE:       printf(" <= "); break;
+    case OPERATOR_GT:        printf(" > "); break;
+    case OPERATOR_GTE:       printf(" >= "); break;
+    case OPERATOR_IS:        printf(" is "); break;
+    case OPERATOR_IN:        printf(" in "); break;
+    default:
+      panic("unknown operator (pg_print_expr)");
+  }
+
+  pg_print_unary_expr(expr->rhs);
+}
+
+
+//
+// pg_print_value
+//
+static void pg_print_value(struct VALUE* value)
+{
+  if (value->value_type == VALUE_EXPR)
+  {
+    pg_print_expr(value->types.expr);
+    return;
+  }
+
+  assert(value->value_type == VALUE_FUNCTION_CALL);
+
+  printf("%s(", value->types.function_call->function_name);
+  pg_print_element(value->types.function_call->parameter);
+  putchar(')');
+}
+
+
+//
+// pg_print_body
+//
+// Prints the statements from stmt up to (but not including) the
+// given stop statement, indented by the given # of spaces.
+//
+static void pg_print_body(struct STMT* stmt, int indent, struct STMT* stop)
+{
+  while (stmt != stop)
+  {
+    for (int i = 0; i < indent; i++)
+      putchar(' ');
+
+    if (stmt->stmt_type == STMT_ASSIGNMENT)
+    {
+      struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+
+      if (assignment->isPtrDeref)
+        putchar('*');
+
+      printf("%s = ", assignment->var_name);
+      pg_print_value(assignment->rhs);
+      putchar('\n');
+
+      stmt = assignment->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_FUNCTION_CALL)
+    {
+      struct STMT_FUNCTION_CALL* call = stmt->types.function_call;
+
+      printf("%s(", call->function_name);
+      pg_print_element(call->parameter);
+      puts(")");
+
+      stmt = call->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_IF_THEN_ELSE)
+    {
+      struct STMT_IF_THEN_ELSE* ifthen = stmt->types.if_then_else;
+      struct STMT* next = ifthen->next_stmt;
+
+      printf("if ");
+
+      while (true)
+      {
+        pg_print_expr(ifthen->condition);
+        puts(":");
+
+        for (int i = 0; i < indent; i++)
+          putchar(' ');
+        puts("{");
+
+        pg_print_body(ifthen->true_path, indent + 2, next);
+
+        for (int i = 0; i < indent; i++)
+          putchar(' ');
+        puts("}");
+
+        struct STMT* false_path = ifthen->false_path;
+
+        if (false_path == next)
+          break;
+
+        for (int i = 0; i < indent; i++)
+          putchar(' ');
+
+        if (false_path->stmt_type == STMT_IF_THEN_ELSE &&
+          false_path->types.if_then_else->next_stmt == next)
+        {
+          printf("elif ");
+          ifthen = false_path->types.if_then_else;
+          continue;
+        }
+
+        puts("else:");
+
+        for (int i = 0; i < indent; i++)
+          putchar(' ');
+        puts("{");
+
+        pg_print_body(false_path, indent + 2, next);
+
+        for (int i = 0; i < indent; i++)
+          putchar(' ');
+        puts("}");
+        break;
+      }
+
+      stmt = next;
+    }
+    else if (stmt->stmt_type == STMT_WHILE_LOOP)
+    {
+      struct STMT_WHILE_LOOP* loop = stmt->types.while_loop;
+
+      printf("while ");
+      pg_print_expr(loop->condition);
+      puts(":");
+
+      for (int i = 0; i < indent; i++)
+        putchar(' ');
+      puts("{");
+
+      pg_print_body(loop->loop_body, indent + 2, stmt);
+
+      for (int i = 0; i < indent; i++)
+        putchar(' ');
+      puts("}");
+
+      stmt = loop->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_PASS)
+    {
+      puts("pass");
+
+      stmt = stmt->types.pass->next_stmt;
+    }
+    else
+    {
+      panic("unknown type of statement?! (programgraph_print)");
+    }
+  }
+}
+
+
+//
+// Public functions:
+//
+
+//
+// programgraph_build
+//
+// Given a legal nuPython program in the form of a buffer
+// of tokens (see tokenbuffer.h), builds and returns a program graph
+// representing the nuPython program.
+//
+struct STMT* programgraph_build(struct TOKEN_BUFFER* tokens)
+{
+  if (tokens == NULL)
+    panic("tokens is NULL (programgraph_build)");
+
+  struct TOKEN_CURSOR cursor = tokenbuffer_cursor(tokens);
+  struct TOKEN_CURSOR* cur = &cursor;
+
+  building = (struct PG_ARENA*)malloc(sizeof(struct PG_ARENA));
+  if (building == NULL)
+    panic("out of memory (programgraph_build)");
+
+  building->blocks = NULL;
+
+  struct STMT* program = pg_build_body(cur, nuPy_EOS);
+
+  if (tokenbuffer_peekToken(cur).id != nuPy_EOS)
+    panic("expecting $ at the end of the program tokens?! (programgraph_build)");
+
+  //
+  // the graph's arena is found again from its nodes; an empty
+  // program has none:
+  //
+  if (program == NULL)
+  {
+    pg_free_arena(building);
+  }
+  else
+  {
+    building->next = arenas;
+    arenas = building;
+  }
+
+  building = NULL;
+
+  return program;
+}
+
+
+//
+// programgraph_destroy
+//
+// Frees all the memory with in given program graph, by freeing
+// its arena.
+//
+void programgraph_destroy(struct STMT* program)
+{
+  if (program == NULL)
+    return;
+
+  struct PG_ARENA* arena = pg_find_arena(program);
+  if (arena == NULL)
+    panic("program is not a live program graph (programgraph_destroy)");
+
+  struct PG_ARENA** link = &arenas;
+  while (*link != arena)
+    link = &(*link)->next;
+
+  *link = arena->next;
+
+  pg_free_arena(arena);
+}
+
+
+//
+// programgraph_alloc
+//
+// Allocates size bytes in the arena of the graph holding the given
+// node; see programgraph.h.
+//
+void* programgraph_alloc(const void* node, size_t size)
+{
+  struct PG_ARENA* arena = pg_find_arena(node);
+  if (arena == NULL)
+    panic("node is not in a live program graph (programgraph_alloc)");
+
+  return pg_arena_alloc(arena, size);
+}
+
+
+//
+// programgraph_strdup
+//
+// Copies the given string into the arena of the graph holding the
+// given node; see programgraph.h.
+//
+char* programgraph_strdup(const void* node, const char* s)
+{
+  char* copy = (char*)programgraph_alloc(node, strlen(s) + 1);
+
+  if (copy != NULL)
+    strcpy(copy, s);
+
+  return copy;
+}
+
+
+//
+// programgraph_print
+//
+// Prints the contents of the program graph to the console.
+//
+void programgraph_print(struct STMT* program)
+{
+  printf("**PROGRAM GRAPH PRINT**\n");
+
+  pg_print_body(program, 0, NULL);
+
+  printf("$\n");
+  printf("**END PRINT**\n");
+}
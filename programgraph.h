@@ -11,7 +11,10 @@
 #pragma once
 
 #include <stdbool.h>     // true, false
-#include "tokenqueue.h"
+#include <stddef.h>      // size_t
+#include "tokenbuffer.h"
+
+struct RAM_VALUE;  // see ram.h
 
 
 //
@@ -38,6 +41,12 @@ struct STMT
   int stmt_type;  // enum STMT_TYPES
   int line;       // what line # does it start on?
 
+  //
+  // true if the statement was proven never to fail (see validate.h),
+  // so it can be run without any error checks
+  //
+  bool safe;
+
   //
   // pointer to that stmt struct:
   //
@@ -58,6 +67,7 @@ struct STMT_ASSIGNMENT
   //           *p = x + y
   //
   char* var_name;
+  int   slot;        // RAM slot of var_name (see resolve.h)
   bool  isPtrDeref;
   struct VALUE* rhs;  // rhs = "right-hand side"
 
@@ -71,6 +81,7 @@ struct STMT_FUNCTION_CALL
   //           print("the output is")
   //
   char* function_name;
+  int   builtin;                // enum BUILTINS (see resolve.h)
   struct ELEMENT* parameter;  // optional => could be NULL
 
   struct STMT* next_stmt;
@@ -86,9 +97,15 @@ struct STMT_IF_THEN_ELSE
   //          else:
   //          { ... }
   //
-  struct VALUE_EXPR* condition;
+  // An elif is an if statement on the false path. Both paths end by
+  // linking to next_stmt, which is also the false path if there is no
+  // else; an empty path (e.g. once pass is optimized away) is just
+  // next_stmt itself.
+  //
+  struct EXPR* condition;
   struct STMT* true_path;  // next stmt if the condition is true
   struct STMT* false_path; // next stmt if the condition is false
+  struct STMT* next_stmt;  // next stmt after the if, where the paths join
 };
 
 struct STMT_WHILE_LOOP
@@ -100,6 +117,14 @@ struct STMT_WHILE_LOOP
   struct EXPR* condition;
   struct STMT* loop_body; // loop body if the condition is true
   struct STMT* next_stmt; // next stmt after the loop is over
+
+  //
+  // induction variable, found by the optimizer (see optimize.h): the
+  // slot of a counter i tested by the condition and updated only by
+  // one i = i + step in the body, or -1 if the loop has none
+  //
+  int counter_slot;
+  int counter_step;
 };
 
 struct STMT_PASS
@@ -140,6 +165,7 @@ struct VALUE
 struct FUNCTION_CALL
 {
   char* function_name;
+  int   builtin;                // enum BUILTINS (see resolve.h)
   struct ELEMENT* parameter;  // optional => could be NULL
 };
 
@@ -151,6 +177,20 @@ struct EXPR
 
   int    operator;        // enum OPERATORS
   struct UNARY_EXPR* rhs; // optional => could be NULL
+
+  //
+  // inline cache, filled in at run-time: the operand types seen the
+  // last time this expression was computed (see execute.h)
+  //
+  int    cache_key;       // OP_CACHE_KEY(lhs type, rhs type), 0 => empty
+
+  //
+  // static types, proven by the type inference pass (see typeinfer.h):
+  // the type of the result and OP_CACHE_KEY(lhs type, rhs type) if
+  // both operand types are proven, otherwise -1 and 0
+  //
+  int    type;            // enum RAM_TYPES, or -1 => dynamic
+  int    proven_key;      // OP_CACHE_KEY(lhs type, rhs type), 0 => dynamic
 };
 
 enum UNARY_EXPR_TYPES
@@ -201,6 +241,20 @@ struct ELEMENT
   // underlying element (identifier or literal):
   //
   char* element_value;  // e.g. "x" or "123" or "3.14" or "this is a string"
+
+  int slot;  // identifiers: RAM slot (see resolve.h), otherwise -1
+
+  //
+  // literals: the value, decoded once by the resolution pass (see
+  // resolve.h), otherwise NULL
+  //
+  struct RAM_VALUE* constant;
+
+  //
+  // the type of the element's value wherever it is evaluated, proven
+  // by the type inference pass (see typeinfer.h), or -1 if dynamic
+  //
+  int type;  // enum RAM_TYPES, or -1
 };
 
 
@@ -234,8 +288,8 @@ enum OPERATORS
 //
 // programgraph_build
 //
-// Given a legal nuPython program in the form of a list
-// of tokens, builds and returns a program graph
+// Given a legal nuPython program in the form of a buffer
+// of tokens (see tokenbuffer.h), builds and returns a program graph
 // representing the nuPython program. This is easier
 // to work with than the raw tokens. 
 //
@@ -248,15 +302,30 @@ enum OPERATORS
 // (it could also be done using a pre-execution pass 
 // through the graph).
 //
-struct STMT* programgraph_build(struct TokenQueue* tokens);
+struct STMT* programgraph_build(struct TOKEN_BUFFER* tokens);
 
 //
 // programgraph_destroy
 //
-// Frees all the memory with in given program graph.
+// Frees all the memory with in given program graph. Every node
+// of a graph lives in one arena, laid out in program order, so
+// the graph is freed in bulk; program may be any statement of
+// the graph, but it's normally the first one as built.
 //
 void programgraph_destroy(struct STMT* program);
 
+//
+// programgraph_alloc / programgraph_strdup
+//
+// Allocates memory for a new node (or string) in the arena of
+// the graph holding the given node, e.g. when an optimization
+// pass rewrites the graph. The memory is freed along with the
+// graph; nodes unlinked from the graph are not freed one at a
+// time. Returns NULL if memory could not be allocated.
+//
+void* programgraph_alloc(const void* node, size_t size);
+char* programgraph_strdup(const void* node, const char* s);
+
 //
 // programgraph_print
 //
@@ -17,6 +17,8 @@
 // CS 211
 //
 
+#define _POSIX_C_SOURCE 200809L  // strdup
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h> // true, false
@@ -26,10 +28,115 @@
 #include "ram.h"
 
 
+//
+// Private functions:
+//
+
+//
+// find_bucket
+//
+// Probes the hash index (linear probing) for the given identifier. Returns
+// the bucket holding its address if the identifier is in memory, otherwise
+// the empty bucket where it would be inserted.
+//
+static int find_bucket(struct RAM* memory, const char* identifier)
+{
+	int mask = memory->index_capacity - 1;
+	int bucket = ram_hash_bucket(identifier, memory->index_capacity);
+
+	// load is kept <= 1/2, so we always hit an empty bucket eventually
+	while (memory->index[bucket] != -1) {
+		int addr = memory->index[bucket];
+		if (strcmp(memory->cells[addr].identifier, identifier) == 0) {
+			return bucket;
+		}
+		bucket = (bucket + 1) & mask;
+	}
+
+	return bucket;
+}
+
+
+//
+// rebuild_index
+//
+// Reallocates the hash index with the given # of buckets (a power of 2)
+// and re-inserts every cell currently in memory. Returns false if the
+// allocation fails, in which case the old index is left untouched.
+//
+static bool rebuild_index(struct RAM* memory, int buckets)
+{
+	int* new_index = (int*)malloc(buckets * sizeof(int));
+	if (new_index == NULL) {
+		return false;
+	}
+
+	for (int i = 0; i < buckets; i++) {
+		new_index[i] = -1;
+	}
+
+	free(memory->index);
+	memory->index = new_index;
+	memory->index_capacity = buckets;
+
+	// addresses never change, so just hash each cell into its new bucket
+	for (int addr = 0; addr < memory->num_values; addr++) {
+		int bucket = find_bucket(memory, memory->cells[addr].identifier);
+		memory->index[bucket] = addr;
+	}
+
+	return true;
+}
+
+
+//
+// reserve_cells
+//
+// Reallocates the cells so that the given # of cells are available,
+// initializing the new ones to None. Returns false if the allocation
+// fails.
+//
+static bool reserve_cells(struct RAM* memory, int reserved)
+{
+	struct RAM_CELL* new_cells = (struct RAM_CELL*)realloc(memory->cells, reserved * sizeof(struct RAM_CELL));
+	if (new_cells == NULL) {
+		return false;
+	}
+
+	memory->cells = new_cells;
+
+	// initialize all new cells to default values of None
+	for (int i = memory->reserved; i < reserved; i++) {
+		memory->cells[i].identifier = NULL;
+		memory->cells[i].value.value_type = RAM_TYPE_NONE;
+	}
+
+	memory->reserved = reserved;
+	return true;
+}
+
+
 //
 // Public functions:
 //
 
+//
+// ram_hash_bucket
+//
+// FNV-1a hash of the given identifier, masked to the index.
+//
+int ram_hash_bucket(const char* identifier, int index_capacity)
+{
+	unsigned int hash = 2166136261u;
+
+	for (const unsigned char* c = (const unsigned char*)identifier; *c != '\0'; c++) {
+		hash ^= *c;
+		hash *= 16777619u;
+	}
+
+	return (int)(hash & (unsigned int)(index_capacity - 1));
+}
+
 //
 // ram_init
 //
@@ -48,6 +155,9 @@ struct RAM* ram_init(void)
 	// initial RAM field values
 	memory->num_values = 0;
 	memory->capacity = 4;
+	memory->reserved = memory->capacity;
+	memory->slots = NULL;
+	memory->num_slots = 0;
 
 	// allocate memory for variable cells/array
 	memory->cells = (struct RAM_CELL*)malloc(memory->capacity * sizeof(struct RAM_CELL));
@@ -62,6 +172,16 @@ struct RAM* ram_init(void)
 		memory->cells[i].value.value_type = RAM_TYPE_NONE;
 	}
 
+	// empty hash index, twice as many buckets as cells
+	memory->index = NULL;
+	memory->index_capacity = 0;
+
+	if (!rebuild_index(memory, 2 * memory->capacity)) {
+		free(memory->cells);
+		free(memory);
+		return NULL;
+	}
+
 	return memory;
 }
 
@@ -79,7 +199,7 @@ void ram_destroy(struct RAM* memory)
 		return; 	// aka nothing to free
 	}
 
-	for (int i = 0; i < memory->capacity; i++) {
+	for (int i = 0; i < memory->reserved; i++) {
 		// for each var in cells, free it so long as it is not NULL
 		// question: do we have to set the identifier to NULL after freeing it?
 		if (memory->cells[i].identifier != NULL) {
@@ -87,11 +207,8 @@ void ram_destroy(struct RAM* memory)
 			memory->cells[i].identifier = NULL;
 		}
 
-		// need to free allocated strings since they are duplicated
-		if (memory->cells[i].value.value_type == RAM_TYPE_STR && memory->cells[i].value.types.s != NULL) {
-			free(memory->cells[i].value.types.s);
-			memory->cells[i].value.types.s = NULL;
-		}
+		// drop memory's reference to any string
+		ram_value_release(&memory->cells[i].value);
 	}
 
 	// free the array of cells
@@ -100,6 +217,13 @@ void ram_destroy(struct RAM* memory)
 		memory->cells = NULL;
 	}
 
+	// free the hash index and slot bindings
+	free(memory->index);
+	memory->index = NULL;
+
+	free(memory->slots);
+	memory->slots = NULL;
+
 	// free the actual RAM struct
 	free(memory);
 }
@@ -125,17 +249,9 @@ int ram_get_addr(struct RAM* memory, char* identifier)
 		return -1;
 	}
 
-	// we want to loop through our memory cell array and see if any of the identifiers match
-	// the address we return is basically the index within the cell array, since the addr
-	// must be within the range [0, N-1], where N = # of vals stored in memory
-	for (int i = 0; i < memory->num_values; i++) {
-		if (strcmp(memory->cells[i].identifier, identifier) == 0 && memory->cells[i].identifier != NULL) {
-			return i;
-		}
-	}
-
-	// identifier not found
-	return -1;
+	// the hash index maps the identifier to its address, which is basically the index
+	// within the cell array --- an empty bucket (-1) means the identifier is not found
+	return memory->index[find_bucket(memory, identifier)];
 }
 
 
@@ -147,8 +263,9 @@ int ram_get_addr(struct RAM* memory, char* identifier)
 // Returns NULL if the address is not valid.
 //
 // NOTE: this function allocates memory for the value that
-// is returned. The caller takes ownership of the copy and 
-// must eventually free this memory via ram_free_value().
+// is returned. The caller takes ownership of the copy (and
+// of a reference to its string, if any) and must eventually
+// free this memory via ram_free_value().
 //
 // NOTE: a variable has to be written to memory before its
 // address becomes valid. Once a variable is written to memory,
@@ -181,15 +298,9 @@ struct RAM_VALUE* ram_read_cell_by_addr(struct RAM* memory, int address)
 			break;
 
 		case RAM_TYPE_STR:
-			if (memory->cells[address].value.types.s != NULL) {
-				copy->types.s = strdup(memory->cells[address].value.types.s);
-				if (copy->types.s == NULL) {
-					free(copy);  // strdup fails
-					return NULL;
-				}
-			} else {
-				copy->types.s = NULL;
-			}
+			// strings are immutable, so the copy just shares it
+			copy->types.s = memory->cells[address].value.types.s;
+			ram_value_retain(copy);
 			break;
 
 		case RAM_TYPE_NONE:
@@ -205,6 +316,25 @@ struct RAM_VALUE* ram_read_cell_by_addr(struct RAM* memory, int address)
 }
 
 
+//
+// ram_borrow_cell_by_addr
+//
+// Given a memory address (an integer in the range 0..N-1),
+// returns a pointer to the value contained in that memory cell,
+// or NULL if the address is not valid. Nothing is allocated: the
+// value is only valid until the next write to memory.
+//
+const struct RAM_VALUE* ram_borrow_cell_by_addr(struct RAM* memory, int address)
+{
+	// nothing to search OR address is out of range
+	if (memory == NULL || address < 0 || address >= memory->num_values) {
+		return NULL;
+	}
+
+	return &memory->cells[address].value;
+}
+
+
 // 
 // ram_read_cell_by_name
 //
@@ -240,7 +370,7 @@ struct RAM_VALUE* ram_read_cell_by_name(struct RAM* memory, char* name)
 // ram_free_value
 //
 // Frees the memory value returned by ram_read_cell_by_name and
-// ram_read_cell_by_addr.
+// ram_read_cell_by_addr, releasing its string (if any).
 //
 void ram_free_value(struct RAM_VALUE* value)
 {
@@ -249,11 +379,8 @@ void ram_free_value(struct RAM_VALUE* value)
 		return;
 	}
 
-	// if value is a string, we need to free its duplicate
-	if (value->value_type == RAM_TYPE_STR && value->types.s != NULL) {
-		free(value->types.s);
-		value->types.s = NULL;
-	}
+	// if value is a string, drop the copy's reference
+	ram_value_release(value);
 
 	// free value itself
 	free(value);
@@ -269,8 +396,8 @@ void ram_free_value(struct RAM_VALUE* value)
 // the value was successfully written, false if not (which 
 // implies the memory address is invalid).
 // 
-// NOTE: if the value being written is a string, it will
-// be duplicated and stored.
+// NOTE: if the value being written is a string, memory adds
+// its own reference to it; the caller keeps its reference.
 // 
 // NOTE: a variable has to be written to memory before its
 // address becomes valid. Once a variable is written to memory,
@@ -279,17 +406,18 @@ void ram_free_value(struct RAM_VALUE* value)
 bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int address)
 {
 	// nothing to write/can't write var & check validity of address
-	if (memory == NULL || address < 0 || address >= memory->num_values || &value == NULL ) {
+	if (memory == NULL || address < 0 || address >= memory->num_values) {
 		return false;
 	}
 
 	struct RAM_CELL* cell = &memory->cells[address];
 
+	// reference a new string BEFORE getting rid of the existing one, since
+	// the value may have been borrowed from this very cell
+	ram_value_retain(&value);
+
 	// geet rid of existing data if a string is there
-	if (cell->value.value_type == RAM_TYPE_STR && cell->value.types.s != NULL) {
-		free(cell->value.types.s);
-		cell->value.types.s = NULL;
-	}
+	ram_value_release(&cell->value);
 
 	cell->value.value_type = value.value_type;
 
@@ -305,14 +433,7 @@ bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int addr
 			break;
 
 		case RAM_TYPE_STR:
-			if (value.types.s != NULL) {
-				cell->value.types.s = strdup(value.types.s);
-			if (cell->value.types.s == NULL) {
-				return false;  // strdup failed
-			}
-			} else {
-				cell->value.types.s = NULL;
-			}
+			cell->value.types.s = value.types.s;
 			break;
 
 		case RAM_TYPE_NONE:
@@ -320,6 +441,7 @@ bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int addr
 			break;
 
 		default:
+			cell->value.value_type = RAM_TYPE_NONE;
 			return false;  // unknown var type
 	}
 	return true;
@@ -334,8 +456,8 @@ bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int addr
 // existing value is overwritten by the given value. Returns
 // true since this operation always succeeds.
 // 
-// NOTE: if the value being written is a string, it will
-// be duplicated and stored.
+// NOTE: if the value being written is a string, memory adds
+// its own reference to it; the caller keeps its reference.
 // 
 // NOTE: a variable has to be written to memory before its
 // address becomes valid. Once a variable is written to memory,
@@ -344,13 +466,14 @@ bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int addr
 bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* name)
 {
 	// nothing to write/invalid name
-	if (memory == NULL || name == NULL || &value == NULL) {
+	if (memory == NULL || name == NULL) {
 		return false;
 	}
 
 	// try to get address of var based on name
 	// if we get it, just use other function
-	int addr = ram_get_addr(memory, name);
+	int bucket = find_bucket(memory, name);
+	int addr = memory->index[bucket];
 	if (addr != -1) {
 		return ram_write_cell_by_addr(memory, value, addr);
 	}
@@ -359,19 +482,25 @@ bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* na
 	// are we at capacity?
 	if (memory->num_values >= memory->capacity) {
 		int new_cap = memory->capacity * 2;
-		struct RAM_CELL* new_cells = (struct RAM_CELL*)realloc(memory->cells, new_cap * sizeof(struct RAM_CELL));
-		if (new_cells == NULL) {
-			return false; 	// reallocation of memory failed somehow
+
+		// only reallocate if the cells were not already reserved
+		if (new_cap > memory->reserved) {
+			if (!reserve_cells(memory, new_cap)) {
+				return false; 	// reallocation of memory failed somehow
+			}
 		}
 
-		memory->cells = new_cells;
 		memory->capacity = new_cap;
 
-		// initialize all new cells to default values of None
-		for (int i = memory->num_values; i < memory->capacity; i++) {
-			memory->cells[i].identifier = NULL;
-			memory->cells[i].value.value_type = RAM_TYPE_NONE;
+		// grow the hash index along with the cells
+		if (memory->index_capacity < 2 * memory->capacity) {
+			if (!rebuild_index(memory, 2 * memory->capacity)) {
+				return false;
+			}
 		}
+
+		// buckets may have moved, so find where the new identifier goes
+		bucket = find_bucket(memory, name);
 	}
 
 	// initialize the new cell
@@ -396,16 +525,8 @@ bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* na
 			break;
 
 		case RAM_TYPE_STR:
-			if (value.types.s != NULL) {
-				cell->value.types.s = strdup(value.types.s);
-			if (cell->value.types.s == NULL) {
-				free(cell->identifier);  // free if fails
-				cell->identifier = NULL;
-				return false;  
-			}
-			} else {
-				cell->value.types.s = NULL;
-			}
+			cell->value.types.s = value.types.s;
+			ram_value_retain(&cell->value);
 			break;
 
 		case RAM_TYPE_NONE:
@@ -417,11 +538,221 @@ bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* na
 			cell->identifier = NULL;
 			return false; 
 	}
+	memory->index[bucket] = memory->num_values;
 	memory->num_values++;
 	return true;
 }
 
 
+//
+// ram_reserve_slots
+//
+// Pre-sizes memory for a program whose identifiers were resolved to
+// the given # of slots, so that writing all of them never has to
+// reallocate the cells. Slots already bound keep their addresses.
+//
+bool ram_reserve_slots(struct RAM* memory, int num_slots)
+{
+	if (memory == NULL || num_slots < 0) {
+		return false;
+	}
+
+	// grow the slot bindings, new slots are not yet written
+	if (num_slots > memory->num_slots) {
+		int* new_slots = (int*)realloc(memory->slots, num_slots * sizeof(int));
+		if (new_slots == NULL) {
+			return false;
+		}
+
+		for (int i = memory->num_slots; i < num_slots; i++) {
+			new_slots[i] = -1;
+		}
+
+		memory->slots = new_slots;
+		memory->num_slots = num_slots;
+	}
+
+	// reserve what capacity would grow to (it doubles), so the cells
+	// never move while the program runs
+	int reserved = memory->reserved;
+	while (reserved < num_slots) {
+		reserved *= 2;
+	}
+
+	if (reserved > memory->reserved) {
+		if (!reserve_cells(memory, reserved)) {
+			return false;
+		}
+		if (!rebuild_index(memory, 2 * reserved)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+//
+// ram_get_addr_by_slot
+//
+// Returns the address of the variable bound to the given slot, or
+// -1 if that variable has not been written to memory yet.
+//
+int ram_get_addr_by_slot(struct RAM* memory, int slot)
+{
+	if (memory == NULL || slot < 0 || slot >= memory->num_slots) {
+		return -1;
+	}
+
+	return memory->slots[slot];
+}
+
+
+//
+// ram_read_cell_by_slot
+//
+// If the variable bound to the given slot has been written to
+// memory, returns a COPY of its value; otherwise returns NULL.
+//
+struct RAM_VALUE* ram_read_cell_by_slot(struct RAM* memory, int slot)
+{
+	int addr = ram_get_addr_by_slot(memory, slot);
+
+	// make sure its a valid address
+	if (addr == -1) {
+		return NULL;
+	}
+
+	return ram_read_cell_by_addr(memory, addr);
+}
+
+
+//
+// ram_borrow_cell_by_slot
+//
+// If the variable bound to the given slot has been written to
+// memory, returns a pointer to its value (NOT a copy), otherwise
+// NULL. The value is only valid until the next write to memory.
+//
+const struct RAM_VALUE* ram_borrow_cell_by_slot(struct RAM* memory, int slot)
+{
+	return ram_borrow_cell_by_addr(memory, ram_get_addr_by_slot(memory, slot));
+}
+
+
+//
+// ram_write_cell_by_slot
+//
+// Writes the given value to the variable bound to the given slot,
+// adding a cell named by the given name on the first write.
+//
+bool ram_write_cell_by_slot(struct RAM* memory, struct RAM_VALUE value, int slot, char* name)
+{
+	if (memory == NULL || slot < 0) {
+		return false;
+	}
+
+	// common case: slot already bound to an address
+	if (slot < memory->num_slots && memory->slots[slot] != -1) {
+		return ram_write_cell_by_addr(memory, value, memory->slots[slot]);
+	}
+
+	// make sure there is a binding for this slot
+	if (slot >= memory->num_slots && !ram_reserve_slots(memory, slot + 1)) {
+		return false;
+	}
+
+	// first write, add the cell by name and remember its address
+	if (!ram_write_cell_by_name(memory, value, name)) {
+		return false;
+	}
+
+	memory->slots[slot] = ram_get_addr(memory, name);
+	return true;
+}
+
+
+//
+// ram_str_alloc
+//
+// Returns a new string of the given length with a refcount of 1,
+// '\0'-terminated but otherwise uninitialized. Returns NULL if
+// memory could not be allocated.
+//
+struct RAM_STR* ram_str_alloc(int length)
+{
+	if (length < 0) {
+		return NULL;
+	}
+
+	struct RAM_STR* str = (struct RAM_STR*)malloc(sizeof(struct RAM_STR) + length + 1);
+	if (str == NULL) {
+		return NULL;
+	}
+
+	str->refcount = 1;
+	str->length = length;
+	str->chars[length] = '\0';
+
+	return str;
+}
+
+
+//
+// ram_str_new
+//
+// Returns a new string (refcount 1) holding a copy of the given
+// C string, or NULL if memory could not be allocated.
+//
+struct RAM_STR* ram_str_new(const char* chars)
+{
+	int length = (int)strlen(chars);
+
+	struct RAM_STR* str = ram_str_alloc(length);
+	if (str == NULL) {
+		return NULL;
+	}
+
+	memcpy(str->chars, chars, length);
+	return str;
+}
+
+
+//
+// ram_value_retain
+//
+// If the given value is a string, adds a reference to it.
+//
+void ram_value_retain(struct RAM_VALUE* value)
+{
+	if (value->value_type == RAM_TYPE_STR && value->types.s != NULL) {
+		value->types.s->refcount++;
+	}
+}
+
+
+//
+// ram_value_release
+//
+// If the given value is a string, drops its reference and frees
+// the string once nothing refers to it. Leaves the value as None.
+//
+void ram_value_release(struct RAM_VALUE* value)
+{
+	if (value->value_type != RAM_TYPE_STR) {
+		return;
+	}
+
+	struct RAM_STR* str = value->types.s;
+	if (str != NULL && --str->refcount == 0) {
+		free(str);
+	}
+
+	value->value_type = RAM_TYPE_NONE;
+	value->types.s = NULL;
+}
+
+
 //
 // ram_print
 //
@@ -429,8 +760,6 @@ bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* na
 //
 void ram_print(struct RAM* memory)
 {
-	printf("**MEMORY PRINT**\n");
-
 	if (memory == NULL) {
 		printf("**MEMORY PRINT**\n");
 		printf("Memory is NULL\n");
@@ -463,7 +792,7 @@ void ram_print(struct RAM* memory)
 				break;
 			case RAM_TYPE_STR:
 				if (cell->value.types.s != NULL) {
-					printf("str, '%s'", cell->value.types.s);
+					printf("str, '%s'", cell->value.types.s->chars);
 				} else {
 					printf("str, <null>");
 				}
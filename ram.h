@@ -26,6 +26,18 @@ enum RAM_VALUE_TYPES
   RAM_TYPE_NONE
 };
 
+//
+// Strings are immutable and reference-counted, so copying a string
+// value only bumps a counter. Every RAM_VALUE holding a string owns
+// one reference (see ram_value_retain / ram_value_release).
+//
+struct RAM_STR
+{
+  int  refcount;  // # of references; freed when this drops to 0
+  int  length;    // # of chars, not including the '\0'
+  char chars[];   // '\0'-terminated
+};
+
 struct RAM_VALUE
 {
   //
@@ -40,7 +52,7 @@ struct RAM_VALUE
   {
     int    i; // INT, PTR, BOOLEAN
     double d; // REAL
-    char*  s; // STR 
+    struct RAM_STR* s; // STR
   } types;
 };
 
@@ -55,6 +67,23 @@ struct RAM
   struct RAM_CELL* cells;  // array of memory cells
   int num_values;  // # of values currently stored in memory
   int capacity;    // total # of cells available in memory
+
+  //
+  // open-addressing hash index over the identifiers in cells:
+  // each bucket holds the address of a cell, or -1 if empty.
+  // The index grows along with cells so the load stays <= 1/2.
+  //
+  int* index;
+  int  index_capacity;  // # of buckets (always a power of 2)
+
+  //
+  // slot bindings (see resolve.h): slots[i] is the address of the
+  // variable resolved to slot i, or -1 if it has not been written.
+  //
+  int* slots;
+  int  num_slots;
+
+  int reserved;  // # of cells actually allocated (>= capacity)
 };
 
 
@@ -103,8 +132,9 @@ int ram_get_addr(struct RAM* memory, char* identifier);
 // Returns NULL if the address is not valid.
 //
 // NOTE: this function allocates memory for the value that
-// is returned. The caller takes ownership of the copy and 
-// must eventually free this memory via ram_free_value().
+// is returned. The caller takes ownership of the copy (and
+// of a reference to its string, if any) and must eventually
+// free this memory via ram_free_value().
 //
 // NOTE: a variable has to be written to memory before its
 // address becomes valid. Once a variable is written to memory,
@@ -112,6 +142,21 @@ int ram_get_addr(struct RAM* memory, char* identifier);
 //
 struct RAM_VALUE* ram_read_cell_by_addr(struct RAM* memory, int address);
 
+//
+// ram_borrow_cell_by_addr
+//
+// Given a memory address (an integer in the range 0..N-1),
+// returns a pointer to the value contained in that memory cell
+// --- NOT a copy. Returns NULL if the address is not valid.
+//
+// NOTE: the value is borrowed from memory, so no memory is
+// allocated and the caller must not modify or free it. The
+// pointer (and any string it refers to) is only valid until
+// the next write to memory; use ram_read_cell_by_addr() for
+// a copy that outlives writes.
+//
+const struct RAM_VALUE* ram_borrow_cell_by_addr(struct RAM* memory, int address);
+
 // 
 // ram_read_cell_by_name
 //
@@ -129,7 +174,7 @@ struct RAM_VALUE* ram_read_cell_by_name(struct RAM* memory, char* name);
 // ram_free_value
 //
 // Frees the memory value returned by ram_read_cell_by_name and
-// ram_read_cell_by_addr.
+// ram_read_cell_by_addr, releasing its string (if any).
 //
 void ram_free_value(struct RAM_VALUE* value);
 
@@ -142,8 +187,10 @@ void ram_free_value(struct RAM_VALUE* value);
 // the value was successfully written, false if not (which 
 // implies the memory address is invalid).
 // 
-// NOTE: if the value being written is a string, it will
-// be duplicated and stored.
+// NOTE: if the value being written is a string, memory adds
+// its own reference to it; the caller keeps its reference.
+// The value may be one borrowed from memory, even from the
+// cell being overwritten.
 // 
 // NOTE: a variable has to be written to memory before its
 // address becomes valid. Once a variable is written to memory,
@@ -159,8 +206,8 @@ bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int addr
 // existing value is overwritten by this new value. Returns
 // true since this operation always succeeds.
 // 
-// NOTE: if the value being written is a string, it will
-// be duplicated and stored.
+// NOTE: if the value being written is a string, memory adds
+// its own reference to it; the caller keeps its reference.
 // 
 // NOTE: a variable has to be written to memory before its
 // address becomes valid. Once a variable is written to memory,
@@ -168,6 +215,104 @@ bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int addr
 //
 bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* name);
 
+//
+// ram_reserve_slots
+//
+// Pre-sizes memory for a program whose identifiers were resolved to
+// the given # of slots (see resolve.h), so that writing all of them
+// never has to reallocate the cells. Slots already bound keep their
+// addresses. Returns false if memory could not be allocated.
+//
+// NOTE: the reported capacity still grows as variables are written,
+// exactly as it would without the reservation.
+//
+bool ram_reserve_slots(struct RAM* memory, int num_slots);
+
+//
+// ram_hash_bucket
+//
+// Returns the bucket the given identifier hashes to in an open-addressing
+// index of the given # of buckets (a power of 2). Shared by RAM's name
+// index and the slot table's (see resolve.h), so the two probe alike.
+//
+int ram_hash_bucket(const char* identifier, int index_capacity);
+
+//
+// ram_get_addr_by_slot
+//
+// Returns the address of the variable bound to the given slot, or
+// -1 if that variable has not been written to memory yet.
+//
+int ram_get_addr_by_slot(struct RAM* memory, int slot);
+
+//
+// ram_read_cell_by_slot
+//
+// If the variable bound to the given slot has been written to
+// memory, returns a COPY of its value; otherwise returns NULL.
+//
+// NOTE: this function allocates memory for the value that
+// is returned. The caller takes ownership of the copy and 
+// must eventually free this memory via ram_free_value().
+//
+struct RAM_VALUE* ram_read_cell_by_slot(struct RAM* memory, int slot);
+
+//
+// ram_borrow_cell_by_slot
+//
+// If the variable bound to the given slot has been written to
+// memory, returns a pointer to its value --- NOT a copy; otherwise
+// returns NULL. The same lifetime rules as ram_borrow_cell_by_addr
+// apply: the value is only valid until the next write to memory.
+//
+const struct RAM_VALUE* ram_borrow_cell_by_slot(struct RAM* memory, int slot);
+
+//
+// ram_write_cell_by_slot
+//
+// Writes the given value to the variable bound to the given slot.
+// The first write to a slot adds a memory cell named by the given
+// name (as ram_write_cell_by_name does) and binds the slot to its
+// address; later writes go straight to that address. Returns true
+// if the value was successfully written, false if not.
+//
+bool ram_write_cell_by_slot(struct RAM* memory, struct RAM_VALUE value, int slot, char* name);
+
+//
+// ram_str_alloc
+//
+// Returns a new string of the given length with a refcount of 1;
+// the caller fills in the chars (the '\0' is already in place).
+// Returns NULL if memory could not be allocated.
+//
+struct RAM_STR* ram_str_alloc(int length);
+
+//
+// ram_str_new
+//
+// Returns a new string (refcount 1) holding a copy of the given
+// C string, or NULL if memory could not be allocated.
+//
+struct RAM_STR* ram_str_new(const char* chars);
+
+//
+// ram_value_retain
+//
+// If the given value is a string, adds a reference to it. Call
+// this when copying a value that is owned elsewhere (e.g. one
+// borrowed from memory) into a value you will release later.
+//
+void ram_value_retain(struct RAM_VALUE* value);
+
+//
+// ram_value_release
+//
+// If the given value is a string, drops its reference, freeing
+// the string when the last reference is dropped. The value is
+// left as None.
+//
+void ram_value_release(struct RAM_VALUE* value);
+
 //
 // ram_print
 //
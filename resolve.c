@@ -0,0 +1,427 @@
+/*resolve.c*/
+
+//
+// << Resolution pass: binds each distinct identifier in the program
+//    graph to a fixed slot, and each function name to a builtin id,
+//    so that execution does no string work to find variables. >>
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#define _POSIX_C_SOURCE 200809L  // strdup
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+
+#include "programgraph.h"
+#include "ram.h"
+#include "resolve.h"
+
+
+//
+// Private functions:
+//
+
+//
+// find_bucket
+//
+// Probes the hash index for the given identifier, returning the bucket
+// that holds its slot, or the empty bucket where it would be inserted.
+//
+static int find_bucket(struct SLOT_TABLE* slots, const char* name)
+{
+	int mask = slots->index_capacity - 1;
+	int bucket = ram_hash_bucket(name, slots->index_capacity);
+
+	while (slots->index[bucket] != -1) {
+		if (strcmp(slots->names[slots->index[bucket]], name) == 0) {
+			return bucket;
+		}
+		bucket = (bucket + 1) & mask;
+	}
+
+	return bucket;
+}
+
+
+//
+// grow_table
+//
+// Doubles the # of names the table can hold and rebuilds the hash
+// index to match. Returns false if memory could not be allocated.
+//
+static bool grow_table(struct SLOT_TABLE* slots)
+{
+	int new_cap = slots->capacity * 2;
+
+	char** new_names = (char**)realloc(slots->names, new_cap * sizeof(char*));
+	if (new_names == NULL) {
+		return false;
+	}
+	slots->names = new_names;
+	slots->capacity = new_cap;
+
+	int* new_index = (int*)malloc(2 * new_cap * sizeof(int));
+	if (new_index == NULL) {
+		return false;
+	}
+
+	free(slots->index);
+	slots->index = new_index;
+	slots->index_capacity = 2 * new_cap;
+
+	for (int i = 0; i < slots->index_capacity; i++) {
+		slots->index[i] = -1;
+	}
+
+	for (int slot = 0; slot < slots->num_slots; slot++) {
+		slots->index[find_bucket(slots, slots->names[slot])] = slot;
+	}
+
+	return true;
+}
+
+
+//
+// add_constant
+//
+// Returns a fresh cell in the table's constant pool, or NULL if
+// memory could not be allocated.
+//
+static struct RAM_VALUE* add_constant(struct SLOT_TABLE* slots)
+{
+	struct CONSTANT_BLOCK* block = slots->constants;
+
+	if (block == NULL || block->num_values == CONSTANTS_PER_BLOCK) {
+		block = (struct CONSTANT_BLOCK*)malloc(sizeof(struct CONSTANT_BLOCK));
+		if (block == NULL) {
+			return NULL;
+		}
+		block->num_values = 0;
+		block->next = slots->constants;
+		slots->constants = block;
+	}
+
+	return &block->values[block->num_values++];
+}
+
+
+//
+// resolve_element
+//
+// Binds the given element to a slot if it is an identifier, or
+// decodes it if it is a literal.
+//
+static bool resolve_element(struct SLOT_TABLE* slots, struct ELEMENT* element)
+{
+	if (element == NULL) {
+		return true;
+	}
+
+	if (element->element_type != ELEMENT_IDENTIFIER) {
+		element->slot = -1;
+		return resolve_literal(slots, element);
+	}
+
+	element->slot = resolve_slot(slots, element->element_value);
+	return element->slot != -1;
+}
+
+
+//
+// resolve_expr
+//
+// Binds the identifiers on both sides of the given expression.
+//
+static bool resolve_expr(struct SLOT_TABLE* slots, struct EXPR* expr)
+{
+	if (!resolve_element(slots, expr->lhs->element)) {
+		return false;
+	}
+
+	if (expr->isBinaryExpr && !resolve_element(slots, expr->rhs->element)) {
+		return false;
+	}
+
+	return true;
+}
+
+
+//
+// resolve_body
+//
+// Resolves the statements from stmt up to (but not including) stop,
+// which is NULL for the program, the while loop for a loop body, or
+// the statement after an if for its paths.
+//
+static bool resolve_body(struct SLOT_TABLE* slots, struct STMT* stmt, struct STMT* stop)
+{
+	while (stmt != stop) {
+		switch (stmt->stmt_type) {
+			case STMT_ASSIGNMENT: {
+				struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+
+				assignment->slot = resolve_slot(slots, assignment->var_name);
+				if (assignment->slot == -1) {
+					return false;
+				}
+
+				if (assignment->rhs->value_type == VALUE_FUNCTION_CALL) {
+					struct FUNCTION_CALL* call = assignment->rhs->types.function_call;
+					call->builtin = resolve_builtin(call->function_name);
+					if (!resolve_element(slots, call->parameter)) {
+						return false;
+					}
+				}
+				else if (!resolve_expr(slots, assignment->rhs->types.expr)) {
+					return false;
+				}
+
+				stmt = assignment->next_stmt;
+				break;
+			}
+
+			case STMT_FUNCTION_CALL: {
+				struct STMT_FUNCTION_CALL* call = stmt->types.function_call;
+
+				call->builtin = resolve_builtin(call->function_name);
+				if (!resolve_element(slots, call->parameter)) {
+					return false;
+				}
+
+				stmt = call->next_stmt;
+				break;
+			}
+
+			case STMT_IF_THEN_ELSE: {
+				struct STMT_IF_THEN_ELSE* ifthen = stmt->types.if_then_else;
+
+				if (!resolve_expr(slots, ifthen->condition) ||
+					!resolve_body(slots, ifthen->true_path, ifthen->next_stmt) ||
+					!resolve_body(slots, ifthen->false_path, ifthen->next_stmt)) {
+					return false;
+				}
+
+				stmt = ifthen->next_stmt;
+				break;
+			}
+
+			case STMT_WHILE_LOOP: {
+				struct STMT_WHILE_LOOP* loop = stmt->types.while_loop;
+
+				if (!resolve_expr(slots, loop->condition) ||
+					!resolve_body(slots, loop->loop_body, stmt)) {
+					return false;
+				}
+
+				stmt = loop->next_stmt;
+				break;
+			}
+
+			case STMT_PASS:
+				stmt = stmt->types.pass->next_stmt;
+				break;
+
+			default:
+				return false;
+		}
+	}
+
+	return true;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// resolve_init
+//
+// Returns a pointer to a dynamically-allocated, empty slot table.
+//
+struct SLOT_TABLE* resolve_init(void)
+{
+	struct SLOT_TABLE* slots = (struct SLOT_TABLE*)malloc(sizeof(struct SLOT_TABLE));
+	if (slots == NULL) {
+		return NULL;
+	}
+
+	slots->num_slots = 0;
+	slots->capacity = 8;
+	slots->names = (char**)malloc(slots->capacity * sizeof(char*));
+	slots->index_capacity = 2 * slots->capacity;
+	slots->index = (int*)malloc(slots->index_capacity * sizeof(int));
+	slots->constants = NULL;
+	slots->escaped = NULL;
+
+	if (slots->names == NULL || slots->index == NULL) {
+		free(slots->names);
+		free(slots->index);
+		free(slots);
+		return NULL;
+	}
+
+	for (int i = 0; i < slots->index_capacity; i++) {
+		slots->index[i] = -1;
+	}
+
+	return slots;
+}
+
+
+//
+// resolve_destroy
+//
+// Frees the memory associated with the given slot table.
+//
+void resolve_destroy(struct SLOT_TABLE* slots)
+{
+	if (slots == NULL) {
+		return;
+	}
+
+	for (int i = 0; i < slots->num_slots; i++) {
+		free(slots->names[i]);
+	}
+
+	while (slots->constants != NULL) {
+		struct CONSTANT_BLOCK* next = slots->constants->next;
+		for (int i = 0; i < slots->constants->num_values; i++) {
+			ram_value_release(&slots->constants->values[i]);
+		}
+		free(slots->constants);
+		slots->constants = next;
+	}
+
+	free(slots->names);
+	free(slots->index);
+	free(slots->escaped);
+	free(slots);
+}
+
+
+//
+// resolve_slot
+//
+// Returns the slot bound to the given identifier, binding it to the
+// next free slot if this is the first time the identifier is seen.
+// Returns -1 if memory could not be allocated.
+//
+int resolve_slot(struct SLOT_TABLE* slots, char* identifier)
+{
+	int bucket = find_bucket(slots, identifier);
+	if (slots->index[bucket] != -1) {
+		return slots->index[bucket];
+	}
+
+	// new identifier, do we have room?
+	if (slots->num_slots >= slots->capacity) {
+		if (!grow_table(slots)) {
+			return -1;
+		}
+		bucket = find_bucket(slots, identifier);
+	}
+
+	char* name = strdup(identifier);
+	if (name == NULL) {
+		return -1;
+	}
+
+	int slot = slots->num_slots;
+	slots->names[slot] = name;
+	slots->index[bucket] = slot;
+	slots->num_slots++;
+
+	return slot;
+}
+
+
+//
+// resolve_builtin
+//
+// Returns the builtin id (enum BUILTINS) for the given function name.
+//
+int resolve_builtin(char* function_name)
+{
+	if (strcmp(function_name, "print") == 0) return BUILTIN_PRINT;
+	if (strcmp(function_name, "input") == 0) return BUILTIN_INPUT;
+	if (strcmp(function_name, "int") == 0)   return BUILTIN_INT;
+	if (strcmp(function_name, "float") == 0) return BUILTIN_FLOAT;
+
+	return BUILTIN_UNKNOWN;
+}
+
+
+//
+// resolve_literal
+//
+// Decodes the given literal element into the constant pool, exactly
+// as the executor would decode it from its text. None is left alone.
+// Returns false if memory could not be allocated.
+//
+bool resolve_literal(struct SLOT_TABLE* slots, struct ELEMENT* element)
+{
+	struct RAM_VALUE value;
+
+	element->constant = NULL;
+
+	switch (element->element_type) {
+		case ELEMENT_INT_LITERAL:
+			value.value_type = RAM_TYPE_INT;
+			value.types.i = atoi(element->element_value);
+			break;
+
+		case ELEMENT_REAL_LITERAL:
+			value.value_type = RAM_TYPE_REAL;
+			value.types.d = atof(element->element_value);
+			break;
+
+		case ELEMENT_STR_LITERAL:
+			value.value_type = RAM_TYPE_STR;
+			value.types.s = ram_str_new(element->element_value);
+			if (value.types.s == NULL) {
+				return false;
+			}
+			break;
+
+		case ELEMENT_TRUE:
+		case ELEMENT_FALSE:
+			value.value_type = RAM_TYPE_BOOLEAN;
+			value.types.i = (element->element_type == ELEMENT_TRUE);
+			break;
+
+		default:
+			return true;
+	}
+
+	element->constant = add_constant(slots);
+	if (element->constant == NULL) {
+		ram_value_release(&value);
+		return false;
+	}
+
+	*element->constant = value;
+	return true;
+}
+
+
+//
+// resolve_program
+//
+// Walks the given program graph, filling in the slot of every
+// identifier element and assignment target, and the builtin id
+// of every function call, and decoding every literal.
+//
+bool resolve_program(struct SLOT_TABLE* slots, struct STMT* program)
+{
+	if (slots == NULL) {
+		return false;
+	}
+
+	return resolve_body(slots, program, NULL);
+}
@@ -0,0 +1,133 @@
+/*resolve.h*/
+
+//
+// Pre-execution resolution pass for nuPython. Walks the program graph
+// once and binds every identifier to a fixed slot number, so that the
+// executor can find a variable's RAM cell by indexing instead of by
+// comparing names. Function names are bound to builtin ids.
+//
+// Literals are decoded at the same time: each literal element gets a
+// RAM_VALUE in the table's constant pool (see ELEMENT::constant), so
+// running "x = x + 1" never parses "1" or allocates a string.
+//
+// A slot is not the same as a RAM address: RAM addresses are handed
+// out in the order variables are first written at run-time (which is
+// what pointers and ram_print() see), while slots are handed out in
+// the order identifiers appear in the program. RAM keeps the mapping
+// from slot to address (see ram_write_cell_by_slot).
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+#include "programgraph.h"
+#include "ram.h"
+
+
+//
+// builtin functions, stored in FUNCTION_CALL / STMT_FUNCTION_CALL:
+//
+enum BUILTINS
+{
+  BUILTIN_UNKNOWN = -1,
+  BUILTIN_PRINT = 0,
+  BUILTIN_INPUT,
+  BUILTIN_INT,
+  BUILTIN_FLOAT
+};
+
+struct SLOT_TABLE
+{
+  char** names;        // names[i] is the identifier bound to slot i
+  int num_slots;       // # of slots handed out so far
+  int capacity;        // # of entries available in names
+
+  //
+  // open-addressing hash index: bucket -> slot, -1 => empty
+  //
+  int* index;
+  int  index_capacity; // # of buckets (always a power of 2)
+
+  //
+  // constant pool: the decoded literals, in blocks that never move
+  // (elements point into them); the pool owns a reference to each
+  // string constant
+  //
+  struct CONSTANT_BLOCK* constants;
+
+  //
+  // escaped[i] => a pointer may reach the variable bound to slot i (see
+  // escape.h); NULL until the escape analysis pass has run
+  //
+  bool* escaped;
+};
+
+#define CONSTANTS_PER_BLOCK 64
+
+struct CONSTANT_BLOCK
+{
+  struct RAM_VALUE values[CONSTANTS_PER_BLOCK];
+  int num_values;
+  struct CONSTANT_BLOCK* next;
+};
+
+
+//
+// Public functions:
+//
+
+//
+// resolve_init
+//
+// Returns a pointer to a dynamically-allocated, empty slot table.
+//
+struct SLOT_TABLE* resolve_init(void);
+
+//
+// resolve_destroy
+//
+// Frees the memory associated with the given slot table.
+//
+void resolve_destroy(struct SLOT_TABLE* slots);
+
+//
+// resolve_slot
+//
+// Returns the slot bound to the given identifier, binding it to the
+// next free slot if this is the first time the identifier is seen.
+// Returns -1 if memory could not be allocated.
+//
+int resolve_slot(struct SLOT_TABLE* slots, char* identifier);
+
+//
+// resolve_builtin
+//
+// Returns the builtin id (enum BUILTINS) for the given function name.
+//
+int resolve_builtin(char* function_name);
+
+//
+// resolve_literal
+//
+// Decodes the given literal element into the table's constant pool
+// and points the element at it. None (and identifiers) are left with
+// no constant. Returns false if memory could not be allocated.
+//
+bool resolve_literal(struct SLOT_TABLE* slots, struct ELEMENT* element);
+
+//
+// resolve_program
+//
+// Walks the given program graph, filling in the slot of every
+// identifier element and assignment target, and the builtin id
+// of every function call, and decoding every literal into the
+// table's constant pool. Slots and constants are added to the
+// given table, so a table can be shared across several program
+// graphs (but must outlive them). Returns false if memory could
+// not be allocated.
+//
+bool resolve_program(struct SLOT_TABLE* slots, struct STMT* program);
@@ -0,0 +1,368 @@
+/*scanbuffer.c*/
+
+//
+// << In-memory scanner: the tokens of a program held in one buffer,
+//    with its runs of chars classified 16 bytes at a time. >>
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+
+#include "token.h"
+#include "tokenbuffer.h"
+#include "scanbuffer.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+//
+// kinds of runs of chars:
+//
+enum RUNS
+{
+  RUN_SPACE = 0,  // whitespace other than \n
+  RUN_IDENTIFIER,  // letters, digits and _
+  RUN_DIGITS,
+  RUN_STRING       // anything up to the closing quote, a \n or a \0
+};
+
+
+//
+// keywords, by perfect hash (see keyword_hash):
+//
+struct KEYWORD
+{
+  const char* name;
+  int len;
+  int id;
+};
+
+static const struct KEYWORD keywords[32] =
+{
+  [23] = { "and", 3, nuPy_KEYW_AND },
+  [29] = { "break", 5, nuPy_KEYW_BREAK },
+  [2]  = { "continue", 8, nuPy_KEYW_CONTINUE },
+  [10] = { "def", 3, nuPy_KEYW_DEF },
+  [13] = { "elif", 4, nuPy_KEYW_ELIF },
+  [8]  = { "else", 4, nuPy_KEYW_ELSE },
+  [11] = { "False", 5, nuPy_KEYW_FALSE },
+  [12] = { "for", 3, nuPy_KEYW_FOR },
+  [25] = { "if", 2, nuPy_KEYW_IF },
+  [1]  = { "in", 2, nuPy_KEYW_IN },
+  [26] = { "is", 2, nuPy_KEYW_IS },
+  [3]  = { "None", 4, nuPy_KEYW_NONE },
+  [14] = { "not", 3, nuPy_KEYW_NOT },
+  [7]  = { "or", 2, nuPy_KEYW_OR },
+  [15] = { "pass", 4, nuPy_KEYW_PASS },
+  [28] = { "return", 6, nuPy_KEYW_RETURN },
+  [21] = { "True", 4, nuPy_KEYW_TRUE },
+  [30] = { "while", 5, nuPy_KEYW_WHILE }
+};
+
+
+//
+// Private functions:
+//
+
+//
+// keyword_hash
+//
+// Hash of an identifier's first and last chars, which is different
+// for every keyword.
+//
+static int keyword_hash(const char* name, int len)
+{
+	return (3 * (unsigned char)name[0] + 5 * (unsigned char)name[len - 1]) & 31;
+}
+
+//
+// identifier_id
+//
+// Returns the keyword id of the given identifier, or nuPy_IDENTIFIER.
+//
+static int identifier_id(const char* name, int len)
+{
+	const struct KEYWORD* keyword = &keywords[keyword_hash(name, len)];
+
+	if (keyword->len == len && memcmp(keyword->name, name, len) == 0) {
+		return keyword->id;
+	}
+
+	return nuPy_IDENTIFIER;
+}
+
+//
+// continues_run
+//
+// Returns true if the given char continues a run of the given kind
+// (for a string, quoted by quote).
+//
+static bool continues_run(char c, int kind, char quote)
+{
+	switch (kind) {
+		case RUN_SPACE:
+			return c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == '\r';
+
+		case RUN_IDENTIFIER:
+			return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+
+		case RUN_DIGITS:
+			return c >= '0' && c <= '9';
+
+		default:
+			return c != quote && c != '\n' && c != '\0';
+	}
+}
+
+#if defined(__SSE2__)
+
+//
+// in_range
+//
+// Marks the bytes between lo and hi (ASCII, so a byte >= 0x80, which
+// compares as negative, is never in range).
+//
+static __m128i in_range(__m128i bytes, char lo, char hi)
+{
+	return _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(lo - 1)), _mm_cmplt_epi8(bytes, _mm_set1_epi8(hi + 1)));
+}
+
+//
+// run_mask
+//
+// Returns a bit per byte of the given 16, set if it continues a run of
+// the given kind.
+//
+static unsigned run_mask(__m128i bytes, int kind, char quote)
+{
+	__m128i run;
+
+	switch (kind) {
+		case RUN_SPACE:
+			run = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t'))),
+				in_range(bytes, '\v', '\r'));
+			break;
+
+		case RUN_IDENTIFIER:
+			// lower-casing maps every letter to a..z, and nothing else there
+			run = _mm_or_si128(_mm_or_si128(in_range(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), 'a', 'z'), in_range(bytes, '0', '9')),
+				_mm_cmpeq_epi8(bytes, _mm_set1_epi8('_')));
+			break;
+
+		case RUN_DIGITS:
+			run = in_range(bytes, '0', '9');
+			break;
+
+		default: {
+			__m128i stop = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(quote)), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'))),
+				_mm_cmpeq_epi8(bytes, _mm_setzero_si128()));
+			return ~(unsigned)_mm_movemask_epi8(stop) & 0xFFFF;
+		}
+	}
+
+	return (unsigned)_mm_movemask_epi8(run);
+}
+
+#endif
+
+//
+// skip_run
+//
+// Returns the end of the run of the given kind starting at p: 16 bytes
+// at a time while there are 16 left, then a char at a time.
+//
+static const char* skip_run(const char* p, const char* end, int kind, char quote)
+{
+#if defined(__SSE2__)
+	while (end - p >= 16) {
+		unsigned stops = ~run_mask(_mm_loadu_si128((const __m128i*)p), kind, quote) & 0xFFFF;
+
+		if (stops != 0) {
+			return p + __builtin_ctz(stops);
+		}
+
+		p += 16;
+	}
+#endif
+
+	while (p < end && continues_run(*p, kind, quote)) {
+		p++;
+	}
+
+	return p;
+}
+
+//
+// operator_id
+//
+// Returns the id of the punctuation or operator token at p, storing its
+// length in len, or nuPy_UNKNOWN.
+//
+static int operator_id(const char* p, const char* end, int* len)
+{
+	bool equal_next = (end - p >= 2 && p[1] == '=');
+
+	*len = 1;
+
+	switch (*p) {
+		case '(': return nuPy_LEFT_PAREN;
+		case ')': return nuPy_RIGHT_PAREN;
+		case '[': return nuPy_LEFT_BRACKET;
+		case ']': return nuPy_RIGHT_BRACKET;
+		case '{': return nuPy_LEFT_BRACE;
+		case '}': return nuPy_RIGHT_BRACE;
+		case '+': return nuPy_PLUS;
+		case '-': return nuPy_MINUS;
+		case '%': return nuPy_PERCENT;
+		case '/': return nuPy_SLASH;
+		case '&': return nuPy_AMPERSAND;
+		case ':': return nuPy_COLON;
+
+		case '*':
+			if (end - p >= 2 && p[1] == '*') {
+				*len = 2;
+				return nuPy_POWER;
+			}
+			return nuPy_ASTERISK;
+
+		case '=':
+			*len += equal_next;
+			return equal_next ? nuPy_EQUALEQUAL : nuPy_EQUAL;
+
+		case '<':
+			*len += equal_next;
+			return equal_next ? nuPy_LTE : nuPy_LT;
+
+		case '>':
+			*len += equal_next;
+			return equal_next ? nuPy_GTE : nuPy_GT;
+
+		case '!':
+			*len += equal_next;
+			return equal_next ? nuPy_NOTEQUAL : nuPy_UNKNOWN;
+
+		default:
+			return nuPy_UNKNOWN;
+	}
+}
+
+
+//
+// append
+//
+// The emit function of scanbuffer_scan.
+//
+static bool append(void* tokens, struct Token token, const char* value, int len)
+{
+	return tokenbuffer_append((struct TOKEN_BUFFER*)tokens, token, value, len);
+}
+
+
+//
+// Public functions:
+//
+
+//
+// scanbuffer_scan
+//
+bool scanbuffer_scan(const char* text, size_t length, struct TOKEN_BUFFER* tokens)
+{
+	return scanbuffer_emit(text, length, append, tokens);
+}
+
+//
+// scanbuffer_emit
+//
+// Columns count bytes from the start of the line, as the stdio scanner
+// does (a tab is 1 column).
+//
+bool scanbuffer_emit(const char* text, size_t length, bool (*emit)(void* sink, struct Token token, const char* value, int len), void* sink)
+{
+	const char* p = text;
+	const char* end = text + length;
+	const char* line_start = text;
+	int line = 1;
+
+	for (;;) {
+		p = skip_run(p, end, RUN_SPACE, 0);
+
+		struct Token token = { .id = nuPy_EOS, .line = line, .col = (int)(p - line_start) + 1 };
+
+		if (p == end || *p == '$') {
+			return emit(sink, token, "$", 1);
+		}
+
+		const char* value = p;
+		int len;
+
+		if (*p == '\n') {
+			token.id = nuPy_EOLN;
+			value = "EOLN";
+			len = 4;
+
+			line++;
+			line_start = ++p;
+		}
+		else if (*p == '#') {
+			const char* eoln = memchr(p, '\n', end - p);
+
+			p = (eoln == NULL) ? end : eoln;
+			continue;
+		}
+		else if (*p == '_' || (*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')) {
+			p = skip_run(p + 1, end, RUN_IDENTIFIER, 0);
+			len = (int)(p - value);
+
+			token.id = identifier_id(value, len);
+		}
+		else if ((*p >= '0' && *p <= '9') || (*p == '.' && end - p >= 2 && p[1] >= '0' && p[1] <= '9')) {
+			// 123, 3.14, 89. or .5
+			token.id = nuPy_INT_LITERAL;
+
+			if (*p != '.') {
+				p = skip_run(p, end, RUN_DIGITS, 0);
+			}
+
+			if (p < end && *p == '.') {
+				token.id = nuPy_REAL_LITERAL;
+				p = skip_run(p + 1, end, RUN_DIGITS, 0);
+			}
+
+			len = (int)(p - value);
+		}
+		else if (*p == '"' || *p == '\'') {
+			const char* close = skip_run(p + 1, end, RUN_STRING, *p);
+
+			if (close == end || *close != *p) {
+				return false;  // not terminated, or a \0
+			}
+
+			value = p + 1;
+			len = (int)(close - value);
+			p = close + 1;
+
+			token.id = nuPy_STR_LITERAL;
+		}
+		else {
+			token.id = operator_id(p, end, &len);
+
+			if (token.id == nuPy_UNKNOWN) {
+				return false;
+			}
+
+			p += len;
+		}
+
+		if (len > SCANBUFFER_MAX_VALUE || !emit(sink, token, value, len)) {
+			return false;
+		}
+	}
+}
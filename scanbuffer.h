@@ -0,0 +1,59 @@
+/*scanbuffer.h*/
+
+//
+// In-memory scanner for nuPython. It turns the text of a program, held
+// in one buffer (e.g. a memory-mapped file, see parsebuffer.h), into a
+// TOKEN_BUFFER, with the same tokens, values, lines and columns as the
+// stdio scanner (scanner.h) gives the parser.
+//
+// It doesn't read a char at a time: runs of whitespace, identifier and
+// digit chars, and the body of a string literal, are found 16 bytes at
+// a time with SSE2 where the compiler has it, and keywords are looked
+// up in a perfect hash table rather than compared one by one.
+//
+// Input the stdio scanner would complain about (a char that is not part
+// of nuPython, a string literal that isn't terminated, a '\0'), or a
+// value too long for the parser, is not scanned: the caller is expected
+// to fall back to parser_parse, so the messages stay the same.
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+#include <stddef.h>   // size_t
+#include "tokenbuffer.h"
+
+
+//
+// longest value the parser takes (its buffer holds 256 chars):
+//
+#define SCANBUFFER_MAX_VALUE 255
+
+
+//
+// Public functions:
+//
+
+//
+// scanbuffer_scan
+//
+// Appends the tokens of the given text, up to and including the
+// nuPy_EOS at its end (or at a $), to tokens. Returns false if the text
+// has input left to the stdio scanner (see above), or if memory could
+// not be allocated; tokens then holds only some of them.
+//
+bool scanbuffer_scan(const char* text, size_t length, struct TOKEN_BUFFER* tokens);
+
+//
+// scanbuffer_emit
+//
+// scanbuffer_scan, handing each token to emit (with the given sink)
+// instead of appending it to a buffer. Values are slices of the text,
+// or string literals, so they outlive the scan. Returns false if emit
+// does, or the text has input left to the stdio scanner.
+//
+bool scanbuffer_emit(const char* text, size_t length, bool (*emit)(void* sink, struct Token token, const char* value, int len), void* sink);
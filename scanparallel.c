@@ -0,0 +1,270 @@
+/*scanparallel.c*/
+
+//
+// << Parallel scanning: a large program cut into chunks at line breaks,
+//    each scanned on its own thread, and stitched back together. >>
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#define _POSIX_C_SOURCE 200809L  // sysconf
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "tokenbuffer.h"
+#include "scanbuffer.h"
+#include "scanparallel.h"
+
+
+//
+// a chunk of the text, and where its tokens go in the whole buffer:
+//
+struct CHUNK
+{
+  const char* text;
+  size_t length;
+
+  struct TOKEN_BUFFER* tokens;  // its tokens, with lines from 1
+  bool scanned;
+  int  lines;                   // # of '\n' in the chunk
+
+  struct TOKEN_BUFFER* whole;
+  int first_line;   // line # the chunk starts on
+  int first_token;  // index of its first token in the whole buffer
+  int pool_offset;  // offset of its values in the whole buffer
+  int num_tokens;   // # of its tokens kept (its nuPy_EOS only if it's last)
+};
+
+
+//
+// Private functions:
+//
+
+//
+// scan_serial
+//
+// scanparallel_scan on this thread.
+//
+static struct TOKEN_BUFFER* scan_serial(const char* text, size_t length)
+{
+	struct TOKEN_BUFFER* tokens = tokenbuffer_alloc((int)(length / 4) + 16, (int)length + 64);
+
+	if (tokens != NULL && !scanbuffer_scan(text, length, tokens)) {
+		tokenbuffer_destroy(tokens);
+		return NULL;
+	}
+
+	return tokens;
+}
+
+//
+// scan_chunk
+//
+// A chunk's thread, first time round: scans it, and counts its lines.
+//
+static void* scan_chunk(void* arg)
+{
+	struct CHUNK* chunk = (struct CHUNK*)arg;
+	const char* p = chunk->text;
+	const char* end = chunk->text + chunk->length;
+
+	chunk->lines = 0;
+	while ((p = memchr(p, '\n', end - p)) != NULL) {
+		chunk->lines++;
+		p++;
+	}
+
+	chunk->tokens = scan_serial(chunk->text, chunk->length);
+	chunk->scanned = (chunk->tokens != NULL);
+
+	return NULL;
+}
+
+//
+// copy_chunk
+//
+// A chunk's thread, second time round: copies its tokens and values to
+// their place in the whole buffer.
+//
+static void* copy_chunk(void* arg)
+{
+	struct CHUNK* chunk = (struct CHUNK*)arg;
+	struct TOKEN_BUFFER* whole = chunk->whole;
+
+	memcpy(whole->pool + chunk->pool_offset, chunk->tokens->pool, chunk->tokens->pool_size);
+
+	for (int i = 0; i < chunk->num_tokens; i++) {
+		struct BUFFERED_TOKEN token = chunk->tokens->tokens[i];
+
+		token.line += chunk->first_line - 1;
+		token.offset += chunk->pool_offset;
+
+		whole->tokens[chunk->first_token + i] = token;
+	}
+
+	return NULL;
+}
+
+//
+// run_chunks
+//
+// Runs the given function on each chunk, a thread per chunk (the first
+// on this one), and waits for them all. A chunk whose thread can't be
+// started is run on this one.
+//
+static void run_chunks(struct CHUNK* chunks, int num_chunks, void* (*run)(void*))
+{
+	pthread_t threads[SCANPARALLEL_MAX_CHUNKS];
+	bool started[SCANPARALLEL_MAX_CHUNKS];
+
+	for (int i = 1; i < num_chunks; i++) {
+		started[i] = (pthread_create(&threads[i], NULL, run, &chunks[i]) == 0);
+	}
+
+	run(&chunks[0]);
+
+	for (int i = 1; i < num_chunks; i++) {
+		if (started[i]) {
+			pthread_join(threads[i], NULL);
+		}
+		else {
+			run(&chunks[i]);
+		}
+	}
+}
+
+//
+// cut
+//
+// Cuts the text into about the given # of chunks, each ending just
+// after a '\n' (but the last, which may be empty). Returns the # of
+// chunks.
+//
+static int cut(const char* text, size_t length, int num_chunks, struct CHUNK* chunks)
+{
+	const char* start = text;
+	const char* end = text + length;
+	int n = 0;
+
+	for (int i = 1; i < num_chunks; i++) {
+		const char* target = text + (length / num_chunks) * i;
+		if (target < start) {
+			continue;  // the last chunk ran past it
+		}
+
+		const char* eoln = memchr(target, '\n', end - target);
+		if (eoln == NULL) {
+			break;
+		}
+
+		chunks[n++] = (struct CHUNK) { .text = start, .length = (size_t)(eoln + 1 - start) };
+		start = eoln + 1;
+	}
+
+	chunks[n++] = (struct CHUNK) { .text = start, .length = (size_t)(end - start) };
+	return n;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// scanparallel_threads
+//
+int scanparallel_threads(void)
+{
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (cores < 1) ? 1 : (cores > SCANPARALLEL_MAX_CHUNKS) ? SCANPARALLEL_MAX_CHUNKS : (int)cores;
+}
+
+//
+// scanparallel_scan
+//
+// A chunk's nuPy_EOS is dropped when it's at the end of the chunk (the
+// next one goes on from there), but kept when it's a $, which ends the
+// program there.
+//
+struct TOKEN_BUFFER* scanparallel_scan(const char* text, size_t length, int threads)
+{
+	int num_chunks = (int)(length / SCANPARALLEL_MIN_CHUNK);
+
+	if (num_chunks > threads) {
+		num_chunks = threads;
+	}
+	if (num_chunks > SCANPARALLEL_MAX_CHUNKS) {
+		num_chunks = SCANPARALLEL_MAX_CHUNKS;
+	}
+
+	if (length < SCANPARALLEL_MIN_TEXT || num_chunks < 2) {
+		return scan_serial(text, length);
+	}
+
+	struct CHUNK chunks[SCANPARALLEL_MAX_CHUNKS];
+
+	num_chunks = cut(text, length, num_chunks, chunks);
+	run_chunks(chunks, num_chunks, scan_chunk);
+
+	//
+	// which chunks are part of the program, and where their tokens go:
+	//
+	int line = 1;
+	int num_tokens = 0;
+	int pool_size = 0;
+	int kept = 0;
+	bool scanned = true;
+
+	for (int i = 0; i < num_chunks; i++) {
+		struct CHUNK* chunk = &chunks[i];
+
+		if (!chunk->scanned) {
+			scanned = false;
+			break;
+		}
+
+		const struct BUFFERED_TOKEN* eos = &chunk->tokens->tokens[chunk->tokens->num_tokens - 1];
+		bool last = (i == num_chunks - 1) || eos->line != chunk->lines + 1 || eos->col != 1;
+
+		chunk->first_line = line;
+		chunk->first_token = num_tokens;
+		chunk->pool_offset = pool_size;
+		chunk->num_tokens = chunk->tokens->num_tokens - (last ? 0 : 1);
+
+		line += chunk->lines;
+		num_tokens += chunk->num_tokens;
+		pool_size += chunk->tokens->pool_size;
+		kept++;
+
+		if (last) {
+			break;
+		}
+	}
+
+	struct TOKEN_BUFFER* whole = scanned ? tokenbuffer_alloc(num_tokens, pool_size) : NULL;
+
+	if (whole != NULL) {
+		for (int i = 0; i < kept; i++) {
+			chunks[i].whole = whole;
+		}
+
+		run_chunks(chunks, kept, copy_chunk);
+
+		whole->num_tokens = num_tokens;
+		whole->pool_size = pool_size;
+	}
+
+	for (int i = 0; i < num_chunks; i++) {
+		tokenbuffer_destroy(chunks[i].tokens);
+	}
+
+	return whole;
+}
@@ -0,0 +1,53 @@
+/*scanparallel.h*/
+
+//
+// Data-parallel scanning of large nuPython programs. Every token ends
+// before the '\n' that ends its line --- a string literal or a comment
+// can't go on past one --- so the scanner is in the same state after
+// each '\n' as at the start of the text. A large text is cut right
+// after a '\n' into about equal chunks, one per core, and each chunk is
+// scanned on a thread of its own (see scanbuffer.h) into a buffer of
+// its own. The buffers are then copied into one, in order, with each
+// chunk's lines moved down by the # of lines before it, again a thread
+// per chunk.
+//
+// The only thing a chunk can't see is a $ before it, which ends the
+// program: chunks after the one a $ is found in are dropped, along with
+// anything they couldn't scan.
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#pragma once
+
+#include <stddef.h>   // size_t
+#include "tokenbuffer.h"
+
+
+#define SCANPARALLEL_MIN_TEXT  (1 << 20)   // bytes below which a text is scanned on one thread
+#define SCANPARALLEL_MIN_CHUNK (256 << 10) // bytes a chunk should have at least
+#define SCANPARALLEL_MAX_CHUNKS 64
+
+
+//
+// Public functions:
+//
+
+//
+// scanparallel_threads
+//
+// Returns the # of threads to scan with: the # of cores online.
+//
+int scanparallel_threads(void);
+
+//
+// scanparallel_scan
+//
+// Scans the given text like scanbuffer_scan, on up to the given # of
+// threads (a text too small to be worth it is scanned on this one).
+// Returns its tokens in a new buffer, or NULL if the text has input
+// left to the stdio scanner, or memory could not be allocated.
+//
+struct TOKEN_BUFFER* scanparallel_scan(const char* text, size_t length, int threads);
@@ -0,0 +1,392 @@
+/*stream.c*/
+
+//
+// << Streaming reader: a nuPython program split into its top-level
+//    statements as it is read, each parsed on its own. >>
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#define _POSIX_C_SOURCE 200809L  // getc_unlocked
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+
+#include "tokenbuffer.h"
+#include "parsebuffer.h"
+#include "stream.h"
+
+
+//
+// what to do after a char is read:
+//
+enum ACTIONS
+{
+  READ_ON = 0,  // the statement goes on
+  COMPLETE,     // the text is the statement
+  SPLIT,        // the text before this line is the statement
+  END           // $ was read
+};
+
+//
+// where the reader is in the current line:
+//
+enum LINE_STATES
+{
+  LINE_START = 0,  // only whitespace so far
+  LINE_WORD,       // reading the line's first word
+  LINE_REST
+};
+
+//
+// what the reader knows about the statement being read:
+//
+struct STMT_STATE
+{
+  int  kind;         // enum STREAM_STMT_KINDS
+  int  depth;        // # of open {
+  bool closed;       // a while / if block closed back to depth 0
+  bool expect_brace; // after a while / if / elif / else line, before its {
+  bool broken;       // missing its {, so it ends with this line
+  char quote;        // in a string: its quote, otherwise '\0'
+  bool comment;
+
+  int    line_state; // enum LINE_STATES
+  size_t line_start; // offset of the current line in the text
+  size_t word_start; // offset of the line's first word
+};
+
+
+//
+// Private functions:
+//
+
+//
+// is_space
+//
+// Whitespace the scanner skips (not '\n', which is a token).
+//
+static bool is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == '\r';
+}
+
+//
+// is_word
+//
+// Returns true if c can be part of an identifier or keyword; start says
+// whether it's the first char.
+//
+static bool is_word(char c, bool start)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || (!start && c >= '0' && c <= '9');
+}
+
+//
+// is_word_named
+//
+static bool is_word_named(const char* word, size_t len, const char* name)
+{
+	return len == strlen(name) && strncmp(word, name, len) == 0;
+}
+
+//
+// first_word
+//
+// Called with the first word of each line that has something on it (or
+// an empty word if it doesn't start with one).
+//
+static int first_word(struct STMT_STATE* st, const char* word, size_t len)
+{
+	if (st->kind == STREAM_IF && st->closed && st->depth == 0) {
+		if (!is_word_named(word, len, "elif") && !is_word_named(word, len, "else")) {
+			return SPLIT;
+		}
+
+		st->closed = false;
+		return READ_ON;
+	}
+
+	if (st->kind == STREAM_NONE) {
+		st->kind = is_word_named(word, len, "if") ? STREAM_IF :
+			is_word_named(word, len, "while") ? STREAM_WHILE : STREAM_SIMPLE;
+	}
+
+	return READ_ON;
+}
+
+//
+// end_of_line
+//
+// Called at each '\n' that isn't in a string.
+//
+static int end_of_line(struct STREAM* stream, struct STMT_STATE* st)
+{
+	st->line_start = stream->length;
+	st->line_state = LINE_START;
+
+	switch (st->kind) {
+		case STREAM_SIMPLE:
+			return COMPLETE;
+
+		case STREAM_WHILE:
+		case STREAM_IF:
+			if (st->broken || st->depth < 0 || (st->kind == STREAM_WHILE && st->closed)) {
+				return COMPLETE;
+			}
+
+			// a header line: the next one should open its block
+			st->expect_brace = (st->depth == 0 && !st->closed);
+			return READ_ON;
+
+		default:
+			return READ_ON;
+	}
+}
+
+//
+// feed
+//
+// Called with each char of the statement, once it has been appended to
+// the text.
+//
+static int feed(struct STREAM* stream, struct STMT_STATE* st, char c)
+{
+	if (st->quote != '\0') {
+		if (c == st->quote) {
+			st->quote = '\0';
+			return READ_ON;
+		}
+		if (c != '\n') {
+			return READ_ON;
+		}
+		st->quote = '\0';  // the scanner ends the string with a warning
+	}
+	else if (st->comment) {
+		if (c != '\n') {
+			return READ_ON;
+		}
+		st->comment = false;
+	}
+	else if (st->line_state == LINE_WORD) {
+		if (is_word(c, false)) {
+			return READ_ON;
+		}
+
+		st->line_state = LINE_REST;
+
+		if (first_word(st, stream->text + st->word_start, stream->length - 1 - st->word_start) == SPLIT) {
+			return SPLIT;
+		}
+	}
+	else if (st->line_state == LINE_START) {
+		if (is_space(c)) {
+			return READ_ON;
+		}
+
+		if (st->expect_brace) {
+			st->expect_brace = false;
+			st->broken = (c != '{');
+		}
+
+		if (c == '\n' || c == '#' || c == '$') {
+			// nothing on the line, which ends an if
+			if (st->kind == STREAM_IF && st->closed && st->depth == 0) {
+				return SPLIT;
+			}
+		}
+		else if (is_word(c, true)) {
+			st->line_state = LINE_WORD;
+			st->word_start = stream->length - 1;
+			return READ_ON;
+		}
+		else {
+			st->line_state = LINE_REST;
+
+			if (first_word(st, "", 0) == SPLIT) {
+				return SPLIT;
+			}
+		}
+	}
+
+	switch (c) {
+		case '\'':
+		case '"':
+			st->quote = c;
+			return READ_ON;
+
+		case '#':
+			st->comment = true;
+			return READ_ON;
+
+		case '{':
+			st->depth++;
+			return READ_ON;
+
+		case '}':
+			st->depth--;
+			if (st->depth == 0) {
+				st->closed = true;
+			}
+			return READ_ON;
+
+		case '$':
+			return END;
+
+		case '\n':
+			return end_of_line(stream, st);
+
+		default:
+			return READ_ON;
+	}
+}
+
+//
+// append
+//
+static bool append(struct STREAM* stream, char c)
+{
+	if (stream->length == stream->capacity) {
+		size_t capacity = 2 * stream->capacity;
+
+		char* text = (char*)realloc(stream->text, capacity);
+		if (text == NULL) {
+			return false;
+		}
+
+		stream->text = text;
+		stream->capacity = capacity;
+	}
+
+	stream->text[stream->length++] = c;
+	return true;
+}
+
+//
+// drop_returned
+//
+// Removes the last statement from the front of the text, keeping
+// anything read after it.
+//
+static void drop_returned(struct STREAM* stream)
+{
+	for (size_t i = 0; i < stream->returned; i++) {
+		if (stream->text[i] == '\n') {
+			stream->line++;
+		}
+	}
+
+	memmove(stream->text, stream->text + stream->returned, stream->length - stream->returned);
+
+	stream->length -= stream->returned;
+	stream->returned = 0;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// stream_open
+//
+struct STREAM* stream_open(FILE* input)
+{
+	struct STREAM* stream = (struct STREAM*)malloc(sizeof(struct STREAM));
+	if (stream == NULL) {
+		return NULL;
+	}
+
+	stream->input = input;
+	stream->capacity = 4096;
+	stream->text = (char*)malloc(stream->capacity);
+	stream->length = 0;
+	stream->line = 1;
+	stream->returned = 0;
+	stream->ended = false;
+	stream->read_any = false;
+
+	if (stream->text == NULL) {
+		free(stream);
+		return NULL;
+	}
+
+	return stream;
+}
+
+//
+// stream_close
+//
+void stream_close(struct STREAM* stream)
+{
+	if (stream != NULL) {
+		free(stream->text);
+		free(stream);
+	}
+}
+
+//
+// stream_next
+//
+// Whatever was read past the last statement (the start of a line
+// after an if) is fed through again first, since it starts this one.
+//
+int stream_next(struct STREAM* stream, struct TOKEN_BUFFER** tokens)
+{
+	*tokens = NULL;
+
+	drop_returned(stream);
+
+	if (stream->ended && stream->length == 0) {
+		return STREAM_END;
+	}
+
+	struct STMT_STATE st = { .kind = STREAM_NONE, .line_state = LINE_START };
+	size_t carried = stream->length;
+	int action = READ_ON;
+
+	stream->length = 0;
+	while (action == READ_ON && stream->length < carried) {
+		stream->length++;
+		action = feed(stream, &st, stream->text[stream->length - 1]);
+	}
+
+	while (action == READ_ON) {
+		int c = getc_unlocked(stream->input);
+
+		if (c == EOF) {
+			action = END;
+		}
+		else if (!append(stream, (char)c)) {
+			printf("**ERROR: out of memory (stream_next)\n");
+			return STREAM_ERROR;
+		}
+		else {
+			action = feed(stream, &st, (char)c);
+		}
+	}
+
+	if (action == END) {
+		stream->ended = true;
+
+		// just empty lines and comments after the last statement:
+		if (st.kind == STREAM_NONE && stream->read_any) {
+			stream->returned = stream->length;
+			return STREAM_END;
+		}
+	}
+
+	stream->returned = (action == SPLIT) ? st.line_start : stream->length;
+
+	*tokens = parser_parse_lines(stream->text, stream->returned, stream->line);
+	if (*tokens == NULL) {
+		return STREAM_ERROR;
+	}
+
+	stream->read_any = true;
+	return STREAM_STATEMENT;
+}
@@ -0,0 +1,95 @@
+/*stream.h*/
+
+//
+// Streaming reader for nuPython programs. Instead of parsing the whole
+// program before any of it runs, the input is read a top-level
+// statement at a time: a simple statement ends with its line, a while
+// loop with the } that closes its block, and an if with the line after
+// its last block that isn't an elif or else. Each statement is parsed
+// on its own (see parser_parse_lines), so it can be built and run
+// before the rest of the program has even been typed.
+//
+// The reader tracks just enough of the scanner's rules --- strings,
+// comments, braces, the $ that ends the program --- to find where the
+// statements end; the parser checks everything else, and reports an
+// error at its line in the whole input.
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stddef.h>   // size_t
+#include <stdbool.h>  // true, false
+#include "tokenbuffer.h"
+
+
+//
+// the kinds of top-level statements the reader tells apart:
+//
+enum STREAM_STMT_KINDS
+{
+  STREAM_NONE = 0,  // only empty lines and comments so far
+  STREAM_SIMPLE,    // ends with its line
+  STREAM_WHILE,     // ends with the line its block closes on
+  STREAM_IF         // ... unless the next line is an elif / else
+};
+
+struct STREAM
+{
+  FILE* input;
+
+  char*  text;      // the statement being read
+  size_t length;
+  size_t capacity;
+  int    line;      // line # the text starts on
+  size_t returned;  // # of bytes of text that were the last statement
+
+  bool ended;       // $ or the end of the input was read
+  bool read_any;    // a statement has been returned
+};
+
+//
+// what stream_next found:
+//
+enum STREAM_RESULTS
+{
+  STREAM_STATEMENT = 0,  // the tokens of the next statement
+  STREAM_END,            // the end of the program
+  STREAM_ERROR           // a syntax error, already reported
+};
+
+
+//
+// Public functions:
+//
+
+//
+// stream_open
+//
+// Returns a reader for the program in the given input, or NULL if
+// memory could not be allocated.
+//
+struct STREAM* stream_open(FILE* input);
+
+//
+// stream_close
+//
+// Frees the reader; the input is left open, after the $ that ended
+// the program (if one was read).
+//
+void stream_close(struct STREAM* stream);
+
+//
+// stream_next
+//
+// Reads the next top-level statement, along with any empty lines and
+// comments before it, and parses it. If it is valid, *tokens is set to
+// its tokens (ending with nuPy_EOS), which the caller frees with
+// tokenbuffer_destroy. A program with no statements at all is a syntax
+// error, as it is for parser_parse.
+//
+int stream_next(struct STREAM* stream, struct TOKEN_BUFFER** tokens);
@@ -0,0 +1,61 @@
+print('if / elif / else')
+
+i = 0
+s = 0
+
+while i < 40:
+{
+  k = i % 9
+
+  if k == 0:
+  {
+    s = s + 1
+  }
+  elif k == 1:
+  {
+    s = s + 10
+  }
+  elif 2 == k:
+  {
+    s = s + 100
+  }
+  elif k == 3:
+  {
+    pass
+  }
+  elif k == 5:
+  {
+    s = s - 3
+  }
+  elif k > 6:
+  {
+    s = s * 2
+  }
+  else:
+  {
+    s = s + 1000
+  }
+
+  i = i + 1
+}
+
+print(s)
+
+x = 2.5
+p = &x
+
+if *p < 3:
+{
+  print('less')
+}
+
+if x > 3:
+{
+  print('greater')
+}
+else:
+{
+  print('not greater')
+}
+
+print('done')
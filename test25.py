@@ -0,0 +1,34 @@
+print('conditions that fail')
+
+s = 'text'
+x = 5
+i = 0
+
+print('before')
+
+while s:
+{
+  print('not run')
+}
+
+print('after a string condition')
+
+while x / 0:
+{
+  print('not run')
+}
+
+print('after dividing by zero')
+
+while i < 3:
+{
+  print(i)
+  i = i + 1
+}
+
+if s:
+{
+  print('not run')
+}
+
+print('after an if')
@@ -0,0 +1,60 @@
+print('variables no pointer can reach')
+
+s = 'ab'
+t = ''
+i = 0
+n = 1200
+
+while i < n:
+{
+  t = t + s
+  i = i + 1
+  t = s
+}
+print(t)
+
+x = 5
+p = &x
+z = *p + i
+print(z)
+
+p = &z
+*p = t
+t = *p + s
+print(t)
+
+k = i - 1195
+if k == 1:
+{
+  print('one')
+}
+elif k == 3:
+{
+  print('three')
+}
+elif k == 5:
+{
+  print('five')
+}
+elif k == 7:
+{
+  print('seven')
+}
+else:
+{
+  print('other')
+}
+
+r = 0.5
+j = 0
+while j < 2000:
+{
+  r = r * 1.001
+  j = j + 1
+}
+print(r)
+
+w = t
+t = 1
+print(w)
+print(u)
@@ -0,0 +1,223 @@
+/*tokenbuffer.c*/
+
+//
+// << Token buffer: the parser's tokens packed into one array, with
+//    their values in one string pool, read through cursors. >>
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "token.h"
+#include "tokenqueue.h"
+#include "tokenbuffer.h"
+
+
+//
+// Private functions:
+//
+
+//
+// out_of_memory
+//
+// Outputs an error message and exits, as the parser does.
+//
+static void out_of_memory(void)
+{
+	printf("**TOKENBUFFER ERROR: out of memory (tokenbuffer_create)\n");
+	exit(-1);
+}
+
+//
+// at
+//
+// Returns the token index positions past the cursor, or the final
+// nuPy_EOS token if that's past the end.
+//
+static const struct BUFFERED_TOKEN* at(const struct TOKEN_CURSOR* cursor, int index)
+{
+	const struct TOKEN_BUFFER* buffer = cursor->buffer;
+
+	index += cursor->index;
+	if (index >= buffer->num_tokens) {
+		index = buffer->num_tokens - 1;
+	}
+
+	return &buffer->tokens[index];
+}
+
+static struct Token token_at(const struct TOKEN_CURSOR* cursor, int index)
+{
+	const struct BUFFERED_TOKEN* token = at(cursor, index);
+
+	return (struct Token) { .id = token->id, .line = token->line, .col = token->col };
+}
+
+
+//
+// Public functions:
+//
+
+//
+// tokenbuffer_create
+//
+// Sizes the buffer to fit the tokens exactly, then copies them in.
+//
+struct TOKEN_BUFFER* tokenbuffer_create(struct TokenQueue* tokens)
+{
+	int num_tokens = 0;
+	int pool_size = 0;
+
+	for (struct TokenNode* node = tokens->head; node != NULL; node = node->next) {
+		num_tokens++;
+		pool_size += (node->value == NULL ? 0 : (int)strlen(node->value)) + 1;
+	}
+
+	struct TOKEN_BUFFER* buffer = tokenbuffer_alloc(num_tokens + 1, pool_size + 1);
+	if (buffer == NULL) {
+		out_of_memory();
+	}
+
+	for (struct TokenNode* node = tokens->head; node != NULL; node = node->next) {
+		const char* value = (node->value == NULL) ? "" : node->value;
+
+		tokenbuffer_append(buffer, node->token, value, (int)strlen(value));
+	}
+
+	// never empty, so a cursor always has a token to stop at
+	if (num_tokens == 0) {
+		struct Token eos = { .id = nuPy_EOS, .line = 1, .col = 1 };
+		tokenbuffer_append(buffer, eos, "$", 1);
+	}
+
+	return buffer;
+}
+
+//
+// tokenbuffer_alloc
+//
+struct TOKEN_BUFFER* tokenbuffer_alloc(int num_tokens, int pool_size)
+{
+	struct TOKEN_BUFFER* buffer = (struct TOKEN_BUFFER*)malloc(sizeof(struct TOKEN_BUFFER));
+	if (buffer == NULL) {
+		return NULL;
+	}
+
+	buffer->capacity = (num_tokens > 16) ? num_tokens : 16;
+	buffer->pool_capacity = (pool_size > 64) ? pool_size : 64;
+	buffer->num_tokens = 0;
+	buffer->pool_size = 0;
+	buffer->quiet = false;
+
+	buffer->tokens = (struct BUFFERED_TOKEN*)malloc(buffer->capacity * sizeof(struct BUFFERED_TOKEN));
+	buffer->pool = (char*)malloc(buffer->pool_capacity);
+
+	if (buffer->tokens == NULL || buffer->pool == NULL) {
+		tokenbuffer_destroy(buffer);
+		return NULL;
+	}
+
+	return buffer;
+}
+
+//
+// tokenbuffer_append
+//
+// The arrays double when they fill up.
+//
+bool tokenbuffer_append(struct TOKEN_BUFFER* buffer, struct Token token, const char* value, int len)
+{
+	if (buffer->num_tokens == buffer->capacity) {
+		struct BUFFERED_TOKEN* tokens = (struct BUFFERED_TOKEN*)realloc(buffer->tokens, 2 * buffer->capacity * sizeof(struct BUFFERED_TOKEN));
+		if (tokens == NULL) {
+			return false;
+		}
+		buffer->tokens = tokens;
+		buffer->capacity *= 2;
+	}
+
+	if (buffer->pool_capacity - buffer->pool_size < len + 1) {
+		int pool_capacity = 2 * buffer->pool_capacity + len + 1;
+		char* pool = (char*)realloc(buffer->pool, pool_capacity);
+		if (pool == NULL) {
+			return false;
+		}
+		buffer->pool = pool;
+		buffer->pool_capacity = pool_capacity;
+	}
+
+	struct BUFFERED_TOKEN* buffered = &buffer->tokens[buffer->num_tokens++];
+
+	buffered->id = token.id;
+	buffered->line = token.line;
+	buffered->col = token.col;
+	buffered->offset = buffer->pool_size;
+	buffered->len = len;
+
+	memcpy(buffer->pool + buffer->pool_size, value, len);
+	buffer->pool[buffer->pool_size + len] = '\0';
+	buffer->pool_size += len + 1;
+
+	return true;
+}
+
+//
+// tokenbuffer_destroy
+//
+void tokenbuffer_destroy(struct TOKEN_BUFFER* buffer)
+{
+	if (buffer != NULL) {
+		free(buffer->tokens);
+		free(buffer->pool);
+		free(buffer);
+	}
+}
+
+//
+// tokenbuffer_cursor
+//
+struct TOKEN_CURSOR tokenbuffer_cursor(const struct TOKEN_BUFFER* buffer)
+{
+	return (struct TOKEN_CURSOR) { .buffer = buffer, .index = 0 };
+}
+
+//
+// tokenbuffer_peekToken / tokenbuffer_peekValue
+//
+struct Token tokenbuffer_peekToken(const struct TOKEN_CURSOR* cursor)
+{
+	return token_at(cursor, 0);
+}
+
+const char* tokenbuffer_peekValue(const struct TOKEN_CURSOR* cursor)
+{
+	return cursor->buffer->pool + at(cursor, 0)->offset;
+}
+
+//
+// tokenbuffer_peek2Token / tokenbuffer_peek2Value
+//
+struct Token tokenbuffer_peek2Token(const struct TOKEN_CURSOR* cursor)
+{
+	return token_at(cursor, 1);
+}
+
+const char* tokenbuffer_peek2Value(const struct TOKEN_CURSOR* cursor)
+{
+	return cursor->buffer->pool + at(cursor, 1)->offset;
+}
+
+//
+// tokenbuffer_dequeue
+//
+void tokenbuffer_dequeue(struct TOKEN_CURSOR* cursor)
+{
+	if (cursor->index < cursor->buffer->num_tokens - 1) {
+		cursor->index++;
+	}
+}
@@ -0,0 +1,126 @@
+/*tokenbuffer.h*/
+
+//
+// Contiguous token buffer for nuPython. The parser hands back its
+// tokens as a TokenQueue, a linked list with a malloc'd node and value
+// string per token; the buffer packs them into one array of tokens,
+// whose values are slices of one string pool, so building the program
+// graph walks two blocks of memory instead of a node per token.
+//
+// The buffer is read through a cursor, with the same peek / peek2 /
+// dequeue operations as the TokenQueue. A cursor is just a position in
+// the buffer, so duplicating one (e.g. to look ahead and back up) is a
+// struct copy, and never copies the tokens.
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+#include "token.h"
+#include "tokenqueue.h"
+
+
+//
+// a token, with its value as a slice of the pool:
+//
+struct BUFFERED_TOKEN
+{
+  int id;      // token id (see token.h)
+  int line;    // line containing the token (1-based)
+  int col;     // column where the token starts (1-based)
+  int offset;  // start of the value in TOKEN_BUFFER::pool
+  int len;     // length of the value (it is also '\0'-terminated)
+};
+
+struct TOKEN_BUFFER
+{
+  struct BUFFERED_TOKEN* tokens;
+  int num_tokens;  // the last one is nuPy_EOS
+  int capacity;    // # of tokens there's room for
+  char* pool;      // every value, one after the other
+  int pool_size;   // # of bytes in use
+  int pool_capacity;  // # of bytes there's room for
+  bool quiet;      // read without the parser, which outputs warnings (see parsebuffer.h)
+};
+
+//
+// a position in a token buffer; copy it to duplicate it:
+//
+struct TOKEN_CURSOR
+{
+  const struct TOKEN_BUFFER* buffer;
+  int index;  // the next token
+};
+
+
+//
+// Public functions:
+//
+
+//
+// tokenbuffer_create
+//
+// Packs the tokens of the given queue, as returned by the parser, into
+// a new buffer; the queue is left alone. Like the parser, exits with an
+// error message if memory could not be allocated.
+//
+struct TOKEN_BUFFER* tokenbuffer_create(struct TokenQueue* tokens);
+
+//
+// tokenbuffer_alloc
+//
+// Returns a new, empty buffer with room for about the given # of
+// tokens and bytes of values, to be filled by tokenbuffer_append (a
+// buffer must end with a nuPy_EOS token before it is read). Returns
+// NULL if memory could not be allocated.
+//
+struct TOKEN_BUFFER* tokenbuffer_alloc(int num_tokens, int pool_size);
+
+//
+// tokenbuffer_append
+//
+// Adds the given token, whose value is the first len chars of value,
+// to the end of the buffer. Returns false if memory could not be
+// allocated.
+//
+bool tokenbuffer_append(struct TOKEN_BUFFER* buffer, struct Token token, const char* value, int len);
+
+//
+// tokenbuffer_destroy
+//
+void tokenbuffer_destroy(struct TOKEN_BUFFER* buffer);
+
+//
+// tokenbuffer_cursor
+//
+// Returns a cursor at the first token of the given buffer.
+//
+struct TOKEN_CURSOR tokenbuffer_cursor(const struct TOKEN_BUFFER* buffer);
+
+//
+// tokenbuffer_peekToken / tokenbuffer_peekValue
+//
+// Returns the next token (or its value) without advancing.
+//
+struct Token tokenbuffer_peekToken(const struct TOKEN_CURSOR* cursor);
+const char*  tokenbuffer_peekValue(const struct TOKEN_CURSOR* cursor);
+
+//
+// tokenbuffer_peek2Token / tokenbuffer_peek2Value
+//
+// Returns the token after the next one (or its value).
+//
+struct Token tokenbuffer_peek2Token(const struct TOKEN_CURSOR* cursor);
+const char*  tokenbuffer_peek2Value(const struct TOKEN_CURSOR* cursor);
+
+//
+// tokenbuffer_dequeue
+//
+// Advances the cursor past the next token. The cursor stays at the
+// final nuPy_EOS token once it gets there.
+//
+void tokenbuffer_dequeue(struct TOKEN_CURSOR* cursor);
@@ -0,0 +1,135 @@
+/*tokenring.c*/
+
+//
+// << Token ring: a lock-free single-producer / single-consumer queue of
+//    tokens between the scanner's thread and the parser's. >>
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#define _POSIX_C_SOURCE 200809L  // sched_yield
+
+#include <stdbool.h>  // true, false
+#include <stddef.h>
+#include <stdatomic.h>
+#include <sched.h>
+
+#include "tokenring.h"
+
+
+#define SPINS 256  // times to check again before yielding the core
+
+
+//
+// Private functions:
+//
+
+//
+// backoff
+//
+// Called each time a side finds it has to wait; spins for a while,
+// then lets the other thread have the core.
+//
+static void backoff(int* waits)
+{
+	if (++*waits > SPINS) {
+		sched_yield();
+	}
+}
+
+
+//
+// Public functions:
+//
+
+//
+// tokenring_init
+//
+void tokenring_init(struct TOKEN_RING* ring)
+{
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->tail, 0);
+	atomic_init(&ring->cancelled, false);
+
+	ring->pushed = 0;
+	ring->tail_seen = 0;
+	ring->head_seen = 0;
+}
+
+//
+// tokenring_push
+//
+// The slot written is only read by the consumer once the head moves
+// past it, which the release store in tokenring_flush makes visible
+// after the token itself.
+//
+bool tokenring_push(struct TOKEN_RING* ring, struct RING_TOKEN token)
+{
+	int waits = 0;
+
+	while (ring->pushed - ring->tail_seen == TOKENRING_SIZE) {
+		if (atomic_load_explicit(&ring->cancelled, memory_order_relaxed)) {
+			return false;
+		}
+
+		// publish what's there first, or a consumer waiting on it never frees a slot
+		tokenring_flush(ring);
+
+		ring->tail_seen = atomic_load_explicit(&ring->tail, memory_order_acquire);
+		if (ring->pushed - ring->tail_seen == TOKENRING_SIZE) {
+			backoff(&waits);
+		}
+	}
+
+	ring->tokens[ring->pushed % TOKENRING_SIZE] = token;
+	ring->pushed++;
+
+	if (ring->pushed % TOKENRING_BATCH == 0) {
+		tokenring_flush(ring);
+	}
+
+	return true;
+}
+
+//
+// tokenring_flush
+//
+void tokenring_flush(struct TOKEN_RING* ring)
+{
+	atomic_store_explicit(&ring->head, ring->pushed, memory_order_release);
+}
+
+//
+// tokenring_pop
+//
+int tokenring_pop(struct TOKEN_RING* ring, struct RING_TOKEN* tokens, int max)
+{
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	int waits = 0;
+
+	while (ring->head_seen == tail) {
+		ring->head_seen = atomic_load_explicit(&ring->head, memory_order_acquire);
+		if (ring->head_seen == tail) {
+			backoff(&waits);
+		}
+	}
+
+	int count = 0;
+	while (count < max && tail != ring->head_seen) {
+		tokens[count++] = ring->tokens[tail % TOKENRING_SIZE];
+		tail++;
+	}
+
+	atomic_store_explicit(&ring->tail, tail, memory_order_release);
+	return count;
+}
+
+//
+// tokenring_cancel
+//
+void tokenring_cancel(struct TOKEN_RING* ring)
+{
+	atomic_store_explicit(&ring->cancelled, true, memory_order_relaxed);
+}
@@ -0,0 +1,108 @@
+/*tokenring.h*/
+
+//
+// Lock-free single-producer / single-consumer ring of tokens, to run the
+// scanner and the parser on two threads (see parser_parse_file). The
+// scanner's thread pushes tokens as it finds them, and the parser's
+// thread pops them in the same order.
+//
+// Neither side takes a lock: the producer owns the head, the consumer
+// owns the tail, and each only reads the other's (with acquire /
+// release ordering). Tokens are published in batches, so the two
+// threads touch each other's cache lines about once every
+// TOKENRING_BATCH tokens rather than once a token. A side that finds
+// the ring full (or empty) spins briefly and then yields its core.
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#pragma once
+
+#include <stdbool.h>    // true, false
+#include <stddef.h>     // size_t
+#include <stdatomic.h>
+#include "token.h"
+
+
+#define TOKENRING_SIZE  4096  // # of tokens the ring holds (a power of 2)
+#define TOKENRING_BATCH 64    // # of tokens the producer publishes at a time
+
+//
+// a pushed token whose id is this means the producer failed, and there
+// are no more:
+//
+#define TOKENRING_FAILED -1
+
+//
+// a token, with its value in memory that outlives the ring (e.g. the
+// program's text):
+//
+struct RING_TOKEN
+{
+  int id;      // token id (see token.h), or TOKENRING_FAILED
+  int line;
+  int col;
+  int len;     // length of the value
+  const char* value;
+};
+
+struct TOKEN_RING
+{
+  struct RING_TOKEN tokens[TOKENRING_SIZE];
+
+  //
+  // each side's position on a cache line of its own, so the other
+  // side's reads don't keep stealing it:
+  //
+  _Alignas(64) atomic_size_t head;  // # of tokens published
+  size_t pushed;                    // # of tokens pushed (producer only)
+  size_t tail_seen;                 // last tail the producer read
+
+  _Alignas(64) atomic_size_t tail;  // # of tokens popped
+  size_t head_seen;                 // last head the consumer read
+
+  _Alignas(64) atomic_bool cancelled;  // the consumer stopped early
+};
+
+
+//
+// Public functions:
+//
+
+//
+// tokenring_init
+//
+void tokenring_init(struct TOKEN_RING* ring);
+
+//
+// tokenring_push
+//
+// Producer: adds a token, waiting while the ring is full. Returns false
+// if the consumer cancelled, in which case the producer should stop.
+//
+bool tokenring_push(struct TOKEN_RING* ring, struct RING_TOKEN token);
+
+//
+// tokenring_flush
+//
+// Producer: publishes the tokens pushed so far. Call it after the last
+// token.
+//
+void tokenring_flush(struct TOKEN_RING* ring);
+
+//
+// tokenring_pop
+//
+// Consumer: moves up to max tokens into the given array, in order,
+// waiting until there is at least one. Returns the # moved.
+//
+int tokenring_pop(struct TOKEN_RING* ring, struct RING_TOKEN* tokens, int max);
+
+//
+// tokenring_cancel
+//
+// Consumer: tells the producer to stop; it will push no more tokens.
+//
+void tokenring_cancel(struct TOKEN_RING* ring);
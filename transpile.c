@@ -0,0 +1,1458 @@
+/*transpile.c*/
+
+//
+// << Translates a nuPython program graph into C, for building the
+//    program ahead of time into a native executable. >>
+//
+// The translation is done in two passes:
+//
+//   1. inference: decide which variables can be typed C locals. A
+//      variable qualifies if every assignment to it has the same static
+//      type (int, real or boolean), and no pointer can reach its RAM
+//      cell: escape analysis (see escape.h) keeps variables whose
+//      address is taken (&x) in RAM, and all of them if the program may
+//      do pointer arithmetic, since a pointer can then walk to any cell.
+//      Statements left to the executor make their variables dynamic,
+//      since the executor works on RAM.
+//
+//   2. code generation: walk the graph again, writing one block of C per
+//      statement. Dynamic variables are read and written through RAM
+//      with the same checks and error messages as the VM.
+//
+// A typed local still gets its RAM cell when it is first assigned, so
+// RAM hands out addresses in the same order as the interpreter (which
+// pointers and ram_print() see), and its final value is written back
+// to the cell when run() ends, so memory at exit is the same too.
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+
+#include "programgraph.h"
+#include "resolve.h"
+#include "escape.h"
+#include "transpile.h"
+
+
+//
+// static types of variables and expressions; anything that isn't a
+// typed local is STATIC_DYNAMIC
+//
+enum STATIC_TYPES
+{
+  STATIC_UNSET = 0,  // no assignment seen (yet)
+  STATIC_INT,
+  STATIC_REAL,
+  STATIC_BOOL,
+  STATIC_STR,        // string literals only
+  STATIC_DYNAMIC
+};
+
+struct TRANSPILER
+{
+  FILE* out;    // file-scope declarations
+  FILE* body;   // the body of run(), copied to out at the end
+  int depth;    // indentation in body
+
+  struct SLOT_TABLE* slots;
+  int* types;   // static type of each slot (enum STATIC_TYPES)
+  bool changed; // did inference change a type?
+
+  //
+  // string literals, which become RAM_VALUEs allocated once at start-up
+  //
+  const char** strs;
+  int num_strs;
+  int strs_capacity;
+
+  int num_nodes;  // graph nodes emitted for the executor
+  bool failed;
+};
+
+//
+// runtime helpers included in every translation; they mirror vm.c
+//
+static const char* prelude[] = {
+	"#define NU_NONE ((struct RAM_VALUE){ .value_type = RAM_TYPE_NONE })",
+	"",
+	"static inline struct RAM_VALUE nu_int(int i) { struct RAM_VALUE v = { .value_type = RAM_TYPE_INT }; v.types.i = i; return v; }",
+	"static inline struct RAM_VALUE nu_real(double d) { struct RAM_VALUE v = { .value_type = RAM_TYPE_REAL }; v.types.d = d; return v; }",
+	"static inline struct RAM_VALUE nu_bool(int b) { struct RAM_VALUE v = { .value_type = RAM_TYPE_BOOLEAN }; v.types.i = b; return v; }",
+	"",
+	"static inline void nu_undefined(int slot, int line)",
+	"{",
+	"\tprintf(\"**SEMANTIC ERROR: name '%s' is not defined (line %d)\\n\", nu_names[slot], line);",
+	"}",
+	"",
+	"static inline void nu_zero_division(int line)",
+	"{",
+	"\tprintf(\"**ZeroDivisionError: division by zero (line %d)\\n\", line);",
+	"}",
+	"",
+	"// (int)pow(a, b) as the interpreter computes it on x86-64, where an",
+	"// out of range conversion gives INT_MIN (in C it is undefined, and",
+	"// the optimizer folds it differently)",
+	"static inline int nu_ipow(int a, int b)",
+	"{",
+	"\tdouble p = pow(a, b);",
+	"\treturn (p > -2147483649.0 && p < 2147483648.0) ? (int)p : (-2147483647 - 1);",
+	"}",
+	"",
+	"// value of a typed local, if it has been assigned",
+	"static inline bool nu_typed(bool set, int slot, int line, struct RAM_VALUE typed, struct RAM_VALUE* value)",
+	"{",
+	"\tif (!set) {",
+	"\t\tnu_undefined(slot, line);",
+	"\t\treturn false;",
+	"\t}",
+	"\t*value = typed;",
+	"\treturn true;",
+	"}",
+	"",
+	"// borrows the value of a variable in RAM",
+	"static inline bool nu_fetch(struct RAM* memory, int slot, int line, struct RAM_VALUE* value)",
+	"{",
+	"\tconst struct RAM_VALUE* var = ram_borrow_cell_by_slot(memory, slot);",
+	"\tif (var == NULL) {",
+	"\t\tnu_undefined(slot, line);",
+	"\t\treturn false;",
+	"\t}",
+	"\t*value = *var;",
+	"\treturn true;",
+	"}",
+	"",
+	"static inline bool nu_fetch_addr(struct RAM* memory, int slot, int line, struct RAM_VALUE* value)",
+	"{",
+	"\tint addr = ram_get_addr_by_slot(memory, slot);",
+	"\tif (addr == -1) {",
+	"\t\tnu_undefined(slot, line);",
+	"\t\treturn false;",
+	"\t}",
+	"\tvalue->value_type = RAM_TYPE_PTR;",
+	"\tvalue->types.i = addr;",
+	"\treturn true;",
+	"}",
+	"",
+	"static inline bool nu_fetch_deref(struct RAM* memory, int slot, int line, struct RAM_VALUE* value)",
+	"{",
+	"\tconst struct RAM_VALUE* ptr = ram_borrow_cell_by_slot(memory, slot);",
+	"\tif (ptr == NULL) {",
+	"\t\tnu_undefined(slot, line);",
+	"\t\treturn false;",
+	"\t}",
+	"\tif (ptr->value_type != RAM_TYPE_PTR) {",
+	"\t\tprintf(\"**SEMANTIC ERROR: invalid operand types (line %d)\\n\", line);",
+	"\t\treturn false;",
+	"\t}",
+	"\tconst struct RAM_VALUE* target = ram_borrow_cell_by_addr(memory, ptr->types.i);",
+	"\tif (target == NULL) {",
+	"\t\tprintf(\"**SEMANTIC ERROR: '%s' contains invalid address (line %d)\\n\", nu_names[slot], line);",
+	"\t\treturn false;",
+	"\t}",
+	"\t*value = *target;",
+	"\treturn true;",
+	"}",
+	"",
+	"static inline bool nu_binary(int operator, struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE* result,",
+	"\tint line, struct RAM* memory, bool lhs_deref, bool rhs_deref)",
+	"{",
+	"\treturn determine_op_result(operator, lhs, rhs, result, line, memory, lhs_deref, rhs_deref);",
+	"}",
+	"",
+	"static inline bool nu_store(struct RAM* memory, struct RAM_VALUE value, int slot)",
+	"{",
+	"\tif (!ram_write_cell_by_slot(memory, value, slot, nu_names[slot])) {",
+	"\t\tprintf(\"**ERROR: Could not write variable to memory. Variable: %s\\n\", nu_names[slot]);",
+	"\t\treturn false;",
+	"\t}",
+	"\treturn true;",
+	"}",
+	"",
+	"static inline bool nu_print(struct RAM* memory, int slot, int line)",
+	"{",
+	"\tconst struct RAM_VALUE* value = ram_borrow_cell_by_slot(memory, slot);",
+	"\tif (value == NULL) {",
+	"\t\tnu_undefined(slot, line);",
+	"\t\treturn false;",
+	"\t}",
+	"\tswitch (value->value_type) {",
+	"\t\tcase RAM_TYPE_INT:     printf(\"%d\\n\", value->types.i); break;",
+	"\t\tcase RAM_TYPE_REAL:    printf(\"%f\\n\", value->types.d); break;",
+	"\t\tcase RAM_TYPE_BOOLEAN: printf(\"%s\\n\", value->types.i ? \"True\" : \"False\"); break;",
+	"\t\tcase RAM_TYPE_STR:     printf(\"%s\\n\", value->types.s->chars); break;",
+	"\t\tcase RAM_TYPE_PTR:     printf(\"%d\\n\", value->types.i); break;",
+	"\t\tdefault:",
+	"\t\t\tprintf(\"**ERROR: Unsupported variable type for '%s'\\n\", nu_names[slot]);",
+	"\t\t\treturn false;",
+	"\t}",
+	"\treturn true;",
+	"}",
+	"",
+	"// while loop / if test: 1 => run the body, 0 => leave the loop / take the false path, -1 => stop",
+	"static inline int nu_test(bool ok, struct RAM_VALUE* result, bool owned, bool loop, int line)",
+	"{",
+	"\tint go;",
+	"\tif (!ok) {",
+	"\t\tgo = (loop && result->value_type != RAM_TYPE_NONE) ? 0 : -1;",
+	"\t}",
+	"\telse if (result->value_type == RAM_TYPE_BOOLEAN || result->value_type == RAM_TYPE_INT) {",
+	"\t\tgo = (result->types.i != 0);",
+	"\t}",
+	"\telse if (result->value_type == RAM_TYPE_REAL) {",
+	"\t\tgo = (result->types.d != 0.0);",
+	"\t}",
+	"\telse if (loop) {",
+	"\t\tprintf(\"**SEMANTIC ERROR: invalid while loop condition type (line %d)\\n\", line);",
+	"\t\tgo = 0;",
+	"\t}",
+	"\telse {",
+	"\t\tprintf(\"**SEMANTIC ERROR: invalid if condition type (line %d)\\n\", line);",
+	"\t\tgo = -1;",
+	"\t}",
+	"\tif (owned) {",
+	"\t\tram_value_release(result);",
+	"\t}",
+	"\treturn go;",
+	"}",
+	NULL
+};
+
+
+//
+// Private functions:
+//
+
+//
+// indent
+//
+// Starts a new line of run()'s body at the current depth.
+//
+static void indent(struct TRANSPILER* t)
+{
+	for (int i = 0; i < t->depth; i++) {
+		fputc('\t', t->body);
+	}
+}
+
+
+//
+// write_c_string
+//
+// Writes the given text as a C string literal.
+//
+static void write_c_string(FILE* out, const char* text)
+{
+	if (text == NULL) {
+		fprintf(out, "NULL");
+		return;
+	}
+
+	fputc('"', out);
+	for (const unsigned char* c = (const unsigned char*)text; *c != '\0'; c++) {
+		if (*c == '"' || *c == '\\') {
+			fprintf(out, "\\%c", *c);
+		}
+		else if (*c == '\n') {
+			fprintf(out, "\\n");
+		}
+		else if (*c == '\t') {
+			fprintf(out, "\\t");
+		}
+		else if (*c < 0x20 || *c >= 0x7F || *c == '?') {
+			// octal always with 3 digits, and ? to stay clear of trigraphs
+			fprintf(out, "\\%03o", *c);
+		}
+		else {
+			fputc(*c, out);
+		}
+	}
+	fputc('"', out);
+}
+
+
+//
+// write_int / write_real
+//
+// Writes a literal's value (decoded as the executor does) as C.
+//
+static void write_int(FILE* out, int value)
+{
+	if (value == INT_MIN) {
+		fprintf(out, "(%d - 1)", INT_MIN + 1);
+	}
+	else if (value < 0) {
+		fprintf(out, "(%d)", value);
+	}
+	else {
+		fprintf(out, "%d", value);
+	}
+}
+
+static void write_real(FILE* out, double value)
+{
+	if (isnan(value)) {
+		fprintf(out, "NAN");
+	}
+	else if (isinf(value)) {
+		fprintf(out, value > 0 ? "HUGE_VAL" : "(-HUGE_VAL)");
+	}
+	else {
+		char text[64];
+		snprintf(text, sizeof(text), "%.17g", value);
+		bool is_real = (strpbrk(text, ".e") != NULL);
+		fprintf(out, value < 0 ? "(%s%s)" : "%s%s", text, is_real ? "" : ".0");
+	}
+}
+
+
+//
+// add_str
+//
+// Adds the given text to the string literals, returning its index.
+//
+static int add_str(struct TRANSPILER* t, const char* text)
+{
+	if (t->num_strs >= t->strs_capacity) {
+		int new_cap = t->strs_capacity * 2;
+		const char** new_strs = (const char**)realloc(t->strs, new_cap * sizeof(char*));
+		if (new_strs == NULL) {
+			t->failed = true;
+			return 0;
+		}
+		t->strs = new_strs;
+		t->strs_capacity = new_cap;
+	}
+
+	t->strs[t->num_strs] = text;
+	return t->num_strs++;
+}
+
+
+//
+// is_native_operand
+//
+// Returns true if the given unary expression can be translated, i.e.
+// the VM has an operand for it (see compile_operand in vm.c).
+//
+static bool is_native_operand(struct UNARY_EXPR* expr)
+{
+	struct ELEMENT* element = expr->element;
+
+	if (expr->expr_type == UNARY_PTR_DEREF || expr->expr_type == UNARY_ADDRESS_OF) {
+		return element->element_type == ELEMENT_IDENTIFIER;
+	}
+
+	return element->element_type != ELEMENT_NONE;
+}
+
+static bool is_native_expr(struct EXPR* expr)
+{
+	return is_native_operand(expr->lhs) && (!expr->isBinaryExpr || is_native_operand(expr->rhs));
+}
+
+//
+// is_native_stmt
+//
+// Returns true if the given statement is translated into C, false if
+// it is left to the executor (a while loop always is translated, but
+// may leave its condition to the executor).
+//
+static bool is_native_stmt(struct STMT* stmt)
+{
+	if (stmt->stmt_type == STMT_ASSIGNMENT) {
+		struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+		return !assignment->isPtrDeref && assignment->rhs->value_type == VALUE_EXPR &&
+			is_native_expr(assignment->rhs->types.expr);
+	}
+
+	if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+		return stmt->types.function_call->builtin == BUILTIN_PRINT;
+	}
+
+	return true;
+}
+
+
+//
+// mark_element / mark_expr
+//
+// Makes the variable in the given element (if any) dynamic.
+//
+static void mark_element(struct TRANSPILER* t, struct ELEMENT* element)
+{
+	if (element != NULL && element->element_type == ELEMENT_IDENTIFIER) {
+		t->types[element->slot] = STATIC_DYNAMIC;
+	}
+}
+
+static void mark_expr(struct TRANSPILER* t, struct EXPR* expr)
+{
+	mark_element(t, expr->lhs->element);
+	if (expr->isBinaryExpr) {
+		mark_element(t, expr->rhs->element);
+	}
+}
+
+
+//
+// next_stmt
+//
+// Returns the statement following the given one.
+//
+static struct STMT* next_stmt(struct STMT* stmt)
+{
+	switch (stmt->stmt_type) {
+		case STMT_ASSIGNMENT:    return stmt->types.assignment->next_stmt;
+		case STMT_FUNCTION_CALL: return stmt->types.function_call->next_stmt;
+		case STMT_IF_THEN_ELSE:  return stmt->types.if_then_else->next_stmt;
+		case STMT_WHILE_LOOP:    return stmt->types.while_loop->next_stmt;
+		case STMT_PASS:          return stmt->types.pass->next_stmt;
+		default:                 return NULL;
+	}
+}
+
+
+//
+// find_escapes
+//
+// Makes every variable a pointer can reach dynamic (see escape.h), so
+// it stays in RAM. Returns false if memory could not be allocated.
+//
+static bool find_escapes(struct TRANSPILER* t, struct STMT* program)
+{
+	bool* escaped = (bool*)calloc(t->slots->num_slots + 1, sizeof(bool));
+
+	if (escaped == NULL || !escape_find(t->slots, program, escaped)) {
+		free(escaped);
+		return false;
+	}
+
+	for (int slot = 0; slot < t->slots->num_slots; slot++) {
+		if (escaped[slot]) {
+			t->types[slot] = STATIC_DYNAMIC;
+		}
+	}
+
+	free(escaped);
+	return true;
+}
+
+
+//
+// mark_fallbacks
+//
+// Makes every variable used by a statement left to the executor
+// dynamic. Returns false if the program has a statement we can't
+// translate at all.
+//
+static bool mark_fallbacks(struct TRANSPILER* t, struct STMT* stmt, struct STMT* stop)
+{
+	while (stmt != stop) {
+		if (stmt == NULL) {
+			return false;
+		}
+
+		if (stmt->stmt_type == STMT_IF_THEN_ELSE) {
+			struct STMT_IF_THEN_ELSE* ifthen = stmt->types.if_then_else;
+			if (!is_native_expr(ifthen->condition)) {
+				mark_expr(t, ifthen->condition);
+			}
+			if (!mark_fallbacks(t, ifthen->true_path, ifthen->next_stmt) ||
+				!mark_fallbacks(t, ifthen->false_path, ifthen->next_stmt)) {
+				return false;
+			}
+		}
+		else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+			struct STMT_WHILE_LOOP* loop = stmt->types.while_loop;
+			if (!is_native_expr(loop->condition)) {
+				mark_expr(t, loop->condition);
+			}
+			if (!mark_fallbacks(t, loop->loop_body, stmt)) {
+				return false;
+			}
+		}
+		else if (!is_native_stmt(stmt)) {
+			if (stmt->stmt_type == STMT_ASSIGNMENT) {
+				struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+				t->types[assignment->slot] = STATIC_DYNAMIC;
+				if (assignment->rhs->value_type == VALUE_EXPR) {
+					mark_expr(t, assignment->rhs->types.expr);
+				}
+				else {
+					mark_element(t, assignment->rhs->types.function_call->parameter);
+				}
+			}
+			else {
+				mark_element(t, stmt->types.function_call->parameter);
+			}
+		}
+
+		stmt = next_stmt(stmt);
+	}
+
+	return true;
+}
+
+
+//
+// operand_type / binary_type / expr_type
+//
+// Static type of an operand / expression, given the types inferred
+// for the variables so far.
+//
+static int operand_type(struct TRANSPILER* t, struct UNARY_EXPR* expr)
+{
+	if (expr->expr_type == UNARY_PTR_DEREF || expr->expr_type == UNARY_ADDRESS_OF) {
+		return STATIC_DYNAMIC;
+	}
+
+	switch (expr->element->element_type) {
+		case ELEMENT_IDENTIFIER:   return t->types[expr->element->slot];
+		case ELEMENT_INT_LITERAL:  return STATIC_INT;
+		case ELEMENT_REAL_LITERAL: return STATIC_REAL;
+		case ELEMENT_STR_LITERAL:  return STATIC_STR;
+		case ELEMENT_TRUE:
+		case ELEMENT_FALSE:        return STATIC_BOOL;
+		default:                   return STATIC_DYNAMIC;
+	}
+}
+
+static int binary_type(int operator, int lhs, int rhs)
+{
+	if (lhs == STATIC_UNSET || rhs == STATIC_UNSET) {
+		return STATIC_UNSET;
+	}
+
+	// strings, booleans, ... are errors or need RAM
+	bool lhs_num = (lhs == STATIC_INT || lhs == STATIC_REAL);
+	bool rhs_num = (rhs == STATIC_INT || rhs == STATIC_REAL);
+	if (!lhs_num || !rhs_num) {
+		return STATIC_DYNAMIC;
+	}
+
+	switch (operator) {
+		case OPERATOR_EQUAL:
+		case OPERATOR_NOT_EQUAL:
+		case OPERATOR_LT:
+		case OPERATOR_LTE:
+		case OPERATOR_GT:
+		case OPERATOR_GTE:
+			return STATIC_BOOL;
+
+		case OPERATOR_PLUS:
+		case OPERATOR_MINUS:
+		case OPERATOR_ASTERISK:
+		case OPERATOR_POWER:
+		case OPERATOR_MOD:
+		case OPERATOR_DIV:
+			return (lhs == STATIC_INT && rhs == STATIC_INT) ? STATIC_INT : STATIC_REAL;
+
+		default:
+			return STATIC_DYNAMIC;
+	}
+}
+
+static int expr_type(struct TRANSPILER* t, struct EXPR* expr)
+{
+	int lhs = operand_type(t, expr->lhs);
+
+	if (!expr->isBinaryExpr) {
+		return (lhs == STATIC_STR) ? STATIC_DYNAMIC : lhs;
+	}
+
+	return binary_type(expr->operator, lhs, operand_type(t, expr->rhs));
+}
+
+
+//
+// infer_types
+//
+// One round of inference over the statements from stmt up to stop:
+// joins the type of each translated assignment into its variable.
+//
+static void infer_types(struct TRANSPILER* t, struct STMT* stmt, struct STMT* stop)
+{
+	while (stmt != stop) {
+		if (stmt->stmt_type == STMT_WHILE_LOOP) {
+			infer_types(t, stmt->types.while_loop->loop_body, stmt);
+		}
+		else if (stmt->stmt_type == STMT_IF_THEN_ELSE) {
+			struct STMT_IF_THEN_ELSE* ifthen = stmt->types.if_then_else;
+			infer_types(t, ifthen->true_path, ifthen->next_stmt);
+			infer_types(t, ifthen->false_path, ifthen->next_stmt);
+		}
+		else if (stmt->stmt_type == STMT_ASSIGNMENT && is_native_stmt(stmt)) {
+			struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+			int old_type = t->types[assignment->slot];
+			int new_type = expr_type(t, assignment->rhs->types.expr);
+
+			if (old_type != STATIC_DYNAMIC && new_type != STATIC_UNSET && new_type != old_type) {
+				t->types[assignment->slot] = (old_type == STATIC_UNSET) ? new_type : STATIC_DYNAMIC;
+				t->changed = true;
+			}
+		}
+
+		stmt = next_stmt(stmt);
+	}
+}
+
+
+//
+// emit_* for the executor: graph nodes
+//
+// Writes a static copy of the given graph node (and its children) to
+// the declarations, returning its number; the node is named nu_gN.
+//
+static int emit_element_node(struct TRANSPILER* t, struct ELEMENT* element)
+{
+	if (element == NULL) {
+		return -1;
+	}
+
+	int n = t->num_nodes++;
+	fprintf(t->out, "static struct ELEMENT nu_g%d = { .element_type = %d, .element_value = ", n, element->element_type);
+	write_c_string(t->out, element->element_value);
+	fprintf(t->out, ", .slot = %d };\n", element->slot);
+	return n;
+}
+
+static int emit_unary_node(struct TRANSPILER* t, struct UNARY_EXPR* expr)
+{
+	if (expr == NULL) {
+		return -1;
+	}
+
+	int element = emit_element_node(t, expr->element);
+	int n = t->num_nodes++;
+	fprintf(t->out, "static struct UNARY_EXPR nu_g%d = { .expr_type = %d, .element = &nu_g%d };\n",
+		n, expr->expr_type, element);
+	return n;
+}
+
+static int emit_expr_node(struct TRANSPILER* t, struct EXPR* expr)
+{
+	int lhs = emit_unary_node(t, expr->lhs);
+	int rhs = expr->isBinaryExpr ? emit_unary_node(t, expr->rhs) : -1;
+	int n = t->num_nodes++;
+
+	fprintf(t->out, "static struct EXPR nu_g%d = { .lhs = &nu_g%d, .isBinaryExpr = %s, .operator = %d, .rhs = ",
+		n, lhs, expr->isBinaryExpr ? "true" : "false", expr->operator);
+	if (rhs == -1) {
+		fprintf(t->out, "NULL };\n");
+	}
+	else {
+		fprintf(t->out, "&nu_g%d };\n", rhs);
+	}
+	return n;
+}
+
+static void write_parameter(struct TRANSPILER* t, int parameter)
+{
+	if (parameter == -1) {
+		fprintf(t->out, "NULL");
+	}
+	else {
+		fprintf(t->out, "&nu_g%d", parameter);
+	}
+}
+
+static int emit_stmt_node(struct TRANSPILER* t, struct STMT* stmt)
+{
+	int child;
+
+	if (stmt->stmt_type == STMT_ASSIGNMENT) {
+		struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+		struct VALUE* rhs = assignment->rhs;
+		int value;
+
+		if (rhs->value_type == VALUE_EXPR) {
+			int expr = emit_expr_node(t, rhs->types.expr);
+			value = t->num_nodes++;
+			fprintf(t->out, "static struct VALUE nu_g%d = { .value_type = VALUE_EXPR, .types.expr = &nu_g%d };\n", value, expr);
+		}
+		else {
+			struct FUNCTION_CALL* call = rhs->types.function_call;
+			int parameter = emit_element_node(t, call->parameter);
+			int fn = t->num_nodes++;
+			fprintf(t->out, "static struct FUNCTION_CALL nu_g%d = { .function_name = ", fn);
+			write_c_string(t->out, call->function_name);
+			fprintf(t->out, ", .builtin = %d, .parameter = ", call->builtin);
+			write_parameter(t, parameter);
+			fprintf(t->out, " };\n");
+			value = t->num_nodes++;
+			fprintf(t->out, "static struct VALUE nu_g%d = { .value_type = VALUE_FUNCTION_CALL, .types.function_call = &nu_g%d };\n", value, fn);
+		}
+
+		child = t->num_nodes++;
+		fprintf(t->out, "static struct STMT_ASSIGNMENT nu_g%d = { .var_name = ", child);
+		write_c_string(t->out, assignment->var_name);
+		fprintf(t->out, ", .slot = %d, .isPtrDeref = %s, .rhs = &nu_g%d, .next_stmt = NULL };\n",
+			assignment->slot, assignment->isPtrDeref ? "true" : "false", value);
+	}
+	else {
+		struct STMT_FUNCTION_CALL* call = stmt->types.function_call;
+		int parameter = emit_element_node(t, call->parameter);
+		child = t->num_nodes++;
+		fprintf(t->out, "static struct STMT_FUNCTION_CALL nu_g%d = { .function_name = ", child);
+		write_c_string(t->out, call->function_name);
+		fprintf(t->out, ", .builtin = %d, .parameter = ", call->builtin);
+		write_parameter(t, parameter);
+		fprintf(t->out, ", .next_stmt = NULL };\n");
+	}
+
+	int n = t->num_nodes++;
+	fprintf(t->out, "static struct STMT nu_g%d = { .stmt_type = %d, .line = %d, .types.%s = &nu_g%d };\n",
+		n, stmt->stmt_type, stmt->line,
+		(stmt->stmt_type == STMT_ASSIGNMENT) ? "assignment" : "function_call", child);
+	return n;
+}
+
+
+//
+// write_typed_operand
+//
+// Writes the C expression for an operand of a typed expression,
+// converted to double if as_real.
+//
+static void write_typed_operand(struct TRANSPILER* t, struct UNARY_EXPR* expr, bool as_real)
+{
+	struct ELEMENT* element = expr->element;
+
+	switch (element->element_type) {
+		case ELEMENT_IDENTIFIER:
+			fprintf(t->body, as_real && t->types[element->slot] != STATIC_REAL ? "(double)v%d" : "v%d", element->slot);
+			break;
+		case ELEMENT_INT_LITERAL:
+			if (as_real) {
+				write_real(t->body, (double)atoi(element->element_value));
+			}
+			else {
+				write_int(t->body, atoi(element->element_value));
+			}
+			break;
+		case ELEMENT_REAL_LITERAL:
+			write_real(t->body, atof(element->element_value));
+			break;
+		case ELEMENT_TRUE:
+			fprintf(t->body, "1");
+			break;
+		default:
+			fprintf(t->body, "0");
+			break;
+	}
+}
+
+
+//
+// emit_checks
+//
+// Writes the checks that the typed locals in the given expression
+// have been assigned, in the order the executor reads them.
+//
+static void emit_check(struct TRANSPILER* t, struct UNARY_EXPR* expr, int line)
+{
+	if (expr->element->element_type == ELEMENT_IDENTIFIER) {
+		int slot = expr->element->slot;
+		indent(t);
+		fprintf(t->body, "if (!v%d_set) { nu_undefined(%d, %d); goto nu_exit; }\n", slot, slot, line);
+	}
+}
+
+static void emit_checks(struct TRANSPILER* t, struct EXPR* expr, int line)
+{
+	emit_check(t, expr->lhs, line);
+	if (expr->isBinaryExpr &&
+		(expr->rhs->element->element_type != ELEMENT_IDENTIFIER ||
+		 expr->lhs->element->element_type != ELEMENT_IDENTIFIER ||
+		 expr->rhs->element->slot != expr->lhs->element->slot)) {
+		emit_check(t, expr->rhs, line);
+	}
+}
+
+
+//
+// write_typed_expr
+//
+// Writes the C expression computing the given typed expression. For
+// division, the zero check must already have been emitted.
+//
+static void write_typed_expr(struct TRANSPILER* t, struct EXPR* expr)
+{
+	if (!expr->isBinaryExpr) {
+		write_typed_operand(t, expr->lhs, false);
+		return;
+	}
+
+	int lhs = operand_type(t, expr->lhs);
+	int rhs = operand_type(t, expr->rhs);
+	bool ints = (lhs == STATIC_INT && rhs == STATIC_INT);
+	bool reals = !ints;
+	FILE* out = t->body;
+
+	static const char* c_ops[] = { "+", "-", "*", "", "%", "/", "==", "!=", "<", "<=", ">", ">=" };
+
+	switch (expr->operator) {
+		case OPERATOR_PLUS:
+		case OPERATOR_MINUS:
+		case OPERATOR_ASTERISK:
+			if (ints) {
+				// wrap around like the interpreter does, without signed overflow
+				fprintf(out, "(int)((unsigned)");
+				write_typed_operand(t, expr->lhs, false);
+				fprintf(out, " %s (unsigned)", c_ops[expr->operator]);
+				write_typed_operand(t, expr->rhs, false);
+				fprintf(out, ")");
+				return;
+			}
+			break;
+
+		case OPERATOR_POWER:
+			fprintf(out, ints ? "nu_ipow(" : "pow(");
+			write_typed_operand(t, expr->lhs, reals);
+			fprintf(out, ", ");
+			write_typed_operand(t, expr->rhs, reals);
+			fprintf(out, ")");
+			return;
+
+		case OPERATOR_MOD:
+			if (reals) {
+				fprintf(out, "fmod(");
+				write_typed_operand(t, expr->lhs, true);
+				fprintf(out, ", ");
+				write_typed_operand(t, expr->rhs, true);
+				fprintf(out, ")");
+				return;
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	// relational operators compare ints as ints, and everything else as reals
+	fprintf(out, "(");
+	write_typed_operand(t, expr->lhs, reals);
+	fprintf(out, " %s ", c_ops[expr->operator]);
+	write_typed_operand(t, expr->rhs, reals);
+	fprintf(out, ")");
+}
+
+
+//
+// emit_zero_check
+//
+// Writes the division by zero check for a typed division.
+//
+static void emit_zero_check(struct TRANSPILER* t, struct EXPR* expr, int line)
+{
+	if (!expr->isBinaryExpr || expr->operator != OPERATOR_DIV) {
+		return;
+	}
+
+	bool reals = !(operand_type(t, expr->lhs) == STATIC_INT && operand_type(t, expr->rhs) == STATIC_INT);
+
+	indent(t);
+	fprintf(t->body, "if (");
+	write_typed_operand(t, expr->rhs, reals);
+	fprintf(t->body, reals ? " == 0.0" : " == 0");
+	fprintf(t->body, ") { nu_zero_division(%d); goto nu_exit; }\n", line);
+}
+
+
+//
+// write_boxed
+//
+// Writes the RAM_VALUE for the typed local bound to the given slot.
+//
+static void write_boxed(struct TRANSPILER* t, FILE* out, int slot)
+{
+	static const char* boxes[] = { "", "nu_int", "nu_real", "nu_bool" };
+
+	fprintf(out, "%s(v%d)", boxes[t->types[slot]], slot);
+}
+
+
+//
+// write_fetch
+//
+// Writes a C condition that fetches the given operand into the named
+// RAM_VALUE, and is false (error already reported) if it can't.
+//
+static void write_fetch(struct TRANSPILER* t, struct UNARY_EXPR* expr, const char* value, int line)
+{
+	struct ELEMENT* element = expr->element;
+	FILE* out = t->body;
+
+	if (expr->expr_type == UNARY_PTR_DEREF) {
+		fprintf(out, "nu_fetch_deref(memory, %d, %d, &%s)", element->slot, line, value);
+		return;
+	}
+	if (expr->expr_type == UNARY_ADDRESS_OF) {
+		fprintf(out, "nu_fetch_addr(memory, %d, %d, &%s)", element->slot, line, value);
+		return;
+	}
+
+	switch (element->element_type) {
+		case ELEMENT_IDENTIFIER: {
+			int slot = element->slot;
+			switch (t->types[slot]) {
+				case STATIC_INT:
+				case STATIC_REAL:
+				case STATIC_BOOL:
+					fprintf(out, "nu_typed(v%d_set, %d, %d, ", slot, slot, line);
+					write_boxed(t, out, slot);
+					fprintf(out, ", &%s)", value);
+					break;
+				default:
+					fprintf(out, "nu_fetch(memory, %d, %d, &%s)", slot, line, value);
+					break;
+			}
+			break;
+		}
+
+		case ELEMENT_INT_LITERAL:
+			fprintf(out, "(%s = nu_int(", value);
+			write_int(out, atoi(element->element_value));
+			fprintf(out, "), true)");
+			break;
+
+		case ELEMENT_REAL_LITERAL:
+			fprintf(out, "(%s = nu_real(", value);
+			write_real(out, atof(element->element_value));
+			fprintf(out, "), true)");
+			break;
+
+		case ELEMENT_STR_LITERAL:
+			fprintf(out, "(%s = nu_strs[%d], true)", value, add_str(t, element->element_value));
+			break;
+
+		case ELEMENT_TRUE:
+		case ELEMENT_FALSE:
+			fprintf(out, "(%s = nu_bool(%d), true)", value, element->element_type == ELEMENT_TRUE);
+			break;
+
+		default:
+			t->failed = true;
+			break;
+	}
+}
+
+
+//
+// emit_dynamic_expr
+//
+// Writes code that computes the given expression into the RAM_VALUE
+// named result (which then owns a reference if binary), leaving
+// run() on error.
+//
+static void emit_dynamic_expr(struct TRANSPILER* t, struct EXPR* expr, int line)
+{
+	indent(t);
+	if (!expr->isBinaryExpr) {
+		fprintf(t->body, "if (!");
+		write_fetch(t, expr->lhs, "result", line);
+		fprintf(t->body, ") goto nu_exit;\n");
+		return;
+	}
+
+	fprintf(t->body, "if (!");
+	write_fetch(t, expr->lhs, "lhs", line);
+	fprintf(t->body, " || !");
+	write_fetch(t, expr->rhs, "rhs", line);
+	fprintf(t->body, " ||\n");
+	indent(t);
+	fprintf(t->body, "\t!nu_binary(%d, lhs, rhs, &result, %d, memory, %s, %s)) goto nu_exit;\n",
+		expr->operator, line,
+		expr->lhs->expr_type == UNARY_PTR_DEREF ? "true" : "false",
+		expr->rhs->expr_type == UNARY_PTR_DEREF ? "true" : "false");
+}
+
+
+//
+// emit_assignment
+//
+// x = expr: a typed local is computed directly, anything else goes
+// through RAM.
+//
+static void emit_assignment(struct TRANSPILER* t, struct STMT* stmt)
+{
+	struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+	int slot = assignment->slot;
+
+	if (!is_native_stmt(stmt)) {
+		int node = emit_stmt_node(t, stmt);
+		indent(t);
+		fprintf(t->body, "if (!execute_assignment(&nu_g%d, memory)) goto nu_exit;\n", node);
+		return;
+	}
+
+	struct EXPR* expr = assignment->rhs->types.expr;
+
+	if (t->types[slot] != STATIC_DYNAMIC) {
+		emit_checks(t, expr, stmt->line);
+		emit_zero_check(t, expr, stmt->line);
+		indent(t);
+		fprintf(t->body, "v%d = ", slot);
+		write_typed_expr(t, expr);
+		fprintf(t->body, ";\n");
+
+		// the first assignment also gives the variable its RAM cell
+		indent(t);
+		fprintf(t->body, "if (!v%d_set && !nu_store(memory, ", slot);
+		write_boxed(t, t->body, slot);
+		fprintf(t->body, ", %d)) goto nu_exit;\n", slot);
+		indent(t);
+		fprintf(t->body, "v%d_set = true;\n", slot);
+		return;
+	}
+
+	indent(t);
+	fprintf(t->body, "{\n");
+	t->depth++;
+	indent(t);
+	fprintf(t->body, expr->isBinaryExpr ? "struct RAM_VALUE lhs, rhs, result = NU_NONE;\n" : "struct RAM_VALUE result;\n");
+	emit_dynamic_expr(t, expr, stmt->line);
+
+	indent(t);
+	if (expr->isBinaryExpr) {
+		fprintf(t->body, "bool stored = nu_store(memory, result, %d);\n", slot);
+		indent(t);
+		fprintf(t->body, "ram_value_release(&result);\n");
+		indent(t);
+		fprintf(t->body, "if (!stored) goto nu_exit;\n");
+	}
+	else {
+		fprintf(t->body, "if (!nu_store(memory, result, %d)) goto nu_exit;\n", slot);
+	}
+
+	t->depth--;
+	indent(t);
+	fprintf(t->body, "}\n");
+}
+
+
+//
+// emit_function_call
+//
+// print(...) is written out directly; any other call is left to the
+// executor.
+//
+static void emit_function_call(struct TRANSPILER* t, struct STMT* stmt)
+{
+	struct STMT_FUNCTION_CALL* call = stmt->types.function_call;
+	struct ELEMENT* parameter = call->parameter;
+
+	if (!is_native_stmt(stmt)) {
+		int node = emit_stmt_node(t, stmt);
+		indent(t);
+		fprintf(t->body, "if (!execute_function_call(&nu_g%d, memory)) goto nu_exit;\n", node);
+		return;
+	}
+
+	indent(t);
+
+	if (parameter == NULL) {
+		fprintf(t->body, "putchar('\\n');\n");
+		return;
+	}
+
+	char text[32];
+
+	switch (parameter->element_type) {
+		case ELEMENT_IDENTIFIER: {
+			int slot = parameter->slot;
+			switch (t->types[slot]) {
+				case STATIC_INT:
+				case STATIC_REAL:
+				case STATIC_BOOL:
+					fprintf(t->body, "if (!v%d_set) { nu_undefined(%d, %d); goto nu_exit; }\n", slot, slot, stmt->line);
+					indent(t);
+					if (t->types[slot] == STATIC_INT) {
+						fprintf(t->body, "printf(\"%%d\\n\", v%d);\n", slot);
+					}
+					else if (t->types[slot] == STATIC_REAL) {
+						fprintf(t->body, "printf(\"%%f\\n\", v%d);\n", slot);
+					}
+					else {
+						fprintf(t->body, "puts(v%d ? \"True\" : \"False\");\n", slot);
+					}
+					break;
+				default:
+					fprintf(t->body, "if (!nu_print(memory, %d, %d)) goto nu_exit;\n", slot, stmt->line);
+					break;
+			}
+			return;
+		}
+
+		case ELEMENT_INT_LITERAL:
+			snprintf(text, sizeof(text), "%d", atoi(parameter->element_value));
+			fprintf(t->body, "puts(");
+			write_c_string(t->body, text);
+			break;
+
+		case ELEMENT_REAL_LITERAL:
+			fprintf(t->body, "printf(\"%%f\\n\", ");
+			write_real(t->body, atof(parameter->element_value));
+			break;
+
+		case ELEMENT_STR_LITERAL:
+			fprintf(t->body, "puts(");
+			write_c_string(t->body, parameter->element_value);
+			break;
+
+		case ELEMENT_TRUE:
+			fprintf(t->body, "puts(\"True\"");
+			break;
+
+		case ELEMENT_FALSE:
+			fprintf(t->body, "puts(\"False\"");
+			break;
+
+		default:
+			fprintf(t->body, "puts(\"None\"");
+			break;
+	}
+
+	fprintf(t->body, ");\n");
+}
+
+
+static void emit_body(struct TRANSPILER* t, struct STMT* stmt, struct STMT* stop);
+
+//
+// emit_test
+//
+// Writes the code evaluating the condition of a while loop (loop is
+// true) or an if into a local go, exactly as the executor tests it:
+// non-zero to run the body / true path, 0 otherwise. Errors that stop
+// the program leave run().
+//
+static void emit_test(struct TRANSPILER* t, struct EXPR* condition, int line, bool loop)
+{
+	int type = is_native_expr(condition) ? expr_type(t, condition) : STATIC_DYNAMIC;
+	const char* is_loop = loop ? "true" : "false";
+
+	// a division can fail, and a failed test has its own rules: use RAM
+	if (condition->isBinaryExpr && (condition->operator == OPERATOR_DIV || condition->operator == OPERATOR_MOD)) {
+		type = STATIC_DYNAMIC;
+	}
+
+	if (type == STATIC_INT || type == STATIC_REAL || type == STATIC_BOOL) {
+		emit_checks(t, condition, line);
+		indent(t);
+		fprintf(t->body, "int go = (");
+		write_typed_expr(t, condition);
+		fprintf(t->body, type == STATIC_REAL ? " != 0.0);\n" : " != 0);\n");
+		return;
+	}
+
+	indent(t);
+	fprintf(t->body, (is_native_expr(condition) && condition->isBinaryExpr)
+		? "struct RAM_VALUE lhs, rhs, result = NU_NONE;\n" : "struct RAM_VALUE result = NU_NONE;\n");
+	indent(t);
+
+	if (!is_native_expr(condition)) {
+		int node = emit_expr_node(t, condition);
+		fprintf(t->body, "bool ok = execute_binary_expression(&nu_g%d, &result, memory, %d);\n", node, line);
+		indent(t);
+		fprintf(t->body, "int go = nu_test(ok, &result, true, %s, %d);\n", is_loop, line);
+	}
+	else if (!condition->isBinaryExpr) {
+		fprintf(t->body, "bool ok = ");
+		write_fetch(t, condition->lhs, "result", line);
+		fprintf(t->body, ";\n");
+		indent(t);
+		fprintf(t->body, "int go = nu_test(ok, &result, false, %s, %d);\n", is_loop, line);
+	}
+	else {
+		fprintf(t->body, "if (!");
+		write_fetch(t, condition->lhs, "lhs", line);
+		fprintf(t->body, " || !");
+		write_fetch(t, condition->rhs, "rhs", line);
+		fprintf(t->body, ") goto nu_exit;\n");
+		indent(t);
+		fprintf(t->body, "bool ok = nu_binary(%d, lhs, rhs, &result, %d, memory, %s, %s);\n",
+			condition->operator, line,
+			condition->lhs->expr_type == UNARY_PTR_DEREF ? "true" : "false",
+			condition->rhs->expr_type == UNARY_PTR_DEREF ? "true" : "false");
+		indent(t);
+		fprintf(t->body, "int go = nu_test(ok, &result, true, %s, %d);\n", is_loop, line);
+	}
+
+	indent(t);
+	fprintf(t->body, "if (go < 0) goto nu_exit;\n");
+}
+
+
+//
+// emit_while
+//
+// while cond: { body } becomes an infinite C loop that tests the
+// condition at the top, exactly as the executor does.
+//
+static void emit_while(struct TRANSPILER* t, struct STMT* stmt)
+{
+	struct STMT_WHILE_LOOP* loop = stmt->types.while_loop;
+
+	indent(t);
+	fprintf(t->body, "// line %d: while\n", stmt->line);
+	indent(t);
+	fprintf(t->body, "while (true) {\n");
+	t->depth++;
+
+	emit_test(t, loop->condition, stmt->line, true);
+	indent(t);
+	fprintf(t->body, "if (go == 0) break;\n");
+
+	emit_body(t, loop->loop_body, stmt);
+
+	t->depth--;
+	indent(t);
+	fprintf(t->body, "}\n");
+}
+
+
+//
+// emit_if
+//
+// if cond: { ... } else: { ... } becomes a C if / else in a block of
+// its own (for the test's locals); an elif is an if in the else.
+//
+static void emit_if(struct TRANSPILER* t, struct STMT* stmt)
+{
+	struct STMT_IF_THEN_ELSE* ifthen = stmt->types.if_then_else;
+
+	indent(t);
+	fprintf(t->body, "// line %d: if\n", stmt->line);
+	indent(t);
+	fprintf(t->body, "{\n");
+	t->depth++;
+
+	emit_test(t, ifthen->condition, stmt->line, false);
+	indent(t);
+	fprintf(t->body, "if (go != 0) {\n");
+	t->depth++;
+	emit_body(t, ifthen->true_path, ifthen->next_stmt);
+	t->depth--;
+	indent(t);
+	fprintf(t->body, "}\n");
+
+	if (ifthen->false_path != ifthen->next_stmt) {
+		indent(t);
+		fprintf(t->body, "else {\n");
+		t->depth++;
+		emit_body(t, ifthen->false_path, ifthen->next_stmt);
+		t->depth--;
+		indent(t);
+		fprintf(t->body, "}\n");
+	}
+
+	t->depth--;
+	indent(t);
+	fprintf(t->body, "}\n");
+}
+
+
+//
+// emit_body
+//
+// Writes the statements from stmt up to (but not including) stop.
+//
+static void emit_body(struct TRANSPILER* t, struct STMT* stmt, struct STMT* stop)
+{
+	while (stmt != stop && !t->failed) {
+		switch (stmt->stmt_type) {
+			case STMT_ASSIGNMENT:
+				indent(t);
+				fprintf(t->body, "// line %d: %s%s = ...\n", stmt->line,
+					stmt->types.assignment->isPtrDeref ? "*" : "", stmt->types.assignment->var_name);
+				emit_assignment(t, stmt);
+				break;
+
+			case STMT_FUNCTION_CALL:
+				indent(t);
+				fprintf(t->body, "// line %d: %s()\n", stmt->line, stmt->types.function_call->function_name);
+				emit_function_call(t, stmt);
+				break;
+
+			case STMT_IF_THEN_ELSE:
+				emit_if(t, stmt);
+				break;
+
+			case STMT_WHILE_LOOP:
+				emit_while(t, stmt);
+				break;
+
+			case STMT_PASS:
+				break;
+
+			default:
+				t->failed = true;
+				return;
+		}
+
+		stmt = next_stmt(stmt);
+	}
+}
+
+
+//
+// emit_program
+//
+// Writes the whole translation unit.
+//
+static void emit_program(struct TRANSPILER* t, struct STMT* program, const char* source)
+{
+	int num_slots = t->slots->num_slots;
+
+	fprintf(t->out, "//\n// Generated by the nuPython translator (--emit-c) from ");
+	fprintf(t->out, "%s; do not edit.\n", source);
+	fprintf(t->out, "// Build with: gcc -std=c11 -O2 <this file> execute.c ram.c -lm\n");
+	fprintf(t->out, "// (add -DNU_PRINT_MEMORY to print memory at exit, as the interpreter does)\n//\n\n");
+	fprintf(t->out, "#include <stdio.h>\n#include <stdlib.h>\n#include <stdbool.h>\n#include <math.h>\n\n");
+	fprintf(t->out, "#include \"programgraph.h\"\n#include \"ram.h\"\n#include \"execute.h\"\n\n");
+
+	// identifiers by slot, for error messages and RAM
+	fprintf(t->out, "static char* nu_names[] = {");
+	for (int slot = 0; slot < num_slots; slot++) {
+		fprintf(t->out, "%s\n\t", slot == 0 ? "" : ",");
+		write_c_string(t->out, t->slots->names[slot]);
+	}
+	fprintf(t->out, "%sNULL\n};\n\n", num_slots == 0 ? "\n\t" : ",\n\t");
+
+	for (int i = 0; prelude[i] != NULL; i++) {
+		fprintf(t->out, "%s\n", prelude[i]);
+	}
+	fprintf(t->out, "\n");
+
+	// run(): typed locals first, then the program
+	fprintf(t->body, "static void run(struct RAM* memory)\n{\n");
+	for (int slot = 0; slot < num_slots; slot++) {
+		int type = t->types[slot];
+		if (type == STATIC_INT || type == STATIC_BOOL) {
+			fprintf(t->body, "\tint v%d = 0;  // %s\n\tbool v%d_set = false;\n", slot, t->slots->names[slot], slot);
+		}
+		else if (type == STATIC_REAL) {
+			fprintf(t->body, "\tdouble v%d = 0.0;  // %s\n\tbool v%d_set = false;\n", slot, t->slots->names[slot], slot);
+		}
+	}
+	fprintf(t->body, "\n");
+
+	t->depth = 1;
+	emit_body(t, program, NULL);
+
+	// however run() ends, memory gets the final value of every typed local
+	fprintf(t->body, "\nnu_exit:\n\t;\n");
+	for (int slot = 0; slot < num_slots; slot++) {
+		int type = t->types[slot];
+		if (type == STATIC_INT || type == STATIC_REAL || type == STATIC_BOOL) {
+			fprintf(t->body, "\tif (v%d_set) nu_store(memory, ", slot);
+			write_boxed(t, t->body, slot);
+			fprintf(t->body, ", %d);\n", slot);
+		}
+	}
+	fprintf(t->body, "}\n");
+
+	if (t->failed) {
+		return;
+	}
+
+	// string literals
+	fprintf(t->out, "\nstatic struct RAM_VALUE nu_strs[%d];\n\n", t->num_strs + 1);
+	fprintf(t->out, "static bool nu_init_strs(void)\n{\n");
+	for (int i = 0; i < t->num_strs; i++) {
+		fprintf(t->out, "\tnu_strs[%d].value_type = RAM_TYPE_STR;\n", i);
+		fprintf(t->out, "\tif ((nu_strs[%d].types.s = ram_str_new(", i);
+		write_c_string(t->out, t->strs[i]);
+		fprintf(t->out, ")) == NULL) return false;\n");
+	}
+	fprintf(t->out, "\treturn true;\n}\n\n");
+
+	// the program itself
+	rewind(t->body);
+	char buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), t->body)) > 0) {
+		fwrite(buffer, 1, n, t->out);
+	}
+
+	fprintf(t->out, "\nint main(void)\n{\n");
+	fprintf(t->out, "\tstruct RAM* memory = ram_init();\n");
+	fprintf(t->out, "\tif (memory == NULL || !ram_reserve_slots(memory, %d) || !nu_init_strs()) {\n", num_slots);
+	fprintf(t->out, "\t\tprintf(\"**ERROR: out of memory\\n\");\n\t\treturn 1;\n\t}\n\n");
+	fprintf(t->out, "\trun(memory);\n\n");
+	fprintf(t->out, "#ifdef NU_PRINT_MEMORY\n\tram_print(memory);\n#endif\n\n");
+	fprintf(t->out, "\tfor (int i = 0; i < %d; i++) {\n\t\tram_value_release(&nu_strs[i]);\n\t}\n", t->num_strs);
+	fprintf(t->out, "\tram_destroy(memory);\n\treturn 0;\n}\n");
+}
+
+
+//
+// Public functions:
+//
+
+//
+// transpile_program
+//
+// Writes the C translation of the given (resolved) program graph to
+// the given output stream. Returns false if the program can't be
+// translated.
+//
+bool transpile_program(struct STMT* program, struct SLOT_TABLE* slots, FILE* output, const char* source)
+{
+	struct TRANSPILER t;
+
+	memset(&t, 0, sizeof(t));
+	t.out = output;
+	t.slots = slots;
+	t.strs_capacity = 16;
+	t.strs = (const char**)malloc(t.strs_capacity * sizeof(char*));
+	t.types = (int*)calloc(slots->num_slots + 1, sizeof(int));
+	t.body = tmpfile();
+
+	bool translated = false;
+
+	if (t.strs != NULL && t.types != NULL && t.body != NULL && mark_fallbacks(&t, program, NULL) &&
+		find_escapes(&t, program)) {
+
+		//
+		// iterate to a fixed point; a variable that never gets a type
+		// (e.g. it is only read) is left to RAM, which reports the error,
+		// and then so is anything assigned from it
+		//
+		bool unset;
+		do {
+			do {
+				t.changed = false;
+				infer_types(&t, program, NULL);
+			} while (t.changed);
+
+			unset = false;
+			for (int slot = 0; slot < slots->num_slots; slot++) {
+				if (t.types[slot] == STATIC_UNSET) {
+					t.types[slot] = STATIC_DYNAMIC;
+					unset = true;
+				}
+			}
+		} while (unset);
+
+		emit_program(&t, program, source);
+		translated = !t.failed && !ferror(t.out);
+	}
+
+	if (t.body != NULL) {
+		fclose(t.body);
+	}
+	free(t.strs);
+	free(t.types);
+
+	return translated;
+}
@@ -0,0 +1,44 @@
+/*transpile.h*/
+
+//
+// Ahead-of-time translator from a nuPython program graph to a C
+// translation unit (see main.c, --emit-c). The generated C has a
+// main() that runs the program; build it against the interpreter's
+// runtime:
+//
+//   gcc -std=c11 -O2 -o prog prog.c execute.c ram.c -lm
+//
+// Variables whose type can be proven from the program (int, real or
+// boolean everywhere they are assigned, and never reachable through a
+// pointer) become typed C locals. All other variables live in RAM and
+// go through the same helpers as the VM, and statements the VM leaves
+// to the executor are compiled into calls to it. The native program
+// prints the same output and semantic errors as execute() does.
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>  // true, false
+#include "programgraph.h"
+#include "resolve.h"
+
+
+//
+// Public functions:
+//
+
+//
+// transpile_program
+//
+// Writes the C translation of the given program graph, whose
+// identifiers have been resolved to the given slot table, to the
+// given output stream. The name of the nuPython source is only used
+// in comments. Returns false if the program can't be translated
+// or memory could not be allocated; the output is then incomplete.
+//
+bool transpile_program(struct STMT* program, struct SLOT_TABLE* slots, FILE* output, const char* source);
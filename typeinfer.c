@@ -0,0 +1,513 @@
+/*typeinfer.c*/
+
+//
+// << Type inference pass: proves the types of the operands of binary
+//    expressions ahead of time, so they aren't checked at run-time. >>
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+
+#include "programgraph.h"
+#include "ram.h"
+#include "resolve.h"
+#include "execute.h"
+#include "typeinfer.h"
+
+
+//
+// Besides the RAM types, what a variable may hold at some point:
+//
+#define DYNAMIC   (-1)  // different types on different paths
+#define UNDEFINED (-2)  // nothing yet (or the program stopped with an error)
+
+
+//
+// Private functions:
+//
+
+//
+// join
+//
+// The type a variable may have where paths with the given types meet.
+//
+static int join(int a, int b)
+{
+	if (a == UNDEFINED) return b;
+	if (b == UNDEFINED) return a;
+	return (a == b) ? a : DYNAMIC;
+}
+
+//
+// join_all
+//
+// Joins the types in other into types, returning true if any of them
+// changed.
+//
+static bool join_all(int* types, int* other, int num_slots)
+{
+	bool changed = false;
+
+	for (int slot = 0; slot < num_slots; slot++) {
+		int type = join(types[slot], other[slot]);
+		changed = changed || (type != types[slot]);
+		types[slot] = type;
+	}
+
+	return changed;
+}
+
+//
+// copy_types
+//
+// Returns a copy of the given types, or NULL if memory could not be
+// allocated.
+//
+static int* copy_types(int* types, int num_slots)
+{
+	int* copy = (int*)malloc((num_slots + 1) * sizeof(int));
+	if (copy != NULL) {
+		memcpy(copy, types, num_slots * sizeof(int));
+	}
+	return copy;
+}
+
+//
+// any_variable
+//
+// The type of *p: p may point to any variable that has a value.
+//
+static int any_variable(int* types, int num_slots)
+{
+	int type = UNDEFINED;
+
+	for (int slot = 0; slot < num_slots; slot++) {
+		type = join(type, types[slot]);
+	}
+
+	return type;
+}
+
+//
+// proven
+//
+// The annotation for a type: the type itself, or -1 if nothing is
+// proven about it.
+//
+static int proven(int type)
+{
+	return (type < 0) ? -1 : type;
+}
+
+//
+// element_type
+//
+// The type of the given element, which is annotated with it.
+//
+static int element_type(struct ELEMENT* element, int* types)
+{
+	int type = UNDEFINED;
+
+	if (element->constant != NULL) {
+		type = element->constant->value_type;
+	}
+	else {
+		switch (element->element_type) {
+			case ELEMENT_IDENTIFIER:   type = types[element->slot]; break;
+			case ELEMENT_INT_LITERAL:  type = RAM_TYPE_INT; break;
+			case ELEMENT_REAL_LITERAL: type = RAM_TYPE_REAL; break;
+			case ELEMENT_STR_LITERAL:  type = RAM_TYPE_STR; break;
+			case ELEMENT_TRUE:
+			case ELEMENT_FALSE:        type = RAM_TYPE_BOOLEAN; break;
+			default:                   type = UNDEFINED; break;  // an error
+		}
+	}
+
+	element->type = proven(type);
+	return type;
+}
+
+//
+// unary_type
+//
+// The type of the value of the given operand, as retrieve_value()
+// computes it.
+//
+static int unary_type(struct UNARY_EXPR* expr, int* types, int num_slots)
+{
+	int type = element_type(expr->element, types);
+
+	switch (expr->expr_type) {
+		case UNARY_ADDRESS_OF:
+			if (expr->element->element_type != ELEMENT_IDENTIFIER || type == UNDEFINED) {
+				return UNDEFINED;
+			}
+			return RAM_TYPE_PTR;
+
+		case UNARY_PTR_DEREF:
+			if (type != RAM_TYPE_PTR && type != DYNAMIC) {
+				return UNDEFINED;
+			}
+			return any_variable(types, num_slots);
+
+		default:
+			return type;
+	}
+}
+
+//
+// binary_type
+//
+// The type of lhs operator rhs, following determine_op_result(), or
+// UNDEFINED if it is an error for the given types.
+//
+static int binary_type(int operator, int lhs, int rhs, bool lhs_deref, bool rhs_deref)
+{
+	if (lhs == UNDEFINED || rhs == UNDEFINED) return UNDEFINED;
+	if (lhs == DYNAMIC || rhs == DYNAMIC) return DYNAMIC;
+
+	bool relational = is_relational_op(operator);
+	bool arithmetic = (operator == OPERATOR_PLUS || operator == OPERATOR_MINUS ||
+		operator == OPERATOR_ASTERISK || operator == OPERATOR_POWER ||
+		operator == OPERATOR_MOD || operator == OPERATOR_DIV);
+
+	if (lhs == RAM_TYPE_STR || rhs == RAM_TYPE_STR) {
+		if (lhs != rhs) return UNDEFINED;
+		if (operator == OPERATOR_PLUS) return RAM_TYPE_STR;
+		return relational ? RAM_TYPE_BOOLEAN : UNDEFINED;
+	}
+
+	if ((lhs == RAM_TYPE_PTR && rhs == RAM_TYPE_INT && !lhs_deref) ||
+		(rhs == RAM_TYPE_PTR && lhs == RAM_TYPE_INT && !rhs_deref)) {
+		return (operator == OPERATOR_PLUS || operator == OPERATOR_MINUS) ? RAM_TYPE_PTR : UNDEFINED;
+	}
+
+	bool lhs_number = (lhs == RAM_TYPE_INT || lhs == RAM_TYPE_REAL);
+	bool rhs_number = (rhs == RAM_TYPE_INT || rhs == RAM_TYPE_REAL);
+
+	if (!lhs_number || !rhs_number) return UNDEFINED;
+	if (relational) return RAM_TYPE_BOOLEAN;
+	if (!arithmetic) return UNDEFINED;
+
+	return (lhs == RAM_TYPE_INT && rhs == RAM_TYPE_INT) ? RAM_TYPE_INT : RAM_TYPE_REAL;
+}
+
+//
+// expr_type
+//
+// The type of the given expression, which is annotated with it (and,
+// if it is a binary expression that can succeed, with the proven types
+// of its operands).
+//
+static int expr_type(struct EXPR* expr, int* types, int num_slots)
+{
+	int lhs = unary_type(expr->lhs, types, num_slots);
+	int type = lhs;
+
+	expr->proven_key = 0;
+
+	if (expr->isBinaryExpr) {
+		int rhs = unary_type(expr->rhs, types, num_slots);
+
+		type = binary_type(expr->operator, lhs, rhs,
+			expr->lhs->expr_type == UNARY_PTR_DEREF, expr->rhs->expr_type == UNARY_PTR_DEREF);
+
+		if (lhs >= 0 && rhs >= 0 && type >= 0) {
+			expr->proven_key = OP_CACHE_KEY(lhs, rhs);
+		}
+	}
+
+	expr->type = proven(type);
+	return type;
+}
+
+//
+// call_type
+//
+// The type of the value returned by the given function call, as
+// handle_function() computes it.
+//
+static int call_type(struct FUNCTION_CALL* call, int* types)
+{
+	int parameter = (call->parameter != NULL) ? element_type(call->parameter, types) : UNDEFINED;
+
+	switch (call->builtin) {
+		case BUILTIN_INPUT:
+			return (call->parameter != NULL && call->parameter->element_type == ELEMENT_STR_LITERAL) ? RAM_TYPE_STR : UNDEFINED;
+
+		case BUILTIN_INT:
+		case BUILTIN_FLOAT:
+			// int(s) and float(s) need a string variable
+			if (call->parameter == NULL || call->parameter->element_type != ELEMENT_IDENTIFIER ||
+				(parameter != RAM_TYPE_STR && parameter != DYNAMIC)) {
+				return UNDEFINED;
+			}
+			return (call->builtin == BUILTIN_INT) ? RAM_TYPE_INT : RAM_TYPE_REAL;
+
+		default:
+			return UNDEFINED;
+	}
+}
+
+
+static bool infer_body(struct STMT* stmt, struct STMT* stop, int* types, int num_slots);
+
+//
+// infer_assignment
+//
+// Updates types for the given assignment. x = ... replaces the type of
+// x; *p = ... may write any variable that has a value.
+//
+static void infer_assignment(struct STMT_ASSIGNMENT* assignment, int* types, int num_slots)
+{
+	int type;
+
+	if (assignment->rhs->value_type == VALUE_FUNCTION_CALL) {
+		type = call_type(assignment->rhs->types.function_call, types);
+	}
+	else {
+		type = expr_type(assignment->rhs->types.expr, types, num_slots);
+	}
+
+	if (!assignment->isPtrDeref) {
+		types[assignment->slot] = type;
+		return;
+	}
+
+	int ptr = types[assignment->slot];
+	if (type == UNDEFINED || (ptr != RAM_TYPE_PTR && ptr != DYNAMIC)) {
+		return;  // an error, the program stops
+	}
+
+	for (int slot = 0; slot < num_slots; slot++) {
+		if (types[slot] != UNDEFINED) {
+			types[slot] = join(types[slot], type);
+		}
+	}
+}
+
+//
+// infer_loop
+//
+// Updates types for the given while loop: the body runs with the types
+// at the top of the loop, which are those before the loop joined with
+// those at the end of the body, so it is inferred until they stop
+// changing. The last round annotates the body with the final types.
+//
+static bool infer_loop(struct STMT* stmt, int* types, int num_slots)
+{
+	struct STMT_WHILE_LOOP* loop = stmt->types.while_loop;
+
+	while (true) {
+		expr_type(loop->condition, types, num_slots);
+
+		int* body = copy_types(types, num_slots);
+		if (body == NULL) {
+			return false;
+		}
+
+		bool inferred = infer_body(loop->loop_body, stmt, body, num_slots);
+		bool changed = inferred && join_all(types, body, num_slots);
+
+		free(body);
+
+		if (!inferred) return false;
+		if (!changed) return true;
+	}
+}
+
+//
+// infer_if
+//
+// Updates types for the given if statement: the types after it are
+// those at the end of each path, joined.
+//
+static bool infer_if(struct STMT* stmt, int* types, int num_slots)
+{
+	struct STMT_IF_THEN_ELSE* ifthen = stmt->types.if_then_else;
+
+	expr_type(ifthen->condition, types, num_slots);
+
+	int* true_path = copy_types(types, num_slots);
+	if (true_path == NULL) {
+		return false;
+	}
+
+	bool inferred = infer_body(ifthen->true_path, ifthen->next_stmt, true_path, num_slots) &&
+		infer_body(ifthen->false_path, ifthen->next_stmt, types, num_slots);
+
+	if (inferred) {
+		join_all(types, true_path, num_slots);
+	}
+
+	free(true_path);
+	return inferred;
+}
+
+//
+// infer_body
+//
+// Infers the statements from stmt up to (but not including) stop,
+// given the types variables may have before them; types is updated to
+// those after them. Returns false if memory could not be allocated.
+//
+static bool infer_body(struct STMT* stmt, struct STMT* stop, int* types, int num_slots)
+{
+	while (stmt != stop && stmt != NULL) {
+		switch (stmt->stmt_type) {
+			case STMT_ASSIGNMENT:
+				infer_assignment(stmt->types.assignment, types, num_slots);
+				stmt = stmt->types.assignment->next_stmt;
+				break;
+
+			case STMT_FUNCTION_CALL:
+				if (stmt->types.function_call->parameter != NULL) {
+					element_type(stmt->types.function_call->parameter, types);
+				}
+				stmt = stmt->types.function_call->next_stmt;
+				break;
+
+			case STMT_WHILE_LOOP:
+				if (!infer_loop(stmt, types, num_slots)) {
+					return false;
+				}
+				stmt = stmt->types.while_loop->next_stmt;
+				break;
+
+			case STMT_IF_THEN_ELSE:
+				if (!infer_if(stmt, types, num_slots)) {
+					return false;
+				}
+				stmt = stmt->types.if_then_else->next_stmt;
+				break;
+
+			default:
+				stmt = stmt->types.pass->next_stmt;
+				break;
+		}
+	}
+
+	return true;
+}
+
+//
+// count_expr / count_body
+//
+// Counts the binary expressions in the statements from stmt up to
+// stop, and those with proven operand types. If clear is true, the
+// annotations are removed instead (see typeinfer_program).
+//
+static void count_expr(struct EXPR* expr, struct TYPE_STATS* stats, bool clear)
+{
+	if (clear) {
+		expr->lhs->element->type = -1;
+		if (expr->isBinaryExpr) {
+			expr->rhs->element->type = -1;
+		}
+		expr->type = -1;
+		expr->proven_key = 0;
+	}
+
+	if (expr->isBinaryExpr) {
+		stats->operations++;
+		stats->proven += (expr->proven_key != 0);
+	}
+}
+
+static void count_body(struct STMT* stmt, struct STMT* stop, struct TYPE_STATS* stats, bool clear)
+{
+	while (stmt != stop && stmt != NULL) {
+		switch (stmt->stmt_type) {
+			case STMT_ASSIGNMENT: {
+				struct VALUE* rhs = stmt->types.assignment->rhs;
+
+				if (rhs->value_type == VALUE_EXPR) {
+					count_expr(rhs->types.expr, stats, clear);
+				}
+				else if (clear && rhs->types.function_call->parameter != NULL) {
+					rhs->types.function_call->parameter->type = -1;
+				}
+				stmt = stmt->types.assignment->next_stmt;
+				break;
+			}
+
+			case STMT_FUNCTION_CALL:
+				if (clear && stmt->types.function_call->parameter != NULL) {
+					stmt->types.function_call->parameter->type = -1;
+				}
+				stmt = stmt->types.function_call->next_stmt;
+				break;
+
+			case STMT_WHILE_LOOP: {
+				struct STMT_WHILE_LOOP* loop = stmt->types.while_loop;
+
+				count_expr(loop->condition, stats, clear);
+				count_body(loop->loop_body, stmt, stats, clear);
+				stmt = loop->next_stmt;
+				break;
+			}
+
+			case STMT_IF_THEN_ELSE: {
+				struct STMT_IF_THEN_ELSE* ifthen = stmt->types.if_then_else;
+
+				count_expr(ifthen->condition, stats, clear);
+				count_body(ifthen->true_path, ifthen->next_stmt, stats, clear);
+				count_body(ifthen->false_path, ifthen->next_stmt, stats, clear);
+				stmt = ifthen->next_stmt;
+				break;
+			}
+
+			default:
+				stmt = stmt->types.pass->next_stmt;
+				break;
+		}
+	}
+}
+
+
+//
+// Public functions:
+//
+
+//
+// typeinfer_program
+//
+// Infers the types of the given (resolved) program graph, annotating
+// it in place. Returns false if memory could not be allocated.
+//
+bool typeinfer_program(struct SLOT_TABLE* slots, struct STMT* program, struct TYPE_STATS* stats)
+{
+	int num_slots = slots->num_slots;
+
+	stats->operations = 0;
+	stats->proven = 0;
+
+	int* types = (int*)malloc((num_slots + 1) * sizeof(int));
+	if (types == NULL) {
+		return false;
+	}
+
+	// nothing is defined before the program runs
+	for (int slot = 0; slot < num_slots; slot++) {
+		types[slot] = UNDEFINED;
+	}
+
+	bool inferred = infer_body(program, NULL, types, num_slots);
+	free(types);
+
+	// a loop that wasn't finished may have been annotated with too few
+	// types, so none of it can be trusted
+	count_body(program, NULL, stats, !inferred);
+
+	if (!inferred) {
+		stats->operations = 0;
+		stats->proven = 0;
+	}
+	return inferred;
+}
@@ -0,0 +1,61 @@
+/*typeinfer.h*/
+
+//
+// Static type inference for a resolved nuPython program graph, run
+// after the optimizer. Most variables are only ever assigned one type,
+// so for most binary expressions the types of the operands are known
+// before the program runs; the pass proves them, so the executor and
+// the VM can go straight to the kernel for those types instead of
+// checking them every time (see cached_op_result in execute.c).
+//
+// The pass is flow-sensitive: it walks the graph keeping the type
+// each variable may have at each point, joining the types where the
+// paths of an if meet and iterating loops until nothing changes. A
+// variable with different types on different paths is dynamic from
+// there on. Since *p = ... may write any variable, it joins the type
+// written into every variable, and *p reads the join of all of them.
+//
+// A proven type means "if this is evaluated without an error, this is
+// its type": a variable that may not be defined yet still has a
+// proven type, since reading it before it is defined is an error.
+//
+// Results are stored in the graph: ELEMENT::type, EXPR::type and
+// EXPR::proven_key (see programgraph.h), -1 / 0 where nothing is
+// proven.
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+#include "programgraph.h"
+#include "resolve.h"
+
+
+//
+// what the pass proved, for --stats (see main.c):
+//
+struct TYPE_STATS
+{
+  int operations;  // # of binary expressions in the program
+  int proven;      // ... whose operand types were proven
+};
+
+
+//
+// Public functions:
+//
+
+//
+// typeinfer_program
+//
+// Infers the types of the given program graph, resolved to the given
+// slot table, and annotates its expressions and elements with them;
+// the counts are stored in stats. Returns false if memory could not be
+// allocated, in which case the annotations may be incomplete but are
+// never wrong.
+//
+bool typeinfer_program(struct SLOT_TABLE* slots, struct STMT* program, struct TYPE_STATS* stats);
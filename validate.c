@@ -0,0 +1,248 @@
+/*validate.c*/
+
+//
+// << Validation pass: marks the statements that are proven never to
+//    fail, so they can run without error checks. >>
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+
+#include "programgraph.h"
+#include "ram.h"
+#include "resolve.h"
+#include "execute.h"
+#include "validate.h"
+
+
+//
+// Private functions:
+//
+
+//
+// safe_operand
+//
+// Returns true if the given operand can be retrieved without an error:
+// a decoded literal, or a variable (or its address) defined on every
+// path to here. *p is never safe, since p may point anywhere.
+//
+static bool safe_operand(struct UNARY_EXPR* expr, bool* defined)
+{
+	struct ELEMENT* element = expr->element;
+
+	if (expr->expr_type == UNARY_PTR_DEREF) {
+		return false;
+	}
+
+	if (element->element_type == ELEMENT_IDENTIFIER) {
+		return defined[element->slot];
+	}
+
+	return expr->expr_type != UNARY_ADDRESS_OF && element->constant != NULL;
+}
+
+//
+// nonzero_literal
+//
+// Returns true if the given operand is a literal number other than 0.
+//
+static bool nonzero_literal(struct UNARY_EXPR* expr)
+{
+	const struct RAM_VALUE* value = expr->element->constant;
+
+	if (expr->expr_type == UNARY_PTR_DEREF || expr->expr_type == UNARY_ADDRESS_OF || value == NULL) {
+		return false;
+	}
+
+	switch (value->value_type) {
+		case RAM_TYPE_INT:  return value->types.i != 0;
+		case RAM_TYPE_REAL: return value->types.d != 0.0;
+		default:            return false;
+	}
+}
+
+//
+// safe_expr
+//
+// Returns true if the given expression can be computed without an
+// error: safe operands and, if it is binary, proven operand types for
+// which the operator can't fail (see validate.h).
+//
+static bool safe_expr(struct EXPR* expr, bool* defined)
+{
+	if (!safe_operand(expr->lhs, defined)) {
+		return false;
+	}
+
+	if (!expr->isBinaryExpr) {
+		return true;
+	}
+
+	if (!safe_operand(expr->rhs, defined) || expr->proven_key == 0) {
+		return false;
+	}
+
+	switch (expr->operator) {
+		case OPERATOR_DIV:
+			return nonzero_literal(expr->rhs);
+
+		case OPERATOR_MOD:
+			return expr->proven_key != OP_CACHE_KEY(RAM_TYPE_INT, RAM_TYPE_INT) || nonzero_literal(expr->rhs);
+
+		case OPERATOR_PLUS:
+			return expr->proven_key != OP_CACHE_KEY(RAM_TYPE_STR, RAM_TYPE_STR);
+
+		default:
+			return true;
+	}
+}
+
+//
+// safe_condition
+//
+// Returns true if the given while / if condition can be tested without
+// an error.
+//
+static bool safe_condition(struct EXPR* condition, bool* defined)
+{
+	return safe_expr(condition, defined) &&
+		(condition->type == RAM_TYPE_INT || condition->type == RAM_TYPE_REAL || condition->type == RAM_TYPE_BOOLEAN);
+}
+
+
+static bool validate_body(struct STMT* stmt, struct STMT* stop, bool* defined, int num_slots, struct VALIDATE_STATS* stats);
+
+//
+// validate_path
+//
+// Validates a loop body or a path of an if, which may not run at all:
+// what it defines doesn't count after it, so it works on a copy of
+// defined.
+//
+static bool validate_path(struct STMT* stmt, struct STMT* stop, bool* defined, int num_slots, struct VALIDATE_STATS* stats)
+{
+	bool* in_path = (bool*)malloc((num_slots + 1) * sizeof(bool));
+	if (in_path == NULL) {
+		return false;
+	}
+	memcpy(in_path, defined, num_slots * sizeof(bool));
+
+	bool validated = validate_body(stmt, stop, in_path, num_slots, stats);
+
+	free(in_path);
+	return validated;
+}
+
+//
+// validate_body
+//
+// Validates the statements from stmt up to (but not including) stop.
+// defined[slot] is true if the variable in slot surely has a value at
+// this point; the body updates it as it goes.
+//
+static bool validate_body(struct STMT* stmt, struct STMT* stop, bool* defined, int num_slots, struct VALIDATE_STATS* stats)
+{
+	while (stmt != stop && stmt != NULL) {
+		struct STMT* next = NULL;
+
+		switch (stmt->stmt_type) {
+			case STMT_ASSIGNMENT: {
+				struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+
+				stmt->safe = !assignment->isPtrDeref && assignment->rhs->value_type == VALUE_EXPR &&
+					safe_expr(assignment->rhs->types.expr, defined);
+
+				// if the assignment fails, execution stops: after it, x has a value
+				if (!assignment->isPtrDeref) {
+					defined[assignment->slot] = true;
+				}
+
+				next = assignment->next_stmt;
+				break;
+			}
+
+			case STMT_FUNCTION_CALL: {
+				struct STMT_FUNCTION_CALL* call = stmt->types.function_call;
+				struct ELEMENT* parameter = call->parameter;
+
+				stmt->safe = call->builtin == BUILTIN_PRINT &&
+					(parameter == NULL || parameter->element_type != ELEMENT_IDENTIFIER || defined[parameter->slot]);
+
+				next = call->next_stmt;
+				break;
+			}
+
+			case STMT_WHILE_LOOP: {
+				struct STMT_WHILE_LOOP* loop = stmt->types.while_loop;
+
+				// the body only adds definitions, so at the top of the loop they are those before it
+				stmt->safe = safe_condition(loop->condition, defined);
+
+				if (!validate_path(loop->loop_body, stmt, defined, num_slots, stats)) {
+					return false;
+				}
+
+				next = loop->next_stmt;
+				break;
+			}
+
+			case STMT_IF_THEN_ELSE: {
+				struct STMT_IF_THEN_ELSE* ifthen = stmt->types.if_then_else;
+
+				stmt->safe = safe_condition(ifthen->condition, defined);
+
+				if (!validate_path(ifthen->true_path, ifthen->next_stmt, defined, num_slots, stats) ||
+					!validate_path(ifthen->false_path, ifthen->next_stmt, defined, num_slots, stats)) {
+					return false;
+				}
+
+				next = ifthen->next_stmt;
+				break;
+			}
+
+			default:
+				stmt = stmt->types.pass->next_stmt;
+				continue;
+		}
+
+		stats->statements++;
+		stats->safe += stmt->safe;
+		stmt = next;
+	}
+
+	return true;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// validate_program
+//
+// Marks the statements of the given program graph that can't fail.
+// Returns false if memory could not be allocated.
+//
+bool validate_program(struct SLOT_TABLE* slots, struct STMT* program, struct VALIDATE_STATS* stats)
+{
+	stats->statements = 0;
+	stats->safe = 0;
+
+	// nothing is defined before the program runs
+	bool* defined = (bool*)calloc(slots->num_slots + 1, sizeof(bool));
+	if (defined == NULL) {
+		return false;
+	}
+
+	bool validated = validate_body(program, NULL, defined, slots->num_slots, stats);
+
+	free(defined);
+	return validated;
+}
@@ -0,0 +1,60 @@
+/*validate.h*/
+
+//
+// Ahead-of-time semantic validation for a nuPython program graph, run
+// after type inference (see typeinfer.h). Every statement normally
+// checks while it runs that its variables are defined, its functions
+// exist and its operand types work together; the pass proves which
+// statements can never fail those checks, and marks them safe
+// (STMT::safe), so the executor and the VM run them without checks.
+//
+// A statement is safe if
+//
+//   - every variable it reads has been assigned on all paths leading
+//     to it (a loop body may run zero times, an if takes one path)
+//   - its operand types are proven, and the operator can't fail for
+//     them: division (and integer %) only by a non-zero literal, and
+//     no string +, which allocates
+//   - it doesn't call a function other than print(), and doesn't read
+//     or write through a pointer
+//   - for a while or if, the condition's type is proven to be an int,
+//     a real or a boolean
+//
+// Anything else is run as before, so a program that fails reports the
+// same error at the same line as without the pass.
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+#include "programgraph.h"
+#include "resolve.h"
+
+
+//
+// what the pass proved, for --stats (see main.c):
+//
+struct VALIDATE_STATS
+{
+  int statements;  // # of statements in the program (except pass)
+  int safe;        // ... proven never to fail
+};
+
+
+//
+// Public functions:
+//
+
+//
+// validate_program
+//
+// Marks the statements of the given program graph, resolved to the
+// given slot table and with its types inferred, that can't fail; the
+// counts are stored in stats. Returns false if memory could not be
+// allocated, in which case only some of the safe statements are marked.
+//
+bool validate_program(struct SLOT_TABLE* slots, struct STMT* program, struct VALIDATE_STATS* stats);
@@ -0,0 +1,1628 @@
+/*vm.c*/
+
+//
+// << Bytecode compiler and virtual machine for nuPython. vm_compile()
+//    flattens the program graph into instructions with pre-resolved
+//    operands (slots and constant pool entries), and vm_execute() runs
+//    them in one dispatch loop. Semantics, error messages and line
+//    numbers match execute(); anything unusual is handed to it. >>
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+
+#include "programgraph.h"
+#include "ram.h"
+#include "execute.h"
+#include "resolve.h"
+#include "vm.h"
+#include "jit.h"
+#include "output.h"
+
+
+//
+// value_type of a register whose variable hasn't been assigned yet
+// (None is a value)
+//
+#define VM_UNDEFINED -1
+
+//
+// a list of registers being built (see assign_registers): the slots
+// in list, and listed[slot] => slot is in it
+//
+struct REG_LIST
+{
+  bool* in_register;  // in_register[slot] => slot is kept in a register
+  bool* listed;
+  int*  list;
+  int   length;
+};
+
+
+//
+// Private functions:
+//
+
+//
+// emit
+//
+// Appends a copy of the given instruction to the program, returning
+// its index or -1 if memory could not be allocated.
+//
+static int emit(struct VM_PROGRAM* vm, struct VM_INSTR instr)
+{
+	if (vm->num_instrs >= vm->capacity) {
+		int new_cap = vm->capacity * 2;
+		struct VM_INSTR* new_code = (struct VM_INSTR*)realloc(vm->code, new_cap * sizeof(struct VM_INSTR));
+		if (new_code == NULL) {
+			return -1;
+		}
+		vm->code = new_code;
+		vm->capacity = new_cap;
+	}
+
+	vm->code[vm->num_instrs] = instr;
+	return vm->num_instrs++;
+}
+
+
+//
+// new_instr
+//
+// Returns an instruction with the given opcode and line, and every
+// operand cleared.
+//
+static struct VM_INSTR new_instr(int opcode, int line)
+{
+	struct VM_INSTR instr;
+
+	memset(&instr, 0, sizeof(instr));
+	instr.opcode = opcode;
+	instr.line = line;
+	instr.dst = -1;
+	instr.operator = OPERATOR_NO_OP;
+	instr.target = -1;
+	instr.counter = -1;
+
+	return instr;
+}
+
+
+//
+// add_constant
+//
+// Adds the given value to the constant pool, which takes over the
+// reference to its string (if any). Returns the constant's index,
+// or -1 if memory could not be allocated.
+//
+static int add_constant(struct VM_PROGRAM* vm, struct RAM_VALUE value)
+{
+	if (vm->num_constants >= vm->const_capacity) {
+		int new_cap = vm->const_capacity * 2;
+		struct RAM_VALUE* new_consts = (struct RAM_VALUE*)realloc(vm->constants, new_cap * sizeof(struct RAM_VALUE));
+		if (new_consts == NULL) {
+			ram_value_release(&value);
+			return -1;
+		}
+		vm->constants = new_consts;
+		vm->const_capacity = new_cap;
+	}
+
+	vm->constants[vm->num_constants] = value;
+	return vm->num_constants++;
+}
+
+
+//
+// add_text_constant
+//
+// Adds a string constant holding the given text, returning its
+// index or -1 if memory could not be allocated.
+//
+static int add_text_constant(struct VM_PROGRAM* vm, const char* text)
+{
+	struct RAM_VALUE value;
+
+	value.value_type = RAM_TYPE_STR;
+	value.types.s = ram_str_new(text);
+	if (value.types.s == NULL) {
+		return -1;
+	}
+
+	return add_constant(vm, value);
+}
+
+
+//
+// compile_literal
+//
+// Decodes the given literal element into the constant pool, exactly
+// as the executor would decode it at run-time. Returns the constant's
+// index, or -1 if the element is not a literal (or out of memory).
+//
+static int compile_literal(struct VM_PROGRAM* vm, struct ELEMENT* element)
+{
+	struct RAM_VALUE value;
+
+	// decoded by the resolution pass, share it
+	if (element->constant != NULL) {
+		value = *element->constant;
+		ram_value_retain(&value);
+		return add_constant(vm, value);
+	}
+
+	switch (element->element_type) {
+		case ELEMENT_INT_LITERAL:
+			value.value_type = RAM_TYPE_INT;
+			value.types.i = atoi(element->element_value);
+			break;
+
+		case ELEMENT_REAL_LITERAL:
+			value.value_type = RAM_TYPE_REAL;
+			value.types.d = atof(element->element_value);
+			break;
+
+		case ELEMENT_STR_LITERAL:
+			return add_text_constant(vm, element->element_value);
+
+		case ELEMENT_TRUE:
+			value.value_type = RAM_TYPE_BOOLEAN;
+			value.types.i = 1;
+			break;
+
+		case ELEMENT_FALSE:
+			value.value_type = RAM_TYPE_BOOLEAN;
+			value.types.i = 0;
+			break;
+
+		default:
+			return -1;
+	}
+
+	return add_constant(vm, value);
+}
+
+
+//
+// compile_operand
+//
+// Compiles the given unary expression into an operand. Returns false
+// if the VM has no operand for it (e.g. None, or '&' applied to a
+// literal); the statement is then left to the executor.
+//
+static bool compile_operand(struct VM_PROGRAM* vm, struct UNARY_EXPR* expr, struct VM_OPERAND* operand)
+{
+	struct ELEMENT* element = expr->element;
+
+	operand->name = NULL;
+
+	// '*' and '&' only make sense on identifiers
+	if (expr->expr_type == UNARY_PTR_DEREF || expr->expr_type == UNARY_ADDRESS_OF) {
+		if (element->element_type != ELEMENT_IDENTIFIER) {
+			return false;
+		}
+		operand->kind = (expr->expr_type == UNARY_PTR_DEREF) ? VM_DEREF : VM_ADDR;
+		operand->index = element->slot;
+		operand->name = element->element_value;
+		return true;
+	}
+
+	// NOTE: the executor ignores unary '+' and '-', so we do too
+	if (element->element_type == ELEMENT_IDENTIFIER) {
+		operand->kind = VM_SLOT;
+		operand->index = element->slot;
+		operand->name = element->element_value;
+		return true;
+	}
+
+	operand->kind = VM_CONST;
+	operand->index = compile_literal(vm, element);
+	return operand->index != -1;
+}
+
+
+//
+// compile_assignment
+//
+// Compiles x = ... into a MOVE or BINARY instruction. Pointer writes
+// (*p = ...) and function calls are left to the executor.
+//
+static bool compile_assignment(struct VM_PROGRAM* vm, struct STMT* stmt)
+{
+	struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+	struct VM_INSTR instr = new_instr(VM_MOVE, stmt->line);
+
+	instr.dst = assignment->slot;
+	instr.dst_name = assignment->var_name;
+
+	bool compiled = false;
+
+	if (!assignment->isPtrDeref && assignment->rhs->value_type == VALUE_EXPR) {
+		struct EXPR* expr = assignment->rhs->types.expr;
+
+		if (expr->isBinaryExpr) {
+			instr.opcode = VM_BINARY;
+			instr.operator = expr->operator;
+			instr.expr = expr;
+			compiled = compile_operand(vm, expr->lhs, &instr.lhs) &&
+				compile_operand(vm, expr->rhs, &instr.rhs);
+		}
+		else {
+			compiled = compile_operand(vm, expr->lhs, &instr.lhs);
+		}
+	}
+
+	if (!compiled) {
+		instr = new_instr(VM_EXEC_STMT, stmt->line);
+		instr.stmt = stmt;
+	}
+	else {
+		instr.safe = stmt->safe;
+	}
+
+	return emit(vm, instr) != -1;
+}
+
+
+//
+// compile_function_call
+//
+// Compiles print(...) into a PRINT instruction. A literal argument is
+// formatted once, at compile-time, into a string constant.
+//
+static bool compile_function_call(struct VM_PROGRAM* vm, struct STMT* stmt)
+{
+	struct STMT_FUNCTION_CALL* call = stmt->types.function_call;
+	struct ELEMENT* parameter = call->parameter;
+	struct VM_INSTR instr = new_instr(VM_PRINT, stmt->line);
+
+	instr.lhs.kind = VM_CONST;
+	instr.lhs.index = -1;
+
+	if (call->builtin != BUILTIN_PRINT) {
+		instr.opcode = VM_EXEC_STMT;
+	}
+	else if (parameter == NULL) {
+		instr.lhs.index = add_text_constant(vm, "");
+	}
+	else {
+		char text[32];
+
+		switch (parameter->element_type) {
+			case ELEMENT_IDENTIFIER:
+				instr.lhs.kind = VM_SLOT;
+				instr.lhs.index = parameter->slot;
+				instr.lhs.name = parameter->element_value;
+				instr.safe = stmt->safe;
+				break;
+
+			case ELEMENT_INT_LITERAL:
+				snprintf(text, sizeof(text), "%d", atoi(parameter->element_value));
+				instr.lhs.index = add_text_constant(vm, text);
+				break;
+
+			case ELEMENT_REAL_LITERAL: {
+				double value = atof(parameter->element_value);
+				int len = snprintf(NULL, 0, "%f", value);
+				char* formatted = (char*)malloc(len + 1);
+				if (formatted == NULL) {
+					return false;
+				}
+				snprintf(formatted, len + 1, "%f", value);
+				instr.lhs.index = add_text_constant(vm, formatted);
+				free(formatted);
+				break;
+			}
+
+			case ELEMENT_STR_LITERAL:
+				instr.lhs.index = add_text_constant(vm, parameter->element_value);
+				break;
+
+			case ELEMENT_TRUE:
+				instr.lhs.index = add_text_constant(vm, "True");
+				break;
+
+			case ELEMENT_FALSE:
+				instr.lhs.index = add_text_constant(vm, "False");
+				break;
+
+			case ELEMENT_NONE:
+				instr.lhs.index = add_text_constant(vm, "None");
+				break;
+
+			default:
+				instr.opcode = VM_EXEC_STMT;
+				break;
+		}
+	}
+
+	if (instr.opcode == VM_EXEC_STMT) {
+		instr.stmt = stmt;
+	}
+	else if (instr.lhs.kind == VM_CONST && instr.lhs.index == -1) {
+		return false;
+	}
+
+	return emit(vm, instr) != -1;
+}
+
+
+static bool compile_body(struct VM_PROGRAM* vm, struct STMT* stmt, struct STMT* stop);
+
+//
+// compile_while
+//
+// Compiles a while loop into
+//
+//   top:  WHILE cond, else goto end
+//         <body>
+//         JUMP top
+//   end:
+//
+// If the condition has an operand the VM can't handle, WHILE keeps
+// the loop statement and evaluates the condition with the executor.
+//
+static bool compile_while(struct VM_PROGRAM* vm, struct STMT* stmt)
+{
+	struct STMT_WHILE_LOOP* loop = stmt->types.while_loop;
+	struct EXPR* condition = loop->condition;
+	struct VM_INSTR instr = new_instr(VM_WHILE, stmt->line);
+
+	bool compiled = compile_operand(vm, condition->lhs, &instr.lhs);
+	if (compiled && condition->isBinaryExpr) {
+		instr.operator = condition->operator;
+		compiled = compile_operand(vm, condition->rhs, &instr.rhs);
+	}
+
+	if (!compiled) {
+		instr = new_instr(VM_WHILE, stmt->line);
+		instr.stmt = stmt;
+	}
+	instr.expr = condition;
+	instr.safe = stmt->safe;
+	instr.counter = loop->counter_slot;
+	instr.step = loop->counter_step;
+
+	int top = emit(vm, instr);
+	if (top == -1 || !compile_body(vm, loop->loop_body, stmt)) {
+		return false;
+	}
+
+	struct VM_INSTR jump = new_instr(VM_JUMP, stmt->line);
+	jump.target = top;
+	if (emit(vm, jump) == -1) {
+		return false;
+	}
+
+	// now we know where the loop ends
+	vm->code[top].target = vm->num_instrs;
+	return true;
+}
+
+
+//
+// next_arm
+//
+// Returns the elif following the given arm of an if / elif chain that
+// ends at end, or NULL if there is none.
+//
+static struct STMT* next_arm(struct STMT* arm, struct STMT* end)
+{
+	struct STMT* false_path = arm->types.if_then_else->false_path;
+
+	if (false_path != end && false_path->stmt_type == STMT_IF_THEN_ELSE &&
+		false_path->types.if_then_else->next_stmt == end) {
+		return false_path;
+	}
+	return NULL;
+}
+
+
+//
+// case_test
+//
+// Returns true if the given condition is x == 3 or 3 == x, for some
+// variable x and int literal, setting *var to x and *value to 3.
+//
+static bool case_test(struct EXPR* condition, struct ELEMENT** var, int* value)
+{
+	if (!condition->isBinaryExpr || condition->operator != OPERATOR_EQUAL) {
+		return false;
+	}
+
+	struct UNARY_EXPR* operands[] = { condition->lhs, condition->rhs };
+
+	for (int i = 0; i < 2; i++) {
+		struct UNARY_EXPR* x = operands[i];
+		struct UNARY_EXPR* literal = operands[1 - i];
+
+		if (x->expr_type == UNARY_PTR_DEREF || x->expr_type == UNARY_ADDRESS_OF ||
+			literal->expr_type == UNARY_PTR_DEREF || literal->expr_type == UNARY_ADDRESS_OF) {
+			return false;
+		}
+
+		const struct RAM_VALUE* constant = literal->element->constant;
+
+		if (x->element->element_type == ELEMENT_IDENTIFIER && constant != NULL && constant->value_type == RAM_TYPE_INT) {
+			*var = x->element;
+			*value = constant->types.i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+//
+// new_switch
+//
+// Returns the SWITCH cases for the given values and targets, in arm
+// order (the first arm wins if a value repeats), or NULL if memory
+// could not be allocated. default_target fills the gaps of a table.
+//
+static struct VM_SWITCH* new_switch(int* values, int* targets, int num_cases, int default_target)
+{
+	struct VM_SWITCH* cases = (struct VM_SWITCH*)malloc(sizeof(struct VM_SWITCH));
+	if (cases == NULL) {
+		return NULL;
+	}
+
+	cases->num_cases = 0;
+	cases->values = (int*)malloc(num_cases * sizeof(int));
+	cases->targets = (int*)malloc(num_cases * sizeof(int));
+	cases->low = 0;
+	cases->table_len = 0;
+	cases->table = NULL;
+
+	if (cases->values == NULL || cases->targets == NULL) {
+		free(cases->values);
+		free(cases->targets);
+		free(cases);
+		return NULL;
+	}
+
+	// insertion sort, skipping values already seen
+	for (int i = 0; i < num_cases; i++) {
+		int j = cases->num_cases;
+		while (j > 0 && cases->values[j - 1] > values[i]) {
+			j--;
+		}
+		if (j > 0 && cases->values[j - 1] == values[i]) {
+			continue;
+		}
+
+		memmove(&cases->values[j + 1], &cases->values[j], (cases->num_cases - j) * sizeof(int));
+		memmove(&cases->targets[j + 1], &cases->targets[j], (cases->num_cases - j) * sizeof(int));
+		cases->values[j] = values[i];
+		cases->targets[j] = targets[i];
+		cases->num_cases++;
+	}
+
+	// a table when at least ~half its entries are cases, else binary search
+	long long range = (long long)cases->values[cases->num_cases - 1] - cases->values[0] + 1;
+
+	if (range <= 2LL * cases->num_cases + 8) {
+		cases->table = (int*)malloc(range * sizeof(int));
+		if (cases->table != NULL) {
+			cases->low = cases->values[0];
+			cases->table_len = (int)range;
+
+			for (int i = 0; i < cases->table_len; i++) {
+				cases->table[i] = default_target;
+			}
+			for (int i = 0; i < cases->num_cases; i++) {
+				cases->table[cases->values[i] - cases->low] = cases->targets[i];
+			}
+		}
+	}
+
+	return cases;
+}
+
+
+//
+// free_switch
+//
+static void free_switch(struct VM_SWITCH* cases)
+{
+	if (cases != NULL) {
+		free(cases->values);
+		free(cases->targets);
+		free(cases->table);
+		free(cases);
+	}
+}
+
+
+//
+// compile_if
+//
+// Compiles an if / elif / else chain into
+//
+//         [SWITCH x, else goto t3]
+//   t1:   IF cond1, else goto t2
+//         <body 1>
+//         JUMP end
+//   t2:   IF cond2, else goto t3
+//         <body 2>
+//         JUMP end
+//   t3:   <else body>
+//   end:
+//
+// If the chain starts with VM_SWITCH_MIN_CASES or more tests of the
+// same variable x against int literals, the SWITCH in front jumps
+// straight to the body for x's value (or past those tests), so the
+// decision takes O(1) instead of a test per arm. If x is not an int,
+// SWITCH falls through to the tests, which behave as the executor.
+//
+static bool compile_if(struct VM_PROGRAM* vm, struct STMT* stmt)
+{
+	struct STMT* end = stmt->types.if_then_else->next_stmt;
+
+	int num_arms = 0;
+	for (struct STMT* arm = stmt; arm != NULL; arm = next_arm(arm, end)) {
+		num_arms++;
+	}
+
+	int* jumps = (int*)malloc(num_arms * sizeof(int));
+	int* values = (int*)malloc(num_arms * sizeof(int));
+	int* targets = (int*)malloc(num_arms * sizeof(int));
+	bool compiled = (jumps != NULL && values != NULL && targets != NULL);
+
+	// the leading x == literal tests
+	struct ELEMENT* var = NULL;
+	int num_cases = 0;
+
+	for (struct STMT* arm = stmt; compiled && arm != NULL; arm = next_arm(arm, end)) {
+		struct ELEMENT* x;
+		if (!case_test(arm->types.if_then_else->condition, &x, &values[num_cases]) ||
+			(var != NULL && x->slot != var->slot)) {
+			break;
+		}
+		var = x;
+		num_cases++;
+	}
+
+	int switch_pc = -1;
+
+	if (compiled && num_cases >= VM_SWITCH_MIN_CASES) {
+		struct VM_INSTR instr = new_instr(VM_SWITCH, stmt->line);
+		instr.lhs.kind = VM_SLOT;
+		instr.lhs.index = var->slot;
+		instr.lhs.name = var->element_value;
+
+		switch_pc = emit(vm, instr);
+		compiled = (switch_pc != -1);
+	}
+
+	struct STMT* last = stmt;
+	int i = 0;
+
+	for (struct STMT* arm = stmt; compiled && arm != NULL; arm = next_arm(arm, end), i++) {
+		struct STMT_IF_THEN_ELSE* ifthen = arm->types.if_then_else;
+		struct VM_INSTR test = new_instr(VM_IF, arm->line);
+		test.expr = ifthen->condition;
+		test.safe = arm->safe;
+
+		int pc = emit(vm, test);
+		if (pc == -1 || !compile_body(vm, ifthen->true_path, end)) {
+			compiled = false;
+			break;
+		}
+
+		if (switch_pc != -1 && i < num_cases) {
+			targets[i] = pc + 1;
+		}
+		else if (switch_pc != -1 && i == num_cases) {
+			vm->code[switch_pc].target = pc;  // first test the SWITCH doesn't cover
+		}
+
+		// skip the other arms, unless there are none
+		jumps[i] = -1;
+		if (ifthen->false_path != end) {
+			jumps[i] = emit(vm, new_instr(VM_JUMP, arm->line));
+			compiled = (jumps[i] != -1);
+		}
+
+		vm->code[pc].target = vm->num_instrs;
+		last = arm;
+	}
+
+	if (compiled && switch_pc != -1 && num_cases == num_arms) {
+		vm->code[switch_pc].target = vm->num_instrs;  // the else body, or the end
+	}
+
+	if (compiled) {
+		compiled = compile_body(vm, last->types.if_then_else->false_path, end);
+	}
+
+	// now we know where the chain ends
+	for (int j = 0; compiled && j < num_arms; j++) {
+		if (jumps[j] != -1) {
+			vm->code[jumps[j]].target = vm->num_instrs;
+		}
+	}
+
+	if (compiled && switch_pc != -1) {
+		vm->code[switch_pc].cases = new_switch(values, targets, num_cases, vm->code[switch_pc].target);
+		compiled = (vm->code[switch_pc].cases != NULL);
+	}
+
+	free(jumps);
+	free(values);
+	free(targets);
+	return compiled;
+}
+
+
+//
+// compile_body
+//
+// Compiles the statements from stmt up to (but not including) stop,
+// which is NULL for the program, the while loop for a loop body, or
+// the statement after an if for its paths.
+//
+static bool compile_body(struct VM_PROGRAM* vm, struct STMT* stmt, struct STMT* stop)
+{
+	while (stmt != stop) {
+		bool compiled = false;
+
+		switch (stmt->stmt_type) {
+			case STMT_ASSIGNMENT:
+				compiled = compile_assignment(vm, stmt);
+				stmt = stmt->types.assignment->next_stmt;
+				break;
+
+			case STMT_FUNCTION_CALL:
+				compiled = compile_function_call(vm, stmt);
+				stmt = stmt->types.function_call->next_stmt;
+				break;
+
+			case STMT_IF_THEN_ELSE:
+				compiled = compile_if(vm, stmt);
+				stmt = stmt->types.if_then_else->next_stmt;
+				break;
+
+			case STMT_WHILE_LOOP:
+				compiled = compile_while(vm, stmt);
+				stmt = stmt->types.while_loop->next_stmt;
+				break;
+
+			case STMT_PASS:
+				// nothing to run
+				compiled = true;
+				stmt = stmt->types.pass->next_stmt;
+				break;
+
+			default:
+				break;
+		}
+
+		if (!compiled) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+//
+// list_slot / list_element / list_expr
+//
+// Adds the variable bound to the given slot / in the given element or
+// expression to the list, if it is kept in a register.
+//
+static void list_slot(struct REG_LIST* regs, int slot)
+{
+	if (slot >= 0 && regs->in_register[slot] && !regs->listed[slot]) {
+		regs->listed[slot] = true;
+		regs->list[regs->length++] = slot;
+	}
+}
+
+static void list_element(struct REG_LIST* regs, struct ELEMENT* element)
+{
+	if (element != NULL && element->element_type == ELEMENT_IDENTIFIER) {
+		list_slot(regs, element->slot);
+	}
+}
+
+static void list_expr(struct REG_LIST* regs, struct EXPR* expr)
+{
+	list_element(regs, expr->lhs->element);
+	if (expr->isBinaryExpr) {
+		list_element(regs, expr->rhs->element);
+	}
+}
+
+
+//
+// take_list
+//
+// Moves the list built so far into the given array, NULL if it is
+// empty, and starts a new one. Returns false if memory could not be
+// allocated.
+//
+static bool take_list(struct REG_LIST* regs, int** slots, int* num_slots)
+{
+	*slots = NULL;
+	*num_slots = 0;
+
+	if (regs->length > 0) {
+		*slots = (int*)malloc(regs->length * sizeof(int));
+		if (*slots == NULL) {
+			return false;
+		}
+		memcpy(*slots, regs->list, regs->length * sizeof(int));
+		*num_slots = regs->length;
+	}
+
+	for (int i = 0; i < regs->length; i++) {
+		regs->listed[regs->list[i]] = false;
+	}
+	regs->length = 0;
+
+	return true;
+}
+
+
+//
+// list_exec_stmt
+//
+// Lists the registers the executor reads running the given EXEC_STMT,
+// and makes the variable it assigns (if kept in a register) its dst.
+//
+static void list_exec_stmt(struct REG_LIST* regs, struct VM_INSTR* instr)
+{
+	if (instr->stmt->stmt_type != STMT_ASSIGNMENT) {
+		list_element(regs, instr->stmt->types.function_call->parameter);
+		return;
+	}
+
+	struct STMT_ASSIGNMENT* assignment = instr->stmt->types.assignment;
+
+	if (assignment->isPtrDeref) {
+		list_slot(regs, assignment->slot);  // p, in *p = ...
+	}
+	else if (regs->in_register[assignment->slot]) {
+		instr->dst = assignment->slot;
+		instr->dst_name = assignment->var_name;
+		instr->dst_reg = true;
+	}
+
+	if (assignment->rhs->value_type == VALUE_EXPR) {
+		list_expr(regs, assignment->rhs->types.expr);
+	}
+	else {
+		list_element(regs, assignment->rhs->types.function_call->parameter);
+	}
+}
+
+
+//
+// assign_registers
+//
+// Keeps the variables no pointer can reach (see escape.h) in registers:
+// their operands become VM_REG, and each instruction that hands RAM to
+// the executor or to native code lists the registers to sync. *p and
+// &x are taken from RAM, so p and x stay there. Returns false if memory
+// could not be allocated.
+//
+static bool assign_registers(struct VM_PROGRAM* vm, struct SLOT_TABLE* slots)
+{
+	if (slots == NULL || slots->escaped == NULL) {
+		return true;  // no escape analysis: everything stays in RAM
+	}
+
+	int num_slots = slots->num_slots;
+	struct REG_LIST regs;
+
+	regs.in_register = (bool*)calloc(num_slots + 1, sizeof(bool));
+	regs.listed = (bool*)calloc(num_slots + 1, sizeof(bool));
+	regs.list = (int*)malloc((num_slots + 1) * sizeof(int));
+	regs.length = 0;
+
+	bool assigned = (regs.in_register != NULL && regs.listed != NULL && regs.list != NULL);
+
+	if (assigned) {
+		for (int slot = 0; slot < num_slots; slot++) {
+			regs.in_register[slot] = !slots->escaped[slot];
+		}
+
+		for (int pc = 0; pc < vm->num_instrs; pc++) {
+			struct VM_OPERAND* operands[] = { &vm->code[pc].lhs, &vm->code[pc].rhs };
+			for (int i = 0; i < 2; i++) {
+				if (operands[i]->kind == VM_DEREF || operands[i]->kind == VM_ADDR) {
+					regs.in_register[operands[i]->index] = false;
+				}
+			}
+		}
+
+		for (int slot = 0; slot < num_slots; slot++) {
+			list_slot(&regs, slot);
+		}
+		assigned = take_list(&regs, &vm->reg_slots, &vm->num_regs);
+	}
+
+	if (assigned && vm->num_regs > 0) {
+		vm->registers = (struct RAM_VALUE*)malloc(num_slots * sizeof(struct RAM_VALUE));
+		assigned = (vm->registers != NULL);
+
+		for (int slot = 0; assigned && slot < num_slots; slot++) {
+			vm->registers[slot].value_type = VM_UNDEFINED;
+		}
+	}
+
+	for (int pc = 0; assigned && vm->registers != NULL && pc < vm->num_instrs; pc++) {
+		struct VM_INSTR* instr = &vm->code[pc];
+		struct VM_OPERAND* operands[] = { &instr->lhs, &instr->rhs };
+
+		for (int i = 0; i < 2; i++) {
+			if (operands[i]->kind == VM_SLOT && regs.in_register[operands[i]->index]) {
+				operands[i]->kind = VM_REG;
+			}
+		}
+
+		if (instr->dst != -1 && regs.in_register[instr->dst]) {
+			instr->dst_reg = true;
+		}
+
+		if (instr->opcode == VM_IF || instr->opcode == VM_WHILE) {
+			list_expr(&regs, instr->expr);
+		}
+		else if (instr->opcode == VM_EXEC_STMT) {
+			list_exec_stmt(&regs, instr);
+		}
+
+		assigned = take_list(&regs, &instr->syncs, &instr->num_syncs);
+	}
+
+	//
+	// the registers each loop uses; its native code only ever runs its
+	// own WHILE, MOVE, BINARY, PRINT and JUMP (see jit.c):
+	//
+	for (int pc = 0; assigned && vm->registers != NULL && pc < vm->num_instrs; pc++) {
+		struct VM_INSTR* loop = &vm->code[pc];
+		if (loop->opcode != VM_WHILE) {
+			continue;
+		}
+
+		for (int i = pc; i < loop->target; i++) {
+			struct VM_INSTR* instr = &vm->code[i];
+
+			if (instr->lhs.kind == VM_REG) {
+				list_slot(&regs, instr->lhs.index);
+			}
+			if (instr->rhs.kind == VM_REG) {
+				list_slot(&regs, instr->rhs.index);
+			}
+			if (instr->dst_reg && instr->opcode != VM_EXEC_STMT) {
+				list_slot(&regs, instr->dst);
+			}
+		}
+
+		assigned = take_list(&regs, &loop->loop_syncs, &loop->num_loop_syncs);
+	}
+
+	free(regs.in_register);
+	free(regs.listed);
+	free(regs.list);
+
+	return assigned;
+}
+
+
+//
+// slot_value
+//
+// Same as ram_borrow_cell_by_slot(), but inlined into the VM loop:
+// returns the value of the variable bound to slot, or NULL if it
+// has not been written yet.
+//
+static inline const struct RAM_VALUE* slot_value(struct RAM* memory, int slot)
+{
+	int addr = (slot < memory->num_slots) ? memory->slots[slot] : -1;
+	return (addr == -1) ? NULL : &memory->cells[addr].value;
+}
+
+
+//
+// write_registers
+//
+// Writes the given registers back to their variables' cells, before
+// the executor or native code reads RAM. A variable not assigned yet
+// has neither a value nor a cell.
+//
+static void write_registers(struct VM_PROGRAM* vm, struct RAM* memory, int* slots, int num_slots)
+{
+	for (int i = 0; i < num_slots; i++) {
+		struct RAM_VALUE* reg = &vm->registers[slots[i]];
+		if (reg->value_type == VM_UNDEFINED) {
+			continue;
+		}
+
+		int addr = memory->slots[slots[i]];
+		if (reg->value_type != RAM_TYPE_STR && memory->cells[addr].value.value_type != RAM_TYPE_STR) {
+			memory->cells[addr].value = *reg;
+		}
+		else {
+			ram_write_cell_by_addr(memory, *reg, addr);
+		}
+	}
+}
+
+
+//
+// load_registers
+//
+// Loads the given registers from their variables' cells, after the
+// executor or native code wrote RAM.
+//
+static void load_registers(struct VM_PROGRAM* vm, struct RAM* memory, int* slots, int num_slots)
+{
+	for (int i = 0; i < num_slots; i++) {
+		const struct RAM_VALUE* cell = slot_value(memory, slots[i]);
+		if (cell == NULL) {
+			continue;
+		}
+
+		struct RAM_VALUE* reg = &vm->registers[slots[i]];
+		struct RAM_VALUE value = *cell;
+
+		ram_value_retain(&value);
+		ram_value_release(reg);
+		*reg = value;
+	}
+}
+
+
+//
+// fetch
+//
+// Retrieves the value of the given operand, with the same checks and
+// error messages as the executor's retrieve_value(). Strings are NOT
+// copied: the value is borrowed from memory or the constant pool.
+//
+static bool fetch(struct VM_PROGRAM* vm, struct RAM* memory, struct VM_OPERAND* operand, struct RAM_VALUE* value, int line)
+{
+	switch (operand->kind) {
+		case VM_CONST:
+			*value = vm->constants[operand->index];
+			return true;
+
+		case VM_SLOT: {
+			const struct RAM_VALUE* var = slot_value(memory, operand->index);
+			if (var == NULL) {
+				output_error("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", operand->name, line);
+				return false;
+			}
+			*value = *var;
+			return true;
+		}
+
+		case VM_REG:
+			if (vm->registers[operand->index].value_type == VM_UNDEFINED) {
+				output_error("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", operand->name, line);
+				return false;
+			}
+			*value = vm->registers[operand->index];
+			return true;
+
+		case VM_ADDR: {
+			int addr = ram_get_addr_by_slot(memory, operand->index);
+			if (addr == -1) {
+				output_error("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", operand->name, line);
+				return false;
+			}
+			value->value_type = RAM_TYPE_PTR;
+			value->types.i = addr;
+			return true;
+		}
+
+		case VM_DEREF: {
+			const struct RAM_VALUE* ptr = slot_value(memory, operand->index);
+			if (ptr == NULL) {
+				output_error("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", operand->name, line);
+				return false;
+			}
+			if (ptr->value_type != RAM_TYPE_PTR) {
+				output_error("**SEMANTIC ERROR: invalid operand types (line %d)\n", line);
+				return false;
+			}
+			const struct RAM_VALUE* target = ram_borrow_cell_by_addr(memory, ptr->types.i);
+			if (target == NULL) {
+				output_error("**SEMANTIC ERROR: '%s' contains invalid address (line %d)\n", operand->name, line);
+				return false;
+			}
+			*value = *target;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+//
+// safe_fetch
+//
+// Same as fetch(), for an operand of an instruction proven never to
+// fail (see validate.h): the variable is surely defined, so nothing
+// is checked. Never a *p.
+//
+static inline struct RAM_VALUE safe_fetch(struct VM_PROGRAM* vm, struct RAM* memory, struct VM_OPERAND* operand)
+{
+	if (operand->kind == VM_CONST) {
+		return vm->constants[operand->index];
+	}
+	if (operand->kind == VM_REG) {
+		return vm->registers[operand->index];
+	}
+
+	int addr = memory->slots[operand->index];
+	if (operand->kind == VM_ADDR) {
+		struct RAM_VALUE value = { .value_type = RAM_TYPE_PTR, .types.i = addr };
+		return value;
+	}
+
+	return memory->cells[addr].value;
+}
+
+
+//
+// binary_op
+//
+// Computes lhs operator rhs into result, through the expression's
+// inline cache (see execute.h) so types, errors and pointer
+// arithmetic behave as in the executor. Two ints, proven (see
+// typeinfer.h) or a cache hit, with one of the common operators are
+// done inline.
+//
+static bool binary_op(struct VM_INSTR* instr, struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE* result, struct RAM* memory)
+{
+	bool proven = (instr->expr->proven_key == OP_CACHE_KEY(RAM_TYPE_INT, RAM_TYPE_INT));
+
+	if (proven || (instr->expr->cache_key == OP_CACHE_KEY(RAM_TYPE_INT, RAM_TYPE_INT) &&
+		lhs.value_type == RAM_TYPE_INT && rhs.value_type == RAM_TYPE_INT)) {
+		int a = lhs.types.i;
+		int b = rhs.types.i;
+		bool done = true;
+
+		switch (instr->operator) {
+			case OPERATOR_PLUS:      result->value_type = RAM_TYPE_INT; result->types.i = a + b; break;
+			case OPERATOR_MINUS:     result->value_type = RAM_TYPE_INT; result->types.i = a - b; break;
+			case OPERATOR_ASTERISK:  result->value_type = RAM_TYPE_INT; result->types.i = a * b; break;
+			case OPERATOR_EQUAL:     result->value_type = RAM_TYPE_BOOLEAN; result->types.i = (a == b); break;
+			case OPERATOR_NOT_EQUAL: result->value_type = RAM_TYPE_BOOLEAN; result->types.i = (a != b); break;
+			case OPERATOR_LT:        result->value_type = RAM_TYPE_BOOLEAN; result->types.i = (a < b); break;
+			case OPERATOR_LTE:       result->value_type = RAM_TYPE_BOOLEAN; result->types.i = (a <= b); break;
+			case OPERATOR_GT:        result->value_type = RAM_TYPE_BOOLEAN; result->types.i = (a > b); break;
+			case OPERATOR_GTE:       result->value_type = RAM_TYPE_BOOLEAN; result->types.i = (a >= b); break;
+			default:
+				done = false;
+				break;
+		}
+
+		if (done) {
+			if (proven) {
+				op_cache_stats.proven++;
+			}
+			else {
+				op_cache_stats.hits++;
+			}
+			return true;
+		}
+	}
+
+	return cached_op_result(instr->expr, lhs, rhs, result, instr->line, memory,
+		instr->lhs.kind == VM_DEREF, instr->rhs.kind == VM_DEREF);
+}
+
+
+//
+// store
+//
+// Writes the given value to the instruction's destination variable.
+//
+static bool store(struct VM_INSTR* instr, struct RAM_VALUE value, struct RAM* memory)
+{
+	// common case: overwriting a number with a number, no refcounts involved
+	int addr = (instr->dst < memory->num_slots) ? memory->slots[instr->dst] : -1;
+	if (addr != -1 && value.value_type != RAM_TYPE_STR &&
+		memory->cells[addr].value.value_type != RAM_TYPE_STR) {
+		memory->cells[addr].value = value;
+		return true;
+	}
+
+	if (!ram_write_cell_by_slot(memory, value, instr->dst, instr->dst_name)) {
+		output_error("**ERROR: Could not write variable to memory. Variable: %s\n", instr->dst_name);
+		return false;
+	}
+	return true;
+}
+
+
+//
+// store_register
+//
+// store(), for a destination variable kept in a register. It still
+// gets its cell when it is first assigned, so RAM hands out addresses
+// in the same order as the executor.
+//
+static bool store_register(struct VM_PROGRAM* vm, struct VM_INSTR* instr, struct RAM_VALUE value, struct RAM* memory)
+{
+	struct RAM_VALUE* reg = &vm->registers[instr->dst];
+
+	// common case: overwriting a number with a number
+	if (value.value_type != RAM_TYPE_STR && reg->value_type != RAM_TYPE_STR && reg->value_type != VM_UNDEFINED) {
+		*reg = value;
+		return true;
+	}
+
+	if (reg->value_type == VM_UNDEFINED && !store(instr, value, memory)) {
+		return false;
+	}
+
+	// reference the new string first, it may be the one in the register
+	ram_value_retain(&value);
+	ram_value_release(reg);
+	*reg = value;
+	return true;
+}
+
+
+//
+// print_value
+//
+// print(x) for a variable x, as execute_function_call() does it.
+//
+static bool print_value(struct VM_PROGRAM* vm, struct VM_INSTR* instr, struct RAM* memory)
+{
+	const struct RAM_VALUE* value;
+
+	if (instr->lhs.kind == VM_REG) {
+		value = &vm->registers[instr->lhs.index];
+		value = (value->value_type == VM_UNDEFINED) ? NULL : value;
+	}
+	else {
+		value = instr->safe
+			? &memory->cells[memory->slots[instr->lhs.index]].value
+			: slot_value(memory, instr->lhs.index);
+	}
+	if (value == NULL) {
+		output_error("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", instr->lhs.name, instr->line);
+		return false;
+	}
+
+	switch (value->value_type) {
+		case RAM_TYPE_INT:
+			output_int(value->types.i);
+			break;
+		case RAM_TYPE_REAL:
+			output_real(value->types.d);
+			break;
+		case RAM_TYPE_BOOLEAN:
+			output_line(value->types.i ? "True" : "False", value->types.i ? 4 : 5);
+			break;
+		case RAM_TYPE_STR:
+			output_line(value->types.s->chars, value->types.s->length);
+			break;
+		case RAM_TYPE_PTR:
+			output_int(value->types.i);
+			break;
+		default:
+			output_error("**ERROR: Unsupported variable type for '%s'\n", instr->lhs.name);
+			return false;
+	}
+
+	return true;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// vm_compile
+//
+// Compiles the given (resolved) program graph into bytecode, with the
+// variables no pointer can reach in registers. Returns NULL if memory
+// could not be allocated.
+//
+struct VM_PROGRAM* vm_compile(struct STMT* program, struct SLOT_TABLE* slots)
+{
+	struct VM_PROGRAM* vm = (struct VM_PROGRAM*)malloc(sizeof(struct VM_PROGRAM));
+	if (vm == NULL) {
+		return NULL;
+	}
+
+	vm->num_instrs = 0;
+	vm->capacity = 16;
+	vm->code = (struct VM_INSTR*)malloc(vm->capacity * sizeof(struct VM_INSTR));
+
+	vm->num_constants = 0;
+	vm->const_capacity = 16;
+	vm->constants = (struct RAM_VALUE*)malloc(vm->const_capacity * sizeof(struct RAM_VALUE));
+
+	vm->registers = NULL;
+	vm->reg_slots = NULL;
+	vm->num_regs = 0;
+
+	vm->use_jit = jit_available();
+	vm->dump_jit = false;
+
+	if (vm->code == NULL || vm->constants == NULL) {
+		vm_destroy(vm);
+		return NULL;
+	}
+
+	if (!compile_body(vm, program, NULL) || emit(vm, new_instr(VM_HALT, 0)) == -1 ||
+		!assign_registers(vm, slots)) {
+		vm_destroy(vm);
+		return NULL;
+	}
+
+	return vm;
+}
+
+
+//
+// vm_destroy
+//
+// Frees the memory associated with the given bytecode program.
+//
+void vm_destroy(struct VM_PROGRAM* vm)
+{
+	if (vm == NULL) {
+		return;
+	}
+
+	for (int i = 0; i < vm->num_constants; i++) {
+		ram_value_release(&vm->constants[i]);
+	}
+
+	for (int i = 0; i < vm->num_instrs; i++) {
+		jit_free(vm->code[i].jit);
+		free_switch(vm->code[i].cases);
+		free(vm->code[i].syncs);
+		free(vm->code[i].loop_syncs);
+	}
+
+	free(vm->registers);
+	free(vm->reg_slots);
+	free(vm->constants);
+	free(vm->code);
+	free(vm);
+}
+
+
+//
+// compile_loop
+//
+// The while loop at pc is hot: try compiling it to native code. If
+// that fails, we try again later (the types may have settled by then),
+// up to JIT_MAX_ATTEMPTS times.
+//
+static void compile_loop(struct VM_PROGRAM* vm, int pc, struct RAM* memory)
+{
+	struct VM_INSTR* instr = &vm->code[pc];
+
+	instr->hits = 0;
+	instr->jit_attempts++;
+	instr->jit = jit_compile_loop(vm, pc, memory);
+
+	if (instr->jit != NULL && vm->dump_jit) {
+		jit_dump(instr->jit, vm);
+	}
+}
+
+
+//
+// switch_target
+//
+// Returns the target of the SWITCH case for the given value, or the
+// given default target if there is no such case.
+//
+static int switch_target(struct VM_SWITCH* cases, int value, int default_target)
+{
+	if (cases->table_len > 0) {
+		long long i = (long long)value - cases->low;
+		return (i >= 0 && i < cases->table_len) ? cases->table[i] : default_target;
+	}
+
+	int lo = 0;
+	int hi = cases->num_cases - 1;
+
+	while (lo <= hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (cases->values[mid] == value) {
+			return cases->targets[mid];
+		}
+		if (cases->values[mid] < value) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid - 1;
+		}
+	}
+
+	return default_target;
+}
+
+
+//
+// bailed_out
+//
+// The loop's native code returned to the VM somewhere other than the
+// loop exit. If that keeps happening, the code was specialized for the
+// wrong types: throw it away so the loop is recompiled once it is hot
+// again.
+//
+static void bailed_out(struct VM_INSTR* instr)
+{
+	instr->jit->deopts++;
+
+	if (instr->jit->deopts > JIT_MAX_DEOPTS) {
+		jit_free(instr->jit);
+		instr->jit = NULL;
+		instr->hits = 0;
+	}
+}
+
+
+//
+// run
+//
+// The VM loop: runs the given bytecode program against the given
+// memory, stopping at the first semantic error.
+//
+static bool run(struct VM_PROGRAM* vm, struct RAM* memory)
+{
+	int pc = 0;
+
+	while (true) {
+		struct VM_INSTR* instr = &vm->code[pc];
+
+		switch (instr->opcode) {
+			case VM_MOVE: {
+				struct RAM_VALUE value;
+				if (instr->safe) {
+					value = safe_fetch(vm, memory, &instr->lhs);
+				}
+				else if (!fetch(vm, memory, &instr->lhs, &value, instr->line)) {
+					return false;
+				}
+				bool stored = instr->dst_reg
+					? store_register(vm, instr, value, memory)
+					: store(instr, value, memory);
+				if (!stored) {
+					return false;
+				}
+				pc++;
+				break;
+			}
+
+			case VM_BINARY: {
+				struct RAM_VALUE lhs, rhs;
+				struct RAM_VALUE result = { .value_type = RAM_TYPE_NONE };
+
+				if (instr->safe) {
+					lhs = safe_fetch(vm, memory, &instr->lhs);
+					rhs = safe_fetch(vm, memory, &instr->rhs);
+				}
+				else if (!fetch(vm, memory, &instr->lhs, &lhs, instr->line) ||
+					!fetch(vm, memory, &instr->rhs, &rhs, instr->line)) {
+					return false;
+				}
+
+				if (!binary_op(instr, lhs, rhs, &result, memory)) {
+					return false;
+				}
+
+				bool stored = instr->dst_reg
+					? store_register(vm, instr, result, memory)
+					: store(instr, result, memory);
+				ram_value_release(&result);
+				if (!stored) {
+					return false;
+				}
+				pc++;
+				break;
+			}
+
+			case VM_PRINT:
+				if (instr->lhs.kind == VM_CONST) {
+					output_line(vm->constants[instr->lhs.index].types.s->chars, vm->constants[instr->lhs.index].types.s->length);
+				}
+				else if (!print_value(vm, instr, memory)) {
+					return false;
+				}
+				pc++;
+				break;
+
+			case VM_JUMP:
+				pc = instr->target;
+				break;
+
+			case VM_WHILE: {
+				if (vm->use_jit && instr->jit == NULL && instr->jit_attempts < JIT_MAX_ATTEMPTS &&
+					++instr->hits >= JIT_HOT_LOOP) {
+					write_registers(vm, memory, instr->loop_syncs, instr->num_loop_syncs);
+					compile_loop(vm, pc, memory);
+				}
+
+				if (instr->jit != NULL) {
+					write_registers(vm, memory, instr->loop_syncs, instr->num_loop_syncs);
+					int next = jit_run(instr->jit, memory);
+					load_registers(vm, memory, instr->loop_syncs, instr->num_loop_syncs);
+					if (next != instr->target) {
+						bailed_out(instr);
+					}
+					if (next != pc) {
+						pc = next;
+						break;
+					}
+					// bailed out on the condition itself, so evaluate it here
+				}
+
+				write_registers(vm, memory, instr->syncs, instr->num_syncs);
+				int truth = instr->safe
+					? execute_safe_condition(instr->expr, memory, instr->line)
+					: execute_condition(instr->expr, true, memory, instr->line);
+				if (truth == CONDITION_HALT) {
+					return false;
+				}
+
+				pc = (truth == CONDITION_TRUE) ? pc + 1 : instr->target;
+				break;
+			}
+
+			case VM_IF: {
+				write_registers(vm, memory, instr->syncs, instr->num_syncs);
+				int truth = instr->safe
+					? execute_safe_condition(instr->expr, memory, instr->line)
+					: execute_condition(instr->expr, false, memory, instr->line);
+				if (truth == CONDITION_HALT) {
+					return false;
+				}
+
+				pc = (truth == CONDITION_TRUE) ? pc + 1 : instr->target;
+				break;
+			}
+
+			case VM_SWITCH: {
+				// not an int (or not defined): the tests decide, and report any error
+				const struct RAM_VALUE* value = (instr->lhs.kind == VM_REG)
+					? &vm->registers[instr->lhs.index]
+					: slot_value(memory, instr->lhs.index);
+				if (value == NULL || value->value_type != RAM_TYPE_INT) {
+					pc++;
+					break;
+				}
+
+				pc = switch_target(instr->cases, value->types.i, instr->target);
+				break;
+			}
+
+			case VM_EXEC_STMT: {
+				write_registers(vm, memory, instr->syncs, instr->num_syncs);
+				bool executed = (instr->stmt->stmt_type == STMT_ASSIGNMENT)
+					? execute_assignment(instr->stmt, memory)
+					: execute_function_call(instr->stmt, memory);
+				if (!executed) {
+					return false;
+				}
+				if (instr->dst_reg) {
+					load_registers(vm, memory, &instr->dst, 1);
+				}
+				pc++;
+				break;
+			}
+
+			case VM_HALT:
+			default:
+				return true;
+		}
+	}
+}
+
+
+//
+// vm_execute
+//
+// Runs the given bytecode program against the given memory, stopping
+// at the first semantic error. The registers start from memory (they
+// are empty unless it already holds the program's variables), and end
+// up back in it.
+//
+bool vm_execute(struct VM_PROGRAM* vm, struct RAM* memory)
+{
+	load_registers(vm, memory, vm->reg_slots, vm->num_regs);
+
+	bool finished = run(vm, memory);
+
+	write_registers(vm, memory, vm->reg_slots, vm->num_regs);
+
+	for (int i = 0; i < vm->num_regs; i++) {
+		ram_value_release(&vm->registers[vm->reg_slots[i]]);
+		vm->registers[vm->reg_slots[i]].value_type = VM_UNDEFINED;
+	}
+
+	return finished;
+}
+
+
+//
+// vm_print
+//
+// Prints the bytecode program and its constant pool, for debugging.
+//
+void vm_print(struct VM_PROGRAM* vm)
+{
+	static const char* opcodes[] = { "MOVE", "BINARY", "PRINT", "JUMP", "WHILE", "IF", "SWITCH", "EXEC_STMT", "HALT" };
+	static const char* kinds[] = { "const", "slot", "deref", "addr", "reg" };
+
+	printf("**BYTECODE**\n");
+
+	for (int pc = 0; pc < vm->num_instrs; pc++) {
+		struct VM_INSTR* instr = &vm->code[pc];
+
+		printf(" %d: %s (line %d)", pc, opcodes[instr->opcode], instr->line);
+
+		switch (instr->opcode) {
+			case VM_MOVE:
+			case VM_BINARY:
+			case VM_PRINT:
+			case VM_WHILE:
+				if (instr->stmt != NULL) {
+					printf(" <executor>");
+					break;
+				}
+				if (instr->dst != -1) {
+					printf(" %s %d (%s) <-", instr->dst_reg ? "reg" : "slot", instr->dst, instr->dst_name);
+				}
+				printf(" %s %d", kinds[instr->lhs.kind], instr->lhs.index);
+				if (instr->operator != OPERATOR_NO_OP) {
+					printf(" op %d %s %d", instr->operator, kinds[instr->rhs.kind], instr->rhs.index);
+				}
+				break;
+			case VM_SWITCH:
+				printf(" %s %d (%s), %d cases%s", kinds[instr->lhs.kind], instr->lhs.index, instr->lhs.name,
+					instr->cases->num_cases, (instr->cases->table_len > 0) ? ", table" : "");
+				break;
+			default:
+				break;
+		}
+
+		if (instr->target != -1) {
+			printf(" -> %d", instr->target);
+		}
+		printf("\n");
+	}
+
+	printf("**CONSTANTS**\n");
+
+	for (int i = 0; i < vm->num_constants; i++) {
+		struct RAM_VALUE* value = &vm->constants[i];
+
+		switch (value->value_type) {
+			case RAM_TYPE_INT:     printf(" %d: int, %d\n", i, value->types.i); break;
+			case RAM_TYPE_REAL:    printf(" %d: real, %lf\n", i, value->types.d); break;
+			case RAM_TYPE_STR:     printf(" %d: str, '%s'\n", i, value->types.s->chars); break;
+			case RAM_TYPE_BOOLEAN: printf(" %d: boolean, %s\n", i, value->types.i ? "True" : "False"); break;
+			default:               printf(" %d: unknown\n", i); break;
+		}
+	}
+
+	printf("**END BYTECODE**\n");
+}
@@ -0,0 +1,213 @@
+/*vm.h*/
+
+//
+// Bytecode compiler and virtual machine for nuPython. The program graph
+// is compiled once into a flat array of instructions whose operands are
+// already resolved: variables are slots (see resolve.h), and literals
+// are pre-decoded RAM_VALUEs in a per-program constant pool. The VM then
+// runs the instructions in a single loop, without walking STMT nodes or
+// re-parsing literals.
+//
+// The VM produces the same output, semantic errors and line numbers as
+// the tree-walking executor (execute.h), which remains available for
+// differential testing. Statements the VM has no instruction for are
+// handed to the executor as-is (see VM_EXEC_STMT).
+//
+// Variables no pointer can reach (see escape.h) are kept in the VM's
+// register file instead of their RAM cells while it runs. A variable
+// still gets its cell when it is first assigned, so RAM hands out the
+// same addresses, and the cell is brought up to date wherever RAM is
+// read instead: before the executor runs a statement or condition that
+// uses it, before a loop's native code runs (see jit.h), and when
+// vm_execute() returns, so memory at exit is the same too.
+//
+// << Brock Brown >>
+// << Northwestern University >>
+// << CS 211 >>
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+#include "programgraph.h"
+#include "ram.h"
+#include "resolve.h"
+
+struct JIT_LOOP;  // see jit.h
+
+
+//
+// min # of x == literal tests at the start of an if / elif chain for
+// the chain to get a SWITCH in front of it
+//
+#ifndef VM_SWITCH_MIN_CASES
+#define VM_SWITCH_MIN_CASES 4
+#endif
+
+
+//
+// instruction opcodes:
+//
+enum VM_OPCODES
+{
+  VM_MOVE = 0,   // dst = lhs
+  VM_BINARY,     // dst = lhs operator rhs
+  VM_PRINT,      // print(lhs)
+  VM_JUMP,       // goto target
+  VM_WHILE,      // if !(lhs [operator rhs]) goto target
+  VM_IF,         // if !(expr) goto target
+  VM_SWITCH,     // goto the case for int lhs, else target (else next if lhs isn't an int)
+  VM_EXEC_STMT,  // run stmt with the tree-walking executor
+  VM_HALT
+};
+
+//
+// where an instruction operand comes from:
+//
+enum VM_OPERAND_KINDS
+{
+  VM_CONST = 0,  // constants[index]
+  VM_SLOT,       // variable bound to slot index
+  VM_DEREF,      // *p, where p is bound to slot index
+  VM_ADDR,       // &x, where x is bound to slot index
+  VM_REG         // variable bound to slot index, kept in registers[index]
+};
+
+struct VM_OPERAND
+{
+  int   kind;   // enum VM_OPERAND_KINDS
+  int   index;  // constant index or slot
+  char* name;   // identifier, for error messages (NULL for constants)
+};
+
+//
+// SWITCH: the if / elif bodies to jump to for each value of x, either as
+// a table indexed by x - low (when the values are dense enough), or as
+// values sorted for binary search
+//
+struct VM_SWITCH
+{
+  int  num_cases;
+  int* values;    // sorted, no duplicates
+  int* targets;   // instruction index for values[i]
+
+  int  low;       // dense table: targets for low .. low + table_len - 1,
+  int  table_len; // 0 => no table
+  int* table;     // default target where there is no case
+};
+
+struct VM_INSTR
+{
+  int opcode;  // enum VM_OPCODES
+  int line;    // source line, for error messages
+  bool safe;   // MOVE / BINARY / PRINT / WHILE / IF: proven never to fail (see validate.h)
+
+  int   dst;       // slot written by MOVE / BINARY (and EXEC_STMT, if dst_reg)
+  char* dst_name;  // identifier bound to dst
+  bool  dst_reg;   // dst is kept in registers[dst]
+
+  int operator;    // enum OPERATORS, for BINARY / WHILE (NO_OP => unary)
+  struct VM_OPERAND lhs;
+  struct VM_OPERAND rhs;
+  struct EXPR* expr;  // BINARY: source expression, for its inline cache; WHILE / IF: the condition
+
+  int target;         // instruction index for JUMP / WHILE / IF / SWITCH
+  struct STMT* stmt;  // statement for EXEC_STMT
+  struct VM_SWITCH* cases;  // SWITCH only
+
+  //
+  // IF / WHILE / EXEC_STMT: the registers the executor reads, written
+  // back to their cells before it runs (EXEC_STMT's dst register is
+  // loaded from its cell after); WHILE also: the registers its loop
+  // uses, written back before its native code runs and loaded after
+  //
+  int* syncs;
+  int  num_syncs;
+  int* loop_syncs;
+  int  num_loop_syncs;
+
+  //
+  // WHILE only: # of times the condition has been evaluated, and the
+  // loop's native code once it is hot (see jit.h)
+  //
+  int hits;
+  int jit_attempts;
+  struct JIT_LOOP* jit;
+
+  //
+  // WHILE only: the loop's induction variable (see STMT_WHILE_LOOP),
+  // which the JIT keeps in a register, or -1
+  //
+  int counter;
+  int step;
+};
+
+struct VM_PROGRAM
+{
+  struct VM_INSTR* code;
+  int num_instrs;
+  int capacity;
+
+  //
+  // constant pool: literals decoded once at compile-time; the pool
+  // owns a reference to each string constant
+  //
+  struct RAM_VALUE* constants;
+  int num_constants;
+  int const_capacity;
+
+  //
+  // register file: registers[slot] holds the variable bound to slot,
+  // for each slot in reg_slots; NULL => no registers
+  //
+  struct RAM_VALUE* registers;
+  int* reg_slots;
+  int  num_regs;
+
+  bool use_jit;   // compile hot loops to native code? (default: if available)
+  bool dump_jit;  // print the native code for each loop compiled?
+};
+
+
+//
+// Public functions:
+//
+
+//
+// vm_compile
+//
+// Compiles the given program graph, whose identifiers have been
+// resolved to the given slots (see resolve_program), into bytecode.
+// If escape analysis has been run on the program (see escape.h), the
+// variables no pointer can reach are kept in registers. Returns NULL
+// if memory could not be allocated.
+//
+// NOTE: the bytecode refers to the program graph (names, and any
+// statements run by the executor), so the graph must outlive it.
+//
+struct VM_PROGRAM* vm_compile(struct STMT* program, struct SLOT_TABLE* slots);
+
+//
+// vm_destroy
+//
+// Frees the memory associated with the given bytecode program.
+//
+void vm_destroy(struct VM_PROGRAM* vm);
+
+//
+// vm_execute
+//
+// Runs the given bytecode program against the given memory. If a
+// semantic error occurs, an error message is output, execution
+// stops, and the function returns false --- exactly as execute()
+// does. Returns true if the program ran to the end. Either way, the
+// registers have been written back to memory.
+//
+bool vm_execute(struct VM_PROGRAM* vm, struct RAM* memory);
+
+//
+// vm_print
+//
+// Prints the bytecode program and its constant pool, for debugging.
+//
+void vm_print(struct VM_PROGRAM* vm);